@@ -0,0 +1,153 @@
+;;
+;; Compare persistent maps and vectors with copy-on-write of mutable
+;; containers, when each update has to keep the previous version.
+;; Also compare heaps with tree-maps used as priority queues, and
+;; the native trie for string keys with the generic one of util.trie.
+;;
+;; Run it in this directory, as 'gosh -I. bench.scm'.
+;;
+
+(add-load-path ".")
+
+(use data.persistent)
+(use data.heap)
+(use util.trie)
+(use util.sparse)
+(use gauche.time)
+
+(define *size* 100000)                  ; entries in the base version
+(define *versions* 200)                 ; versions derived from it
+
+(define (total-bytes) (cadr (assq :total-bytes (gc-stat))))
+
+(define (bench name thunk)
+  (print name)
+  (let1 b0 (total-bytes)
+    (time (thunk))
+    (format #t "  ~d bytes allocated per version\n"
+            (quotient (- (total-bytes) b0) *versions*))))
+
+(define base-ht
+  (rlet1 h (make-hash-table 'eqv?)
+    (dotimes [i *size*] (hash-table-put! h i i))))
+(define base-st
+  (rlet1 s (make-sparse-table 'eqv?)
+    (dotimes [i *size*] (sparse-table-set! s i i))))
+(define base-pm
+  (alist->persistent-map (map (^i (cons i i)) (iota *size*))))
+(define base-pv
+  (list->persistent-vector (iota *size*)))
+
+;; Each version updates one entry of the previous one, and all versions
+;; are kept alive.
+(bench "hash-table-copy + hash-table-put!"
+       (^[] (let loop ([i 0] [h base-ht] [vs '()])
+              (when (< i *versions*)
+                (let1 h2 (hash-table-copy h)
+                  (hash-table-put! h2 (* i 37) 'x)
+                  (loop (+ i 1) h2 (cons h2 vs)))))))
+
+(bench "sparse-table-copy + sparse-table-set!"
+       (^[] (let loop ([i 0] [s base-st] [vs '()])
+              (when (< i *versions*)
+                (let1 s2 (sparse-table-copy s)
+                  (sparse-table-set! s2 (* i 37) 'x)
+                  (loop (+ i 1) s2 (cons s2 vs)))))))
+
+(bench "persistent-map-put"
+       (^[] (let loop ([i 0] [m base-pm] [vs '()])
+              (when (< i *versions*)
+                (let1 m2 (persistent-map-put m (* i 37) 'x)
+                  (loop (+ i 1) m2 (cons m2 vs)))))))
+
+(bench "vector-copy + vector-set!"
+       (^[] (let loop ([i 0] [v (list->vector (iota *size*))] [vs '()])
+              (when (< i *versions*)
+                (let1 v2 (vector-copy v)
+                  (vector-set! v2 (* i 37) 'x)
+                  (loop (+ i 1) v2 (cons v2 vs)))))))
+
+(bench "persistent-vector-set"
+       (^[] (let loop ([i 0] [v base-pv] [vs '()])
+              (when (< i *versions*)
+                (let1 v2 (persistent-vector-set v (* i 37) 'x)
+                  (loop (+ i 1) v2 (cons v2 vs)))))))
+
+;; Batch construction
+(set! *versions* 1)
+
+(bench "build a map by persistent-map-put"
+       (^[] (let loop ([i 0] [m (make-persistent-map)])
+              (when (< i *size*)
+                (loop (+ i 1) (persistent-map-put m i i))))))
+
+(bench "build a map with a transient"
+       (^[] (let1 t (persistent-map-transient (make-persistent-map))
+              (dotimes [i *size*] (transient-map-put! t i i))
+              (transient-map-persistent! t))))
+
+(bench "build a vector by persistent-vector-push"
+       (^[] (let loop ([i 0] [v (persistent-vector)])
+              (when (< i *size*)
+                (loop (+ i 1) (persistent-vector-push v i))))))
+
+(bench "build a vector with a transient"
+       (^[] (let1 t (persistent-vector-transient (persistent-vector))
+              (dotimes [i *size*] (transient-vector-push! t i))
+              (transient-vector-persistent! t))))
+
+;; Priority queues: push *size* random priorities, then pop them all.
+(define priorities
+  (let1 v (make-vector *size*)
+    (dotimes [i *size*] (vector-set! v i (modulo (* i 7919) 100003)))
+    v))
+
+(bench "tree-map as a priority queue"
+       (^[] (let1 t (make-tree-map = <)
+              ;; tree-map doesn't allow duplicate keys; keep a count
+              (vector-for-each (^p (tree-map-update! t p (cut + <> 1) 0))
+                               priorities)
+              (until (tree-map-empty? t)
+                (let1 e (tree-map-min t)
+                  (if (= (cdr e) 1)
+                    (tree-map-delete! t (car e))
+                    (tree-map-put! t (car e) (- (cdr e) 1))))))))
+
+(dolist [arity '(2 4)]
+  (bench #"heap (arity ~arity)"
+         (^[] (let1 h (make-heap :arity arity)
+                (vector-for-each (^p (heap-push! h p)) priorities)
+                (until (heap-empty? h) (heap-pop! h))))))
+
+(bench "heap with a Scheme comparator"
+       (^[] (let1 h (make-heap :less-than (^[a b] (< a b)))
+              (vector-for-each (^p (heap-push! h p)) priorities)
+              (until (heap-empty? h) (heap-pop! h)))))
+
+;; String tries: build, look up every key, then report the heap
+;; retained by the trie.
+(define (gc-stat-ref key) (cadr (assq key (gc-stat))))
+(define (live-bytes)
+  (gc) (gc)
+  (- (gc-stat-ref :total-heap-size) (gc-stat-ref :free-bytes)))
+
+(define words
+  (vector-tabulate *size*
+                   (^i (string-append "/usr/share/gauche/lib/"
+                                      (number->string (* i 7919) 36)
+                                      "/index.html"))))
+
+(define (bench-trie name make)
+  (let* ([b0 (live-bytes)]
+         [t (begin (print name)
+                   (time (rlet1 t (make)
+                           (vector-for-each (^w (trie-put! t w #t)) words))))])
+    (time (vector-for-each (^w (trie-get t w)) words))
+    (format #t "  ~d bytes retained per key\n"
+            (quotient (- (live-bytes) b0) *size*))
+    (set! t #f)))
+
+(bench-trie "trie with a hash table per node"
+            (^[] (make-trie (cut make-hash-table 'eqv?))))
+(bench-trie "trie with native string keys"
+            (^[] (make-trie)))
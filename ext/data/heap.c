@@ -0,0 +1,373 @@
+/*
+ * heap.c - Binary and d-ary heaps
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "heap.h"
+
+/*===================================================================
+ * Constructor
+ */
+
+static void heap_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<%s %ld>",
+               INDEXED_HEAP_P(obj)? "indexed-heap" : "heap",
+               HEAP(obj)->size);
+}
+
+static ScmClass *heap_cpl[] = {
+    SCM_CLASS_STATIC_PTR(Scm_HeapClass),
+    SCM_CLASS_STATIC_PTR(Scm_CollectionClass),
+    SCM_CLASS_STATIC_PTR(Scm_TopClass),
+    NULL
+};
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_HeapClass, heap_print, NULL, NULL, NULL,
+                         heap_cpl+1);
+SCM_DEFINE_BUILTIN_CLASS(Scm_IndexedHeapClass, heap_print, NULL, NULL, NULL,
+                         heap_cpl);
+
+#define INITIAL_CAPACITY 16
+
+static Heap *alloc_heap(ScmClass *klass, ScmObj lessThan, int order,
+                        int arity)
+{
+    if (arity < 2 || arity > HEAP_MAX_ARITY) {
+        Scm_Error("heap arity must be between 2 and %d, but got %d",
+                  HEAP_MAX_ARITY, arity);
+    }
+    if (order == 0 && !SCM_PROCEDUREP(lessThan)) {
+        Scm_Error("procedure required for heap ordering, but got %S",
+                  lessThan);
+    }
+    Heap *h = SCM_NEW(Heap);
+    SCM_SET_CLASS(h, klass);
+    h->size = 0;
+    h->capacity = INITIAL_CAPACITY;
+    h->entries = SCM_NEW_ARRAY(HeapEntry, INITIAL_CAPACITY);
+    h->arity = arity;
+    h->order = order;
+    h->lessThan = lessThan;
+    h->index = NULL;
+    h->slots = NULL;
+    return h;
+}
+
+ScmObj MakeHeap(ScmObj lessThan, int order, int arity)
+{
+    return SCM_OBJ(alloc_heap(SCM_CLASS_HEAP, lessThan, order, arity));
+}
+
+ScmObj MakeIndexedHeap(ScmObj lessThan, int order, int arity,
+                       ScmHashType type)
+{
+    Heap *h = alloc_heap(SCM_CLASS_INDEXED_HEAP, lessThan, order, arity);
+    h->index = SCM_NEW(ScmHashCore);
+    Scm_HashCoreInitSimple(h->index, type, 0, NULL);
+    h->slots = SCM_NEW_ARRAY(ScmDictEntry*, INITIAL_CAPACITY);
+    return SCM_OBJ(h);
+}
+
+/*===================================================================
+ * Sifting
+ */
+
+static inline int heap_less(Heap *h, ScmObj a, ScmObj b)
+{
+    if (h->order != 0) {
+        if (SCM_INTP(a) && SCM_INTP(b)) {
+            ScmSmallInt x = SCM_INT_VALUE(a), y = SCM_INT_VALUE(b);
+            return (h->order > 0)? (x < y) : (x > y);
+        }
+        if (SCM_FLONUMP(a) && SCM_FLONUMP(b)) {
+            double x = SCM_FLONUM_VALUE(a), y = SCM_FLONUM_VALUE(b);
+            return (h->order > 0)? (x < y) : (x > y);
+        }
+        return Scm_NumCmp(a, b) * h->order < 0;
+    }
+    return !SCM_FALSEP(Scm_ApplyRec2(h->lessThan, a, b));
+}
+
+/* We store the position directly, bypassing the check of
+   SCM_DICT_SET_VALUE; it's a fixnum, and this is done for every swap. */
+#define SET_POSITION(h, i) \
+    ((h)->slots[i]->value = (intptr_t)SCM_MAKE_INT(i))
+
+static inline void heap_swap(Heap *h, ScmSmallInt i, ScmSmallInt j)
+{
+    HeapEntry t = h->entries[i];
+    h->entries[i] = h->entries[j];
+    h->entries[j] = t;
+    if (h->slots) {
+        ScmDictEntry *s = h->slots[i];
+        h->slots[i] = h->slots[j];
+        h->slots[j] = s;
+        SET_POSITION(h, i);
+        SET_POSITION(h, j);
+    }
+}
+
+static void sift_up(Heap *h, ScmSmallInt i)
+{
+    while (i > 0) {
+        ScmSmallInt p = (i-1)/h->arity;
+        if (!heap_less(h, h->entries[i].priority, h->entries[p].priority)) {
+            break;
+        }
+        heap_swap(h, i, p);
+        i = p;
+    }
+}
+
+static void sift_down(Heap *h, ScmSmallInt i)
+{
+    for (;;) {
+        ScmSmallInt c = i*h->arity + 1;
+        if (c >= h->size) break;
+        ScmSmallInt e = c + h->arity;
+        if (e > h->size) e = h->size;
+        ScmSmallInt best = c;
+        for (c++; c < e; c++) {
+            if (heap_less(h, h->entries[c].priority,
+                          h->entries[best].priority)) {
+                best = c;
+            }
+        }
+        if (!heap_less(h, h->entries[best].priority,
+                       h->entries[i].priority)) {
+            break;
+        }
+        heap_swap(h, i, best);
+        i = best;
+    }
+}
+
+/* Restores the heap property after the priority at I is changed. */
+static void sift(Heap *h, ScmSmallInt i)
+{
+    if (i > 0
+        && heap_less(h, h->entries[i].priority,
+                     h->entries[(i-1)/h->arity].priority)) {
+        sift_up(h, i);
+    } else {
+        sift_down(h, i);
+    }
+}
+
+/*===================================================================
+ * Operations
+ */
+
+static void ensure_capacity(Heap *h, ScmSmallInt n)
+{
+    if (n <= h->capacity) return;
+    ScmSmallInt newcap = h->capacity * 2;
+    if (newcap < n) newcap = n;
+    HeapEntry *e = SCM_NEW_ARRAY(HeapEntry, newcap);
+    memcpy(e, h->entries, sizeof(HeapEntry)*h->size);
+    h->entries = e;
+    if (h->slots) {
+        ScmDictEntry **s = SCM_NEW_ARRAY(ScmDictEntry*, newcap);
+        memcpy(s, h->slots, sizeof(ScmDictEntry*)*h->size);
+        h->slots = s;
+    }
+    h->capacity = newcap;
+}
+
+/* Appends an entry at the end, without restoring the heap property.
+   For an indexed heap, if VALUE is already in the heap, its priority
+   is changed and its position is returned.  Otherwise returns -1. */
+static ScmSmallInt heap_append(Heap *h, ScmObj priority, ScmObj value)
+{
+    ScmDictEntry *s = NULL;
+    if (h->index) {
+        s = Scm_HashCoreSearch(h->index, (intptr_t)value, SCM_DICT_CREATE);
+        if (s->value) {
+            ScmSmallInt i = SCM_INT_VALUE(SCM_DICT_VALUE(s));
+            h->entries[i].priority = priority;
+            return i;
+        }
+    }
+    ensure_capacity(h, h->size+1);
+    h->entries[h->size].priority = priority;
+    h->entries[h->size].value = value;
+    if (s) {
+        h->slots[h->size] = s;
+        SET_POSITION(h, h->size);
+    }
+    h->size++;
+    return -1;
+}
+
+/* For an indexed heap, this changes the priority of VALUE if it's
+   already in the heap. */
+void HeapPush(Heap *h, ScmObj priority, ScmObj value)
+{
+    ScmSmallInt i = heap_append(h, priority, value);
+    if (i >= 0) sift(h, i);
+    else        sift_up(h, h->size-1);
+}
+
+void HeapPushAll(Heap *h, ScmObj alist)
+{
+    ScmObj cp;
+    ScmSmallInt len = 0;
+    /* Check the argument first, so that we won't leave the heap
+       half-built on error. */
+    SCM_FOR_EACH(cp, alist) {
+        if (!SCM_PAIRP(SCM_CAR(cp))) {
+            Scm_Error("pair required, but got %S", SCM_CAR(cp));
+        }
+        len++;
+    }
+    if (!SCM_NULLP(cp)) Scm_Error("proper list required, but got %S", alist);
+    ensure_capacity(h, h->size + len);
+
+    if (h->index || len < h->size) {
+        SCM_FOR_EACH(cp, alist) {
+            HeapPush(h, SCM_CAAR(cp), SCM_CDAR(cp));
+        }
+    } else {
+        /* Floyd's heap construction takes O(n), while pushing them
+           one by one takes O(n log n). */
+        SCM_FOR_EACH(cp, alist) {
+            heap_append(h, SCM_CAAR(cp), SCM_CDAR(cp));
+        }
+        if (h->size > 1) {
+            for (ScmSmallInt i = (h->size-2)/h->arity; i >= 0; i--) {
+                sift_down(h, i);
+            }
+        }
+    }
+}
+
+/* Removes the entry at I. */
+static void heap_remove(Heap *h, ScmSmallInt i)
+{
+    ScmSmallInt last = h->size-1;
+    if (i != last) heap_swap(h, i, last);
+    if (h->index) {
+        Scm_HashCoreSearch(h->index, (intptr_t)h->entries[last].value,
+                           SCM_DICT_DELETE);
+        h->slots[last] = NULL;
+    }
+    h->entries[last].priority = SCM_FALSE; /* gc friendliness */
+    h->entries[last].value = SCM_FALSE;
+    h->size--;
+    if (i < h->size) sift(h, i);
+}
+
+/* Returns FALSE if the heap is empty. */
+int HeapPeek(Heap *h, ScmObj *priority, ScmObj *value)
+{
+    if (h->size == 0) return FALSE;
+    *priority = h->entries[0].priority;
+    *value = h->entries[0].value;
+    return TRUE;
+}
+
+int HeapPop(Heap *h, ScmObj *priority, ScmObj *value)
+{
+    if (!HeapPeek(h, priority, value)) return FALSE;
+    heap_remove(h, 0);
+    return TRUE;
+}
+
+/* Pops the top and pushes a new entry at once, which needs only
+   one sift-down.  Returns FALSE, without pushing, if the heap is empty. */
+int HeapReplace(Heap *h, ScmObj priority, ScmObj value,
+                ScmObj *oldpriority, ScmObj *oldvalue)
+{
+    if (h->size == 0) return FALSE;
+    if (h->index) {
+        /* an indexed heap may have VALUE at another position */
+        HeapPop(h, oldpriority, oldvalue);
+        HeapPush(h, priority, value);
+        return TRUE;
+    }
+    *oldpriority = h->entries[0].priority;
+    *oldvalue = h->entries[0].value;
+    h->entries[0].priority = priority;
+    h->entries[0].value = value;
+    sift_down(h, 0);
+    return TRUE;
+}
+
+void HeapClear(Heap *h)
+{
+    for (ScmSmallInt i=0; i<h->size; i++) {
+        h->entries[i].priority = h->entries[i].value = SCM_FALSE;
+        if (h->slots) h->slots[i] = NULL;
+    }
+    if (h->index) Scm_HashCoreClear(h->index);
+    h->size = 0;
+}
+
+/* In the order of the internal array. */
+ScmObj HeapToAlist(Heap *h)
+{
+    ScmObj r = SCM_NIL;
+    for (ScmSmallInt i=h->size-1; i>=0; i--) {
+        r = Scm_Acons(h->entries[i].priority, h->entries[i].value, r);
+    }
+    return r;
+}
+
+ScmObj HeapPriority(Heap *h, ScmObj value, ScmObj fallback)
+{
+    SCM_ASSERT(h->index);
+    ScmDictEntry *s = Scm_HashCoreSearch(h->index, (intptr_t)value,
+                                         SCM_DICT_GET);
+    if (s == NULL) return fallback;
+    return h->entries[SCM_INT_VALUE(SCM_DICT_VALUE(s))].priority;
+}
+
+int HeapDelete(Heap *h, ScmObj value)
+{
+    SCM_ASSERT(h->index);
+    ScmDictEntry *s = Scm_HashCoreSearch(h->index, (intptr_t)value,
+                                         SCM_DICT_GET);
+    if (s == NULL) return FALSE;
+    heap_remove(h, SCM_INT_VALUE(SCM_DICT_VALUE(s)));
+    return TRUE;
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_heap(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_HeapClass, "<heap>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_IndexedHeapClass, "<indexed-heap>",
+                        mod, NULL, 0);
+}
@@ -0,0 +1,109 @@
+/*
+ * heap.h - Binary and d-ary heaps
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_DATA_HEAP_H
+#define GAUCHE_DATA_HEAP_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTDATA_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/* An implicit d-ary heap on an array of (priority, value) entries.
+ *
+ * Priorities are compared either by a Scheme procedure, or, if the
+ * heap is created with < or >, numerically with inlined fast paths
+ * for fixnums and flonums.
+ *
+ * An indexed heap additionally keeps a hash table from each value
+ * to its position, so that the priority of a value can be changed
+ * (decrease-key) or the value can be removed in O(d log_d n) time.
+ * Each value can appear in an indexed heap at most once.
+ *
+ * We swap entries during sifting, instead of moving a hole, so that
+ * the heap keeps all of its entries even if the comparison procedure
+ * throws an error in the middle.
+ */
+
+typedef struct HeapEntryRec {
+    ScmObj priority;
+    ScmObj value;
+} HeapEntry;
+
+typedef struct HeapRec {
+    SCM_HEADER;
+    ScmSmallInt size;
+    ScmSmallInt capacity;
+    HeapEntry  *entries;
+    int         arity;          /* d, >= 2 */
+    int         order;          /* 1: numeric <, -1: numeric >,
+                                   0: use lessThan */
+    ScmObj      lessThan;
+    /* indexed heap only */
+    ScmHashCore *index;         /* value -> position (fixnum) */
+    ScmDictEntry **slots;       /* index entry of each position */
+} Heap;
+
+SCM_CLASS_DECL(Scm_HeapClass);
+SCM_CLASS_DECL(Scm_IndexedHeapClass);
+#define SCM_CLASS_HEAP          (&Scm_HeapClass)
+#define SCM_CLASS_INDEXED_HEAP  (&Scm_IndexedHeapClass)
+#define HEAP(obj)               ((Heap*)(obj))
+#define HEAPP(obj)              SCM_ISA(obj, SCM_CLASS_HEAP)
+#define INDEXED_HEAP_P(obj)     SCM_XTYPEP(obj, SCM_CLASS_INDEXED_HEAP)
+
+#define HEAP_MAX_ARITY  16
+
+extern ScmObj MakeHeap(ScmObj lessThan, int order, int arity);
+extern ScmObj MakeIndexedHeap(ScmObj lessThan, int order, int arity,
+                              ScmHashType type);
+
+extern void   HeapPush(Heap *h, ScmObj priority, ScmObj value);
+extern void   HeapPushAll(Heap *h, ScmObj alist);
+extern int    HeapPop(Heap *h, ScmObj *priority, ScmObj *value);
+extern int    HeapPeek(Heap *h, ScmObj *priority, ScmObj *value);
+extern int    HeapReplace(Heap *h, ScmObj priority, ScmObj value,
+                          ScmObj *oldpriority, ScmObj *oldvalue);
+extern void   HeapClear(Heap *h);
+extern ScmObj HeapToAlist(Heap *h);
+
+/* indexed heap only */
+extern ScmObj HeapPriority(Heap *h, ScmObj value, ScmObj fallback);
+extern int    HeapDelete(Heap *h, ScmObj value);
+
+extern void   Scm_Init_heap(ScmModule *mod);
+
+#endif /*GAUCHE_DATA_HEAP_H*/
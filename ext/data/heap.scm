@@ -0,0 +1,139 @@
+;;;
+;;; data.heap - priority queues
+;;;
+;;;   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(define-module data.heap
+  (use gauche.collection)
+  (export <heap> <indexed-heap> make-heap make-indexed-heap
+          heap? heap-size heap-empty? heap-push! heap-push-all!
+          heap-pop! heap-peek heap-replace! heap-clear! heap->alist
+          heap-update! heap-delete! heap-priority heap-exists?)
+  )
+(select-module data.heap)
+
+(inline-stub
+ "#include \"heap.h\""
+
+ (initcode "Scm_Init_heap(Scm_CurrentModule());")
+
+ (define-type <heap> "Heap*" "heap" "HEAPP" "HEAP")
+ (define-type <indexed-heap> "Heap*" "indexed heap"
+   "INDEXED_HEAP_P" "HEAP")
+
+ (define-cproc %make-heap (less-than order::<fixnum> arity::<fixnum>)
+   (result (MakeHeap less-than order arity)))
+
+ (define-cproc %make-indexed-heap (less-than order::<fixnum> arity::<fixnum>
+                                   type)
+   (let* ([t::ScmHashType SCM_HASH_EQV])
+     (cond
+      [(SCM_EQ type 'eq?)      (set! t SCM_HASH_EQ)]
+      [(SCM_EQ type 'eqv?)     (set! t SCM_HASH_EQV)]
+      [(SCM_EQ type 'equal?)   (set! t SCM_HASH_EQUAL)]
+      [(SCM_EQ type 'string=?) (set! t SCM_HASH_STRING)]
+      [else (Scm_Error "unsupported indexed-heap hash type: %S" type)])
+     (result (MakeIndexedHeap less-than order arity t))))
+
+ (define-cproc heap? (obj) ::<boolean> HEAPP)
+
+ (define-cproc heap-size (h::<heap>) ::<long>
+   (result (-> h size)))
+
+ (define-cproc heap-empty? (h::<heap>) ::<boolean>
+   (result (== (-> h size) 0)))
+
+ (define-cproc heap-push! (h::<heap> priority :optional value) ::<void>
+   (when (SCM_UNBOUNDP value) (set! value priority))
+   (HeapPush h priority value))
+
+ (define-cproc heap-push-all! (h::<heap> alist) ::<void> HeapPushAll)
+
+ (define-cproc heap-pop! (h::<heap> :optional fallback) ::(<top> <top>)
+   (let* ([p] [v])
+     (cond [(HeapPop h (& p) (& v)) (result p v)]
+           [(SCM_UNBOUNDP fallback)
+            (Scm_Error "heap is empty: %S" (SCM_OBJ h))]
+           [else (result fallback fallback)])))
+
+ (define-cproc heap-peek (h::<heap> :optional fallback) ::(<top> <top>)
+   (let* ([p] [v])
+     (cond [(HeapPeek h (& p) (& v)) (result p v)]
+           [(SCM_UNBOUNDP fallback)
+            (Scm_Error "heap is empty: %S" (SCM_OBJ h))]
+           [else (result fallback fallback)])))
+
+ (define-cproc heap-replace! (h::<heap> priority :optional value)
+   ::(<top> <top>)
+   (when (SCM_UNBOUNDP value) (set! value priority))
+   (let* ([p] [v])
+     (unless (HeapReplace h priority value (& p) (& v))
+       (Scm_Error "heap is empty: %S" (SCM_OBJ h)))
+     (result p v)))
+
+ (define-cproc heap-clear! (h::<heap>) ::<void> HeapClear)
+
+ (define-cproc heap->alist (h::<heap>) HeapToAlist)
+
+ (define-cproc heap-update! (h::<indexed-heap> value priority) ::<void>
+   (HeapPush h priority value))
+
+ (define-cproc heap-delete! (h::<indexed-heap> value) ::<boolean>
+   HeapDelete)
+
+ (define-cproc heap-priority (h::<indexed-heap> value :optional fallback)
+   (let* ([r (HeapPriority h value fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have %S" (SCM_OBJ h) value))
+     (result r)))
+
+ (define-cproc heap-exists? (h::<indexed-heap> value) ::<boolean>
+   (result (not (SCM_UNBOUNDP (HeapPriority h value SCM_UNBOUND)))))
+ )
+
+;; If LESS-THAN is < or >, priorities are compared numerically in C.
+(define (%heap-order less-than)
+  (cond [(eq? less-than <) 1]
+        [(eq? less-than >) -1]
+        [else 0]))
+
+(define (make-heap :key (less-than <) (arity 2))
+  (%make-heap less-than (%heap-order less-than) arity))
+
+(define (make-indexed-heap :key (less-than <) (arity 2) (type 'eqv?))
+  (%make-indexed-heap less-than (%heap-order less-than) arity type))
+
+;; Collection protocol.  Entries (priority . value) are visited in
+;; an unspecified order.
+(define-method call-with-iterator ((h <heap>) proc . _)
+  (let1 entries (heap->alist h)
+    (proc (^[] (null? entries)) (^[] (pop! entries)))))
+
+(define-method size-of ((h <heap>)) (heap-size h))
@@ -0,0 +1,167 @@
+/*
+ * persistent.h - Persistent maps and vectors
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_DATA_PERSISTENT_H
+#define GAUCHE_DATA_PERSISTENT_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTDATA_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/* Persistent collections are never modified once created; an update
+ * returns a new collection that shares most of its structure with the
+ * original.
+ *
+ * Each of them has a transient counterpart for batch updates.  A
+ * transient is created from a persistent collection in O(1), modified
+ * in place, and turned back to a persistent one in O(1) again.  Nodes
+ * are tagged by the 'edit' token of the transient that created them,
+ * and only such nodes are modified in place; shared nodes are copied
+ * on the first write as in persistent update.  Once a transient is made
+ * persistent, its token is dropped and it can no longer be modified.
+ *
+ * These structures are not intended to be used outside of ext/data,
+ * hence no 'Scm' prefix.
+ */
+
+/*
+ * Persistent map - Hash array mapped trie
+ */
+
+typedef struct PMapNodeRec PMapNode;
+
+typedef struct PMapRec {
+    SCM_HEADER;
+    u_long    size;             /* # of entries */
+    PMapNode *root;
+    ScmHashType type;
+    u_long    (*hashfn)(ScmObj key);
+    int       (*cmpfn)(ScmObj a, ScmObj b);
+    void     *edit;             /* transient only.  NULL if frozen. */
+} PMap;
+
+SCM_CLASS_DECL(Scm_PersistentMapClass);
+SCM_CLASS_DECL(Scm_TransientMapClass);
+#define SCM_CLASS_PERSISTENT_MAP  (&Scm_PersistentMapClass)
+#define SCM_CLASS_TRANSIENT_MAP   (&Scm_TransientMapClass)
+#define PMAP(obj)                 ((PMap*)(obj))
+#define PERSISTENT_MAP_P(obj)     SCM_XTYPEP(obj, SCM_CLASS_PERSISTENT_MAP)
+#define TRANSIENT_MAP_P(obj)      SCM_XTYPEP(obj, SCM_CLASS_TRANSIENT_MAP)
+#define ANY_PMAP_P(obj)           (PERSISTENT_MAP_P(obj)||TRANSIENT_MAP_P(obj))
+
+extern ScmObj MakePMap(ScmHashType type);
+extern ScmObj PMapRef(PMap *m, ScmObj key, ScmObj fallback);
+extern ScmObj PMapSet(PMap *m, ScmObj key, ScmObj value);
+extern ScmObj PMapDelete(PMap *m, ScmObj key);
+extern ScmObj PMapDiff(PMap *a, PMap *b, ScmObj absent);
+
+extern ScmObj PMapTransient(PMap *m);
+extern void   TMapSet(PMap *t, ScmObj key, ScmObj value);
+extern int    TMapDelete(PMap *t, ScmObj key);
+extern ScmObj TMapPersistent(PMap *t);
+
+/* The trie has at most this many levels; a 32bit hash value is
+   consumed 5 bits at a time. */
+#define PMAP_MAX_DEPTH 7
+
+/* Iterator.  Iterating a persistent map is always safe, for it never
+   changes.  The result of modifying a transient map during iteration
+   is undefined. */
+typedef struct PMapIterRec {
+    PMapNode *nodes[PMAP_MAX_DEPTH];
+    int       index[PMAP_MAX_DEPTH];
+    int       depth;            /* -1 when exhausted */
+    ScmObj    bucket;           /* rest of the current collision bucket */
+} PMapIter;
+
+extern void   PMapIterInit(PMapIter *it, PMap *m);
+extern ScmObj PMapIterNext(PMapIter *it);
+
+extern void   Scm_Init_pmap(ScmModule *mod);
+
+/*
+ * Persistent vector - 32-way radix balanced trie with a tail buffer
+ */
+
+typedef struct PVecNodeRec PVecNode;
+
+typedef struct PVecRec {
+    SCM_HEADER;
+    u_long    size;             /* # of elements */
+    int       shift;            /* 5 * (height of the trie) */
+    PVecNode *root;
+    PVecNode *tail;             /* the last 1-32 elements */
+    void     *edit;             /* transient only.  NULL if frozen. */
+} PVec;
+
+SCM_CLASS_DECL(Scm_PersistentVectorClass);
+SCM_CLASS_DECL(Scm_TransientVectorClass);
+#define SCM_CLASS_PERSISTENT_VECTOR  (&Scm_PersistentVectorClass)
+#define SCM_CLASS_TRANSIENT_VECTOR   (&Scm_TransientVectorClass)
+#define PVEC(obj)                    ((PVec*)(obj))
+#define PERSISTENT_VECTOR_P(obj)     \
+    SCM_XTYPEP(obj, SCM_CLASS_PERSISTENT_VECTOR)
+#define TRANSIENT_VECTOR_P(obj)      SCM_XTYPEP(obj, SCM_CLASS_TRANSIENT_VECTOR)
+#define ANY_PVEC_P(obj)  (PERSISTENT_VECTOR_P(obj)||TRANSIENT_VECTOR_P(obj))
+
+extern ScmObj MakePVec(void);
+extern ScmObj ListToPVec(ScmObj lis);
+extern ScmObj PVecRef(PVec *v, ScmSmallInt index, ScmObj fallback);
+extern ScmObj PVecSet(PVec *v, ScmSmallInt index, ScmObj value);
+extern ScmObj PVecPush(PVec *v, ScmObj value);
+extern ScmObj PVecPop(PVec *v);
+
+extern ScmObj PVecTransient(PVec *v);
+extern void   TVecSet(PVec *t, ScmSmallInt index, ScmObj value);
+extern void   TVecPush(PVec *t, ScmObj value);
+extern ScmObj TVecPop(PVec *t);
+extern ScmObj TVecPersistent(PVec *t);
+
+/* Iterator.  It walks a leaf at a time, instead of descending the trie
+   for each element. */
+typedef struct PVecIterRec {
+    PVec     *v;
+    u_long    index;
+    PVecNode *leaf;
+} PVecIter;
+
+extern void   PVecIterInit(PVecIter *it, PVec *v, u_long start);
+extern ScmObj PVecIterNext(PVecIter *it, ScmObj eofval);
+
+extern void   Scm_Init_pvec(ScmModule *mod);
+
+#endif /*GAUCHE_DATA_PERSISTENT_H*/
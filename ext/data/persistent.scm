@@ -0,0 +1,323 @@
+;;;
+;;; data.persistent - persistent maps and vectors
+;;;
+;;;   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(define-module data.persistent
+  (use gauche.dictionary)
+  (use gauche.sequence)
+  (export <persistent-map> <transient-map>
+          make-persistent-map persistent-map? persistent-map-size
+          persistent-map-ref persistent-map-exists?
+          persistent-map-put persistent-map-delete persistent-map-update
+          persistent-map-fold persistent-map-for-each persistent-map-map
+          persistent-map-keys persistent-map-values
+          persistent-map->alist alist->persistent-map
+          persistent-map-diff persistent-map-transient
+          transient-map-size transient-map-ref transient-map-exists?
+          transient-map-put! transient-map-delete! transient-map-persistent!
+
+          <persistent-vector> <transient-vector>
+          persistent-vector list->persistent-vector vector->persistent-vector
+          persistent-vector? persistent-vector-length persistent-vector-ref
+          persistent-vector-set persistent-vector-push persistent-vector-pop
+          persistent-vector-fold persistent-vector-for-each
+          persistent-vector->list persistent-vector->vector
+          persistent-vector-transient
+          transient-vector-length transient-vector-ref transient-vector-set!
+          transient-vector-push! transient-vector-pop!
+          transient-vector-persistent!
+          )
+  )
+(select-module data.persistent)
+
+(inline-stub
+ "#include \"persistent.h\""
+ )
+
+;;===============================================================
+;; Persistent maps
+;;
+
+(inline-stub
+ (initcode "Scm_Init_pmap(Scm_CurrentModule());")
+
+ (define-type <persistent-map> "PMap*" "persistent map"
+   "PERSISTENT_MAP_P" "PMAP")
+ (define-type <transient-map> "PMap*" "transient map"
+   "TRANSIENT_MAP_P" "PMAP")
+ (define-type <pmap> "PMap*" "persistent or transient map"
+   "ANY_PMAP_P" "PMAP")
+
+ (define-cproc make-persistent-map (:optional (type 'eqv?))
+   (let* ([t::ScmHashType SCM_HASH_EQV])
+     (cond
+      [(SCM_EQ type 'eq?)      (set! t SCM_HASH_EQ)]
+      [(SCM_EQ type 'eqv?)     (set! t SCM_HASH_EQV)]
+      [(SCM_EQ type 'equal?)   (set! t SCM_HASH_EQUAL)]
+      [(SCM_EQ type 'string=?) (set! t SCM_HASH_STRING)]
+      [else (Scm_Error "unsupported persistent-map hash type: %S" type)])
+     (result (MakePMap t))))
+
+ (define-cproc persistent-map? (obj) ::<boolean> PERSISTENT_MAP_P)
+
+ (define-cproc persistent-map-size (m::<persistent-map>) ::<ulong>
+   (result (-> m size)))
+
+ (define-cproc persistent-map-ref (m::<persistent-map> key :optional fallback)
+   (let* ([r (PMapRef m key fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have an entry for key %S" (SCM_OBJ m) key))
+     (result r)))
+
+ (define-cproc persistent-map-exists? (m::<persistent-map> key) ::<boolean>
+   (result (not (SCM_UNBOUNDP (PMapRef m key SCM_UNBOUND)))))
+
+ (define-cproc persistent-map-put (m::<persistent-map> key value) PMapSet)
+
+ (define-cproc persistent-map-delete (m::<persistent-map> key) PMapDelete)
+
+ (define-cproc persistent-map-diff (a::<persistent-map> b::<persistent-map>
+                                    :optional (absent #f))
+   PMapDiff)
+
+ (define-cproc persistent-map-transient (m::<persistent-map>) PMapTransient)
+
+ (define-cproc transient-map-size (m::<transient-map>) ::<ulong>
+   (result (-> m size)))
+
+ (define-cproc transient-map-ref (m::<transient-map> key :optional fallback)
+   (let* ([r (PMapRef m key fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have an entry for key %S" (SCM_OBJ m) key))
+     (result r)))
+
+ (define-cproc transient-map-exists? (m::<transient-map> key) ::<boolean>
+   (result (not (SCM_UNBOUNDP (PMapRef m key SCM_UNBOUND)))))
+
+ (define-cproc transient-map-put! (m::<transient-map> key value) ::<void>
+   TMapSet)
+
+ (define-cproc transient-map-delete! (m::<transient-map> key) ::<boolean>
+   TMapDelete)
+
+ (define-cproc transient-map-persistent! (m::<transient-map>) TMapPersistent)
+
+ (define-cfn pmap-iter (args::ScmObj* nargs::int data::void*) :static
+   (let* ([iter::PMapIter* (cast PMapIter* data)]
+          [r (PMapIterNext iter)]
+          [eofval (aref args 0)])
+     (if (SCM_FALSEP r)
+       (return (values eofval eofval))
+       (return (values (SCM_CAR r) (SCM_CDR r))))))
+
+ (define-cproc %pmap-iter (m::<pmap>)
+   (let* ([iter::PMapIter* (SCM_NEW PMapIter)])
+     (PMapIterInit iter m)
+     (result (Scm_MakeSubr pmap-iter iter 1 0 '"persistent-map-iterator"))))
+ )
+
+;; The fold and friends work on transient maps as well; they're used
+;; for the dictionary interface.
+(define (persistent-map-fold m proc seed)
+  (let ([iter (%pmap-iter m)]
+        [end  (list #f)])
+    (let loop ([seed seed])
+      (receive (key val) (iter end)
+        (if (eq? key end)
+          seed
+          (loop (proc key val seed)))))))
+
+(define (persistent-map-for-each m proc)
+  (persistent-map-fold m (^[k v _] (proc k v)) #f))
+(define (persistent-map-map m proc)
+  (persistent-map-fold m (^[k v s] (cons (proc k v) s)) '()))
+(define (persistent-map-keys m)
+  (persistent-map-fold m (^[k v s] (cons k s)) '()))
+(define (persistent-map-values m)
+  (persistent-map-fold m (^[k v s] (cons v s)) '()))
+(define (persistent-map->alist m)
+  (persistent-map-fold m acons '()))
+
+(define (persistent-map-update m key proc . fallback)
+  (persistent-map-put m key (proc (apply persistent-map-ref m key fallback))))
+
+(define (alist->persistent-map alist :optional (type 'eqv?))
+  (let1 t (persistent-map-transient (make-persistent-map type))
+    (dolist [p alist] (transient-map-put! t (car p) (cdr p)))
+    (transient-map-persistent! t)))
+
+;;===============================================================
+;; Persistent vectors
+;;
+
+(inline-stub
+ (initcode "Scm_Init_pvec(Scm_CurrentModule());")
+
+ (define-type <persistent-vector> "PVec*" "persistent vector"
+   "PERSISTENT_VECTOR_P" "PVEC")
+ (define-type <transient-vector> "PVec*" "transient vector"
+   "TRANSIENT_VECTOR_P" "PVEC")
+ (define-type <pvec> "PVec*" "persistent or transient vector"
+   "ANY_PVEC_P" "PVEC")
+
+ (define-cproc list->persistent-vector (lis::<list>) ListToPVec)
+
+ (define-cproc persistent-vector? (obj) ::<boolean> PERSISTENT_VECTOR_P)
+
+ (define-cproc persistent-vector-length (v::<persistent-vector>) ::<ulong>
+   (result (-> v size)))
+
+ (define-cproc persistent-vector-ref (v::<persistent-vector>
+                                      index::<fixnum>
+                                      :optional fallback)
+   (let* ([r (PVecRef v index fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "index out of range: %ld" index))
+     (result r)))
+
+ (define-cproc persistent-vector-set (v::<persistent-vector>
+                                      index::<fixnum> value)
+   PVecSet)
+
+ (define-cproc persistent-vector-push (v::<persistent-vector> value) PVecPush)
+
+ (define-cproc persistent-vector-pop (v::<persistent-vector>) PVecPop)
+
+ (define-cproc persistent-vector-transient (v::<persistent-vector>)
+   PVecTransient)
+
+ (define-cproc transient-vector-length (v::<transient-vector>) ::<ulong>
+   (result (-> v size)))
+
+ (define-cproc transient-vector-ref (v::<transient-vector>
+                                     index::<fixnum>
+                                     :optional fallback)
+   (let* ([r (PVecRef v index fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "index out of range: %ld" index))
+     (result r)))
+
+ (define-cproc transient-vector-set! (v::<transient-vector>
+                                      index::<fixnum> value) ::<void>
+   TVecSet)
+
+ (define-cproc transient-vector-push! (v::<transient-vector> value) ::<void>
+   TVecPush)
+
+ (define-cproc transient-vector-pop! (v::<transient-vector>) TVecPop)
+
+ (define-cproc transient-vector-persistent! (v::<transient-vector>)
+   TVecPersistent)
+
+ (define-cfn pvec-iter (args::ScmObj* nargs::int data::void*) :static
+   (return (PVecIterNext (cast PVecIter* data) (aref args 0))))
+
+ (define-cproc %pvec-iter (v::<pvec> :optional (start::<ulong> 0))
+   (let* ([iter::PVecIter* (SCM_NEW PVecIter)])
+     (PVecIterInit iter v start)
+     (result (Scm_MakeSubr pvec-iter iter 1 0 '"persistent-vector-iterator"))))
+ )
+
+(define (persistent-vector . elts) (list->persistent-vector elts))
+
+(define (vector->persistent-vector vec :optional (start 0) (end -1))
+  (list->persistent-vector (vector->list vec start end)))
+
+;; PROC is called as (proc elt seed).
+(define (persistent-vector-fold v proc seed)
+  (let ([iter (%pvec-iter v)]
+        [end  (list #f)])
+    (let loop ([seed seed])
+      (let1 e (iter end)
+        (if (eq? e end)
+          seed
+          (loop (proc e seed)))))))
+
+(define (persistent-vector-for-each v proc)
+  (persistent-vector-fold v (^[e _] (proc e)) #f))
+
+(define (persistent-vector->list v)
+  (reverse! (persistent-vector-fold v cons '())))
+
+(define (persistent-vector->vector v)
+  (list->vector (persistent-vector->list v)))
+
+;;===============================================================
+;; Collection and dictionary protocols
+;;
+
+;; A persistent map can't be modified, so it only provides the
+;; read-only part of the dictionary interface.
+(define-dict-interface <persistent-map>
+  :get       persistent-map-ref
+  :exists?   persistent-map-exists?
+  :fold      persistent-map-fold
+  :for-each  persistent-map-for-each
+  :map       persistent-map-map
+  :keys      persistent-map-keys
+  :values    persistent-map-values)
+
+(define-dict-interface <transient-map>
+  :get       transient-map-ref
+  :put!      transient-map-put!
+  :delete!   transient-map-delete!
+  :exists?   transient-map-exists?
+  :fold      persistent-map-fold
+  :for-each  persistent-map-for-each
+  :map       persistent-map-map
+  :keys      persistent-map-keys
+  :values    persistent-map-values)
+
+(define-method size-of ((m <persistent-map>)) (persistent-map-size m))
+(define-method size-of ((m <transient-map>)) (transient-map-size m))
+
+(define (%pvec-call-with-iterator v proc start)
+  (let* ([len  (if (persistent-vector? v)
+                 (persistent-vector-length v)
+                 (transient-vector-length v))]
+         [i    (or start 0)]
+         [iter (%pvec-iter v i)])
+    (proc (^[] (>= i len))
+          (^[] (inc! i) (iter #f)))))
+
+(define-method call-with-iterator ((v <persistent-vector>) proc
+                                   :key (start #f) :allow-other-keys)
+  (%pvec-call-with-iterator v proc start))
+(define-method call-with-iterator ((v <transient-vector>) proc
+                                   :key (start #f) :allow-other-keys)
+  (%pvec-call-with-iterator v proc start))
+
+(define-method size-of ((v <persistent-vector>)) (persistent-vector-length v))
+(define-method size-of ((v <transient-vector>)) (transient-vector-length v))
+
+(define-method referencer ((v <persistent-vector>)) persistent-vector-ref)
+(define-method referencer ((v <transient-vector>)) transient-vector-ref)
+(define-method modifier ((v <transient-vector>)) transient-vector-set!)
@@ -0,0 +1,700 @@
+/*
+ * pmap.c - Persistent map
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "persistent.h"
+#include <gauche/bits.h>
+#include <gauche/bits_inline.h>
+
+/*===================================================================
+ * Nodes
+ */
+
+/* The node layout follows CompactTrie in ext/sparse/ctrie.h.  A node
+ * is a 32-way branch; EMAP tells which logical indexes are occupied,
+ * and LMAP tells which of them are leaves.  The entries are packed
+ * after the header in the order of the logical index.
+ *
+ * A leaf is a pair (key . value).  At the deepest level all hash bits
+ * are consumed, so keys that reach the same entry there have the same
+ * hash value; those leaves are collision buckets, i.e. lists of
+ * (key . value).
+ *
+ * Leaf pairs are shared among versions, so they are never modified.
+ */
+
+struct PMapNodeRec {
+    u_long  emap;
+    u_long  lmap;
+    void   *edit;
+    void   *entries[2];         /* variable length */
+};
+
+#define MAX_LEVEL     (PMAP_MAX_DEPTH-1)
+#define HASH_MASK     0xffffffffUL
+#define INDEX(h, lv)  (((h) >> ((lv)*5)) & 0x1f)
+
+#define HAS_ARC(n, ind)   SCM_BITS_TEST_IN_WORD((n)->emap, (ind))
+#define IS_LEAF(n, ind)   SCM_BITS_TEST_IN_WORD((n)->lmap, (ind))
+#define NCHILDREN(n)      ((int)Scm__CountBitsInWord((n)->emap))
+#define OFFSET(n, ind)    ((int)Scm__CountBitsBelow((n)->emap, (ind)))
+
+/* We round up the number of entries to even, so that a transient can
+   insert into a node without reallocation every other time. */
+static PMapNode *make_node(int nentries, void *edit)
+{
+    int nalloc = (nentries+1)&~1;
+    if (nalloc < 2) nalloc = 2;
+    PMapNode *n = SCM_NEW2(PMapNode*,
+                           sizeof(PMapNode) + sizeof(void*)*(nalloc-2));
+    n->emap = n->lmap = 0;
+    n->edit = edit;
+    return n;
+}
+
+static PMapNode *copy_node(PMapNode *n, void *edit)
+{
+    int size = NCHILDREN(n);
+    PMapNode *m = make_node(size, edit);
+    m->emap = n->emap;
+    m->lmap = n->lmap;
+    for (int i=0; i<size; i++) m->entries[i] = n->entries[i];
+    return m;
+}
+
+/* Returns a node we can modify.  EDIT is NULL for persistent update. */
+static inline PMapNode *editable(PMapNode *n, void *edit)
+{
+    if (edit != NULL && n->edit == edit) return n;
+    return copy_node(n, edit);
+}
+
+static PMapNode *node_insert(PMapNode *n, int ind, void *entry, int leafp,
+                             void *edit)
+{
+    int size = NCHILDREN(n);
+    int off = OFFSET(n, ind);
+    PMapNode *m;
+
+    if (edit != NULL && n->edit == edit && (size&1)) {
+        /* we have a room */
+        m = n;
+        for (int i=size; i>off; i--) m->entries[i] = m->entries[i-1];
+    } else {
+        m = make_node(size+1, edit);
+        m->emap = n->emap;
+        m->lmap = n->lmap;
+        for (int i=0; i<off; i++) m->entries[i] = n->entries[i];
+        for (int i=off; i<size; i++) m->entries[i+1] = n->entries[i];
+    }
+    m->entries[off] = entry;
+    SCM_BITS_SET_IN_WORD(m->emap, ind);
+    if (leafp) SCM_BITS_SET_IN_WORD(m->lmap, ind);
+    else       SCM_BITS_RESET_IN_WORD(m->lmap, ind);
+    return m;
+}
+
+/* Returns NULL if N becomes empty. */
+static PMapNode *node_remove(PMapNode *n, int ind, void *edit)
+{
+    int size = NCHILDREN(n);
+    if (size == 1) return NULL;
+    int off = OFFSET(n, ind);
+    PMapNode *m;
+
+    if (edit != NULL && n->edit == edit) {
+        m = n;
+        for (int i=off; i<size-1; i++) m->entries[i] = m->entries[i+1];
+        m->entries[size-1] = NULL;
+    } else {
+        m = make_node(size-1, edit);
+        m->emap = n->emap;
+        m->lmap = n->lmap;
+        for (int i=0; i<off; i++) m->entries[i] = n->entries[i];
+        for (int i=off+1; i<size; i++) m->entries[i-1] = n->entries[i];
+    }
+    SCM_BITS_RESET_IN_WORD(m->emap, ind);
+    SCM_BITS_RESET_IN_WORD(m->lmap, ind);
+    return m;
+}
+
+static PMapNode *node_replace(PMapNode *n, int ind, void *entry, int leafp,
+                              void *edit)
+{
+    PMapNode *m = editable(n, edit);
+    m->entries[OFFSET(m, ind)] = entry;
+    if (leafp) SCM_BITS_SET_IN_WORD(m->lmap, ind);
+    else       SCM_BITS_RESET_IN_WORD(m->lmap, ind);
+    return m;
+}
+
+/*===================================================================
+ * Constructor
+ */
+
+static u_long string_hash(ScmObj key)
+{
+    if (!SCM_STRINGP(key)) {
+        Scm_Error("persistent string map got non-string key: %S", key);
+    }
+    return Scm_HashString(SCM_STRING(key), 0);
+}
+
+static int string_cmp(ScmObj a, ScmObj b)
+{
+    if (!SCM_STRINGP(a)) {
+        Scm_Error("persistent string map got non-string key: %S", a);
+    }
+    if (!SCM_STRINGP(b)) {
+        Scm_Error("persistent string map got non-string key: %S", b);
+    }
+    return Scm_StringEqual(SCM_STRING(a), SCM_STRING(b));
+}
+
+static PMap *alloc_pmap(ScmClass *klass, const PMap *orig)
+{
+    PMap *m = SCM_NEW(PMap);
+    SCM_SET_CLASS(m, klass);
+    m->size = orig->size;
+    m->root = orig->root;
+    m->type = orig->type;
+    m->hashfn = orig->hashfn;
+    m->cmpfn = orig->cmpfn;
+    m->edit = NULL;
+    return m;
+}
+
+ScmObj MakePMap(ScmHashType type)
+{
+    PMap proto;
+    proto.size = 0;
+    proto.root = NULL;
+    proto.type = type;
+
+    switch (type) {
+    case SCM_HASH_EQ:
+        proto.hashfn = Scm_EqHash;
+        proto.cmpfn = Scm_EqP;
+        break;
+    case SCM_HASH_EQV:
+        proto.hashfn = Scm_EqvHash;
+        proto.cmpfn = Scm_EqvP;
+        break;
+    case SCM_HASH_EQUAL:
+        proto.hashfn = Scm_Hash;
+        proto.cmpfn = Scm_EqualP;
+        break;
+    case SCM_HASH_STRING:
+        proto.hashfn = string_hash;
+        proto.cmpfn = string_cmp;
+        break;
+    default:
+        Scm_Error("invalid hash type (%d) for a persistent map", type);
+    }
+    return SCM_OBJ(alloc_pmap(SCM_CLASS_PERSISTENT_MAP, &proto));
+}
+
+static void pmap_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<%s %lu>",
+               PERSISTENT_MAP_P(obj)? "persistent-map" : "transient-map",
+               PMAP(obj)->size);
+}
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_PersistentMapClass, pmap_print, NULL, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+SCM_DEFINE_BUILTIN_CLASS(Scm_TransientMapClass, pmap_print, NULL, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+
+static inline u_long pmap_hash(PMap *m, ScmObj key)
+{
+    return m->hashfn(key) & HASH_MASK;
+}
+
+/*===================================================================
+ * Lookup
+ */
+
+/* Search KEY in the entry E of a node of level LV.  Returns the leaf
+   pair or #f. */
+static ScmObj entry_lookup(PMap *m, void *e, int leafp, int lv,
+                           u_long h, ScmObj key)
+{
+    for (;;) {
+        if (leafp) {
+            if (lv == MAX_LEVEL) {
+                ScmObj cp;
+                SCM_FOR_EACH(cp, SCM_OBJ(e)) {
+                    if (m->cmpfn(SCM_CAAR(cp), key)) return SCM_CAR(cp);
+                }
+                return SCM_FALSE;
+            }
+            if (m->cmpfn(SCM_CAR(SCM_OBJ(e)), key)) return SCM_OBJ(e);
+            return SCM_FALSE;
+        }
+        PMapNode *n = (PMapNode*)e;
+        int ind = INDEX(h, lv+1);
+        if (!HAS_ARC(n, ind)) return SCM_FALSE;
+        e = n->entries[OFFSET(n, ind)];
+        leafp = IS_LEAF(n, ind);
+        lv++;
+    }
+}
+
+static ScmObj pmap_lookup(PMap *m, ScmObj key)
+{
+    if (m->root == NULL) return SCM_FALSE;
+    u_long h = pmap_hash(m, key);
+    int ind = INDEX(h, 0);
+    if (!HAS_ARC(m->root, ind)) return SCM_FALSE;
+    return entry_lookup(m, m->root->entries[OFFSET(m->root, ind)],
+                        IS_LEAF(m->root, ind), 0, h, key);
+}
+
+ScmObj PMapRef(PMap *m, ScmObj key, ScmObj fallback)
+{
+    ScmObj p = pmap_lookup(m, key);
+    if (SCM_PAIRP(p)) return SCM_CDR(p);
+    return fallback;
+}
+
+/*===================================================================
+ * Update
+ */
+
+static inline ScmObj make_leaf(int lv, ScmObj pair)
+{
+    return (lv == MAX_LEVEL)? SCM_LIST1(pair) : pair;
+}
+
+/* Creates a subtree of level LV that contains two leaf pairs whose
+   keys differ. */
+static PMapNode *make_subtree(int lv, ScmObj p1, u_long h1,
+                              ScmObj p2, u_long h2, void *edit)
+{
+    PMapNode *n = make_node(2, edit);
+    int i1 = INDEX(h1, lv), i2 = INDEX(h2, lv);
+    if (i1 == i2) {
+        if (lv == MAX_LEVEL) {
+            n->entries[0] = SCM_LIST2(p1, p2);
+        } else {
+            n->entries[0] = make_subtree(lv+1, p1, h1, p2, h2, edit);
+        }
+        SCM_BITS_SET_IN_WORD(n->emap, i1);
+        if (lv == MAX_LEVEL) SCM_BITS_SET_IN_WORD(n->lmap, i1);
+    } else {
+        n->entries[(i1 < i2)? 0 : 1] = make_leaf(lv, p1);
+        n->entries[(i1 < i2)? 1 : 0] = make_leaf(lv, p2);
+        SCM_BITS_SET_IN_WORD(n->emap, i1);
+        SCM_BITS_SET_IN_WORD(n->emap, i2);
+        SCM_BITS_SET_IN_WORD(n->lmap, i1);
+        SCM_BITS_SET_IN_WORD(n->lmap, i2);
+    }
+    return n;
+}
+
+/* Returns a bucket with KEY's value replaced or added. */
+static ScmObj bucket_set(PMap *m, ScmObj bucket, ScmObj key, ScmObj value,
+                         int *added)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, cp;
+    SCM_FOR_EACH(cp, bucket) {
+        ScmObj p = SCM_CAR(cp);
+        if (m->cmpfn(SCM_CAR(p), key)) {
+            if (SCM_EQ(SCM_CDR(p), value)) return bucket;
+            SCM_APPEND1(h, t, Scm_Cons(SCM_CAR(p), value));
+            if (!SCM_NULLP(SCM_CDR(cp))) SCM_SET_CDR(t, SCM_CDR(cp));
+            return h;
+        }
+        SCM_APPEND1(h, t, p);
+    }
+    *added = TRUE;
+    return Scm_Cons(Scm_Cons(key, value), bucket);
+}
+
+/* Returns a bucket without KEY, or the same bucket if KEY isn't there. */
+static ScmObj bucket_delete(PMap *m, ScmObj bucket, ScmObj key)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, cp;
+    SCM_FOR_EACH(cp, bucket) {
+        ScmObj p = SCM_CAR(cp);
+        if (m->cmpfn(SCM_CAR(p), key)) {
+            if (SCM_NULLP(h)) return SCM_CDR(cp);
+            SCM_SET_CDR(t, SCM_CDR(cp));
+            return h;
+        }
+        SCM_APPEND1(h, t, p);
+    }
+    return bucket;
+}
+
+/* Returns the updated node, or N itself if nothing changes. */
+static PMapNode *node_set(PMap *m, PMapNode *n, int lv, u_long h,
+                          ScmObj key, ScmObj value, void *edit, int *added)
+{
+    int ind = INDEX(h, lv);
+    if (!HAS_ARC(n, ind)) {
+        *added = TRUE;
+        return node_insert(n, ind, make_leaf(lv, Scm_Cons(key, value)),
+                           TRUE, edit);
+    }
+    void *e = n->entries[OFFSET(n, ind)];
+    if (IS_LEAF(n, ind)) {
+        if (lv == MAX_LEVEL) {
+            ScmObj b = bucket_set(m, SCM_OBJ(e), key, value, added);
+            if (SCM_EQ(b, SCM_OBJ(e))) return n;
+            return node_replace(n, ind, b, TRUE, edit);
+        }
+        ScmObj p = SCM_OBJ(e);
+        if (m->cmpfn(SCM_CAR(p), key)) {
+            if (SCM_EQ(SCM_CDR(p), value)) return n;
+            return node_replace(n, ind, Scm_Cons(SCM_CAR(p), value),
+                                TRUE, edit);
+        }
+        *added = TRUE;
+        PMapNode *sub = make_subtree(lv+1, p, pmap_hash(m, SCM_CAR(p)),
+                                     Scm_Cons(key, value), h, edit);
+        return node_replace(n, ind, sub, FALSE, edit);
+    } else {
+        PMapNode *c = (PMapNode*)e;
+        PMapNode *nc = node_set(m, c, lv+1, h, key, value, edit, added);
+        if (nc == c) return n;
+        return node_replace(n, ind, nc, FALSE, edit);
+    }
+}
+
+/* Returns the updated node, NULL if it becomes empty, or N itself
+   if KEY isn't found. */
+static PMapNode *node_delete(PMap *m, PMapNode *n, int lv, u_long h,
+                             ScmObj key, void *edit, int *deleted)
+{
+    int ind = INDEX(h, lv);
+    if (!HAS_ARC(n, ind)) return n;
+    void *e = n->entries[OFFSET(n, ind)];
+    if (IS_LEAF(n, ind)) {
+        if (lv == MAX_LEVEL) {
+            ScmObj b = bucket_delete(m, SCM_OBJ(e), key);
+            if (SCM_EQ(b, SCM_OBJ(e))) return n;
+            *deleted = TRUE;
+            if (SCM_NULLP(b)) return node_remove(n, ind, edit);
+            return node_replace(n, ind, b, TRUE, edit);
+        }
+        if (!m->cmpfn(SCM_CAR(SCM_OBJ(e)), key)) return n;
+        *deleted = TRUE;
+        return node_remove(n, ind, edit);
+    } else {
+        PMapNode *c = (PMapNode*)e;
+        PMapNode *nc = node_delete(m, c, lv+1, h, key, edit, deleted);
+        if (!*deleted) return n;
+        if (nc == NULL) return node_remove(n, ind, edit);
+        /* If the child is left with a single pair, pull it up, so that
+           the trie doesn't keep a chain of single-entry nodes.  Note that
+           a transient may have modified the child in place, so NC can
+           be C here. */
+        if (NCHILDREN(nc) == 1 && nc->lmap != 0) {
+            ScmObj leaf = SCM_OBJ(nc->entries[0]);
+            if (lv+1 < MAX_LEVEL) {
+                return node_replace(n, ind, leaf, TRUE, edit);
+            }
+            if (SCM_NULLP(SCM_CDR(leaf))) {
+                return node_replace(n, ind, SCM_CAR(leaf), TRUE, edit);
+            }
+        }
+        if (nc == c) return n;
+        return node_replace(n, ind, nc, FALSE, edit);
+    }
+}
+
+static void pmap_set(PMap *m, ScmObj key, ScmObj value, void *edit)
+{
+    u_long h = pmap_hash(m, key);
+    int added = FALSE;
+    if (m->root == NULL) {
+        m->root = make_node(1, edit);
+        m->root->entries[0] = Scm_Cons(key, value);
+        SCM_BITS_SET_IN_WORD(m->root->emap, INDEX(h, 0));
+        SCM_BITS_SET_IN_WORD(m->root->lmap, INDEX(h, 0));
+        added = TRUE;
+    } else {
+        m->root = node_set(m, m->root, 0, h, key, value, edit, &added);
+    }
+    if (added) m->size++;
+}
+
+static int pmap_delete(PMap *m, ScmObj key, void *edit)
+{
+    if (m->root == NULL) return FALSE;
+    int deleted = FALSE;
+    m->root = node_delete(m, m->root, 0, pmap_hash(m, key), key, edit,
+                          &deleted);
+    if (deleted) m->size--;
+    return deleted;
+}
+
+ScmObj PMapSet(PMap *m, ScmObj key, ScmObj value)
+{
+    PMap *r = alloc_pmap(SCM_CLASS_PERSISTENT_MAP, m);
+    pmap_set(r, key, value, NULL);
+    if (r->root == m->root) return SCM_OBJ(m);
+    return SCM_OBJ(r);
+}
+
+ScmObj PMapDelete(PMap *m, ScmObj key)
+{
+    PMap *r = alloc_pmap(SCM_CLASS_PERSISTENT_MAP, m);
+    if (!pmap_delete(r, key, NULL)) return SCM_OBJ(m);
+    return SCM_OBJ(r);
+}
+
+/*===================================================================
+ * Transient
+ */
+
+ScmObj PMapTransient(PMap *m)
+{
+    PMap *t = alloc_pmap(SCM_CLASS_TRANSIENT_MAP, m);
+    t->edit = SCM_NEW_ATOMIC(long); /* a unique token */
+    return SCM_OBJ(t);
+}
+
+static void check_transient(PMap *t)
+{
+    if (t->edit == NULL) {
+        Scm_Error("transient map is already made persistent: %S", SCM_OBJ(t));
+    }
+}
+
+void TMapSet(PMap *t, ScmObj key, ScmObj value)
+{
+    check_transient(t);
+    pmap_set(t, key, value, t->edit);
+}
+
+int TMapDelete(PMap *t, ScmObj key)
+{
+    check_transient(t);
+    return pmap_delete(t, key, t->edit);
+}
+
+ScmObj TMapPersistent(PMap *t)
+{
+    check_transient(t);
+    t->edit = NULL;
+    return SCM_OBJ(alloc_pmap(SCM_CLASS_PERSISTENT_MAP, t));
+}
+
+/*===================================================================
+ * Difference
+ */
+
+/* We compare two versions of a map, skipping the subtrees they share.
+   The cost is proportional to the size of the changed part, not to
+   the size of the maps. */
+
+typedef struct DiffRec {
+    PMap  *m;
+    ScmObj absent;
+    ScmObj head;
+    ScmObj tail;
+} Diff;
+
+static void diff_add(Diff *d, ScmObj key, ScmObj v1, ScmObj v2)
+{
+    SCM_APPEND1(d->head, d->tail, SCM_LIST3(key, v1, v2));
+}
+
+/* Calls PROC on each leaf pair in the entry E of a node of level LV. */
+static void entry_for_each(void *e, int leafp, int lv,
+                           void (*proc)(ScmObj, void*), void *data)
+{
+    if (leafp) {
+        if (lv == MAX_LEVEL) {
+            ScmObj cp;
+            SCM_FOR_EACH(cp, SCM_OBJ(e)) proc(SCM_CAR(cp), data);
+        } else {
+            proc(SCM_OBJ(e), data);
+        }
+    } else {
+        PMapNode *n = (PMapNode*)e;
+        for (int ind=0; ind<32; ind++) {
+            if (!HAS_ARC(n, ind)) continue;
+            entry_for_each(n->entries[OFFSET(n, ind)], IS_LEAF(n, ind),
+                           lv+1, proc, data);
+        }
+    }
+}
+
+typedef struct DiffEntryRec {
+    Diff *d;
+    void *other;
+    int   otherleafp;
+    int   lv;
+    int   first;                /* TRUE if we're scanning the old one */
+} DiffEntry;
+
+static void diff_entry_1(ScmObj p, void *data)
+{
+    DiffEntry *de = (DiffEntry*)data;
+    Diff *d = de->d;
+    ScmObj q = SCM_FALSE;
+    if (de->other) {
+        q = entry_lookup(d->m, de->other, de->otherleafp, de->lv,
+                         pmap_hash(d->m, SCM_CAR(p)), SCM_CAR(p));
+    }
+    if (de->first) {
+        if (!SCM_PAIRP(q)) {
+            diff_add(d, SCM_CAR(p), SCM_CDR(p), d->absent);
+        } else if (!Scm_EqvP(SCM_CDR(p), SCM_CDR(q))) {
+            diff_add(d, SCM_CAR(p), SCM_CDR(p), SCM_CDR(q));
+        }
+    } else {
+        if (!SCM_PAIRP(q)) {
+            diff_add(d, SCM_CAR(p), d->absent, SCM_CDR(p));
+        }
+    }
+}
+
+/* Compares entries at the same position of two nodes of level LV.
+   Either one may be NULL. */
+static void diff_entry(Diff *d, void *a, int aleafp, void *b, int bleafp,
+                       int lv)
+{
+    if (a == b) return;
+    if (a && b && !aleafp && !bleafp) {
+        PMapNode *na = (PMapNode*)a, *nb = (PMapNode*)b;
+        for (int ind=0; ind<32; ind++) {
+            void *ea = NULL, *eb = NULL;
+            int la = FALSE, lb = FALSE;
+            if (HAS_ARC(na, ind)) {
+                ea = na->entries[OFFSET(na, ind)];
+                la = IS_LEAF(na, ind);
+            }
+            if (HAS_ARC(nb, ind)) {
+                eb = nb->entries[OFFSET(nb, ind)];
+                lb = IS_LEAF(nb, ind);
+            }
+            if (ea || eb) diff_entry(d, ea, la, eb, lb, lv+1);
+        }
+        return;
+    }
+    DiffEntry de;
+    de.d = d;
+    de.lv = lv;
+    if (a) {
+        de.other = b; de.otherleafp = bleafp; de.first = TRUE;
+        entry_for_each(a, aleafp, lv, diff_entry_1, &de);
+    }
+    if (b) {
+        de.other = a; de.otherleafp = aleafp; de.first = FALSE;
+        entry_for_each(b, bleafp, lv, diff_entry_1, &de);
+    }
+}
+
+/* Returns a list of (key value-in-A value-in-B) for each key whose value
+   differs (by eqv?) in A and B.  ABSENT is used for the value of a
+   missing key. */
+ScmObj PMapDiff(PMap *a, PMap *b, ScmObj absent)
+{
+    if (a->type != b->type) {
+        Scm_Error("persistent maps with different key comparison "
+                  "can't be compared: %S and %S", SCM_OBJ(a), SCM_OBJ(b));
+    }
+    Diff d;
+    d.m = a;
+    d.absent = absent;
+    d.head = d.tail = SCM_NIL;
+    if (a->root != b->root) {
+        /* Treat the roots as the children of an imaginary node. */
+        diff_entry(&d, a->root, FALSE, b->root, FALSE, -1);
+    }
+    return d.head;
+}
+
+/*===================================================================
+ * Iterator
+ */
+
+void PMapIterInit(PMapIter *it, PMap *m)
+{
+    it->bucket = SCM_NIL;
+    if (m->root == NULL) {
+        it->depth = -1;
+    } else {
+        it->depth = 0;
+        it->nodes[0] = m->root;
+        it->index[0] = 0;
+    }
+}
+
+/* returns (key . value) or #f */
+ScmObj PMapIterNext(PMapIter *it)
+{
+    if (SCM_PAIRP(it->bucket)) {
+        ScmObj p = SCM_CAR(it->bucket);
+        it->bucket = SCM_CDR(it->bucket);
+        return p;
+    }
+    while (it->depth >= 0) {
+        int lv = it->depth;
+        PMapNode *n = it->nodes[lv];
+        int ind = it->index[lv]++;
+        if (ind >= 32) {
+            it->depth--;
+            continue;
+        }
+        if (!HAS_ARC(n, ind)) continue;
+        void *e = n->entries[OFFSET(n, ind)];
+        if (IS_LEAF(n, ind)) {
+            if (lv == MAX_LEVEL) {
+                it->bucket = SCM_CDR(SCM_OBJ(e));
+                return SCM_CAR(SCM_OBJ(e));
+            }
+            return SCM_OBJ(e);
+        }
+        it->depth++;
+        it->nodes[lv+1] = (PMapNode*)e;
+        it->index[lv+1] = 0;
+    }
+    return SCM_FALSE;
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_pmap(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_PersistentMapClass, "<persistent-map>",
+                        mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_TransientMapClass, "<transient-map>",
+                        mod, NULL, 0);
+}
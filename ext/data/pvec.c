@@ -0,0 +1,394 @@
+/*
+ * pvec.c - Persistent vector
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "persistent.h"
+
+/*===================================================================
+ * Nodes
+ */
+
+/* We follow the structure of Clojure's PersistentVector.  Elements are
+ * kept in 32-element leaves of a radix trie, except the last 1-32
+ * elements that are kept in a separate tail node; so push and pop
+ * touch the trie only once in 32 times.
+ *
+ * Unused slots are NULL.
+ */
+
+#define PVEC_BITS   5
+#define PVEC_WIDTH  (1<<PVEC_BITS)
+#define PVEC_MASK   (PVEC_WIDTH-1)
+
+struct PVecNodeRec {
+    void *edit;
+    void *slots[PVEC_WIDTH];
+};
+
+/* Shared by all empty vectors.  It's never modified, since its edit
+   token doesn't match any transient. */
+static PVecNode empty_node;
+
+static PVecNode *make_node(void *edit)
+{
+    PVecNode *n = SCM_NEW(PVecNode);
+    n->edit = edit;
+    for (int i=0; i<PVEC_WIDTH; i++) n->slots[i] = NULL;
+    return n;
+}
+
+/* Returns a node we can modify.  EDIT is NULL for persistent update. */
+static PVecNode *editable(PVecNode *n, void *edit)
+{
+    if (edit != NULL && n->edit == edit) return n;
+    PVecNode *m = SCM_NEW(PVecNode);
+    m->edit = edit;
+    for (int i=0; i<PVEC_WIDTH; i++) m->slots[i] = n->slots[i];
+    return m;
+}
+
+/* The index of the first element in the tail. */
+static inline u_long tailoff(u_long size)
+{
+    if (size < PVEC_WIDTH) return 0;
+    return ((size-1) >> PVEC_BITS) << PVEC_BITS;
+}
+
+/* Returns the leaf that contains the INDEX-th element. */
+static PVecNode *leaf_for(PVec *v, u_long index)
+{
+    if (index >= tailoff(v->size)) return v->tail;
+    PVecNode *n = v->root;
+    for (int level = v->shift; level > 0; level -= PVEC_BITS) {
+        n = (PVecNode*)n->slots[(index >> level) & PVEC_MASK];
+    }
+    return n;
+}
+
+/*===================================================================
+ * Constructor
+ */
+
+static PVec *alloc_pvec(ScmClass *klass, const PVec *orig)
+{
+    PVec *v = SCM_NEW(PVec);
+    SCM_SET_CLASS(v, klass);
+    if (orig) {
+        v->size = orig->size;
+        v->shift = orig->shift;
+        v->root = orig->root;
+        v->tail = orig->tail;
+    } else {
+        v->size = 0;
+        v->shift = PVEC_BITS;
+        v->root = &empty_node;
+        v->tail = &empty_node;
+    }
+    v->edit = NULL;
+    return v;
+}
+
+ScmObj MakePVec(void)
+{
+    return SCM_OBJ(alloc_pvec(SCM_CLASS_PERSISTENT_VECTOR, NULL));
+}
+
+static void pvec_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<%s %lu>",
+               (PERSISTENT_VECTOR_P(obj)? "persistent-vector"
+                : "transient-vector"),
+               PVEC(obj)->size);
+}
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_PersistentVectorClass, pvec_print,
+                         NULL, NULL, NULL, SCM_CLASS_SEQUENCE_CPL);
+SCM_DEFINE_BUILTIN_CLASS(Scm_TransientVectorClass, pvec_print,
+                         NULL, NULL, NULL, SCM_CLASS_SEQUENCE_CPL);
+
+/*===================================================================
+ * Access
+ */
+
+ScmObj PVecRef(PVec *v, ScmSmallInt index, ScmObj fallback)
+{
+    if (index < 0 || (u_long)index >= v->size) return fallback;
+    return SCM_OBJ(leaf_for(v, index)->slots[index & PVEC_MASK]);
+}
+
+static void check_index(PVec *v, ScmSmallInt index)
+{
+    if (index < 0 || (u_long)index >= v->size) {
+        Scm_Error("index out of range: %ld", index);
+    }
+}
+
+/*===================================================================
+ * Update
+ */
+
+/* The following routines modify the header V in place.  For persistent
+   update, V is a fresh copy and EDIT is NULL. */
+
+static PVecNode *do_set(int level, PVecNode *n, u_long index, ScmObj value,
+                        void *edit)
+{
+    PVecNode *m = editable(n, edit);
+    if (level == 0) {
+        m->slots[index & PVEC_MASK] = value;
+    } else {
+        int sub = (index >> level) & PVEC_MASK;
+        m->slots[sub] = do_set(level-PVEC_BITS, (PVecNode*)n->slots[sub],
+                               index, value, edit);
+    }
+    return m;
+}
+
+static void pvec_set(PVec *v, ScmSmallInt index, ScmObj value, void *edit)
+{
+    check_index(v, index);
+    u_long toff = tailoff(v->size);
+    if ((u_long)index >= toff) {
+        v->tail = editable(v->tail, edit);
+        v->tail->slots[index - toff] = value;
+    } else {
+        v->root = do_set(v->shift, v->root, index, value, edit);
+    }
+}
+
+static PVecNode *new_path(int level, PVecNode *n, void *edit)
+{
+    if (level == 0) return n;
+    PVecNode *r = make_node(edit);
+    r->slots[0] = new_path(level-PVEC_BITS, n, edit);
+    return r;
+}
+
+static PVecNode *push_tail(PVec *v, int level, PVecNode *parent,
+                           PVecNode *tailnode, void *edit)
+{
+    int sub = ((v->size-1) >> level) & PVEC_MASK;
+    PVecNode *r = editable(parent, edit);
+    PVecNode *ins;
+    if (level == PVEC_BITS) {
+        ins = tailnode;
+    } else {
+        PVecNode *child = (PVecNode*)parent->slots[sub];
+        if (child) ins = push_tail(v, level-PVEC_BITS, child, tailnode, edit);
+        else       ins = new_path(level-PVEC_BITS, tailnode, edit);
+    }
+    r->slots[sub] = ins;
+    return r;
+}
+
+static void pvec_push(PVec *v, ScmObj value, void *edit)
+{
+    u_long toff = tailoff(v->size);
+    if (v->size - toff < PVEC_WIDTH) {
+        v->tail = editable(v->tail, edit);
+        v->tail->slots[v->size - toff] = value;
+    } else {
+        /* the tail is full; move it into the trie */
+        PVecNode *root;
+        if ((v->size >> PVEC_BITS) > (1UL << v->shift)) {
+            /* root overflow */
+            root = make_node(edit);
+            root->slots[0] = v->root;
+            root->slots[1] = new_path(v->shift, v->tail, edit);
+            v->shift += PVEC_BITS;
+        } else {
+            root = push_tail(v, v->shift, v->root, v->tail, edit);
+        }
+        v->root = root;
+        v->tail = make_node(edit);
+        v->tail->slots[0] = value;
+    }
+    v->size++;
+}
+
+static PVecNode *pop_tail(PVec *v, int level, PVecNode *n, void *edit)
+{
+    int sub = ((v->size-2) >> level) & PVEC_MASK;
+    if (level > PVEC_BITS) {
+        PVecNode *child = pop_tail(v, level-PVEC_BITS,
+                                   (PVecNode*)n->slots[sub], edit);
+        if (child == NULL && sub == 0) return NULL;
+        PVecNode *r = editable(n, edit);
+        r->slots[sub] = child;
+        return r;
+    } else if (sub == 0) {
+        return NULL;
+    } else {
+        PVecNode *r = editable(n, edit);
+        r->slots[sub] = NULL;
+        return r;
+    }
+}
+
+/* Returns the removed element. */
+static ScmObj pvec_pop(PVec *v, void *edit)
+{
+    if (v->size == 0) {
+        Scm_Error("can't pop from an empty vector: %S", SCM_OBJ(v));
+    }
+    ScmObj last = PVecRef(v, v->size-1, SCM_UNDEFINED);
+    if (v->size == 1) {
+        v->size = 0;
+        v->shift = PVEC_BITS;
+        v->root = &empty_node;
+        v->tail = &empty_node;
+        return last;
+    }
+    u_long toff = tailoff(v->size);
+    if (v->size - toff > 1) {
+        v->tail = editable(v->tail, edit);
+        v->tail->slots[v->size - toff - 1] = NULL;
+    } else {
+        /* the tail becomes empty; take the last leaf from the trie */
+        PVecNode *newtail = leaf_for(v, v->size-2);
+        PVecNode *root = pop_tail(v, v->shift, v->root, edit);
+        if (root == NULL) root = &empty_node;
+        if (v->shift > PVEC_BITS && root->slots[1] == NULL) {
+            root = (PVecNode*)root->slots[0];
+            v->shift -= PVEC_BITS;
+        }
+        v->root = root;
+        v->tail = newtail;
+    }
+    v->size--;
+    return last;
+}
+
+ScmObj PVecSet(PVec *v, ScmSmallInt index, ScmObj value)
+{
+    PVec *r = alloc_pvec(SCM_CLASS_PERSISTENT_VECTOR, v);
+    pvec_set(r, index, value, NULL);
+    return SCM_OBJ(r);
+}
+
+ScmObj PVecPush(PVec *v, ScmObj value)
+{
+    PVec *r = alloc_pvec(SCM_CLASS_PERSISTENT_VECTOR, v);
+    pvec_push(r, value, NULL);
+    return SCM_OBJ(r);
+}
+
+ScmObj PVecPop(PVec *v)
+{
+    PVec *r = alloc_pvec(SCM_CLASS_PERSISTENT_VECTOR, v);
+    pvec_pop(r, NULL);
+    return SCM_OBJ(r);
+}
+
+/*===================================================================
+ * Transient
+ */
+
+ScmObj PVecTransient(PVec *v)
+{
+    PVec *t = alloc_pvec(SCM_CLASS_TRANSIENT_VECTOR, v);
+    t->edit = SCM_NEW_ATOMIC(long); /* a unique token */
+    return SCM_OBJ(t);
+}
+
+static void check_transient(PVec *t)
+{
+    if (t->edit == NULL) {
+        Scm_Error("transient vector is already made persistent: %S",
+                  SCM_OBJ(t));
+    }
+}
+
+void TVecSet(PVec *t, ScmSmallInt index, ScmObj value)
+{
+    check_transient(t);
+    pvec_set(t, index, value, t->edit);
+}
+
+void TVecPush(PVec *t, ScmObj value)
+{
+    check_transient(t);
+    pvec_push(t, value, t->edit);
+}
+
+ScmObj TVecPop(PVec *t)
+{
+    check_transient(t);
+    return pvec_pop(t, t->edit);
+}
+
+ScmObj TVecPersistent(PVec *t)
+{
+    check_transient(t);
+    t->edit = NULL;
+    return SCM_OBJ(alloc_pvec(SCM_CLASS_PERSISTENT_VECTOR, t));
+}
+
+ScmObj ListToPVec(ScmObj lis)
+{
+    PVec *t = PVEC(PVecTransient(PVEC(MakePVec())));
+    ScmObj cp;
+    SCM_FOR_EACH(cp, lis) pvec_push(t, SCM_CAR(cp), t->edit);
+    return TVecPersistent(t);
+}
+
+/*===================================================================
+ * Iterator
+ */
+
+void PVecIterInit(PVecIter *it, PVec *v, u_long start)
+{
+    it->v = v;
+    it->index = start;
+    it->leaf = NULL;
+}
+
+ScmObj PVecIterNext(PVecIter *it, ScmObj eofval)
+{
+    if (it->index >= it->v->size) return eofval;
+    if (it->leaf == NULL || (it->index & PVEC_MASK) == 0) {
+        it->leaf = leaf_for(it->v, it->index);
+    }
+    return SCM_OBJ(it->leaf->slots[it->index++ & PVEC_MASK]);
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_pvec(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_PersistentVectorClass, "<persistent-vector>",
+                        mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_TransientVectorClass, "<transient-vector>",
+                        mod, NULL, 0);
+}
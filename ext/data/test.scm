@@ -0,0 +1,487 @@
+;;
+;; testing data.*
+;;
+
+(use gauche.test)
+(use gauche.dictionary)
+(use gauche.sequence)
+(use srfi-1)
+
+(test-start "data.*")
+
+;;---------------------------------------------------------------
+(test-section "data.persistent")
+(use data.persistent)
+(test-module 'data.persistent)
+
+;; A simple LCG, so that the tests don't depend on other extensions.
+(define (make-rand seed)
+  (^[n] (set! seed (modulo (+ (* seed 1103515245) 12345) 2147483648))
+        (modulo (quotient seed 65536) n)))
+
+(define (alist-sort alist)
+  (sort alist (^[a b] (< (car a) (car b)))))
+
+;;---------------------------------------------------------------
+(test-section "persistent-map basics")
+
+(let* ([m0 (make-persistent-map)]
+       [m1 (persistent-map-put m0 'a 1)]
+       [m2 (persistent-map-put m1 'b 2)]
+       [m3 (persistent-map-put m2 'a 10)]
+       [m4 (persistent-map-delete m3 'b)])
+  (test* "size" '(0 1 2 2 1) (map persistent-map-size (list m0 m1 m2 m3 m4)))
+  (test* "ref" '(1 1 2 10 2 10)
+         (list (persistent-map-ref m1 'a) (persistent-map-ref m2 'a)
+               (persistent-map-ref m2 'b) (persistent-map-ref m3 'a)
+               (persistent-map-ref m3 'b) (persistent-map-ref m4 'a)))
+  (test* "ref fallback" 'none (persistent-map-ref m4 'b 'none))
+  (test* "ref error" (test-error) (persistent-map-ref m4 'b))
+  (test* "exists?" '(#f #t #f)
+         (list (persistent-map-exists? m0 'a) (persistent-map-exists? m1 'a)
+               (persistent-map-exists? m4 'b)))
+  (test* "put same value" #t (eq? m1 (persistent-map-put m1 'a 1)))
+  (test* "delete nonexistent" #t (eq? m1 (persistent-map-delete m1 'z)))
+  (test* "update" 11
+         (persistent-map-ref (persistent-map-update m3 'a (cut + <> 1)) 'a))
+  (test* "update fallback" 0
+         (persistent-map-ref (persistent-map-update m0 'z (cut + <> 1) -1) 'z))
+  (test* "->alist" '((a . 10) (b . 2))
+         (sort (persistent-map->alist m3)
+               (^[x y] (string<? (x->string (car x)) (x->string (car y)))))))
+
+(test* "string=? map" '(2 1 #f)
+       (let1 m (alist->persistent-map '(("abc" . 1) ("def" . 2)) 'string=?)
+         (list (persistent-map-size m)
+               (persistent-map-ref m (string-copy "abc"))
+               (persistent-map-exists? m "xyz"))))
+
+(test* "invalid type" (test-error) (make-persistent-map 'foo))
+
+;;---------------------------------------------------------------
+(test-section "persistent-map versions")
+
+;; Builds a sequence of versions by random updates, and checks every
+;; version against an alist kept alongside.
+(define (test-versions name type keygen nops)
+  (let ([rand (make-rand 42)]
+        [versions '()])
+    (let loop ([i 0] [m (make-persistent-map type)] [ht (make-hash-table type)])
+      (if (= i nops)
+        (push! versions (cons m ht))
+        (let ([k (keygen (rand 500))]
+              [op (rand 3)])
+          (push! versions (cons m ht))
+          (let1 ht2 (hash-table-copy ht)
+            (if (= op 0)
+              (begin (hash-table-delete! ht2 k)
+                     (loop (+ i 1) (persistent-map-delete m k) ht2))
+              (begin (hash-table-put! ht2 k i)
+                     (loop (+ i 1) (persistent-map-put m k i) ht2)))))))
+    (test* #"~name" #t
+           (every (^[v]
+                    (let ([m (car v)] [ht (cdr v)])
+                      (and (= (persistent-map-size m)
+                              (hash-table-num-entries ht))
+                           (every (^k (eqv? (persistent-map-ref m k #f)
+                                            (hash-table-get ht k #f)))
+                                  (map keygen (iota 500)))
+                           (= (length (persistent-map->alist m))
+                              (hash-table-num-entries ht)))))
+                  versions))))
+
+(test-versions "eqv? fixnum keys" 'eqv? identity 2000)
+(test-versions "equal? string keys" 'equal? number->string 2000)
+
+;; Keys whose hash values collide a lot, to exercise the deepest level.
+(define-class <ckey> ()
+  ((id :init-keyword :id)))
+(define-method object-hash ((k <ckey>)) (modulo (~ k'id) 3))
+(define-method object-equal? ((a <ckey>) (b <ckey>)) (= (~ a'id) (~ b'id)))
+(define ckeys (list->vector (map (^i (make <ckey> :id i)) (iota 500))))
+
+(test-versions "colliding keys" 'equal? (cut vector-ref ckeys <>) 1000)
+
+(test* "delete all colliding keys" 0
+       (let1 m (fold (^[k m] (persistent-map-put m k #t))
+                     (make-persistent-map 'equal?) (vector->list ckeys))
+         (persistent-map-size
+          (fold (^[k m] (persistent-map-delete m k)) m (vector->list ckeys)))))
+
+;;---------------------------------------------------------------
+(test-section "persistent-map diff")
+
+(let* ([m0 (alist->persistent-map (map (^i (cons i i)) (iota 1000)))]
+       [m1 (persistent-map-put (persistent-map-delete m0 3) 5 'five)]
+       [m2 (persistent-map-put m1 2000 'new)])
+  (test* "no change" '() (persistent-map-diff m0 m0))
+  (test* "diff" '((3 3 none) (5 5 five) (2000 none new))
+         (sort (persistent-map-diff m0 m2 'none) (^[a b] (< (car a) (car b)))))
+  (test* "diff reverse" '((3 none 3) (5 five 5) (2000 new none))
+         (sort (persistent-map-diff m2 m0 'none) (^[a b] (< (car a) (car b)))))
+  (test* "diff with empty" 1000
+         (length (persistent-map-diff (make-persistent-map) m0)))
+  (test* "diff type mismatch" (test-error)
+         (persistent-map-diff m0 (make-persistent-map 'equal?))))
+
+;;---------------------------------------------------------------
+(test-section "transient-map")
+
+(let* ([m0 (alist->persistent-map (map (^i (cons i i)) (iota 100)))]
+       [t  (persistent-map-transient m0)])
+  (dotimes [i 50] (transient-map-delete! t (* i 2)))
+  (dotimes [i 50] (transient-map-put! t (+ i 100) 'x))
+  (test* "transient size" 100 (transient-map-size t))
+  (test* "original intact" '(100 0 #f)
+         (list (persistent-map-size m0) (persistent-map-ref m0 0)
+               (persistent-map-ref m0 120 #f)))
+  (let1 m1 (transient-map-persistent! t)
+    (test* "persistent!" '(100 #f 1 x)
+           (list (persistent-map-size m1) (persistent-map-ref m1 0 #f)
+                 (persistent-map-ref m1 1) (persistent-map-ref m1 120)))
+    (test* "frozen" (test-error) (transient-map-put! t 'a 1))
+    (test* "diff after transient" 100 (length (persistent-map-diff m0 m1)))))
+
+(let1 t (persistent-map-transient (make-persistent-map 'equal?))
+  (test* "dict interface" '(1 #t #f 2)
+         (begin
+           (dict-put! t 'a 1)
+           (dict-put! t 'b 2)
+           (list (dict-get t 'a) (dict-exists? t 'b)
+                 (begin (dict-delete! t 'a) (dict-exists? t 'a))
+                 (dict-get (transient-map-persistent! t) 'b)))))
+
+;;---------------------------------------------------------------
+(test-section "persistent-vector")
+
+(let* ([v0 (persistent-vector)]
+       [v1 (persistent-vector-push v0 'a)]
+       [v2 (persistent-vector-push v1 'b)]
+       [v3 (persistent-vector-set v2 0 'c)]
+       [v4 (persistent-vector-pop v3)])
+  (test* "length" '(0 1 2 2 1) (map persistent-vector-length
+                                    (list v0 v1 v2 v3 v4)))
+  (test* "->list" '(() (a) (a b) (c b) (c))
+         (map persistent-vector->list (list v0 v1 v2 v3 v4)))
+  (test* "ref out of range" (test-error) (persistent-vector-ref v2 2))
+  (test* "ref fallback" 'none (persistent-vector-ref v2 -1 'none))
+  (test* "set out of range" (test-error) (persistent-vector-set v2 2 'x))
+  (test* "pop empty" (test-error) (persistent-vector-pop v0)))
+
+;; Push and pop across the boundaries of the tail and of trie levels.
+(dolist [n '(31 32 33 64 1024 1025 1056 1057 33000)]
+  (let1 v (list->persistent-vector (iota n))
+    (test* #"push ~n" (iota n) (persistent-vector->list v))
+    (test* #"ref ~n" #t
+           (every (^i (= i (persistent-vector-ref v i))) (iota n)))
+    (test* #"pop ~n" (iota (- n 1))
+           (persistent-vector->list (persistent-vector-pop v)))
+    (test* #"pop all ~n" 0
+           (let loop ([v v])
+             (let1 len (persistent-vector-length v)
+               (cond [(zero? len) 0]
+                     [(= (persistent-vector-ref v (- len 1)) (- len 1))
+                      (loop (persistent-vector-pop v))]
+                     [else -1]))))))
+
+(let* ([v0 (list->persistent-vector (iota 2000))]
+       [v1 (fold (^[i v] (persistent-vector-set v (* i 7) 'x)) v0 (iota 200))])
+  (test* "set keeps the original" (iota 2000) (persistent-vector->list v0))
+  (test* "set" (map (^i (if (and (zero? (modulo i 7)) (< i 1400)) 'x i))
+                    (iota 2000))
+         (persistent-vector->list v1)))
+
+(test* "transient-vector" '(1000 (0 1 2 x) 999 #t)
+       (let* ([v0 (list->persistent-vector (iota 1000))]
+              [t  (persistent-vector-transient v0)])
+         (dotimes [i 500] (transient-vector-push! t i))
+         (dotimes [i 497] (transient-vector-pop! t))
+         (transient-vector-set! t 3 'x)
+         (let1 v1 (transient-vector-persistent! t)
+           (list (persistent-vector-length v0)
+                 (take (persistent-vector->list v1) 4)
+                 (persistent-vector-ref v0 999)
+                 (= (persistent-vector-length v1) 1003)))))
+
+(test* "frozen vector" (test-error)
+       (let1 t (persistent-vector-transient (persistent-vector 1))
+         (transient-vector-persistent! t)
+         (transient-vector-push! t 2)))
+
+(test* "sequence protocol" '(45 (1 2 3) 3 #(0 1 2))
+       (let1 v (list->persistent-vector (iota 10))
+         (list (fold + 0 v)
+               (take (map (cut + <> 1) v) 3)
+               (ref v 3)
+               (persistent-vector->vector (persistent-vector 0 1 2)))))
+
+(test-section "data.heap")
+(use data.heap)
+(test-module 'data.heap)
+
+(define (heap-drain! h)
+  (let loop ([r '()])
+    (if (heap-empty? h)
+      (reverse r)
+      (receive (p v) (heap-pop! h) (loop (cons (cons p v) r))))))
+
+(define (random-list n range seed)
+  (let1 rand (make-rand seed)
+    (list-tabulate n (^_ (rand range)))))
+
+(dolist [arity '(2 3 4 16)]
+  (let ([h (make-heap :arity arity)]
+        [data (random-list 1000 300 arity)])
+    (dolist [x data] (heap-push! h x))
+    (test* #"fixnum heap (arity ~arity)" (sort data)
+           (map car (heap-drain! h)))))
+
+(test* "flonum max heap" '(3.5 2.0 1.5 -1.0)
+       (let1 h (make-heap :less-than >)
+         (dolist [x '(1.5 -1.0 3.5 2.0)] (heap-push! h x))
+         (map car (heap-drain! h))))
+
+(test* "mixed numbers" '(-1 1/2 0.75 1 3.0)
+       (let1 h (make-heap)
+         (dolist [x '(1 0.75 3.0 -1 1/2)] (heap-push! h x))
+         (map car (heap-drain! h))))
+
+(test* "custom ordering" '("a" "bb" "ccc")
+       (let1 h (make-heap :less-than (^[a b] (< (string-length a)
+                                                (string-length b))))
+         (dolist [s '("ccc" "a" "bb")] (heap-push! h s))
+         (map car (heap-drain! h))))
+
+(test* "priority and value" '((1 . b) (2 . c) (3 . a))
+       (let1 h (make-heap)
+         (heap-push! h 3 'a)
+         (heap-push! h 1 'b)
+         (heap-push! h 2 'c)
+         (heap-drain! h)))
+
+(test* "peek, size" '(1 b 3)
+       (let1 h (make-heap)
+         (heap-push-all! h '((3 . a) (1 . b) (2 . c)))
+         (receive (p v) (heap-peek h) (list p v (heap-size h)))))
+
+(test* "pop empty" (test-error) (heap-pop! (make-heap)))
+(test* "pop empty with fallback" 'none (heap-pop! (make-heap) 'none))
+(test* "replace empty" (test-error) (heap-replace! (make-heap) 1))
+
+(test* "push-all! (heapify)" (sort (random-list 500 1000 7))
+       (let1 h (make-heap :arity 4)
+         (heap-push-all! h (map (^x (cons x x)) (random-list 500 1000 7)))
+         (map car (heap-drain! h))))
+
+(test* "push-all! into nonempty heap" '(0 1 2 3 4 5)
+       (let1 h (make-heap)
+         (heap-push-all! h '((5 . 5) (3 . 3) (1 . 1) (4 . 4)))
+         (heap-push-all! h '((0 . 0) (2 . 2)))
+         (map car (heap-drain! h))))
+
+(test* "push-all! bad argument" '(1 (1 . 1))
+       (let1 h (make-heap)
+         (heap-push! h 1 1)
+         (guard (e [else (list (heap-size h) (car (heap->alist h)))])
+           (heap-push-all! h '((2 . 2) 3)))))
+
+(test* "replace!" '(1 4 (2 3 5 9))
+       (let1 h (make-heap)
+         (dolist [x '(5 1 9 3)] (heap-push! h x))
+         (receive (p v) (heap-replace! h 2)
+           (list p (heap-size h) (map car (heap-drain! h))))))
+
+(test* "comparator error keeps entries" 3
+       (let1 h (make-heap :less-than (^[a b] (if (eq? a 'bad)
+                                                 (error "bad")
+                                                 (< a b))))
+         (heap-push! h 1)
+         (heap-push! h 2)
+         (guard (e [else (heap-size h)])
+           (heap-push! h 'bad))))
+
+(test* "collection" '(6 3)
+       (let1 h (make-heap)
+         (heap-push-all! h '((1 . a) (2 . b) (3 . c)))
+         (list (fold (^[p s] (+ (car p) s)) 0 h) (size-of h))))
+
+(test* "invalid arity" (test-error) (make-heap :arity 1))
+
+;; indexed heap
+(let1 h (make-indexed-heap)
+  (for-each (^[v p] (heap-push! h p v)) '(a b c d e) '(50 40 30 20 10))
+  (heap-update! h 'a 5)                 ; decrease-key
+  (heap-update! h 'e 45)                ; increase-key
+  (test* "indexed heap priority" '(5 45 #f)
+         (list (heap-priority h 'a) (heap-priority h 'e)
+               (heap-priority h 'z #f)))
+  (test* "indexed heap delete" '(#t #f #f)
+         (list (heap-delete! h 'c) (heap-delete! h 'c) (heap-exists? h 'c)))
+  (test* "indexed heap push existing" 4
+         (begin (heap-push! h 1 'b) (heap-size h)))
+  (test* "indexed heap order" '((1 . b) (5 . a) (20 . d) (45 . e))
+         (heap-drain! h))
+  (test* "indexed heap empty" '(0 #f)
+         (list (heap-size h) (heap-exists? h 'a))))
+
+(test* "indexed heap random updates" #t
+       (let ([h (make-indexed-heap :arity 3)]
+             [ht (make-hash-table 'eqv?)]
+             [rand (make-rand 99)])
+         (dotimes [i 3000]
+           (let ([k (rand 200)] [p (rand 10000)])
+             (case (rand 3)
+               [(0) (heap-delete! h k) (hash-table-delete! ht k)]
+               [else (heap-update! h k p) (hash-table-put! ht k p)])))
+         (let1 drained (heap-drain! h)
+           (and (equal? (map car drained) (sort (hash-table-values ht)))
+                (every (^e (= (car e) (hash-table-get ht (cdr e))))
+                       drained)))))
+
+(test* "indexed heap string keys" '(("x" . 1) ("y" . 2))
+       (let1 h (make-indexed-heap :type 'string=?)
+         (heap-update! h "y" 2)
+         (heap-update! h "x" 3)
+         (heap-update! h (string-copy "x") 1)
+         (map (^e (cons (cdr e) (car e))) (heap-drain! h))))
+
+(test-section "data.trie")
+(use data.trie)
+(use gauche.uvector)
+(test-module 'data.trie)
+
+(let1 t (make-byte-trie)
+  (dolist [k '("kane" "kana" "ka" "kanawai" "" "ku" "lili`u")]
+    (byte-trie-put! t k (string-length k)))
+  (byte-trie-put! t '#u8(1 2 3) 'a)
+  (byte-trie-put! t '#u8(1 2) 'b)
+  (byte-trie-put! t '#u8() 'c)
+  (test* "size" 10 (byte-trie-size t))
+  (test* "ref" '(4 0 a c none)
+         (list (byte-trie-ref t "kane") (byte-trie-ref t "")
+               (byte-trie-ref t '#u8(1 2 3)) (byte-trie-ref t '#u8())
+               (byte-trie-ref t "kan" 'none)))
+  (test* "ref error" (test-error) (byte-trie-ref t "kan"))
+  (test* "bad key" (test-error) (byte-trie-ref t '(#\k)))
+  (test* "exists?" '(#t #f #f)
+         (list (byte-trie-exists? t "ka") (byte-trie-exists? t "k")
+               (byte-trie-exists? t '#u8(1))))
+  (test* "strings and u8vectors are different" '(#f 0)
+         (list (byte-trie-exists? t (string->u8vector "kane"))
+               (byte-trie-ref t "")))
+  (test* "keys in order"
+         '("" "ka" "kana" "kanawai" "kane" "ku" "lili`u"
+           #u8() #u8(1 2) #u8(1 2 3))
+         (byte-trie-keys t))
+  (test* "keys with prefix" '("kana" "kanawai" "kane")
+         (byte-trie-keys t "kan"))
+  (test* "keys with prefix (within an edge)" '("lili`u")
+         (byte-trie-keys t "li"))
+  (test* "keys with prefix (u8vector)" '(#u8(1 2) #u8(1 2 3))
+         (byte-trie-keys t '#u8(1)))
+  (test* "keys with prefix (none)" '() (byte-trie-keys t "kx"))
+  (test* "longest-match" '(("kana" . 4) ("ka" . 2) ("" . 0) (#u8(1 2) . b))
+         (list (byte-trie-longest-match t "kanaw")
+               (byte-trie-longest-match t "kan")
+               (byte-trie-longest-match t "x")
+               (byte-trie-longest-match t '#u8(1 2 4))))
+  (test* "update!" 14
+         (begin (byte-trie-update! t "kanawai" (cut * <> 2))
+                (byte-trie-ref t "kanawai")))
+  (test* "delete!" '(#t #f 9 #f ("kanawai" "kane"))
+         (list (byte-trie-delete! t "kana")
+               (byte-trie-delete! t "kana")
+               (byte-trie-size t)
+               (byte-trie-exists? t "kana")
+               (byte-trie-keys t "kan")))
+  (test* "dictionary" '(5 (#u8() #u8(1 2) #u8(1 2 3)))
+         (begin (dict-put! t "ku" 5)
+                (list (dict-get t "ku")
+                      (filter u8vector? (dict-map t (^[k v] k))))))
+  (test* "clear!" '(0 ())
+         (begin (byte-trie-clear! t) (list (byte-trie-size t) (dict-keys t)))))
+
+(test* "incomplete string key" (test-error)
+       (byte-trie-put! (make-byte-trie) #*"\xff" 1))
+
+(test* "multibyte keys" '(("\u6f22" . 1) ("\u6f22\u5b57" . 2)
+                          ("\u6f22\u5b57\u304b\u306a" . 3))
+       (let1 t (make-byte-trie)
+         (byte-trie-put! t "\u6f22\u5b57\u304b\u306a" 3)
+         (byte-trie-put! t "\u6f22" 1)
+         (byte-trie-put! t "\u6f22\u5b57" 2)
+         (byte-trie-put! t "\u6f23" 4)
+         (byte-trie->alist t "\u6f22")))
+
+(test* "class precedence list" (list <byte-trie> <dictionary> <collection> <top>)
+       (class-precedence-list <byte-trie>))
+
+;; Deletion merges and shrinks nodes in place; the iterator has to find
+;; its position again.
+(let ()
+  (define (delete-while-iterating keys del)
+    (let1 t (make-byte-trie)
+      (for-each (cut byte-trie-put! t <> #t) keys)
+      (rlet1 seen '()
+        (byte-trie-for-each t (^[k v]
+                                (push! seen k)
+                                (when (equal? k del) (byte-trie-delete! t k))))
+        (set! seen (reverse seen)))))
+  (test* "delete during iteration (merge with children)" '("ab" "abcd" "abce")
+         (delete-while-iterating '("ab" "abcd" "abce") "ab"))
+  (test* "delete during iteration (merge with a child)" '("ab" "abc")
+         (delete-while-iterating '("ab" "abc") "ab"))
+  (test* "delete during iteration (shrink)"
+         (map (^i (string (integer->char i))) (iota 20 33))
+         (let1 keys (map (^i (string (integer->char i))) (iota 20 33))
+           ;; Deleting many children of the root makes it switch back
+           ;; from the direct table to the sorted array.
+           (let1 t (make-byte-trie)
+             (for-each (cut byte-trie-put! t <> #t) keys)
+             (rlet1 seen '()
+               (byte-trie-for-each t (^[k v]
+                                       (push! seen k)
+                                       (byte-trie-delete! t k)))
+               (set! seen (reverse seen))))))
+  (test* "delete others during iteration" '("a" "c" "e")
+         (let1 t (make-byte-trie)
+           (for-each (cut byte-trie-put! t <> #t) '("a" "b" "c" "d" "e"))
+           (rlet1 seen '()
+             (byte-trie-for-each t (^[k v]
+                                     (push! seen k)
+                                     (byte-trie-delete!
+                                      t (string (integer->char
+                                                 (+ (char->integer
+                                                     (string-ref k 0))
+                                                    1))))))
+             (set! seen (reverse seen)))))
+  )
+
+;; Compare with a hash table, over many nodes of varying fan-out.
+(test* "random operations" #t
+       (let ([t (make-byte-trie)]
+             [ht (make-hash-table 'equal?)]
+             [rand (make-rand 17)])
+         ;; A small alphabet makes long shared prefixes, and the full
+         ;; range of bytes makes nodes with many children.
+         (define (rand-key)
+           (let1 bytes (list-tabulate (rand 6)
+                                      (^_ (if (zero? (rand 2))
+                                            (+ 97 (rand 4))
+                                            (rand 128))))
+             (if (zero? (rand 2))
+               (list->string (map integer->char bytes))
+               (list->u8vector bytes))))
+         (dotimes [i 5000]
+           (let1 k (rand-key)
+             (case (rand 3)
+               [(0) (byte-trie-delete! t k) (hash-table-delete! ht k)]
+               [else (byte-trie-put! t k i) (hash-table-put! ht k i)])))
+         (and (= (byte-trie-size t) (hash-table-num-entries ht))
+              (every (^p (equal? (byte-trie-ref t (car p)) (cdr p)))
+                     (hash-table->alist ht))
+              (let1 ks (byte-trie-keys t)
+                (and (= (length ks) (hash-table-num-entries ht))
+                     (every (cut hash-table-exists? ht <>) ks))))))
+
+(test-end)
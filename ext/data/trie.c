@@ -0,0 +1,634 @@
+/*
+ * trie.c - Byte-keyed radix trie
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "trie.h"
+
+/*===================================================================
+ * Nodes
+ */
+
+static BTNode *new_node(const u_char *edge, u_int edgeLen, ScmObj value)
+{
+    BTNode *n = SCM_NEW(BTNode);
+    n->value = value;
+    n->edge = edge;
+    n->edgeLen = edgeLen;
+    n->numChildren = 0;
+    n->capacity = 0;
+    n->children = NULL;
+    return n;
+}
+
+/* Creates a leaf with a private copy of the rest of the key. */
+static BTNode *new_leaf(const u_char *key, u_int len, ScmObj value)
+{
+    u_char *edge = NULL;
+    if (len > 0) {
+        edge = SCM_NEW_ATOMIC2(u_char*, len);
+        memcpy(edge, key, len);
+    }
+    return new_node(edge, len, value);
+}
+
+#define LABELS(n)  ((u_char*)((n)->children + (n)->capacity))
+
+static BTNode *find_child(BTNode *n, u_char b)
+{
+    if (n->capacity == BT_DIRECT) return n->children[b];
+    u_char *labels = LABELS(n);
+    for (int i = 0; i < n->numChildren; i++) {
+        if (labels[i] == b) return n->children[i];
+        if (labels[i] > b) break;
+    }
+    return NULL;
+}
+
+/* Reallocates the child array of N to hold CAPACITY children, switching
+   between the sorted and the direct representation as needed. */
+static void resize_children(BTNode *n, int capacity)
+{
+    BTNode **children;
+    if (capacity == BT_DIRECT) {
+        children = SCM_NEW_ARRAY(BTNode*, BT_DIRECT);
+        memset(children, 0, sizeof(BTNode*) * BT_DIRECT);
+        u_char *labels = LABELS(n);
+        for (int i = 0; i < n->numChildren; i++) {
+            children[labels[i]] = n->children[i];
+        }
+    } else {
+        children = SCM_NEW2(BTNode**,
+                            capacity * (sizeof(BTNode*) + 1));
+        u_char *labels = (u_char*)(children + capacity);
+        if (n->capacity == BT_DIRECT) {
+            int k = 0;
+            for (int i = 0; i < BT_DIRECT; i++) {
+                if (n->children[i]) {
+                    labels[k] = (u_char)i;
+                    children[k++] = n->children[i];
+                }
+            }
+        } else if (n->numChildren > 0) {
+            memcpy(children, n->children, n->numChildren * sizeof(BTNode*));
+            memcpy(labels, LABELS(n), n->numChildren);
+        }
+    }
+    n->children = children;
+    n->capacity = (u_short)capacity;
+}
+
+static void add_child(BTNode *n, BTNode *child)
+{
+    u_char b = child->edge[0];
+    if (n->capacity == BT_DIRECT) {
+        n->children[b] = child;
+        n->numChildren++;
+        return;
+    }
+    if (n->numChildren == n->capacity) {
+        int cap = (n->capacity == 0)? 2 : n->capacity * 2;
+        resize_children(n, (cap > 16)? BT_DIRECT : cap);
+        if (n->capacity == BT_DIRECT) {
+            n->children[b] = child;
+            n->numChildren++;
+            return;
+        }
+    }
+    u_char *labels = LABELS(n);
+    int i = n->numChildren;
+    for (; i > 0 && labels[i-1] > b; i--) {
+        labels[i] = labels[i-1];
+        n->children[i] = n->children[i-1];
+    }
+    labels[i] = b;
+    n->children[i] = child;
+    n->numChildren++;
+}
+
+static void remove_child(BTNode *n, u_char b)
+{
+    if (n->capacity == BT_DIRECT) {
+        n->children[b] = NULL;
+        n->numChildren--;
+        if (n->numChildren <= 8) resize_children(n, 16);
+        return;
+    }
+    u_char *labels = LABELS(n);
+    int i = 0;
+    for (; i < n->numChildren; i++) {
+        if (labels[i] == b) break;
+    }
+    if (i == n->numChildren) return;
+    for (; i < n->numChildren - 1; i++) {
+        labels[i] = labels[i+1];
+        n->children[i] = n->children[i+1];
+    }
+    n->numChildren--;
+    if (n->numChildren == 0) {
+        n->children = NULL;
+        n->capacity = 0;
+    } else if (n->capacity > 2 && n->numChildren <= n->capacity/4) {
+        resize_children(n, n->capacity/2);
+    }
+}
+
+/* Splits the edge of N at POS, in place: N keeps the first POS bytes
+   and gets a single child that takes over the rest of the edge, the
+   value and the children of N.  Doing it in place saves us from
+   tracking the parent of N. */
+static void split_node(BTNode *n, u_int pos)
+{
+    BTNode *rest = new_node(n->edge + pos, n->edgeLen - pos, n->value);
+    rest->numChildren = n->numChildren;
+    rest->capacity = n->capacity;
+    rest->children = n->children;
+    n->edgeLen = pos;
+    n->value = SCM_UNBOUND;
+    n->numChildren = 0;
+    n->capacity = 0;
+    n->children = NULL;
+    add_child(n, rest);
+}
+
+/* Merges a valueless non-root node N with its only child, in place. */
+static void merge_node(BTNode *n)
+{
+    BTNode *child;
+    if (n->capacity == BT_DIRECT) {
+        int i = 0;
+        while (n->children[i] == NULL) i++;
+        child = n->children[i];
+    } else {
+        child = n->children[0];
+    }
+    u_int len = n->edgeLen + child->edgeLen;
+    u_char *edge = SCM_NEW_ATOMIC2(u_char*, len);
+    memcpy(edge, n->edge, n->edgeLen);
+    memcpy(edge + n->edgeLen, child->edge, child->edgeLen);
+    n->edge = edge;
+    n->edgeLen = len;
+    n->value = child->value;
+    n->numChildren = child->numChildren;
+    n->capacity = child->capacity;
+    n->children = child->children;
+}
+
+/* Returns the length of the common prefix of the edge of N and KEY. */
+static u_int match_edge(BTNode *n, const u_char *key, u_int len)
+{
+    u_int lim = (len < n->edgeLen)? len : n->edgeLen;
+    u_int i = 0;
+    while (i < lim && n->edge[i] == key[i]) i++;
+    return i;
+}
+
+/*===================================================================
+ * Keys
+ */
+
+/* Returns the root for KEY, and sets its bytes to *BYTES and *LEN. */
+static BTNode *key_root(ByteTrie *t, ScmObj key,
+                        const u_char **bytes, u_int *len)
+{
+    if (SCM_STRINGP(key)) {
+        u_int size, flags;
+        const char *s = Scm_GetStringContent(SCM_STRING(key), &size,
+                                             NULL, &flags);
+        if (flags & SCM_STRING_INCOMPLETE) {
+            Scm_Error("complete string required, but got %S", key);
+        }
+        *bytes = (const u_char*)s;
+        *len = size;
+        return t->strRoot;
+    }
+    if (SCM_U8VECTORP(key)) {
+        *bytes = SCM_U8VECTOR_ELEMENTS(key);
+        *len = (u_int)SCM_U8VECTOR_SIZE(key);
+        return t->u8Root;
+    }
+    Scm_Error("string or u8vector required, but got %S", key);
+    return NULL;                /* dummy */
+}
+
+static ScmObj make_key(int stringKey, const u_char *bytes, u_int len)
+{
+    if (stringKey) {
+        return Scm_MakeString((const char*)bytes, len, -1,
+                              SCM_STRING_COPYING);
+    } else {
+        return Scm_MakeU8VectorFromArray(len, bytes);
+    }
+}
+
+/* A stored key whose bytes begin with the bytes of a string doesn't
+   necessarily begin with the string, if the encoding isn't
+   self-synchronizing.  This checks if byte offset OFF of S falls on
+   a character boundary. */
+#if defined(GAUCHE_CHAR_ENCODING_UTF_8)
+#define CHAR_BOUNDARY_P(s, len, off)  TRUE
+#else  /*!GAUCHE_CHAR_ENCODING_UTF_8*/
+static int char_boundary_p(const u_char *s, u_int len, u_int off)
+{
+    u_int i = 0;
+    while (i < off && i < len) i += SCM_CHAR_NFOLLOWS(s[i]) + 1;
+    return i == off;
+}
+#define CHAR_BOUNDARY_P(s, len, off)  char_boundary_p(s, len, off)
+#endif /*!GAUCHE_CHAR_ENCODING_UTF_8*/
+
+/*===================================================================
+ * Constructor
+ */
+
+static void byte_trie_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<byte-trie %lu>", BYTE_TRIE(obj)->size);
+}
+
+static ScmClass *byte_trie_cpl[] = {
+    SCM_CLASS_STATIC_PTR(Scm_ByteTrieClass),
+    SCM_CLASS_STATIC_PTR(Scm_DictionaryClass),
+    SCM_CLASS_STATIC_PTR(Scm_CollectionClass),
+    SCM_CLASS_STATIC_PTR(Scm_TopClass),
+    NULL
+};
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_ByteTrieClass, byte_trie_print, NULL, NULL,
+                         NULL, byte_trie_cpl+1);
+
+ScmObj MakeByteTrie(void)
+{
+    ByteTrie *t = SCM_NEW(ByteTrie);
+    SCM_SET_CLASS(t, SCM_CLASS_BYTE_TRIE);
+    t->strRoot = new_node(NULL, 0, SCM_UNBOUND);
+    t->u8Root = new_node(NULL, 0, SCM_UNBOUND);
+    t->size = 0;
+    t->epoch = 0;
+    return SCM_OBJ(t);
+}
+
+void ByteTrieClear(ByteTrie *t)
+{
+    t->strRoot = new_node(NULL, 0, SCM_UNBOUND);
+    t->u8Root = new_node(NULL, 0, SCM_UNBOUND);
+    t->size = 0;
+    t->epoch++;
+}
+
+/*===================================================================
+ * Access
+ */
+
+ScmObj ByteTrieRef(ByteTrie *t, ScmObj key, ScmObj fallback)
+{
+    const u_char *k;
+    u_int len, pos = 0;
+    BTNode *n = key_root(t, key, &k, &len);
+
+    while (pos < len) {
+        n = find_child(n, k[pos]);
+        if (n == NULL) return fallback;
+        if (match_edge(n, k + pos, len - pos) < n->edgeLen) return fallback;
+        pos += n->edgeLen;
+    }
+    return SCM_UNBOUNDP(n->value)? fallback : n->value;
+}
+
+/* Returns TRUE if KEY is newly added. */
+int ByteTriePut(ByteTrie *t, ScmObj key, ScmObj value)
+{
+    const u_char *k;
+    u_int len, pos = 0;
+    BTNode *n = key_root(t, key, &k, &len);
+
+    for (;;) {
+        if (pos == len) {
+            int added = SCM_UNBOUNDP(n->value);
+            n->value = value;
+            if (added) { t->size++; t->epoch++; }
+            return added;
+        }
+        BTNode *c = find_child(n, k[pos]);
+        if (c == NULL) {
+            add_child(n, new_leaf(k + pos, len - pos, value));
+            t->size++;
+            t->epoch++;
+            return TRUE;
+        }
+        u_int m = match_edge(c, k + pos, len - pos);
+        if (m < c->edgeLen) split_node(c, m);
+        n = c;
+        pos += m;
+    }
+}
+
+/* Returns TRUE if KEY was in the trie.  We keep the invariant that
+   every non-root node without a value has at least two children. */
+int ByteTrieDelete(ByteTrie *t, ScmObj key)
+{
+    const u_char *k;
+    u_int len, pos = 0;
+    BTNode *root = key_root(t, key, &k, &len);
+    BTNode *parent = NULL, *n = root;
+
+    while (pos < len) {
+        BTNode *c = find_child(n, k[pos]);
+        if (c == NULL) return FALSE;
+        if (match_edge(c, k + pos, len - pos) < c->edgeLen) return FALSE;
+        parent = n;
+        n = c;
+        pos += c->edgeLen;
+    }
+    if (SCM_UNBOUNDP(n->value)) return FALSE;
+    n->value = SCM_UNBOUND;
+    t->size--;
+    t->epoch++;
+
+    if (n == root) return TRUE;
+    if (n->numChildren == 1) {
+        merge_node(n);
+    } else if (n->numChildren == 0) {
+        remove_child(parent, n->edge[0]);
+        if (parent != root && parent->numChildren == 1
+            && SCM_UNBOUNDP(parent->value)) {
+            merge_node(parent);
+        }
+    }
+    return TRUE;
+}
+
+/* Returns (key . value) of the longest key that is a prefix of SEQ,
+   or #f if there's none. */
+ScmObj ByteTrieLongestMatch(ByteTrie *t, ScmObj seq)
+{
+    const u_char *k;
+    u_int len, pos = 0;
+    BTNode *n = key_root(t, seq, &k, &len);
+    BTNode *best = NULL;
+    u_int bestLen = 0;
+    int stringKey = SCM_STRINGP(seq);
+
+    for (;;) {
+        if (!SCM_UNBOUNDP(n->value)
+            && (!stringKey || CHAR_BOUNDARY_P(k, len, pos))) {
+            best = n;
+            bestLen = pos;
+        }
+        if (pos == len) break;
+        n = find_child(n, k[pos]);
+        if (n == NULL) break;
+        if (match_edge(n, k + pos, len - pos) < n->edgeLen) break;
+        pos += n->edgeLen;
+    }
+    if (best == NULL) return SCM_FALSE;
+    return Scm_Cons(make_key(stringKey, k, bestLen), best->value);
+}
+
+/*===================================================================
+ * Iterator
+ */
+
+static void iter_reserve_key(ByteTrieIter *it, u_int size)
+{
+    if (size <= it->keySize) return;
+    u_int newSize = it->keySize * 2;
+    if (newSize < size) newSize = size;
+    u_char *key = SCM_NEW_ATOMIC2(u_char*, newSize);
+    memcpy(key, it->key, it->keySize);
+    it->key = key;
+    it->keySize = newSize;
+}
+
+static void iter_push(ByteTrieIter *it, BTNode *n, u_int keyLen)
+{
+    if (it->depth == it->stackSize) {
+        int newSize = it->stackSize * 2;
+        BTIterFrame *stack = SCM_NEW_ARRAY(BTIterFrame, newSize);
+        memcpy(stack, it->stack, it->depth * sizeof(BTIterFrame));
+        it->stack = stack;
+        it->stackSize = newSize;
+    }
+    BTIterFrame *f = &it->stack[it->depth++];
+    f->node = n;
+    f->index = -1;
+    f->keyLen = keyLen;
+}
+
+/* Finds the subtree of keys that begin with PREFIX, and sets up the
+   key buffer to the bytes leading to it. */
+static void iter_start(ByteTrieIter *it, BTNode *root,
+                       const u_char *prefix, u_int len)
+{
+    BTNode *n = root;
+    u_int pos = 0;
+    while (pos < len) {
+        n = find_child(n, prefix[pos]);
+        if (n == NULL) return;
+        u_int m = match_edge(n, prefix + pos, len - pos);
+        if (m < n->edgeLen && pos + m < len) return;
+        iter_reserve_key(it, pos + n->edgeLen);
+        memcpy(it->key + pos, n->edge, n->edgeLen);
+        pos += n->edgeLen;
+    }
+    iter_push(it, n, pos);
+}
+
+#define ITER_INITIAL_DEPTH 16
+
+/* PREFIX may be a string, a u8vector, or #f to visit all the keys. */
+void ByteTrieIterInit(ByteTrieIter *it, ByteTrie *t, ScmObj prefix)
+{
+    it->trie = t;
+    it->epoch = t->epoch;
+    it->stackSize = ITER_INITIAL_DEPTH;
+    it->stack = SCM_NEW_ARRAY(BTIterFrame, ITER_INITIAL_DEPTH);
+    it->depth = 0;
+    it->keySize = 64;
+    it->key = SCM_NEW_ATOMIC2(u_char*, it->keySize);
+    it->lastLen = 0;
+    it->lastVisited = FALSE;
+    it->pending = FALSE;
+    it->prefixLen = 0;
+
+    if (SCM_FALSEP(prefix)) {
+        it->stringKeys = TRUE;
+        it->pending = TRUE;
+        iter_push(it, t->strRoot, 0);
+    } else {
+        const u_char *p;
+        u_int len;
+        BTNode *root = key_root(t, prefix, &p, &len);
+        it->stringKeys = (root == t->strRoot);
+        it->prefixLen = len;
+        /* The prefix is where we start; we may need to seek it again. */
+        iter_reserve_key(it, len);
+        memcpy(it->key, p, len);
+        it->lastLen = len;
+        iter_start(it, root, p, len);
+    }
+}
+
+/* Returns the index of the first child of N whose label is B or greater,
+   in the sense of next_child. */
+static int child_index(BTNode *n, u_char b)
+{
+    if (n->capacity == BT_DIRECT) return b;
+    u_char *labels = LABELS(n);
+    int i = 0;
+    while (i < n->numChildren && labels[i] < b) i++;
+    return i;
+}
+
+/* Rebuilds the stack after the trie is modified, so that the iteration
+   continues from the keys greater than the last key returned (or from
+   the last key itself, if it hasn't been visited).  The key buffer holds
+   the last key, and we only overwrite it with the same bytes until we
+   find where to continue. */
+static void iter_reseek(ByteTrieIter *it)
+{
+    BTNode *n = it->stringKeys? it->trie->strRoot : it->trie->u8Root;
+    u_int len = it->lastLen, pos = 0;
+
+    it->depth = 0;
+    /* Find the root of the subtree of the prefix.  If it's gone, or all
+       of its keys are smaller than the last key, we're done. */
+    while (pos < it->prefixLen) {
+        BTNode *c = find_child(n, it->key[pos]);
+        if (c == NULL) return;
+        u_int m = match_edge(c, it->key + pos, len - pos);
+        if (m < c->edgeLen) {
+            if (pos + m < it->prefixLen) return;
+            if (pos + m < len && c->edge[m] < it->key[pos+m]) return;
+        }
+        iter_reserve_key(it, pos + c->edgeLen);
+        memcpy(it->key + pos, c->edge, c->edgeLen);
+        pos += c->edgeLen;
+        n = c;
+        if (m < c->edgeLen) {
+            /* every key of C is greater than the last key */
+            iter_push(it, n, pos);
+            return;
+        }
+    }
+    for (;;) {
+        iter_push(it, n, pos);
+        BTIterFrame *f = &it->stack[it->depth-1];
+        if (pos >= len) {
+            f->index = (pos > len || !it->lastVisited)? -1 : 0;
+            return;
+        }
+        u_char b = it->key[pos];
+        int i = child_index(n, b);
+        BTNode *c = find_child(n, b);
+        if (c == NULL) {
+            f->index = i;
+            return;
+        }
+        u_int m = match_edge(c, it->key + pos, len - pos);
+        if (m < c->edgeLen) {
+            /* The last key ends in the edge of C, or diverges from it. */
+            if (pos + m == len || c->edge[m] > it->key[pos+m]) {
+                f->index = i;
+            } else {
+                f->index = i+1;
+            }
+            return;
+        }
+        f->index = i+1;
+        pos += c->edgeLen;
+        n = c;
+    }
+}
+
+static BTNode *next_child(BTNode *n, int *index)
+{
+    if (n->capacity == BT_DIRECT) {
+        while (*index < BT_DIRECT) {
+            BTNode *c = n->children[(*index)++];
+            if (c) return c;
+        }
+        return NULL;
+    }
+    if (*index < n->numChildren) return n->children[(*index)++];
+    return NULL;
+}
+
+/* Returns (key . value), or #f when exhausted. */
+ScmObj ByteTrieIterNext(ByteTrieIter *it)
+{
+    if (it->epoch != it->trie->epoch) {
+        it->epoch = it->trie->epoch;
+        if (it->depth > 0) iter_reseek(it);
+    }
+    for (;;) {
+        while (it->depth > 0) {
+            BTIterFrame *f = &it->stack[it->depth-1];
+            if (f->index < 0) {
+                f->index = 0;
+                if (!SCM_UNBOUNDP(f->node->value)
+                    && (!it->stringKeys
+                        || CHAR_BOUNDARY_P(it->key, f->keyLen,
+                                           it->prefixLen))) {
+                    it->lastLen = f->keyLen;
+                    it->lastVisited = TRUE;
+                    return Scm_Cons(make_key(it->stringKeys, it->key,
+                                             f->keyLen),
+                                    f->node->value);
+                }
+            }
+            BTNode *c = next_child(f->node, &f->index);
+            if (c == NULL) {
+                it->depth--;
+                continue;
+            }
+            u_int keyLen = f->keyLen + c->edgeLen;
+            iter_reserve_key(it, keyLen);
+            memcpy(it->key + f->keyLen, c->edge, c->edgeLen);
+            iter_push(it, c, keyLen);
+        }
+        if (!it->pending) return SCM_FALSE;
+        it->stringKeys = FALSE;
+        it->pending = FALSE;
+        it->lastLen = 0;
+        it->lastVisited = FALSE;
+        iter_push(it, it->trie->u8Root, 0);
+    }
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_trie(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_ByteTrieClass, "<byte-trie>", mod, NULL, 0);
+}
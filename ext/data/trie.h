@@ -0,0 +1,132 @@
+/*
+ * trie.h - Byte-keyed radix trie
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_DATA_TRIE_H
+#define GAUCHE_DATA_TRIE_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTDATA_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/* A compressed radix trie keyed by byte sequences.
+ *
+ * Each node owns the run of bytes on the edge from its parent (a
+ * pointer into an atomic buffer, so a node that is split shares the
+ * buffer with the node it came from) and an optional value.  Children
+ * are kept in an array whose representation adapts to the fan-out:
+ * up to 16 children are kept in a sorted array of labels parallel to
+ * the child pointers, both in a single allocation, and nodes with more
+ * children switch to an array of 256 pointers indexed directly by
+ * the next byte.  Unlike a node per character with a hash table of
+ * children, a node here costs 32 bytes plus its child array, and
+ * chains of single-child nodes are collapsed into one edge.
+ *
+ * Strings and u8vectors are kept under separate roots, so that the
+ * trie can give back keys of the type they were stored with.  Strings
+ * are keyed by the bytes of their internal representation, which
+ * orders them as string<? does.
+ */
+
+typedef struct BTNodeRec BTNode;
+
+struct BTNodeRec {
+    ScmObj value;               /* SCM_UNBOUND if no key ends here */
+    const u_char *edge;         /* label of the edge from the parent */
+    u_int  edgeLen;
+    u_short numChildren;
+    u_short capacity;           /* 0, 2, 4, 8, 16 or BT_DIRECT */
+    BTNode **children;          /* if capacity < BT_DIRECT, followed by
+                                   CAPACITY sorted labels */
+};
+
+#define BT_DIRECT  256
+
+typedef struct ByteTrieRec {
+    SCM_HEADER;
+    BTNode *strRoot;
+    BTNode *u8Root;
+    u_long  size;
+    u_long  epoch;              /* bumped when a key is added or deleted */
+} ByteTrie;
+
+SCM_CLASS_DECL(Scm_ByteTrieClass);
+#define SCM_CLASS_BYTE_TRIE     (&Scm_ByteTrieClass)
+#define BYTE_TRIE(obj)          ((ByteTrie*)(obj))
+#define BYTE_TRIE_P(obj)        SCM_XTYPEP(obj, SCM_CLASS_BYTE_TRIE)
+
+extern ScmObj MakeByteTrie(void);
+extern ScmObj ByteTrieRef(ByteTrie *t, ScmObj key, ScmObj fallback);
+extern int    ByteTriePut(ByteTrie *t, ScmObj key, ScmObj value);
+extern int    ByteTrieDelete(ByteTrie *t, ScmObj key);
+extern ScmObj ByteTrieLongestMatch(ByteTrie *t, ScmObj seq);
+extern void   ByteTrieClear(ByteTrie *t);
+
+/* Iterator.  Entries are visited in ascending order of keys; strings
+   come before u8vectors when both are visited.  The trie may be
+   modified during iteration.  Since deletion merges and shrinks nodes
+   in place, the iterator notices the change by the epoch, and finds
+   its position again by the key it returned last.  So it never returns
+   a key that isn't stored, and visits each key that stays in the trie
+   exactly once. */
+typedef struct BTIterFrameRec {
+    BTNode *node;
+    int     index;              /* next child; -1 if value not visited */
+    u_int   keyLen;             /* length of the key up to this node */
+} BTIterFrame;
+
+typedef struct ByteTrieIterRec {
+    ByteTrie *trie;
+    u_long  epoch;              /* trie->epoch when the stack was built */
+    BTIterFrame *stack;
+    int     depth;
+    int     stackSize;
+    u_char *key;
+    u_int   keySize;
+    u_int   lastLen;            /* the last key returned is key[0..lastLen) */
+    int     lastVisited;        /* FALSE if the entry of that key itself
+                                   hasn't been visited (i.e. the prefix) */
+    int     stringKeys;         /* TRUE while walking the string root */
+    int     pending;            /* TRUE if u8vector root is to be visited */
+    u_int   prefixLen;
+} ByteTrieIter;
+
+extern void   ByteTrieIterInit(ByteTrieIter *it, ByteTrie *t, ScmObj prefix);
+extern ScmObj ByteTrieIterNext(ByteTrieIter *it);
+
+extern void   Scm_Init_trie(ScmModule *mod);
+
+#endif /*GAUCHE_DATA_TRIE_H*/
@@ -0,0 +1,133 @@
+;;;
+;;; data.trie - byte-keyed radix trie
+;;;
+;;;   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+;; This module provides the native trie used by util.trie for string
+;; and u8vector keys.  It can be used by itself as a dictionary
+;; with string and u8vector keys.
+
+(define-module data.trie
+  (use gauche.dictionary)
+  (export <byte-trie> make-byte-trie byte-trie? byte-trie-size
+          byte-trie-ref byte-trie-exists? byte-trie-put! byte-trie-delete!
+          byte-trie-update! byte-trie-clear! byte-trie-longest-match
+          byte-trie-fold byte-trie-for-each byte-trie-map
+          byte-trie-keys byte-trie-values byte-trie->alist
+          %byte-trie-iter)
+  )
+(select-module data.trie)
+
+(inline-stub
+ "#include \"trie.h\""
+
+ (initcode "Scm_Init_trie(Scm_CurrentModule());")
+
+ (define-type <byte-trie> "ByteTrie*" "byte trie" "BYTE_TRIE_P" "BYTE_TRIE")
+
+ (define-cproc make-byte-trie () MakeByteTrie)
+
+ (define-cproc byte-trie? (obj) ::<boolean> BYTE_TRIE_P)
+
+ (define-cproc byte-trie-size (t::<byte-trie>) ::<ulong>
+   (result (-> t size)))
+
+ (define-cproc byte-trie-ref (t::<byte-trie> key :optional fallback)
+   (let* ([r (ByteTrieRef t key fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have an entry for key %S" (SCM_OBJ t) key))
+     (result r)))
+
+ (define-cproc byte-trie-exists? (t::<byte-trie> key) ::<boolean>
+   (result (not (SCM_UNBOUNDP (ByteTrieRef t key SCM_UNBOUND)))))
+
+ (define-cproc byte-trie-put! (t::<byte-trie> key value) ::<void>
+   (ByteTriePut t key value))
+
+ (define-cproc byte-trie-delete! (t::<byte-trie> key) ::<boolean>
+   ByteTrieDelete)
+
+ (define-cproc byte-trie-clear! (t::<byte-trie>) ::<void> ByteTrieClear)
+
+ (define-cproc byte-trie-longest-match (t::<byte-trie> seq)
+   ByteTrieLongestMatch)
+
+ (define-cfn byte-trie-iter (args::ScmObj* nargs::int data::void*) :static
+   (let* ([r (ByteTrieIterNext (cast ByteTrieIter* data))]
+          [eofval (aref args 0)])
+     (if (SCM_FALSEP r)
+       (return (values eofval eofval))
+       (return (values (SCM_CAR r) (SCM_CDR r))))))
+
+ ;; PREFIX is a string or a u8vector to visit only the keys of the
+ ;; same type that begin with it, or #f to visit all the keys.
+ (define-cproc %byte-trie-iter (t::<byte-trie> :optional (prefix #f))
+   (let* ([iter::ByteTrieIter* (SCM_NEW ByteTrieIter)])
+     (ByteTrieIterInit iter t prefix)
+     (result (Scm_MakeSubr byte-trie-iter iter 1 0 '"byte-trie-iterator"))))
+ )
+
+(define (byte-trie-update! t key proc . fallback)
+  (byte-trie-put! t key (proc (apply byte-trie-ref t key fallback))))
+
+;; Entries are visited in ascending order of keys.
+(define (byte-trie-fold t proc seed :optional (prefix #f))
+  (let ([iter (%byte-trie-iter t prefix)]
+        [end  (list #f)])
+    (let loop ([seed seed])
+      (receive (key val) (iter end)
+        (if (eq? key end)
+          seed
+          (loop (proc key val seed)))))))
+
+(define (byte-trie-for-each t proc :optional (prefix #f))
+  (byte-trie-fold t (^[k v _] (proc k v)) #f prefix))
+(define (byte-trie-map t proc :optional (prefix #f))
+  (reverse! (byte-trie-fold t (^[k v s] (cons (proc k v) s)) '() prefix)))
+(define (byte-trie-keys t :optional (prefix #f))
+  (reverse! (byte-trie-fold t (^[k v s] (cons k s)) '() prefix)))
+(define (byte-trie-values t :optional (prefix #f))
+  (reverse! (byte-trie-fold t (^[k v s] (cons v s)) '() prefix)))
+(define (byte-trie->alist t :optional (prefix #f))
+  (reverse! (byte-trie-fold t acons '() prefix)))
+
+(define-dict-interface <byte-trie>
+  :get       byte-trie-ref
+  :put!      byte-trie-put!
+  :delete!   byte-trie-delete!
+  :exists?   byte-trie-exists?
+  :clear!    byte-trie-clear!
+  :fold      byte-trie-fold
+  :for-each  byte-trie-for-each
+  :map       byte-trie-map
+  :keys      byte-trie-keys
+  :values    byte-trie-values)
+
+(define-method size-of ((t <byte-trie>)) (byte-trie-size t))
@@ -177,7 +177,12 @@ ScmObj Scm_SysFcntl(ScmObj port_or_fd, int op, ScmObj arg)
                       flag_name(op), arg);
         }
         ScmSysFlock *fl = SCM_SYS_FLOCK(arg);
-        SCM_SYSCALL(r, fcntl(fd, op, &fl->lock));
+        /* F_GETLK writes back to the lock.  We don't let the kernel
+           write into the heap object; see "Incremental collection"
+           in src/core.c. */
+        struct flock lock = fl->lock;
+        SCM_SYSCALL(r, fcntl(fd, op, &lock));
+        if (op == F_GETLK && r >= 0) fl->lock = lock;
         if (op == F_SETLK) {
             if (r >= 0) return SCM_TRUE;
             if (errno == EAGAIN) return SCM_FALSE;
@@ -178,6 +178,11 @@
        (generator->list (gmerge <
                                 '(0 15) '(11) '(3 7 14) '(4 10) '() '(16)
                                 '(1 5) '(6 8 9) '(2) '(12) '(13))))
+(test* "gmerge multi-way, custom order" '("a" "b" "c" "d" "e" "f" "g")
+       (generator->list (gmerge string<? '("b" "f") '("a" "e") '("c" "d" "g"))))
+(test* "gmerge multi-way, many inputs" (iota 1000)
+       (generator->list (apply gmerge < (map (^i (giota 10 i 100))
+                                             (iota 100)))))
 
 (test* "gconcatenate" '(0 1 2 3 a b c d A B C D)
        (generator->list (gconcatenate (x->generator
@@ -0,0 +1,465 @@
+/*
+ * prime.c - Prime number kernels
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "prime.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(GAUCHE_USE_PTHREADS)
+#include <pthread.h>
+#endif
+
+typedef ScmUInt64 u64;
+
+/*===================================================================
+ * Segmented sieve
+ */
+
+/* The sieve is bit-packed with the mod 30 wheel; byte k represents
+   the 8 numbers 30k+r, where r is one of the residues below, which are
+   the ones coprime to 2, 3 and 5.  Multiples of 2, 3 and 5 aren't
+   represented at all, so one byte covers 30 numbers.
+
+   To cross off the multiples of a prime p, we enumerate the cofactors q
+   (q >= p) in each residue class.  If q = 30j+r, the multiple p*q is in
+   byte p*j + p*r/30, with the bit determined by p*r mod 30, and adding
+   30 to q moves it by exactly p bytes without changing the bit.
+   So each prime takes 8 simple strided loops per segment. */
+
+static const int wheel_residues[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+/* residue mod 30 -> bit index, or -1 */
+static signed char wheel_bit[30];
+
+/* Bytes per segment.  Chosen to fit in L1 cache. */
+#define SIEVE_SEGMENT_BYTES 32768
+
+/* Collected primes.  This is filled by worker threads, so it must not
+   use GC-allocated memory. */
+typedef struct prime_buf_rec {
+    u64 *primes;
+    size_t count;
+    size_t size;
+    int failed;                 /* TRUE if we ran out of memory */
+} prime_buf;
+
+static void prime_buf_add(prime_buf *buf, u64 p)
+{
+    if (buf->failed) return;
+    if (buf->count == buf->size) {
+        size_t nsize = buf->size ? buf->size * 2 : 1024;
+        u64 *np = (u64*)realloc(buf->primes, nsize * sizeof(u64));
+        if (np == NULL) {
+            /* We can't call Scm_Error from a worker; just stop adding.
+               The caller checks the flag after joining the workers. */
+            buf->failed = TRUE;
+            return;
+        }
+        buf->primes = np;
+        buf->size = nsize;
+    }
+    buf->primes[buf->count++] = p;
+}
+
+/* Sieve bytes [sb, eb), and adds primes in [lo, hi) to BUF.
+   BASE contains the primes from 7 up to sqrt(hi). */
+typedef struct sieve_job_rec {
+    u64 sb, eb;                 /* byte range */
+    u64 lo, hi;                 /* number range */
+    const ScmUInt32 *base;
+    size_t nbase;
+    prime_buf result;
+} sieve_job;
+
+static void sieve_segment(unsigned char *seg, u64 sb, u64 eb,
+                          const ScmUInt32 *base, size_t nbase)
+{
+    memset(seg, 0xff, (size_t)(eb - sb));
+    if (sb == 0) seg[0] &= ~1;  /* 1 is not a prime */
+
+    for (size_t i = 0; i < nbase; i++) {
+        u64 p = base[i];
+        /* The smallest cofactor q >= p such that p*q >= 30*sb.
+           We compute ceil(30*sb/p) without overflow. */
+        u64 a = sb / p, c = sb % p;
+        u64 q0 = 30*a + (30*c + p - 1) / p;
+        if (q0 < p) q0 = p;
+        /* Primes are sorted, so once p^2 is beyond the segment, so are
+           all the multiples we need to cross off for the rest. */
+        if (p*p/30 >= eb) break;
+
+        u64 j0 = q0 / 30;
+        int r0 = (int)(q0 % 30);
+        for (int k = 0; k < 8; k++) {
+            int r = wheel_residues[k];
+            u64 j = (r < r0) ? j0 + 1 : j0;
+            u64 b = p*j + (p*r)/30;
+            unsigned char mask = ~(1 << wheel_bit[(p*r) % 30]);
+            for (; b < eb; b += p) seg[b - sb] &= mask;
+        }
+    }
+}
+
+static void sieve_collect(const unsigned char *seg, u64 sb, u64 eb,
+                          u64 lo, u64 hi, prime_buf *buf)
+{
+    for (u64 b = sb; b < eb; b++) {
+        unsigned int bits = seg[b - sb];
+        if (bits == 0) continue;
+        u64 n0 = 30*b;          /* never overflows, since 30*b < hi */
+        for (int k = 0; bits; k++, bits >>= 1) {
+            if (!(bits & 1)) continue;
+            u64 r = (u64)wheel_residues[k];
+            /* n = n0 + r; check lo <= n < hi without overflow */
+            if (r >= hi - n0) return;
+            if (n0 + r < lo) continue;
+            prime_buf_add(buf, n0 + r);
+        }
+    }
+}
+
+static void *sieve_worker(void *data)
+{
+    sieve_job *job = (sieve_job*)data;
+    unsigned char *seg = (unsigned char*)malloc(SIEVE_SEGMENT_BYTES);
+    if (seg == NULL) {
+        job->result.failed = TRUE;
+        return NULL;
+    }
+    for (u64 sb = job->sb; sb < job->eb; sb += SIEVE_SEGMENT_BYTES) {
+        u64 eb = sb + SIEVE_SEGMENT_BYTES;
+        if (eb > job->eb) eb = job->eb;
+        sieve_segment(seg, sb, eb, job->base, job->nbase);
+        sieve_collect(seg, sb, eb, job->lo, job->hi, &job->result);
+        if (job->result.failed) break;
+    }
+    free(seg);
+    return NULL;
+}
+
+static u64 isqrt64(u64 n)
+{
+    u64 r = (u64)sqrt((double)n);
+    while (r > 0 && (r > 0xffffffffUL || r*r > n)) r--;
+    while (r < 0xffffffffUL && (r+1)*(r+1) <= n) r++;
+    return r;
+}
+
+/* Sieving primes (7 <= p <= limit) are cached.  We grow the cache
+   by sieving with itself, so the recursion ends quickly.  The old
+   cache is left to GC, for other threads may still be using it. */
+static struct {
+    ScmUInt32 *primes;
+    size_t count;
+    u64 limit;
+    ScmInternalMutex mutex;
+} base_cache = { NULL, 0, 0 };
+
+static void sieve_range(u64 lo, u64 hi, int nthreads, prime_buf *result);
+
+static void get_base_primes(u64 limit, const ScmUInt32 **primes,
+                            size_t *count)
+{
+    SCM_INTERNAL_MUTEX_LOCK(base_cache.mutex);
+    if (base_cache.limit < limit) {
+        /* Grow geometrically to avoid repeated recomputation while
+           the lazy prime sequence advances.  Sieving up to NLIMIT needs
+           the primes up to sqrt(NLIMIT), which either hits the cache or
+           recurses with a smaller limit. */
+        u64 nlimit = base_cache.limit * 2;
+        if (nlimit < limit) nlimit = limit;
+        if (nlimit > 0xffffffffUL) nlimit = 0xffffffffUL;
+        prime_buf buf = { NULL, 0, 0, FALSE };
+        SCM_INTERNAL_MUTEX_UNLOCK(base_cache.mutex);
+        sieve_range(7, nlimit+1, 1, &buf);
+        SCM_INTERNAL_MUTEX_LOCK(base_cache.mutex);
+        if (buf.failed) {
+            free(buf.primes);
+            SCM_INTERNAL_MUTEX_UNLOCK(base_cache.mutex);
+            Scm_Error("out of memory while computing sieving primes up to %lu",
+                      (u_long)nlimit);
+        }
+        if (base_cache.limit < nlimit) {
+            ScmUInt32 *v = SCM_NEW_ATOMIC_ARRAY(ScmUInt32, buf.count);
+            for (size_t i = 0; i < buf.count; i++) {
+                v[i] = (ScmUInt32)buf.primes[i];
+            }
+            base_cache.primes = v;
+            base_cache.count = buf.count;
+            base_cache.limit = nlimit;
+        }
+        free(buf.primes);
+    }
+    /* We only need the primes up to LIMIT. */
+    size_t lo = 0, hi = base_cache.count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (base_cache.primes[mid] <= limit) lo = mid + 1;
+        else hi = mid;
+    }
+    *primes = base_cache.primes;
+    *count = lo;
+    SCM_INTERNAL_MUTEX_UNLOCK(base_cache.mutex);
+}
+
+static void sieve_range(u64 lo, u64 hi, int nthreads, prime_buf *result)
+{
+    static const int small_primes[3] = { 2, 3, 5 };
+    const ScmUInt32 *base = NULL;
+    size_t nbase = 0;
+
+    if (lo >= hi) return;
+    for (int i = 0; i < 3; i++) {
+        if (lo <= (u64)small_primes[i] && (u64)small_primes[i] < hi) {
+            prime_buf_add(result, small_primes[i]);
+        }
+    }
+
+    u64 root = isqrt64(hi - 1);
+    if (root >= 7) get_base_primes(root, &base, &nbase);
+
+    u64 sb = lo / 30;
+    u64 eb = (hi - 1) / 30 + 1;
+
+#if defined(GAUCHE_USE_PTHREADS)
+    /* Don't bother to spawn threads for small ranges. */
+    u64 nbytes = eb - sb;
+    if (nthreads > 1 && nbytes / SIEVE_SEGMENT_BYTES < (u64)nthreads) {
+        nthreads = (int)(nbytes / SIEVE_SEGMENT_BYTES);
+    }
+    if (nthreads > 1) {
+        sieve_job *jobs = SCM_NEW_ARRAY(sieve_job, nthreads);
+        pthread_t *threads = SCM_NEW_ATOMIC_ARRAY(pthread_t, nthreads);
+        int *started = SCM_NEW_ATOMIC_ARRAY(int, nthreads);
+        /* Chunk boundaries are aligned to segments. */
+        u64 chunk = (nbytes / nthreads + SIEVE_SEGMENT_BYTES - 1)
+            / SIEVE_SEGMENT_BYTES * SIEVE_SEGMENT_BYTES;
+        for (int i = 0; i < nthreads; i++) {
+            sieve_job *job = &jobs[i];
+            job->sb = sb + chunk * i;
+            job->eb = (i == nthreads-1) ? eb : sb + chunk * (i+1);
+            if (job->sb > eb) job->sb = eb;
+            if (job->eb > eb) job->eb = eb;
+            job->lo = lo;
+            job->hi = hi;
+            job->base = base;
+            job->nbase = nbase;
+            job->result.primes = NULL;
+            job->result.count = job->result.size = 0;
+            job->result.failed = FALSE;
+            started[i] = (pthread_create(&threads[i], NULL, sieve_worker,
+                                         job) == 0);
+            /* If we can't create a thread, do it by ourselves. */
+            if (!started[i]) sieve_worker(job);
+        }
+        for (int i = 0; i < nthreads; i++) {
+            if (started[i]) pthread_join(threads[i], NULL);
+        }
+        size_t total = result->count;
+        for (int i = 0; i < nthreads; i++) {
+            total += jobs[i].result.count;
+            if (jobs[i].result.failed) result->failed = TRUE;
+        }
+        if (!result->failed && total > result->size) {
+            u64 *np = (u64*)realloc(result->primes, total * sizeof(u64));
+            if (np == NULL) result->failed = TRUE;
+            else { result->primes = np; result->size = total; }
+        }
+        for (int i = 0; i < nthreads; i++) {
+            prime_buf *r = &jobs[i].result;
+            if (!result->failed) {
+                memcpy(result->primes + result->count, r->primes,
+                       r->count * sizeof(u64));
+                result->count += r->count;
+            }
+            free(r->primes);
+        }
+        return;
+    }
+#endif /*GAUCHE_USE_PTHREADS*/
+    {
+        sieve_job job;
+        job.sb = sb;
+        job.eb = eb;
+        job.lo = lo;
+        job.hi = hi;
+        job.base = base;
+        job.nbase = nbase;
+        job.result = *result;
+        sieve_worker(&job);
+        *result = job.result;
+    }
+}
+
+ScmObj Scm_PrimesInRange(u64 lo, u64 hi, int nthreads)
+{
+    prime_buf buf = { NULL, 0, 0, FALSE };
+    sieve_range(lo, hi, nthreads, &buf);
+    if (buf.failed) {
+        free(buf.primes);
+        Scm_Error("out of memory while sieving primes");
+    }
+    ScmObj v = Scm_MakeU64VectorFromArray(buf.count, buf.primes);
+    free(buf.primes);
+    return v;
+}
+
+/*===================================================================
+ * Miller-Rabin test for 64bit integers
+ */
+
+/* We use Montgomery representation so that we don't need division
+   in the modular exponentiation.  With R = 2^64, x is represented as
+   xR mod n, and the product of such a and b is REDC(a*b) = abR^-1 mod n.
+   We need 64x64->128 bit multiplication; most compilers provide 128bit
+   integer type on 64bit platforms. */
+
+#if defined(__SIZEOF_INT128__)
+static inline void mul64(u64 a, u64 b, u64 *hi, u64 *lo)
+{
+    unsigned __int128 t = (unsigned __int128)a * b;
+    *hi = (u64)(t >> 64);
+    *lo = (u64)t;
+}
+#else  /*!__SIZEOF_INT128__*/
+static inline void mul64(u64 a, u64 b, u64 *hi, u64 *lo)
+{
+    u64 a0 = a & 0xffffffffUL, a1 = a >> 32;
+    u64 b0 = b & 0xffffffffUL, b1 = b >> 32;
+    u64 p00 = a0*b0, p01 = a0*b1, p10 = a1*b0, p11 = a1*b1;
+    u64 mid = (p00 >> 32) + (p01 & 0xffffffffUL) + (p10 & 0xffffffffUL);
+    *lo = (mid << 32) | (p00 & 0xffffffffUL);
+    *hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+#endif /*!__SIZEOF_INT128__*/
+
+typedef struct mont_rec {
+    u64 n;
+    u64 ninv;                   /* n^-1 mod 2^64 */
+    u64 one;                    /* R mod n */
+    u64 r2;                     /* R^2 mod n */
+} mont;
+
+static inline u64 mont_mul(u64 a, u64 b, const mont *m)
+{
+    u64 thi, tlo, mhi, mlo;
+    mul64(a, b, &thi, &tlo);
+    u64 q = tlo * m->ninv;
+    mul64(q, m->n, &mhi, &mlo);
+    /* (t - q*n) / R; the low words cancel out. */
+    return (thi >= mhi) ? thi - mhi : thi - mhi + m->n;
+}
+
+static void mont_init(mont *m, u64 n)
+{
+    u64 inv = n;                /* correct to 3 bits, since n is odd */
+    for (int i = 0; i < 5; i++) inv *= 2 - n * inv;
+    m->n = n;
+    m->ninv = inv;
+    m->one = (0 - n) % n;
+    u64 x = m->one;
+    for (int i = 0; i < 64; i++) {  /* x = x * 2^64 mod n */
+        x = (x >= n - x) ? x - (n - x) : x + x;
+    }
+    m->r2 = x;
+}
+
+/* Single Miller-Rabin round.  n-1 = d*2^s.  Returns FALSE if A is
+   a witness of compositeness. */
+static int mr_round(u64 a, u64 d, int s, const mont *m)
+{
+    u64 n = m->n;
+    a %= n;
+    if (a == 0) return TRUE;
+    u64 minus_one = n - m->one;
+    u64 x = m->one, b = mont_mul(a, m->r2, m);
+    for (; d; d >>= 1) {
+        if (d & 1) x = mont_mul(x, b, m);
+        b = mont_mul(b, b, m);
+    }
+    if (x == m->one || x == minus_one) return TRUE;
+    for (int i = 1; i < s; i++) {
+        x = mont_mul(x, x, m);
+        if (x == minus_one) return TRUE;
+        if (x == m->one) return FALSE;
+    }
+    return FALSE;
+}
+
+/* Deterministic bases.
+   For n < 2^32, {2, 7, 61} suffices (Jaeschke).
+   For n < 2^64, the set found by Jim Sinclair suffices. */
+static const u64 mr_bases32[] = { 2, 7, 61 };
+static const u64 mr_bases64[] = { 2, 325, 9375, 28178, 450775, 9780504,
+                                  1795265022 };
+
+int Scm_SmallPrimeP(u64 n)
+{
+    static const int trial[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    for (size_t i = 0; i < sizeof(trial)/sizeof(trial[0]); i++) {
+        if (n == (u64)trial[i]) return TRUE;
+        if (n % trial[i] == 0) return FALSE;
+    }
+    if (n < 41*41) return n > 1;
+
+    u64 d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) { d >>= 1; s++; }
+
+    mont m;
+    mont_init(&m, n);
+    const u64 *bases;
+    int nbases;
+    if (n < ((u64)1 << 32)) {
+        bases = mr_bases32;
+        nbases = sizeof(mr_bases32)/sizeof(mr_bases32[0]);
+    } else {
+        bases = mr_bases64;
+        nbases = sizeof(mr_bases64)/sizeof(mr_bases64[0]);
+    }
+    for (int i = 0; i < nbases; i++) {
+        if (!mr_round(bases[i], d, s, &m)) return FALSE;
+    }
+    return TRUE;
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_prime(void)
+{
+    for (int i = 0; i < 30; i++) wheel_bit[i] = -1;
+    for (int i = 0; i < 8; i++) wheel_bit[wheel_residues[i]] = (signed char)i;
+    SCM_INTERNAL_MUTEX_INIT(base_cache.mutex);
+}
@@ -40,8 +40,7 @@
   (use gauche.sequence)
   (use gauche.threads)
   (use util.sparse)
-  (use util.match)
-  (export primes *primes* reset-primes
+  (export primes *primes* reset-primes primes-in-range
           small-prime? *small-prime-bound*
           miller-rabin-prime? bpsw-prime?
           naive-factorize mc-factorize
@@ -52,77 +51,52 @@
 ;;; Infinite sequence of prime numbers
 ;;;
 
-;; This section of code is based on the segment sieve prime number generator
-;; written by @cddddr.  Optimized by SK.  As of 0.9.4_pre2, it can generate
-;; first 10^7 primes in 14sec on 2.4GHz Core2 machine.
-
-(define (take-first-term a0 d lower-bound)
-  (if (<= lower-bound a0)
-      a0
-      (+ a0 (* d (quotient (- lower-bound a0 (- d) 1) d)))))
-(define (->odd x)  (if (odd? x) x (+ x 1)))
-(define (->even x) (if (even? x) x (+ x 1)))
-(define-inline (integer->index x) (ash x -1))
-
-(define-constant *segment-size* (->even #e5e4))
-(define-constant *first-segment-start*
-  (->odd (ceiling->exact (expt *segment-size* 0.6))))
-(define-constant *sieve-vec-size* (/ *segment-size* 2))
-(define-constant *sieve-filler* '#u8(0))
-
-;; sieve is a bytevector, representing a range of odd numbers.
-;; given odd number N in the range [start, end] (where start and end
-;; are both odd), (vector-ref bytevec (/ (- N start) 2)) is 0 if N
-;; is composite, 1 if not.
-(define (segment-sieve! bytevec start primes)
-  (let ([root (floor->exact (sqrt (+ start *segment-size* -1)))]
-        [start-index (integer->index start)])
-    (let sieve! ([ps (cdr primes)])
-      (match-let1 (p . qs) ps
-        (when (<= p root)
-          (let1 i (- (take-first-term (integer->index (* p p)) p start-index)
-                     start-index)
-            (u8vector-multi-copy! bytevec i p *sieve-filler*))
-          (sieve! qs))))))
-
-(define (bytevec->generator bytevec start)
-  (let1 i 0
-    (^[] (let loop ([j i])
-           (cond [(>= j *sieve-vec-size*) (set! i j) (eof-object)]
-                 [(not (zero? (u8vector-ref bytevec j)))
-                  (set! i (+ j 1))
-                  (+ (* j 2) start)]
-                 [else (loop (+ j 1))])))))
-
-(define (segment-prime-generator start primes)
-  (let1 bytevec (make-u8vector *sieve-vec-size* 1)
-    (segment-sieve! bytevec start primes)
-    (bytevec->generator bytevec start)))
-
-;; Head of prime sequence.  We don't make it a generator,
-;; for we only need to calculate them once and it won't
-;; take long.  We just wrap it with delay so that it won't
-;; tax loading time.
-(define *small-primes*
-  (delay (list-ec (:range n 2 *first-segment-start*)
-                  (if (every?-ec (:range j 2 (+ 1 (floor->exact (sqrt n))))
-                                 (< 0 (mod n j))))
-                  n)))
+;; The sieve is implemented in C (prime.c).  It was originally based on
+;; the segment sieve prime number generator written by @cddddr in Scheme.
+
+(inline-stub
+ "#include \"prime.h\""
+
+ (initcode "Scm_Init_prime();")
+
+ (define-cproc %primes-in-range (lo hi nthreads::<int>)
+   (result (Scm_PrimesInRange (Scm_GetIntegerU64 lo) (Scm_GetIntegerU64 hi)
+                              nthreads)))
+
+ (define-cproc %small-prime? (n) ::<boolean>
+   (result (Scm_SmallPrimeP (Scm_GetIntegerU64 n))))
+ )
+
+;; Each segment covers this many numbers.  The sieve itself
+;; works in L1-cache sized chunks.
+(define-constant *segment-size* (* 30 32768))
+
+;; API
+(define (primes-in-range lo hi :key (num-threads 1))
+  (unless (and (exact-integer? lo) (>= lo 0))
+    (error "nonnegative exact integer required for lower bound, but got:" lo))
+  (unless (exact-integer? hi)
+    (error "exact integer required for upper bound, but got:" hi))
+  ;; The largest 64bit integer isn't a prime, so clamping HI is harmless.
+  (let1 hi (min hi #xffffffffffffffff)
+    (if (<= hi lo)
+      (u64vector)
+      (%primes-in-range lo hi num-threads))))
 
 ;; API
 (define (primes)
-  (define start *first-segment-start*)
-  (define gen (list->generator (force *small-primes*)))
+  (define start 0)
+  (define vec (u64vector))
+  (define i 0)
   (define (gen-primes)
-    (let loop ([v (gen)])
-      (if (eof-object? v)
-        (begin
-          (set! gen (segment-prime-generator start prime-lseq))
-          (inc! start *segment-size*)
-          (loop (gen)))
-        v)))
-  (define prime-lseq (generator->lseq gen-primes))
-  prime-lseq)
+    (if (< i (u64vector-length vec))
+      (begin0 (u64vector-ref vec i) (inc! i))
+      (begin
+        (set! vec (%primes-in-range start (+ start *segment-size*) 1))
+        (set! i 0)
+        (inc! start *segment-size*)
+        (gen-primes))))
+  (generator->lseq gen-primes))
 
 ;; API
 (define *primes* (primes))
@@ -150,33 +124,16 @@
                 [(= a^d n-1) #t]
                 [else (loop (+ i 1) (expt-mod a^d 2 n))])))))
 
-;; For small integers, determinisitc Miller-Rabin is known.
-;; Selfridge&Wagstaff  doi:10.2307/2006210
-;; Jaeschke doi:10.2307/2153262
-(define *deterministic-witnesses*
-  ;; ((bound a ...) ...)
-  ;; If the number to test is less than bound, we only need to test with a ...
-  '((1373653 2 3)
-    (9080191 31 73)
-    (4759123141 2 7 61)
-    (2152302898747 2 3 5 7 11)
-    (3474749660383 2 3 5 7 11 13)
-    (341550071728321 2 3 5 7 11 13 17)))
-
-(define *small-prime-bound*
-  (car (last *deterministic-witnesses*)))
-
-(define (deterministic-miller-rabin n witnesses)
-  (every?-ec (: a witnesses) (miller-rabin-test a n)))
+;; For integers below 2^64, we have deterministic Miller-Rabin test
+;; with a fixed set of bases, implemented natively with Montgomery
+;; multiplication in prime.c.
+(define *small-prime-bound* (expt 2 64))
 
 ;; If n is below *small-prime-bound*, returns deterministic
 ;; answer.  If n is over, always return #f.
 (define (small-prime? n)
-  (if (<= n 100)
-    (boolean (memv n (take *primes* 25))) ; we have 25 primes below 100.
-    (and-let* ([ (odd? n) ]
-               [p (find (^p (< n (car p))) *deterministic-witnesses*)])
-      (deterministic-miller-rabin n (cdr p)))))
+  (and (< 1 n *small-prime-bound*)
+       (%small-prime? n)))
 
 (define *miller-rabin-random-source*
   (rlet1 s (make-random-source)
@@ -415,9 +372,7 @@
         (append (smash (car d)) (smash (cdr d))))))
 
   (define (definite-prime? n)
-    (cond [(< n *small-prime-bound*) (small-prime? n)]
-          [(< n 18446744073709551616) (bpsw-prime? n)]; (expt 2 64)
-          [else #f]))
+    (and (< n *small-prime-bound*) (small-prime? n)))
 
   (define try-prime-limit 1000)
 
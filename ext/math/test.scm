@@ -0,0 +1,71 @@
+;;
+;; testing math.prime native kernels
+;;  More tests of math.prime are in test/math.scm.
+;;
+
+(use gauche.test)
+(use gauche.uvector)
+(use srfi-1)
+
+(test-start "math.prime (native)")
+
+(use math.prime)
+(test-module 'math.prime)
+
+(define (naive-prime? n)
+  (and (> n 1)
+       (let loop ([d 2])
+         (cond [(> (* d d) n) #t]
+               [(zero? (remainder n d)) #f]
+               [else (loop (+ d 1))]))))
+
+(define (naive-primes lo hi)
+  (list->u64vector (filter naive-prime? (iota (- hi lo) lo))))
+
+(test-section "primes-in-range")
+
+(dolist [range '((0 0) (0 2) (0 3) (2 3) (1 8) (7 8) (29 31) (0 1000)
+                 (1000 900) (100000 103000) (999999000 999999999))]
+  (test* #`"primes-in-range ,(car range) ,(cadr range)"
+         (apply naive-primes range)
+         (apply primes-in-range range)))
+
+;; Ranges spanning several sieve segments, also sieved in parallel
+(let1 expected (primes-in-range 983000 3000000)
+  (test* "primes-in-range (first 100 primes)"
+         (take *primes* 100)
+         (u64vector->list (primes-in-range 0 542)))
+  (test* "primes-in-range :num-threads" expected
+         (primes-in-range 983000 3000000 :num-threads 4))
+  (test* "primes-in-range vs *primes*"
+         (take-while (cut < <> 3000000) (drop-while (cut < <> 983000) *primes*))
+         (u64vector->list expected)))
+
+(test* "primes-in-range (count below 10^7)" 664579
+       (u64vector-length (primes-in-range 0 10000000 :num-threads 2)))
+
+(test* "primes-in-range (near 2^64)"
+       '#u64(18446744073709551521 18446744073709551533 18446744073709551557)
+       (primes-in-range (- (expt 2 64) 100) (expt 2 64)))
+
+(test* "primes-in-range (out of range)" (test-error)
+       (primes-in-range (expt 2 64) (expt 2 65)))
+
+(test-section "small-prime?")
+
+(test* "small-prime? vs naive" '()
+       (remove (^n (eq? (small-prime? n) (naive-prime? n))) (iota 20000)))
+
+;; strong pseudoprimes to several bases
+(test* "small-prime? (pseudoprimes)" '(#f #f #f #f)
+       (map small-prime? '(3215031751 2152302898747 3474749660383
+                           3825123056546413051)))
+
+(test* "small-prime? (large primes)" '(#t #t #t)
+       (map small-prime? '(1000000000039 4611686018427387847
+                           18446744073709551557)))
+
+(test* "small-prime? (over the bound)" #f
+       (small-prime? (+ (expt 2 64) 13)))
+
+(test-end)
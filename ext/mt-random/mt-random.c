@@ -281,6 +281,30 @@ ScmObj Scm_MTGenrandInt(ScmMersenneTwister *mt, ScmObj n)
     return SCM_UNDEFINED; /*dummy*/
 }
 
+/*
+ * Normal and exponential distributions
+ */
+
+static inline ScmUInt64 mt_next64(ScmMersenneTwister *mt)
+{
+    ScmUInt64 hi = Scm_MTGenrandU32(mt);
+    return (hi << 32) | Scm_MTGenrandU32(mt);
+}
+
+#define ZIG_STATE      ScmMersenneTwister
+#define ZIG_NEXT64(st) mt_next64(st)
+#include "ziggurat.h"
+
+double Scm_MTGenrandNormal(ScmMersenneTwister *mt)
+{
+    return Zig_Normal(mt);
+}
+
+double Scm_MTGenrandExponential(ScmMersenneTwister *mt)
+{
+    return Zig_Exponential(mt);
+}
+
 /*
  * Gauche specific stuff
  */
@@ -311,6 +335,7 @@ SCM_EXTENSION_ENTRY void Scm_Init_math__mt_random(void)
     Scm_InitStaticClass(&Scm_MersenneTwisterClass, "<mersenne-twister>",
                         mod, NULL, 0);
     key_seed = SCM_MAKE_KEYWORD("seed");
+    Zig_Init();
     Scm_Init_mt_lib(mod);
 }
 
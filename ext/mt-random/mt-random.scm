@@ -42,7 +42,11 @@
           mt-random-integer
           mt-random-fill-u32vector!
           mt-random-fill-f32vector!
-          mt-random-fill-f64vector!)
+          mt-random-fill-f64vector!
+          mt-random-normal
+          mt-random-exponential
+          mt-random-fill-normal-f64vector!
+          mt-random-fill-exponential-f64vector!)
   )
 (select-module math.mt-random)
 
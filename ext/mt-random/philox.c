@@ -0,0 +1,443 @@
+/*
+ * philox.c - Philox4x32-10 counter-based random number generator
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Philox4x32-10 by J. K. Salmon, M. A. Moraes, R. O. Dror and D. E. Shaw,
+ * "Parallel Random Numbers: As Easy as 1, 2, 3", SC11, 2011.
+ *
+ * Philox is a keyed bijection on 128bit counters.  Each output block
+ * depends only on (key, counter), so there's no state to carry from one
+ * block to the next; bulk fill computes PHILOX_LANES blocks side by side
+ * in the struct-of-arrays form, which compilers turn into SIMD code
+ * (32x32->64 multiply is available on SSE2/NEON and later).
+ */
+
+#include <string.h>
+#include "philox.h"
+
+#define PHILOX_M0  0xD2511F53U
+#define PHILOX_M1  0xCD9E8D57U
+#define PHILOX_W0  0x9E3779B9U
+#define PHILOX_W1  0xBB67AE85U
+#define PHILOX_ROUNDS 10
+#define PHILOX_LANES  8
+
+/* Computes one block for the counter ctr. */
+static inline void philox_block(const ScmUInt32 key[2], const ScmUInt32 ctr[4],
+                                ScmUInt32 out[4])
+{
+    ScmUInt32 c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    ScmUInt32 k0 = key[0], k1 = key[1];
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        ScmUInt64 p0 = (ScmUInt64)PHILOX_M0 * c0;
+        ScmUInt64 p1 = (ScmUInt64)PHILOX_M1 * c2;
+        c0 = (ScmUInt32)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (ScmUInt32)p1;
+        c2 = (ScmUInt32)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (ScmUInt32)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+/* Computes PHILOX_LANES consecutive blocks starting from the counter ctr,
+   and stores them to out in the stream order. */
+static void philox_lanes(const ScmUInt32 key[2], const ScmUInt32 ctr[4],
+                         ScmUInt32 *out)
+{
+    ScmUInt32 c0[PHILOX_LANES], c1[PHILOX_LANES];
+    ScmUInt32 c2[PHILOX_LANES], c3[PHILOX_LANES];
+    ScmUInt64 pos = ctr[0] | ((ScmUInt64)ctr[1] << 32);
+    ScmUInt32 k0 = key[0], k1 = key[1];
+    int i, r;
+
+    for (i = 0; i < PHILOX_LANES; i++) {
+        c0[i] = (ScmUInt32)(pos + i);
+        c1[i] = (ScmUInt32)((pos + i) >> 32);
+        c2[i] = ctr[2];
+        c3[i] = ctr[3];
+    }
+    for (r = 0; r < PHILOX_ROUNDS; r++) {
+        for (i = 0; i < PHILOX_LANES; i++) {
+            ScmUInt64 p0 = (ScmUInt64)PHILOX_M0 * c0[i];
+            ScmUInt64 p1 = (ScmUInt64)PHILOX_M1 * c2[i];
+            ScmUInt32 n0 = (ScmUInt32)(p1 >> 32) ^ c1[i] ^ k0;
+            ScmUInt32 n2 = (ScmUInt32)(p0 >> 32) ^ c3[i] ^ k1;
+            c1[i] = (ScmUInt32)p1;
+            c3[i] = (ScmUInt32)p0;
+            c0[i] = n0;
+            c2[i] = n2;
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    for (i = 0; i < PHILOX_LANES; i++) {
+        out[4*i]   = c0[i];
+        out[4*i+1] = c1[i];
+        out[4*i+2] = c2[i];
+        out[4*i+3] = c3[i];
+    }
+}
+
+/* Advances the position part (lower 64 bits) of the counter.
+   The position wraps around within the stream. */
+static inline void ctr_advance(ScmUInt32 ctr[4], ScmUInt64 n)
+{
+    ScmUInt64 pos = (ctr[0] | ((ScmUInt64)ctr[1] << 32)) + n;
+    ctr[0] = (ScmUInt32)pos;
+    ctr[1] = (ScmUInt32)(pos >> 32);
+}
+
+static inline void refill(ScmPhilox *p)
+{
+    philox_block(p->key, p->ctr, p->buf);
+    ctr_advance(p->ctr, 1);
+    p->index = 0;
+}
+
+static inline ScmUInt32 next32(ScmPhilox *p)
+{
+    if (p->index >= 4) refill(p);
+    return p->buf[p->index++];
+}
+
+static inline ScmUInt64 next64(ScmPhilox *p)
+{
+    ScmUInt64 hi = next32(p);
+    return (hi << 32) | next32(p);
+}
+
+/* 53bit uniform on [0,1), or on (0,1) if exclude0 */
+static inline double u64_to_f64(ScmUInt64 u, int exclude0)
+{
+    double r = (double)(u >> 11);
+    if (exclude0) r += 0.5;
+    return r * (1.0/9007199254740992.0);
+}
+
+/* 23bit uniform on (0,1); we don't use 24bits, for then the largest
+   value would be rounded to 1.0. */
+static inline float u32_to_f32(ScmUInt32 u)
+{
+    return ((float)(u >> 9) + 0.5f) * (1.0f/8388608.0f);
+}
+
+#define ZIG_STATE      ScmPhilox
+#define ZIG_NEXT64(st) next64(st)
+#include "ziggurat.h"
+
+/*
+ * Seeding and positioning
+ */
+
+static ScmUInt64 seed_to_u64(ScmObj seed)
+{
+    if (SCM_INTP(seed)) {
+        return (ScmUInt64)(ScmInt64)SCM_INT_VALUE(seed);
+    } else if (SCM_BIGNUMP(seed)) {
+        /* fold the bignum into 64 bits */
+        ScmUInt64 s = 0;
+        for (u_int i = 0; i < SCM_BIGNUM_SIZE(seed); i++) {
+            s ^= (ScmUInt64)SCM_BIGNUM(seed)->values[i]
+                << ((i % (64/SCM_WORD_BITS)) * SCM_WORD_BITS);
+        }
+        return s;
+    } else {
+        Scm_TypeError("random seed", "an exact integer", seed);
+        return 0;               /* dummy */
+    }
+}
+
+void Scm_PhiloxSetSeed(ScmPhilox *p, ScmObj seed, ScmObj stream)
+{
+    ScmUInt64 k = seed_to_u64(seed);
+    ScmUInt64 s = Scm_GetIntegerU64(stream);
+    p->key[0] = (ScmUInt32)k;
+    p->key[1] = (ScmUInt32)(k >> 32);
+    p->ctr[0] = p->ctr[1] = 0;
+    p->ctr[2] = (ScmUInt32)s;
+    p->ctr[3] = (ScmUInt32)(s >> 32);
+    p->index = 4;
+}
+
+/* Skips nwords 32bit words, as if Scm_PhiloxGenrandU32 is called
+   nwords times. */
+void Scm_PhiloxJump(ScmPhilox *p, ScmUInt64 nwords)
+{
+    ScmUInt64 avail = 4 - p->index;
+    if (nwords < avail) {
+        p->index += (int)nwords;
+        return;
+    }
+    nwords -= avail;
+    p->index = 4;
+    ctr_advance(p->ctr, nwords / 4);
+    if (nwords % 4) {
+        refill(p);
+        p->index = (int)(nwords % 4);
+    }
+}
+
+/* The state is #u32(key0 key1 ctr0 ctr1 ctr2 ctr3 index).  The buffer
+   isn't saved, since it can be recomputed from the previous counter. */
+ScmObj Scm_PhiloxGetState(ScmPhilox *p)
+{
+    ScmObj v = Scm_MakeU32Vector(SCM_PHILOX_STATE_SIZE, 0);
+    ScmUInt32 *e = SCM_U32VECTOR_ELEMENTS(v);
+    e[0] = p->key[0];
+    e[1] = p->key[1];
+    memcpy(e+2, p->ctr, sizeof(p->ctr));
+    e[6] = p->index;
+    return v;
+}
+
+void Scm_PhiloxSetState(ScmPhilox *p, ScmObj state)
+{
+    if (!SCM_U32VECTORP(state)
+        || SCM_U32VECTOR_SIZE(state) != SCM_PHILOX_STATE_SIZE) {
+        Scm_Error("u32vector of length %d is required, but got %S",
+                  SCM_PHILOX_STATE_SIZE, state);
+    }
+    ScmUInt32 *e = SCM_U32VECTOR_ELEMENTS(state);
+    if (e[6] > 4) Scm_Error("invalid philox state: %S", state);
+    p->key[0] = e[0];
+    p->key[1] = e[1];
+    memcpy(p->ctr, e+2, sizeof(p->ctr));
+    p->index = 4;
+    if (e[6] < 4) {
+        ctr_advance(p->ctr, (ScmUInt64)-1);
+        refill(p);
+        p->index = e[6];
+    }
+}
+
+/* Returns a new generator with the same key, at the beginning of
+   the stream STREAM. */
+ScmObj Scm_PhiloxStream(ScmPhilox *p, ScmObj stream)
+{
+    ScmUInt64 s = Scm_GetIntegerU64(stream);
+    ScmPhilox *q = SCM_NEW_ATOMIC(ScmPhilox);
+    SCM_SET_CLASS(q, &Scm_PhiloxClass);
+    q->key[0] = p->key[0];
+    q->key[1] = p->key[1];
+    q->ctr[0] = q->ctr[1] = 0;
+    q->ctr[2] = (ScmUInt32)s;
+    q->ctr[3] = (ScmUInt32)(s >> 32);
+    q->index = 4;
+    return SCM_OBJ(q);
+}
+
+/*
+ * Scalar generation
+ */
+
+ScmUInt32 Scm_PhiloxGenrandU32(ScmPhilox *p)
+{
+    return next32(p);
+}
+
+ScmUInt64 Scm_PhiloxGenrandU64(ScmPhilox *p)
+{
+    return next64(p);
+}
+
+double Scm_PhiloxGenrandF64(ScmPhilox *p, int exclude0)
+{
+    return u64_to_f64(next64(p), exclude0);
+}
+
+double Scm_PhiloxNormal(ScmPhilox *p)
+{
+    return Zig_Normal(p);
+}
+
+double Scm_PhiloxExponential(ScmPhilox *p)
+{
+    return Zig_Exponential(p);
+}
+
+/* Returns a random integer in [0, n), 0 < n <= 2^64.  We take the
+   largest multiple of n that fits in the word and reject the
+   values beyond it. */
+ScmObj Scm_PhiloxGenrandInt(ScmPhilox *p, ScmObj n)
+{
+    if (SCM_INTEGERP(n) && Scm_Sign(n) > 0) {
+        int oor = FALSE;
+        ScmUInt64 mask =        /* n-1 */
+            Scm_GetIntegerU64Clamp(Scm_Sub(n, SCM_MAKE_INT(1)),
+                                   SCM_CLAMP_NONE, &oor);
+        if (!oor) {
+            if ((mask & (mask+1)) == 0) {
+                /* n is a power of two */
+                if (mask <= 0xffffffffULL) {
+                    return Scm_MakeIntegerU64(next32(p) & mask);
+                } else {
+                    return Scm_MakeIntegerU64(next64(p) & mask);
+                }
+            }
+            ScmUInt64 m = mask + 1;
+            if (m <= 0xffffffffULL) {
+                ScmUInt32 lim = 0xffffffffU - (ScmUInt32)(0x100000000ULL % m);
+                ScmUInt32 r;
+                do { r = next32(p); } while (r > lim);
+                return Scm_MakeIntegerU64(r % m);
+            } else {
+                ScmUInt64 lim = ~(ScmUInt64)0 - ((~(ScmUInt64)0 % m) + 1) % m;
+                ScmUInt64 r;
+                do { r = next64(p); } while (r > lim);
+                return Scm_MakeIntegerU64(r % m);
+            }
+        }
+    }
+    Scm_Error("bad type of argument for n: positive integer up to 2^64 is required, but got %S", n);
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+/*
+ * Bulk generation
+ */
+
+void Scm_PhiloxFillU32(ScmPhilox *p, ScmUInt32 *v, int n)
+{
+    /* drain the buffer first, so that the result is the same as
+       calling Scm_PhiloxGenrandU32 n times */
+    while (n > 0 && p->index < 4) {
+        *v++ = p->buf[p->index++];
+        n--;
+    }
+    while (n >= 4*PHILOX_LANES) {
+        philox_lanes(p->key, p->ctr, v);
+        ctr_advance(p->ctr, PHILOX_LANES);
+        v += 4*PHILOX_LANES;
+        n -= 4*PHILOX_LANES;
+    }
+    while (n >= 4) {
+        philox_block(p->key, p->ctr, v);
+        ctr_advance(p->ctr, 1);
+        v += 4;
+        n -= 4;
+    }
+    if (n > 0) {
+        refill(p);
+        while (n-- > 0) *v++ = p->buf[p->index++];
+    }
+}
+
+/* The other fills go through a chunk of raw words on the stack. */
+#define CHUNK_WORDS  (4*PHILOX_LANES*8)
+
+void Scm_PhiloxFillU64(ScmPhilox *p, ScmUInt64 *v, int n)
+{
+    ScmUInt32 w[CHUNK_WORDS];
+    while (n > 0) {
+        int k = (n > CHUNK_WORDS/2)? CHUNK_WORDS/2 : n;
+        Scm_PhiloxFillU32(p, w, k*2);
+        for (int i = 0; i < k; i++) {
+            v[i] = ((ScmUInt64)w[2*i] << 32) | w[2*i+1];
+        }
+        v += k;
+        n -= k;
+    }
+}
+
+void Scm_PhiloxFillF64(ScmPhilox *p, double *v, int n)
+{
+    ScmUInt32 w[CHUNK_WORDS];
+    while (n > 0) {
+        int k = (n > CHUNK_WORDS/2)? CHUNK_WORDS/2 : n;
+        Scm_PhiloxFillU32(p, w, k*2);
+        for (int i = 0; i < k; i++) {
+            v[i] = u64_to_f64(((ScmUInt64)w[2*i] << 32) | w[2*i+1], TRUE);
+        }
+        v += k;
+        n -= k;
+    }
+}
+
+void Scm_PhiloxFillF32(ScmPhilox *p, float *v, int n)
+{
+    ScmUInt32 w[CHUNK_WORDS];
+    while (n > 0) {
+        int k = (n > CHUNK_WORDS)? CHUNK_WORDS : n;
+        Scm_PhiloxFillU32(p, w, k);
+        for (int i = 0; i < k; i++) v[i] = u32_to_f32(w[i]);
+        v += k;
+        n -= k;
+    }
+}
+
+/* Ziggurat consumes a variable number of words per sample, so we just
+   run the scalar sampler; it's still a few nanoseconds per sample. */
+void Scm_PhiloxFillNormal(ScmPhilox *p, double *v, int n,
+                          double mean, double sd)
+{
+    for (int i = 0; i < n; i++) v[i] = mean + sd * Zig_Normal(p);
+}
+
+void Scm_PhiloxFillExponential(ScmPhilox *p, double *v, int n, double mean)
+{
+    for (int i = 0; i < n; i++) v[i] = mean * Zig_Exponential(p);
+}
+
+/*
+ * Gauche specific stuff
+ */
+static ScmObj key_seed;
+static ScmObj key_stream;
+static ScmObj philox_allocate(ScmClass *klass, ScmObj initargs);
+SCM_DEFINE_BUILTIN_CLASS(Scm_PhiloxClass,
+                         NULL, NULL, NULL, philox_allocate,
+                         NULL);
+
+static ScmObj philox_allocate(ScmClass *klass, ScmObj initargs)
+{
+    ScmObj seed = Scm_GetKeyword(key_seed, initargs, SCM_MAKE_INT(0));
+    ScmObj stream = Scm_GetKeyword(key_stream, initargs, SCM_MAKE_INT(0));
+    ScmPhilox *p = SCM_NEW_ATOMIC(ScmPhilox);
+    SCM_SET_CLASS(p, &Scm_PhiloxClass);
+    Scm_PhiloxSetSeed(p, seed, stream);
+    return SCM_OBJ(p);
+}
+
+extern void Scm_Init_philox_lib(ScmModule*);
+
+SCM_EXTENSION_ENTRY void Scm_Init_math__philox(void)
+{
+    ScmModule *mod = SCM_FIND_MODULE("math.philox", SCM_FIND_MODULE_CREATE);
+    SCM_INIT_EXTENSION(math__philox);
+    Scm_InitStaticClass(&Scm_PhiloxClass, "<philox>", mod, NULL, 0);
+    key_seed = SCM_MAKE_KEYWORD("seed");
+    key_stream = SCM_MAKE_KEYWORD("stream");
+    Zig_Init();
+    Scm_Init_philox_lib(mod);
+}
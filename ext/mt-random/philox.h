@@ -0,0 +1,89 @@
+/*
+ * philox.h - Philox4x32-10 counter-based random number generator
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_MATH_PHILOX_H
+#define GAUCHE_MATH_PHILOX_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTMTRANDOM_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/* The output stream is the concatenation of Philox4x32-10 blocks
+   for counter values ctr, ctr+1, ...  The lower 64 bits of the counter
+   are the position in the stream, and the upper 64 bits are the
+   stream id.  Since each block depends only on (key, counter),
+   skipping ahead is just an addition, and the generator for a
+   different stream id is statistically independent. */
+typedef struct ScmPhiloxRec {
+    SCM_HEADER;
+    ScmUInt32 key[2];
+    ScmUInt32 ctr[4];           /* counter of the next block */
+    ScmUInt32 buf[4];           /* current block */
+    int index;                  /* next word in buf; 4 if buf is empty */
+} ScmPhilox;
+
+SCM_CLASS_DECL(Scm_PhiloxClass);
+#define SCM_PHILOX(obj)     ((ScmPhilox*)obj)
+#define SCM_PHILOXP(obj)    SCM_XTYPEP(obj, &Scm_PhiloxClass)
+
+#define SCM_PHILOX_STATE_SIZE 7
+
+SCM_EXTERN void      Scm_PhiloxSetSeed(ScmPhilox *p, ScmObj seed, ScmObj stream);
+SCM_EXTERN void      Scm_PhiloxJump(ScmPhilox *p, ScmUInt64 nwords);
+SCM_EXTERN ScmObj    Scm_PhiloxGetState(ScmPhilox *p);
+SCM_EXTERN void      Scm_PhiloxSetState(ScmPhilox *p, ScmObj state);
+SCM_EXTERN ScmObj    Scm_PhiloxStream(ScmPhilox *p, ScmObj stream);
+
+SCM_EXTERN ScmUInt32 Scm_PhiloxGenrandU32(ScmPhilox *p);
+SCM_EXTERN ScmUInt64 Scm_PhiloxGenrandU64(ScmPhilox *p);
+SCM_EXTERN double    Scm_PhiloxGenrandF64(ScmPhilox *p, int exclude0);
+SCM_EXTERN ScmObj    Scm_PhiloxGenrandInt(ScmPhilox *p, ScmObj n);
+SCM_EXTERN double    Scm_PhiloxNormal(ScmPhilox *p);
+SCM_EXTERN double    Scm_PhiloxExponential(ScmPhilox *p);
+
+/* Bulk fill.  Whole blocks are generated without going through
+   the buffer, so these are much faster than repeated calls. */
+SCM_EXTERN void Scm_PhiloxFillU32(ScmPhilox *p, ScmUInt32 *v, int n);
+SCM_EXTERN void Scm_PhiloxFillU64(ScmPhilox *p, ScmUInt64 *v, int n);
+SCM_EXTERN void Scm_PhiloxFillF32(ScmPhilox *p, float *v, int n);
+SCM_EXTERN void Scm_PhiloxFillF64(ScmPhilox *p, double *v, int n);
+SCM_EXTERN void Scm_PhiloxFillNormal(ScmPhilox *p, double *v, int n,
+                                     double mean, double sd);
+SCM_EXTERN void Scm_PhiloxFillExponential(ScmPhilox *p, double *v, int n,
+                                          double mean);
+
+#endif /*GAUCHE_MATH_PHILOX_H*/
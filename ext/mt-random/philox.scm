@@ -0,0 +1,77 @@
+;;;
+;;; philox - Counter-based random number generator
+;;;
+;;;   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module math.philox
+  (use gauche.uvector)
+  (export <philox>
+          philox-random-set-seed!
+          philox-random-stream
+          philox-random-jump!
+          philox-random-get-state
+          philox-random-set-state!
+          philox-random-real
+          philox-random-real0
+          philox-random-integer
+          philox-random-normal
+          philox-random-exponential
+          philox-random-fill-u32vector!
+          philox-random-fill-u64vector!
+          philox-random-fill-f32vector!
+          philox-random-fill-f64vector!
+          philox-random-fill-normal-f64vector!
+          philox-random-fill-exponential-f64vector!)
+  )
+(select-module math.philox)
+
+(dynamic-load "math--philox")
+
+;; The native routine covers the range up to 2^64.  Beyond that,
+;; we concatenate 64bit words and reject the excess, as mt-random-integer.
+(define (%get-nword-random-int p n)
+  (let loop ([i 1] [r (%philox-random-uint64 p)])
+    (if (= i n)
+      r
+      (loop (+ i 1)
+            (+ (ash r 64) (%philox-random-uint64 p))))))
+
+(define (philox-random-integer p n)
+  (when (not (positive? n)) (error "invalid range" n))
+  (if (<= n #x10000000000000000)
+    (%philox-random-integer p n)
+    (let* ([siz (+ (ash (integer-length n) -6) 1)]
+           [q   (quotient (ash 1 (* 64 siz)) n)]
+           [qn  (* q n)])
+      (let loop ([r (%get-nword-random-int p siz)])
+        (if (< r qn)
+          (quotient r q)
+          (loop (%get-nword-random-int p siz)))))))
@@ -110,6 +110,122 @@
                      (make-random-sequence <list> 100 (^[] (mt-random-real m2)))
                      ))))
 
+;; For nonuniform distributions we check the sample moments loosely.
+(define (mean&variance v)
+  (let* ([xs (f64vector->list v)]
+         [n  (length xs)]
+         [m  (/ (apply + xs) n)])
+    (values m (/ (fold (^[x s] (+ s (* (- x m) (- x m)))) 0 xs) n))))
+
+(define (moment-check name v mean variance)
+  (receive (m var) (mean&variance v)
+    (test* #"~name mean" #t (< (abs (- m mean)) (* 0.05 (sqrt variance))))
+    (test* #"~name variance" #t (< (abs (- var variance)) (* 0.1 variance)))))
+
+(let1 m (make <mersenne-twister> :seed 53)
+  (moment-check "mt normal"
+                (mt-random-fill-normal-f64vector! m (make-f64vector 10000) 3 2)
+                3 4)
+  (moment-check "mt exponential"
+                (mt-random-fill-exponential-f64vector! m (make-f64vector 10000) 2)
+                2 4))
+
+(test* "mt normal (scalar vs fill)" #t
+       (let ([m0 (make <mersenne-twister> :seed 1)]
+             [m1 (make <mersenne-twister> :seed 1)])
+         (equal? (make-random-sequence <f64vector> 100
+                                       (^[] (mt-random-normal m0)))
+                 (mt-random-fill-normal-f64vector! m1 (make-f64vector 100)))))
+
+;;-------------------------------------------------------------------
+(test-section "math.philox")
+
+(use math.philox)
+(test-module 'math.philox)
+
+(define p (make <philox> :seed 1))
+
+;; Known answer from Random123: key 0, counter 0
+(test* "philox block" '#u32(#x6627e8d5 #xe169c58d #xbc57ac4c #x9b00dbd8)
+       (philox-random-fill-u32vector! (make <philox> :seed 0)
+                                      (make-u32vector 4)))
+
+(test* "philox-random-integer" #t
+       (every (value-in-range? 7)
+              (make-random-sequence <list> 1000
+                                    (^[] (philox-random-integer p 7)))))
+(test* "philox-random-integer (2^64)" #t
+       (every (value-in-range? (expt 2 64))
+              (make-random-sequence <list> 100
+                                    (^[] (philox-random-integer p (expt 2 64))))))
+(test* "philox-random-integer (bignum)" #t
+       (every (value-in-range? (expt 3 100))
+              (make-random-sequence <list> 1000
+                                    (^[] (philox-random-integer p (expt 3 100))))))
+(test* "philox-random-real" #t
+       (every (^n (< 0 n 1))
+              (make-random-sequence <list> 1000 (^[] (philox-random-real p)))))
+
+(test* "philox seed" #t
+       (let ([p0 (make <philox> :seed 1)]
+             [p1 (make <philox> :seed 1)])
+         (equal? (make-random-sequence <list> 100 (^[] (philox-random-real p0)))
+                 (make-random-sequence <list> 100 (^[] (philox-random-real p1))))))
+(test* "philox stream" #f
+       (let ([p0 (make <philox> :seed 1 :stream 0)]
+             [p1 (make <philox> :seed 1 :stream 1)])
+         (equal? (make-random-sequence <list> 100 (^[] (philox-random-real p0)))
+                 (make-random-sequence <list> 100 (^[] (philox-random-real p1))))))
+(test* "philox-random-stream" #t
+       (let ([p0 (philox-random-stream p 5)]
+             [p1 (make <philox> :seed 1 :stream 5)])
+         (equal? (make-random-sequence <list> 100 (^[] (philox-random-real p0)))
+                 (make-random-sequence <list> 100 (^[] (philox-random-real p1))))))
+
+;; bulk fill must produce the same sequence as the scalar calls,
+;; even if it starts in the middle of a block.
+(test* "philox u32vector" #t
+       (let ([p0 (make <philox> :seed 1)]
+             [p1 (make <philox> :seed 1)])
+         (philox-random-integer p0 2)
+         (philox-random-integer p1 2)
+         (equal? (make-random-sequence <u32vector> 1001
+                                       (^[] (philox-random-integer p0 (expt 2 32))))
+                 (philox-random-fill-u32vector! p1 (make-u32vector 1001)))))
+(test* "philox f64vector" #t
+       (let ([p0 (make <philox> :seed 1)]
+             [p1 (make <philox> :seed 1)])
+         (equal? (make-random-sequence <f64vector> 1001
+                                       (^[] (philox-random-real p0)))
+                 (philox-random-fill-f64vector! p1 (make-f64vector 1001)))))
+(test* "philox f32vector" #t
+       (every (^n (< 0 n 1))
+              (philox-random-fill-f32vector! p (make-f32vector 1000))))
+
+(test* "philox-random-jump!" #t
+       (let ([p0 (make <philox> :seed 1)]
+             [p1 (make <philox> :seed 1)])
+         (philox-random-integer p0 2)
+         (philox-random-integer p1 2)
+         (philox-random-jump! p0 12345)
+         (philox-random-fill-u32vector! p1 (make-u32vector 12345))
+         (equal? (philox-random-fill-u32vector! p0 (make-u32vector 10))
+                 (philox-random-fill-u32vector! p1 (make-u32vector 10)))))
+
+(test* "philox state" #t
+       (let ([s  (begin (philox-random-integer p 2) (philox-random-get-state p))]
+             [p2 (make <philox> :seed 9324)])
+         (philox-random-set-state! p2 s)
+         (equal? (make-random-sequence <list> 100 (^[] (philox-random-real p)))
+                 (make-random-sequence <list> 100 (^[] (philox-random-real p2))))))
+
+(moment-check "philox normal"
+              (philox-random-fill-normal-f64vector! p (make-f64vector 10000) 3 2)
+              3 4)
+(moment-check "philox exponential"
+              (philox-random-fill-exponential-f64vector! p (make-f64vector 10000) 2)
+              2 4)
+
 ;;-------------------------------------------------------------------
 ;; srfi-27 is built on top of mt-random, so we test it here.
 (test-section "srfi-27")
@@ -0,0 +1,149 @@
+/*
+ * ziggurat.h - normal and exponential samplers
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Ziggurat method by G. Marsaglia and W. W. Tsang, "The Ziggurat Method
+ * for Generating Random Variables", Journal of Statistical Software 5(8),
+ * 2000.  The tables are computed at initialization.
+ *
+ * The original code takes the layer index from the low bits of the
+ * same 32bit word that is scaled to the sample, which makes them
+ * correlated.  We draw a 64bit word instead, and use the upper half
+ * for the sample and the lower half for the index.
+ *
+ * This file is meant to be included by exactly one source file of
+ * each DSO.  The includer defines ZIG_STATE to the generator type
+ * and ZIG_NEXT64(st) to an expression that yields a uniform 64bit word.
+ * Zig_Init() must be called once before sampling.
+ */
+
+#ifndef ZIGGURAT_H
+#define ZIGGURAT_H
+
+#include <math.h>
+
+static ScmUInt32 zig_kn[128], zig_ke[256];
+static double zig_wn[128], zig_fn[128], zig_we[256], zig_fe[256];
+
+#define ZIG_NORMAL_R   3.442619855899
+#define ZIG_EXP_R      7.697117470131487
+
+static void Zig_Init(void)
+{
+    const double m1 = 2147483648.0, m2 = 4294967296.0;
+    double dn = ZIG_NORMAL_R, tn = dn, vn = 9.91256303526217e-3;
+    double de = ZIG_EXP_R, te = de, ve = 3.949659822581572e-3;
+    double q;
+    int i;
+
+    q = vn/exp(-0.5*dn*dn);
+    zig_kn[0] = (ScmUInt32)((dn/q)*m1);
+    zig_kn[1] = 0;
+    zig_wn[0] = q/m1;
+    zig_wn[127] = dn/m1;
+    zig_fn[0] = 1.0;
+    zig_fn[127] = exp(-0.5*dn*dn);
+    for (i=126; i>=1; i--) {
+        dn = sqrt(-2.0*log(vn/dn + exp(-0.5*dn*dn)));
+        zig_kn[i+1] = (ScmUInt32)((dn/tn)*m1);
+        tn = dn;
+        zig_fn[i] = exp(-0.5*dn*dn);
+        zig_wn[i] = dn/m1;
+    }
+
+    q = ve/exp(-de);
+    zig_ke[0] = (ScmUInt32)((de/q)*m2);
+    zig_ke[1] = 0;
+    zig_we[0] = q/m2;
+    zig_we[255] = de/m2;
+    zig_fe[0] = 1.0;
+    zig_fe[255] = exp(-de);
+    for (i=254; i>=1; i--) {
+        de = -log(ve/de + exp(-de));
+        zig_ke[i+1] = (ScmUInt32)((de/te)*m2);
+        te = de;
+        zig_fe[i] = exp(-de);
+        zig_we[i] = de/m2;
+    }
+}
+
+/* uniform on (0,1) */
+static inline double zig_uni(ZIG_STATE *st)
+{
+    return ((double)(ZIG_NEXT64(st) >> 11) + 0.5) * (1.0/9007199254740992.0);
+}
+
+/* standard normal deviate */
+static double Zig_Normal(ZIG_STATE *st)
+{
+    for (;;) {
+        ScmUInt64 u = ZIG_NEXT64(st);
+        ScmInt32 hz = (ScmInt32)(ScmUInt32)(u >> 32);
+        int iz = (int)(u & 127);
+        ScmUInt32 az = (hz < 0)? (ScmUInt32)0 - (ScmUInt32)hz : (ScmUInt32)hz;
+        double x = hz * zig_wn[iz];
+
+        if (az < zig_kn[iz]) return x;
+        if (iz == 0) {
+            /* tail beyond R */
+            double xx, y;
+            do {
+                xx = -log(zig_uni(st)) * (1.0/ZIG_NORMAL_R);
+                y = -log(zig_uni(st));
+            } while (y+y < xx*xx);
+            return (hz > 0)? ZIG_NORMAL_R + xx : -ZIG_NORMAL_R - xx;
+        }
+        if (zig_fn[iz] + zig_uni(st)*(zig_fn[iz-1]-zig_fn[iz])
+            < exp(-0.5*x*x)) {
+            return x;
+        }
+    }
+}
+
+/* exponential deviate with mean 1 */
+static double Zig_Exponential(ZIG_STATE *st)
+{
+    for (;;) {
+        ScmUInt64 u = ZIG_NEXT64(st);
+        ScmUInt32 jz = (ScmUInt32)(u >> 32);
+        int iz = (int)(u & 255);
+        double x = jz * zig_we[iz];
+
+        if (jz < zig_ke[iz]) return x;
+        if (iz == 0) return ZIG_EXP_R - log(zig_uni(st));
+        if (zig_fe[iz] + zig_uni(st)*(zig_fe[iz-1]-zig_fe[iz]) < exp(-x)) {
+            return x;
+        }
+    }
+}
+
+#endif /*ZIGGURAT_H*/
@@ -762,6 +762,16 @@
                                                   [(null) 'null]))])
          (parse-json-string "{\"x\":[1,2,3],\"y\":[false,true,null]}")))
 
+(test* "json-intern-strings" '(#t #t #f)
+       (let1 v (parameterize ([json-intern-strings 3])
+                 (parse-json-string
+                  "[{\"id\":\"abc\",\"name\":\"abcdef\"},\
+                    {\"id\":\"abc\",\"name\":\"abcdef\"}]"))
+         (let ([x (vector-ref v 0)] [y (vector-ref v 1)])
+           (list (eq? (car (assoc "id" x)) (car (assoc "id" y)))
+                 (eq? (cdr (assoc "id" x)) (cdr (assoc "id" y)))
+                 (eq? (cdr (assoc "name" x)) (cdr (assoc "name" y)))))))
+
 (let ()
   (define (test-writer name obj)
     (test* name obj
@@ -388,6 +388,21 @@
        (rlet1 v (make-u16vector 4 0)
          (uvector-copy! v 2 '#u8(1 1))))
 
+(test* "u8vector-search" '(1 4 #f 0 2 #f 5 #f)
+       (let1 v '#u8(1 2 3 1 2 3 4)
+         (list (u8vector-search v '#u8(2 3))
+               (u8vector-search v '#u8(2 3) 2)
+               (u8vector-search v '#u8(2 3) 2 5)
+               (u8vector-search v '#u8(1))
+               (u8vector-search v '#u8() 2)
+               (u8vector-search v '#u8(3 4 5))
+               (u8vector-search v '#u8(3 4))
+               (u8vector-search '#u8() '#u8(1)))))
+(test* "u8vector-search (long)" 9995
+       (let1 v (make-u8vector 10000 65)
+         (u8vector-set! v 9999 66)
+         (u8vector-search v (string->u8vector "AAAAB"))))
+
 (define (uv-multicopy!-test msg make ctor copy!)
   (test* #"~msg generic" (ctor 0 1 2 3 0 1 2 3 0 1 2)
          (rlet1 dst (make 11 0)
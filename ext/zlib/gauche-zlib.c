@@ -34,6 +34,9 @@
 #include "gauche-zlib.h"
 #include <gauche/exception.h>
 #include <gauche/class.h>
+#if defined(GAUCHE_USE_PTHREADS)
+#include <unistd.h>
+#endif
 #define CHUNK 4096
 
 #define DEFAULT_BUFFER_SIZE 4096
@@ -57,6 +60,10 @@ SCM_DEFINE_BASE_CLASS(Scm_InflatingPortClass,
                       ScmPort, /* instance type */
                       NULL, NULL, NULL, NULL, port_cpl);
 
+SCM_DEFINE_BASE_CLASS(Scm_ParallelDeflatingPortClass,
+                      ScmPort, /* instance type */
+                      NULL, NULL, NULL, NULL, port_cpl);
+
 /*================================================================
  * Conditions
  */
@@ -553,6 +560,624 @@ ScmObj Scm_InflateSync(ScmPort *port)
     return Scm_MakeIntegerU(strm->total_in - curr_in);
 }
 
+/*================================================================
+ * Parallel deflating port
+ *
+ *   Like pigz, the input is split into blocks of BLOCKSIZE bytes, and
+ *   each block is compressed into a raw deflate stream independently
+ *   by a worker thread.  Each block is primed with the last window of
+ *   the previous block as the dictionary, so the compression ratio is
+ *   almost the same as the sequential one.  Every block but the last
+ *   is terminated by a sync flush, so that the concatenation of the
+ *   compressed blocks is a valid deflate stream.  The caller's thread
+ *   writes the compressed blocks in order, along with the zlib or gzip
+ *   header and trailer.  The check value is computed per block and
+ *   combined by crc32_combine/adler32_combine.
+ *
+ *   If we don't have threads, or the number of threads is 1, blocks
+ *   are compressed in the caller's thread, producing the same output.
+ */
+
+#define DEFAULT_BLOCK_SIZE  (128*1024)
+#define MINIMUM_BLOCK_SIZE  (32*1024)
+
+enum {
+    PDEFLATE_RAW,
+    PDEFLATE_ZLIB,
+    PDEFLATE_GZIP
+};
+
+typedef struct ScmParDeflateJobRec {
+    struct ScmParDeflateJobRec *next;  /* link in pending list */
+    struct ScmParDeflateJobRec *qnext; /* link in work queue */
+    unsigned char *in;          /* input block */
+    int inlen;
+    unsigned char *dict;        /* priming dictionary */
+    int dictlen;
+    unsigned char *out;         /* compressed data */
+    int outsize;
+    int outlen;
+    uLong check;                /* crc32 or adler32 of the input block */
+    int last;                   /* TRUE if this is the last block */
+    int done;                   /* TRUE if compression is done */
+    int status;                 /* Z_OK, or zlib error code */
+} ScmParDeflateJob;
+
+typedef struct ScmParDeflateInfoRec {
+    ScmPort *remote;            /* drain port */
+    int ownerp;
+    int level;
+    int memlevel;
+    int strategy;
+    int format;                 /* PDEFLATE_RAW, _ZLIB or _GZIP */
+    int window_bits;            /* 9..15 */
+    int blocksize;
+    unsigned char *block;       /* block being filled */
+    int blocklen;
+    unsigned char *tail;        /* last window of the data submitted */
+    int taillen;
+    uLong check;                /* combined check value of written blocks */
+    uLong total_in;
+    int header_written;
+    ScmParDeflateJob *pending;  /* submitted, but not written yet */
+    ScmParDeflateJob *pending_tail;
+    int npending;
+    ScmParDeflateJob *queue;    /* waiting for a worker */
+    ScmParDeflateJob *queue_tail;
+    int nthreads;               /* 0 if we compress in the caller thread */
+    int nstarted;               /* # of worker threads running */
+    int shutdown;
+#if defined(GAUCHE_USE_PTHREADS)
+    pthread_t *workers;
+#endif
+    ScmInternalMutex mutex;
+    ScmInternalCond work_cv;    /* signalled when a job is queued */
+    ScmInternalCond done_cv;    /* signalled when a job is done */
+} ScmParDeflateInfo;
+
+#define SCM_PORT_PDEFLATE_INFO(p) ((ScmParDeflateInfo*)(p)->src.buf.data)
+
+/* Compresses one block.  Called from worker threads, so it must not
+   touch Scheme objects nor allocate. */
+static void pdeflate_compress(ScmParDeflateInfo *info, ScmParDeflateJob *job)
+{
+    z_stream strm;
+
+    memset(&strm, 0, sizeof(strm));
+    int r = deflateInit2(&strm, info->level, Z_DEFLATED, -info->window_bits,
+                         info->memlevel, info->strategy);
+    if (r != Z_OK) {
+        job->status = r;
+        return;
+    }
+    if (job->dictlen > 0) {
+        r = deflateSetDictionary(&strm, job->dict, job->dictlen);
+        if (r != Z_OK) {
+            deflateEnd(&strm);
+            job->status = r;
+            return;
+        }
+    }
+    strm.next_in = job->in;
+    strm.avail_in = job->inlen;
+    strm.next_out = job->out;
+    strm.avail_out = job->outsize;
+    r = deflate(&strm, job->last? Z_FINISH : Z_SYNC_FLUSH);
+    if (job->last) {
+        job->status = (r == Z_STREAM_END)? Z_OK : (r == Z_OK)? Z_BUF_ERROR : r;
+    } else {
+        job->status = (r == Z_OK && strm.avail_out > 0)? Z_OK
+            : (r == Z_OK)? Z_BUF_ERROR : r;
+    }
+    job->outlen = strm.next_out - job->out;
+    deflateEnd(&strm);
+
+    switch (info->format) {
+    case PDEFLATE_GZIP:
+        job->check = crc32(crc32(0L, Z_NULL, 0), job->in, job->inlen);
+        break;
+    case PDEFLATE_ZLIB:
+        job->check = adler32(adler32(0L, Z_NULL, 0), job->in, job->inlen);
+        break;
+    }
+}
+
+#if defined(GAUCHE_USE_PTHREADS)
+static void *pdeflate_worker(void *data)
+{
+    ScmParDeflateInfo *info = (ScmParDeflateInfo*)data;
+
+    for (;;) {
+        (void)SCM_INTERNAL_MUTEX_LOCK(info->mutex);
+        while (info->queue == NULL && !info->shutdown) {
+            (void)SCM_INTERNAL_COND_WAIT(info->work_cv, info->mutex);
+        }
+        if (info->shutdown) {
+            (void)SCM_INTERNAL_MUTEX_UNLOCK(info->mutex);
+            break;
+        }
+        ScmParDeflateJob *job = info->queue;
+        info->queue = job->qnext;
+        if (info->queue == NULL) info->queue_tail = NULL;
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(info->mutex);
+
+        pdeflate_compress(info, job);
+
+        (void)SCM_INTERNAL_MUTEX_LOCK(info->mutex);
+        job->done = TRUE;
+        (void)SCM_INTERNAL_COND_BROADCAST(info->done_cv);
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(info->mutex);
+    }
+    return NULL;
+}
+#endif /*GAUCHE_USE_PTHREADS*/
+
+/* Start worker threads lazily, so that small output doesn't pay for it.
+   If we fail to create threads, we fall back to compress by ourselves. */
+static void pdeflate_start_workers(ScmParDeflateInfo *info)
+{
+#if defined(GAUCHE_USE_PTHREADS)
+    info->workers = SCM_NEW_ATOMIC2(pthread_t*,
+                                    sizeof(pthread_t)*info->nthreads);
+    for (int i=0; i<info->nthreads; i++) {
+        if (pthread_create(&info->workers[i], NULL,
+                           pdeflate_worker, info) != 0) {
+            break;
+        }
+        info->nstarted++;
+    }
+#endif /*GAUCHE_USE_PTHREADS*/
+    if (info->nstarted == 0) info->nthreads = 0;
+}
+
+static void pdeflate_stop_workers(ScmParDeflateInfo *info)
+{
+    if (info->nstarted == 0) return;
+    (void)SCM_INTERNAL_MUTEX_LOCK(info->mutex);
+    info->shutdown = TRUE;
+    (void)SCM_INTERNAL_COND_BROADCAST(info->work_cv);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(info->mutex);
+#if defined(GAUCHE_USE_PTHREADS)
+    for (int i=0; i<info->nstarted; i++) {
+        pthread_join(info->workers[i], NULL);
+    }
+#endif /*GAUCHE_USE_PTHREADS*/
+    info->nstarted = 0;
+}
+
+static void pdeflate_put_u32(ScmPort *port, uLong n, int bigendian)
+{
+    unsigned char b[4];
+    for (int i=0; i<4; i++) {
+        b[bigendian? 3-i : i] = (unsigned char)((n >> (i*8)) & 0xff);
+    }
+    Scm_Putz((char*)b, 4, port);
+}
+
+static void pdeflate_write_header(ScmParDeflateInfo *info)
+{
+    unsigned char b[10];
+    int lflags;
+
+    switch (info->format) {
+    case PDEFLATE_ZLIB:
+        /* See deflate.c of zlib for the level flags */
+        if (info->strategy >= Z_HUFFMAN_ONLY
+            || (info->level >= 0 && info->level < 2)) lflags = 0;
+        else if (info->level >= 0 && info->level < 6) lflags = 1;
+        else if (info->level == 6 || info->level < 0) lflags = 2;
+        else lflags = 3;
+        {
+            unsigned int h = ((((info->window_bits-8)<<4)|Z_DEFLATED)<<8)
+                | (lflags<<6);
+            h += 31 - (h % 31);
+            b[0] = (unsigned char)(h >> 8);
+            b[1] = (unsigned char)(h & 0xff);
+        }
+        Scm_Putz((char*)b, 2, info->remote);
+        break;
+    case PDEFLATE_GZIP:
+        memset(b, 0, sizeof(b));
+        b[0] = 0x1f; b[1] = 0x8b; b[2] = Z_DEFLATED;
+        b[8] = (info->level == 9)? 2
+            : (info->strategy >= Z_HUFFMAN_ONLY
+               || (info->level >= 0 && info->level < 2))? 4 : 0;
+        b[9] = 3;               /* OS_CODE: unix */
+        Scm_Putz((char*)b, 10, info->remote);
+        break;
+    }
+    info->header_written = TRUE;
+}
+
+static void pdeflate_write_trailer(ScmParDeflateInfo *info)
+{
+    switch (info->format) {
+    case PDEFLATE_ZLIB:
+        pdeflate_put_u32(info->remote, info->check, TRUE);
+        break;
+    case PDEFLATE_GZIP:
+        pdeflate_put_u32(info->remote, info->check, FALSE);
+        pdeflate_put_u32(info->remote, info->total_in & 0xffffffffUL, FALSE);
+        break;
+    }
+}
+
+/* Write out finished blocks in order.  We wait for the oldest block to
+   finish as long as more than MAXPENDING blocks are in flight; so passing
+   0 writes everything submitted so far. */
+static void pdeflate_write_ready(ScmParDeflateInfo *info, int maxpending)
+{
+    while (info->pending) {
+        ScmParDeflateJob *job = info->pending;
+        (void)SCM_INTERNAL_MUTEX_LOCK(info->mutex);
+        while (!job->done && info->npending > maxpending) {
+            (void)SCM_INTERNAL_COND_WAIT(info->done_cv, info->mutex);
+        }
+        int done = job->done;
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(info->mutex);
+        if (!done) break;
+
+        info->pending = job->next;
+        if (info->pending == NULL) info->pending_tail = NULL;
+        info->npending--;
+
+        if (job->status != Z_OK) {
+            pdeflate_stop_workers(info);
+            Scm_ZlibError(job->status, "deflate failed in parallel deflating port");
+        }
+        if (!info->header_written) pdeflate_write_header(info);
+        switch (info->format) {
+        case PDEFLATE_GZIP:
+            info->check = crc32_combine(info->check, job->check, job->inlen);
+            break;
+        case PDEFLATE_ZLIB:
+            info->check = adler32_combine(info->check, job->check, job->inlen);
+            break;
+        }
+        info->total_in += job->inlen;
+        if (job->outlen > 0) {
+            Scm_Putz((char*)job->out, job->outlen, info->remote);
+        }
+    }
+}
+
+/* Hand the current block to the workers. */
+static void pdeflate_submit(ScmParDeflateInfo *info, int last)
+{
+    ScmParDeflateJob *job = SCM_NEW(ScmParDeflateJob);
+    int wsize = 1 << info->window_bits;
+    int len = info->blocklen;
+
+    job->next = job->qnext = NULL;
+    job->in = info->block;
+    job->inlen = len;
+    job->dict = info->tail;
+    job->dictlen = info->taillen;
+    /* Conservative bound of deflateBound(), plus room for sync flush. */
+    job->outsize = len + ((len+7)>>3) + ((len+63)>>6) + 5 + 16;
+    job->out = SCM_NEW_ATOMIC2(unsigned char*, job->outsize);
+    job->outlen = 0;
+    job->check = 0;
+    job->last = last;
+    job->done = FALSE;
+    job->status = Z_OK;
+
+    if (!last) {
+        /* The dictionary of the next block is the last window of
+           (tail + this block). */
+        int keep = (len >= wsize)? 0 : wsize - len;
+        if (keep > info->taillen) keep = info->taillen;
+        unsigned char *t = SCM_NEW_ATOMIC2(unsigned char*, keep + len);
+        memcpy(t, info->tail + info->taillen - keep, keep);
+        int nlen = (len >= wsize)? wsize : len;
+        memcpy(t + keep, info->block + len - nlen, nlen);
+        info->tail = t;
+        info->taillen = keep + nlen;
+        info->block = SCM_NEW_ATOMIC2(unsigned char*, info->blocksize);
+        info->blocklen = 0;
+    }
+
+    if (info->pending_tail) info->pending_tail->next = job;
+    else info->pending = job;
+    info->pending_tail = job;
+    info->npending++;
+
+    if (info->nthreads > 0 && info->nstarted == 0) {
+        pdeflate_start_workers(info);
+    }
+    if (info->nthreads == 0) {
+        pdeflate_compress(info, job);
+        job->done = TRUE;
+    } else {
+        (void)SCM_INTERNAL_MUTEX_LOCK(info->mutex);
+        if (info->queue_tail) info->queue_tail->qnext = job;
+        else info->queue = job;
+        info->queue_tail = job;
+        (void)SCM_INTERNAL_COND_SIGNAL(info->work_cv);
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(info->mutex);
+    }
+}
+
+static void pdeflate_feed(ScmParDeflateInfo *info, const char *buf, int len)
+{
+    while (len > 0) {
+        int room = info->blocksize - info->blocklen;
+        int n = (len < room)? len : room;
+        memcpy(info->block + info->blocklen, buf, n);
+        info->blocklen += n;
+        buf += n;
+        len -= n;
+        if (info->blocklen == info->blocksize) {
+            pdeflate_submit(info, FALSE);
+            /* Keep at most twice as many blocks as threads in flight */
+            pdeflate_write_ready(info, info->nthreads*2);
+        }
+    }
+}
+
+static int pdeflate_flusher(ScmPort *port, int cnt, int forcep)
+{
+    ScmParDeflateInfo *info = SCM_PORT_PDEFLATE_INFO(port);
+    int avail = SCM_PORT_BUFFER_AVAIL(port);
+
+    pdeflate_feed(info, port->src.buf.buffer, avail);
+    if (forcep) {
+        if (info->blocklen > 0) pdeflate_submit(info, FALSE);
+        pdeflate_write_ready(info, 0);
+    } else {
+        pdeflate_write_ready(info, info->nthreads*2);
+    }
+    return avail;
+}
+
+static void pdeflate_closer(ScmPort *port)
+{
+    ScmParDeflateInfo *info = SCM_PORT_PDEFLATE_INFO(port);
+
+    pdeflate_feed(info, port->src.buf.buffer, SCM_PORT_BUFFER_AVAIL(port));
+    pdeflate_submit(info, TRUE);
+    pdeflate_write_ready(info, 0);
+    pdeflate_stop_workers(info);
+    pdeflate_write_trailer(info);
+    Scm_Flush(info->remote);
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+/* Ports are closed by their finalizer, and pdeflate_closer joins the
+   workers.  But if closing fails (e.g. the drain is already closed),
+   the workers would be left waiting for jobs forever.  So we replace
+   the port's finalizer with this one, which closes the port the same
+   way but makes sure the workers are shut down. */
+static void pdeflate_finalize(ScmObj obj, void *data)
+{
+    ScmPort *port = SCM_PORT(obj);
+    ScmParDeflateInfo *info = SCM_PORT_PDEFLATE_INFO(port);
+
+    SCM_UNWIND_PROTECT {
+        Scm_ClosePort(port);
+    } SCM_WHEN_ERROR {
+        pdeflate_stop_workers(info);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+}
+
+static int pdeflate_fileno(ScmPort *port)
+{
+    return Scm_PortFileNo(SCM_PORT_PDEFLATE_INFO(port)->remote);
+}
+
+static int default_nthreads(void)
+{
+#if defined(GAUCHE_USE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return (int)n;
+#endif
+    return 1;
+}
+
+ScmObj Scm_MakeParallelDeflatingPort(ScmPort *drain, int level,
+                                     int window_bits, int memlevel,
+                                     int strategy, int blocksize,
+                                     int nthreads, int ownerp)
+{
+    ScmParDeflateInfo *info = SCM_NEW(ScmParDeflateInfo);
+
+    if (window_bits < 0) {
+        info->format = PDEFLATE_RAW;
+        info->window_bits = -window_bits;
+    } else if (window_bits > 15) {
+        info->format = PDEFLATE_GZIP;
+        info->window_bits = window_bits - 16;
+    } else {
+        info->format = PDEFLATE_ZLIB;
+        info->window_bits = window_bits;
+    }
+    if (info->window_bits < 9 || info->window_bits > 15) {
+        Scm_Error("window-bits out of range: %d", window_bits);
+    }
+    if (blocksize <= 0) blocksize = DEFAULT_BLOCK_SIZE;
+    if (blocksize < MINIMUM_BLOCK_SIZE) blocksize = MINIMUM_BLOCK_SIZE;
+    if (nthreads <= 0) nthreads = default_nthreads();
+
+    info->remote = drain;
+    info->ownerp = ownerp;
+    info->level = level;
+    info->memlevel = memlevel;
+    info->strategy = strategy;
+    info->blocksize = blocksize;
+    info->block = SCM_NEW_ATOMIC2(unsigned char*, blocksize);
+    info->blocklen = 0;
+    info->tail = NULL;
+    info->taillen = 0;
+    info->check = (info->format == PDEFLATE_ZLIB)? adler32(0L, Z_NULL, 0)
+        : crc32(0L, Z_NULL, 0);
+    info->total_in = 0;
+    info->header_written = FALSE;
+    info->pending = info->pending_tail = NULL;
+    info->npending = 0;
+    info->queue = info->queue_tail = NULL;
+#if defined(GAUCHE_USE_PTHREADS)
+    info->nthreads = (nthreads > 1)? nthreads : 0;
+    info->workers = NULL;
+#else
+    info->nthreads = 0;
+#endif
+    info->nstarted = 0;
+    info->shutdown = FALSE;
+    (void)SCM_INTERNAL_MUTEX_INIT(info->mutex);
+    (void)SCM_INTERNAL_COND_INIT(info->work_cv);
+    (void)SCM_INTERNAL_COND_INIT(info->done_cv);
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = DEFAULT_BUFFER_SIZE;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, DEFAULT_BUFFER_SIZE);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = NULL;
+    bufrec.flusher = pdeflate_flusher;
+    bufrec.closer = pdeflate_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = pdeflate_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("parallel deflating", drain);
+    ScmObj port = Scm_MakeBufferedPort(SCM_CLASS_PARALLEL_DEFLATING_PORT,
+                                       name, SCM_PORT_OUTPUT, TRUE, &bufrec);
+    Scm_RegisterFinalizer(port, pdeflate_finalize, NULL);
+    return port;
+}
+
+/*================================================================
+ * One-shot compression
+ *
+ *   These work directly on the u8vector storage, without going
+ *   through port buffers.
+ */
+
+ScmObj Scm_DeflateU8Vector(ScmUVector *v, int level,
+                           int window_bits, int memlevel,
+                           int strategy, ScmObj dict)
+{
+    z_stream strm;
+
+    memset(&strm, 0, sizeof(strm));
+    int r = deflateInit2(&strm, level, Z_DEFLATED, window_bits,
+                         memlevel, strategy);
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "deflateInit2 error: %s", strm.msg);
+    }
+    if (!SCM_FALSEP(dict)) {
+        if (!SCM_STRINGP(dict)) {
+            deflateEnd(&strm);
+            Scm_Error("String required, but got %S", dict);
+        }
+        r = deflateSetDictionary(&strm,
+                                 (unsigned char*)SCM_STRING_START(dict),
+                                 SCM_STRING_SIZE(dict));
+        if (r != Z_OK) {
+            deflateEnd(&strm);
+            Scm_ZlibError(r, "deflateSetDictionary failed: %s", strm.msg);
+        }
+    }
+
+    uLong size = deflateBound(&strm, SCM_U8VECTOR_SIZE(v));
+    unsigned char *out = SCM_NEW_ATOMIC2(unsigned char*, size);
+    strm.next_in = SCM_U8VECTOR_ELEMENTS(v);
+    strm.avail_in = SCM_U8VECTOR_SIZE(v);
+    strm.next_out = out;
+    strm.avail_out = size;
+    r = deflate(&strm, Z_FINISH);
+    int len = strm.next_out - out;
+    deflateEnd(&strm);
+    if (r != Z_STREAM_END) {
+        Scm_ZlibError((r == Z_OK)? Z_STREAM_ERROR : r,
+                      "deflate failed: %s", strm.msg? strm.msg : "");
+    }
+    return Scm_MakeU8VectorFromArrayShared(len, out);
+}
+
+/* See Scm_InflateU8Vector */
+#define INFLATE_INITIAL_MAX  (64*1024*1024)
+#define INFLATE_OUTPUT_MAX   ((size_t)SCM_SMALL_INT_MAX)
+#define ZLIB_AVAIL(n)        (((n) > UINT_MAX)? UINT_MAX : (uInt)(n))
+
+ScmObj Scm_InflateU8Vector(ScmUVector *v, int window_bits, ScmObj dict)
+{
+    z_stream strm;
+
+    if (!SCM_FALSEP(dict) && !SCM_STRINGP(dict)) {
+        Scm_Error("String required, but got %S", dict);
+    }
+    memset(&strm, 0, sizeof(strm));
+    int r = inflateInit2(&strm, window_bits);
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "inflateInit2 error: %s", strm.msg);
+    }
+
+    /* We start with 4 times of the input, but not more than
+       INFLATE_INITIAL_MAX, and double the buffer as needed.  Since
+       zlib's avail_in and avail_out are uInt, we feed the input and
+       the room of the buffer in pieces of at most UINT_MAX bytes. */
+    unsigned char *in = SCM_U8VECTOR_ELEMENTS(v);
+    size_t insize = SCM_U8VECTOR_SIZE(v);
+    size_t size = (insize < CHUNK/4)? CHUNK
+        : (insize > INFLATE_INITIAL_MAX/4)? INFLATE_INITIAL_MAX
+        : insize*4;
+    unsigned char *out = SCM_NEW_ATOMIC2(unsigned char*, size);
+    strm.next_in = in;
+    strm.avail_in = ZLIB_AVAIL(insize);
+    strm.next_out = out;
+    strm.avail_out = ZLIB_AVAIL(size);
+    for (;;) {
+        r = inflate(&strm, Z_NO_FLUSH);
+        if (r == Z_STREAM_END) break;
+        if (r == Z_NEED_DICT) {
+            if (SCM_FALSEP(dict)) {
+                inflateEnd(&strm);
+                Scm_ZlibError(r, "dictionary required");
+            }
+            r = inflateSetDictionary(&strm,
+                                     (unsigned char*)SCM_STRING_START(dict),
+                                     SCM_STRING_SIZE(dict));
+            if (r != Z_OK) {
+                inflateEnd(&strm);
+                Scm_ZlibError(r, "inflateSetDictionary error: %s", strm.msg);
+            }
+            continue;
+        }
+        size_t inleft = insize - (size_t)(strm.next_in - in);
+        if (r == Z_BUF_ERROR && inleft == 0) {
+            inflateEnd(&strm);
+            Scm_ZlibError(Z_DATA_ERROR, "inflate error: incomplete input");
+        }
+        if (r != Z_OK && r != Z_BUF_ERROR) {
+            inflateEnd(&strm);
+            Scm_ZlibError(r, "inflate error: %s", strm.msg? strm.msg : "");
+        }
+        if (strm.avail_in == 0) strm.avail_in = ZLIB_AVAIL(inleft);
+
+        size_t len = strm.next_out - out;
+        if (len == size) {
+            if (size > INFLATE_OUTPUT_MAX/2) {
+                inflateEnd(&strm);
+                Scm_Error("inflated data is too large (more than %lu bytes)",
+                          (u_long)size);
+            }
+            unsigned char *nout = SCM_NEW_ATOMIC2(unsigned char*, size*2);
+            memcpy(nout, out, len);
+            out = nout;
+            strm.next_out = out + len;
+            size *= 2;
+        }
+        strm.avail_out = ZLIB_AVAIL(size - len);
+    }
+    size_t len = strm.next_out - out;
+    inflateEnd(&strm);
+    return Scm_MakeU8VectorFromArrayShared(len, out);
+}
+
 /*
  * Module initialization function.
  */
@@ -570,6 +1195,8 @@ SCM_EXTENSION_ENTRY void Scm_Init_rfc__zlib(void)
                         mod, NULL, 0);
     Scm_InitStaticClass(&Scm_InflatingPortClass, "<inflating-port>",
                         mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_ParallelDeflatingPortClass,
+                        "<parallel-deflating-port>", mod, NULL, 0);
 
     ScmClass *cond_meta = Scm_ClassOf(SCM_OBJ(SCM_CLASS_CONDITION));
     Scm_InitStaticClassWithMeta(SCM_CLASS_ZLIB_ERROR,
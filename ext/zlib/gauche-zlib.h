@@ -81,6 +81,25 @@ extern ScmObj Scm_MakeInflatingPort(ScmPort *sink, int bufsiz,
                                     int window_bits, ScmObj dict,
                                     int ownerp);
 
+/* Parallel deflating port.  The data is split into blocks, which are
+   compressed independently by worker threads and written out in order. */
+SCM_CLASS_DECL(Scm_ParallelDeflatingPortClass);
+#define SCM_CLASS_PARALLEL_DEFLATING_PORT  (&Scm_ParallelDeflatingPortClass)
+#define SCM_PARALLEL_DEFLATING_PORT_P(obj) \
+    SCM_ISA(obj, SCM_CLASS_PARALLEL_DEFLATING_PORT)
+
+extern ScmObj Scm_MakeParallelDeflatingPort(ScmPort *drain, int level,
+                                            int window_bits, int memlevel,
+                                            int strategy, int blocksize,
+                                            int nthreads, int ownerp);
+
+/* One-shot compression/decompression */
+extern ScmObj Scm_DeflateU8Vector(ScmUVector *v, int level,
+                                  int window_bits, int memlevel,
+                                  int strategy, ScmObj dict);
+extern ScmObj Scm_InflateU8Vector(ScmUVector *v, int window_bits,
+                                  ScmObj dict);
+
 /*================================================================
  * Conditions
  */
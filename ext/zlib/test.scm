@@ -357,4 +357,72 @@
               (v (inflate-sync in)))
          (list v (eof-object? (read-char in)))))
 
+;;------------------------------------------------------------------
+(test-section "parallel deflating port")
+
+(define *long-data*
+  (string-join (map number->string (iota 60000)) " "))
+
+(define (parallel-deflate str . args)
+  (call-with-output-string
+    (^p (let1 p2 (apply open-parallel-deflating-port p args)
+          (display str p2)
+          (close-output-port p2)))))
+
+(dolist [threads '(1 4)]
+  (test* (format "parallel deflate (zlib, threads=~a)" threads) *long-data*
+         (inflate-string (parallel-deflate *long-data* :threads threads)))
+  (test* (format "parallel deflate (gzip, threads=~a)" threads) *long-data*
+         (gzip-decode-string
+          (parallel-deflate *long-data* :threads threads
+                            :window-bits 31 :block-size 32768)))
+  (test* (format "parallel deflate (raw, threads=~a)" threads) *long-data*
+         (inflate-string
+          (parallel-deflate *long-data* :threads threads :window-bits -15)
+          :window-bits -15)))
+
+(test* "parallel deflate (empty)" ""
+       (gzip-decode-string (parallel-deflate "" :window-bits 31)))
+(test* "parallel deflate (same output regardless of threads)" #t
+       (equal? (parallel-deflate *long-data* :threads 1)
+               (parallel-deflate *long-data* :threads 3)))
+(test* "parallel deflate (flush)" "abcdef"
+       (let* ([out (open-output-string)]
+              [p (open-parallel-deflating-port out :threads 2)])
+         (display "abc" p)
+         (flush p)
+         (display "def" p)
+         (close-output-port p)
+         (inflate-string (get-output-string out))))
+
+;;------------------------------------------------------------------
+(test-section "one-shot u8vector")
+
+(test* "deflate-u8vector / inflate-u8vector" *long-data*
+       (u8vector->string
+        (inflate-u8vector (deflate-u8vector (string->u8vector *long-data*)))))
+(test* "deflate-u8vector (compatible)" *long-data*
+       (inflate-string
+        (u8vector->string
+         (deflate-u8vector (string->u8vector *long-data*)
+                           :compression-level Z_BEST_SPEED))))
+(test* "deflate-u8vector (gzip)" "foobar"
+       (gzip-decode-string
+        (u8vector->string
+         (deflate-u8vector (string->u8vector "foobar") :window-bits 31))))
+(test* "inflate-u8vector (dictionary)" "abcdefg"
+       (u8vector->string
+        (inflate-u8vector (string->u8vector
+                           (deflate-string "abcdefg" :dictionary "abc"))
+                          :dictionary "abc")))
+(test* "inflate-u8vector (need dict)" (test-error <zlib-need-dict-error>)
+       (inflate-u8vector (string->u8vector
+                          (deflate-string "abcdefg" :dictionary "abc"))))
+(test* "inflate-u8vector (broken)" (test-error <zlib-data-error>)
+       (inflate-u8vector (string->u8vector "abc")))
+(test* "inflate-u8vector (truncated)" (test-error <zlib-data-error>)
+       (inflate-u8vector
+        (u8vector-copy (deflate-u8vector (string->u8vector *long-data*))
+                       0 100)))
+
 (test-end)
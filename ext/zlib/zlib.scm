@@ -37,11 +37,13 @@
   (use gauche.uvector)
   (export zlib-version adler32 crc32
           open-deflating-port open-inflating-port
+          open-parallel-deflating-port
           deflate-string inflate-string
+          deflate-u8vector inflate-u8vector
           <zlib-error> <zlib-need-dict-error>
           <zlib-stream-error> <zlib-data-error>
           <zlib-memory-error> <zlib-version-error>
-          <deflating-port> <inflating-port>
+          <deflating-port> <inflating-port> <parallel-deflating-port>
           deflating-port-full-flush
           zstream-total-in zstream-total-out
           zstream-params-set!
@@ -76,6 +78,28 @@
                         strategy dictionary
                         buffer-size owner?))
 
+;; block-size and threads default to 128KB and the number of processors.
+(define (open-parallel-deflating-port drain
+                                      :key (compression-level Z_DEFAULT_COMPRESSION)
+                                           (window-bits 15)
+                                           (memory-level 8)
+                                           (strategy Z_DEFAULT_STRATEGY)
+                                           (block-size 0)
+                                           (threads 0)
+                                           (owner? #f))
+  (%open-parallel-deflating-port drain compression-level
+                                 window-bits memory-level
+                                 strategy block-size threads owner?))
+
+(define (deflate-u8vector v
+                          :key (compression-level Z_DEFAULT_COMPRESSION)
+                               (window-bits 15)
+                               (memory-level 8)
+                               (strategy Z_DEFAULT_STRATEGY)
+                               (dictionary #f))
+  (%deflate-u8vector v compression-level window-bits memory-level
+                     strategy dictionary))
+
 ;; utility procedures
 (define (deflate-string str . args)
   (call-with-output-string
@@ -246,6 +246,27 @@ GC_API int GC_CALL GC_is_marked(const void *) GC_ATTR_NONNULL(1);
 GC_API void GC_CALL GC_clear_mark_bit(const void *) GC_ATTR_NONNULL(1);
 GC_API void GC_CALL GC_set_mark_bit(const void *) GC_ATTR_NONNULL(1);
 
+/* Enumerate all reachable (i.e. marked) objects in the heap, calling  */
+/* proc for each of them with its base address and size in bytes.       */
+/* The mark bits are only accurate right after a full collection, so    */
+/* the client usually calls GC_gcollect() first.  The caller must hold  */
+/* the allocation lock (e.g. by GC_call_with_alloc_lock), and proc must */
+/* not allocate or call any other GC_ routine that acquires the lock.   */
+typedef void (GC_CALLBACK * GC_reachable_object_proc)(void * /* obj */,
+                                                size_t /* bytes */,
+                                                void * /* client_data */);
+GC_API void GC_CALL GC_enumerate_reachable_objects_inner(
+                                GC_reachable_object_proc,
+                                void * /* client_data */) GC_ATTR_NONNULL(1);
+
+/* Return the kind of the object (GC_I_PTRFREE, GC_I_NORMAL or other    */
+/* kind index) whose base address is p.  Also store the object size in  */
+/* *psize if psize is not NULL.  Does not acquire the allocation lock.  */
+#define GC_I_PTRFREE 0
+#define GC_I_NORMAL  1
+GC_API int GC_CALL GC_get_kind_and_size(const void * p, size_t * psize)
+                                                        GC_ATTR_NONNULL(1);
+
 /* Push everything in the given range onto the mark stack.              */
 /* (GC_push_conditional pushes either all or only dirty pages depending */
 /* on the third argument.)                                              */
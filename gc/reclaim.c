@@ -581,6 +581,49 @@ void GC_print_free_list(int kind, size_t sz_in_granules)
 
 #endif /* !NO_DEBUGGING */
 
+struct enumerate_reachable_s {
+  GC_reachable_object_proc proc;
+  void *client_data;
+};
+
+STATIC void GC_do_enumerate_reachable_objects(struct hblk *hbp, word ped)
+{
+  struct hblkhdr *hhdr = HDR(hbp);
+  size_t sz = hhdr -> hb_sz;
+  size_t bit_no;
+  char *p, *plim;
+
+  if (GC_block_empty(hhdr)) {
+    return;
+  }
+
+  p = hbp->hb_body;
+  if (sz > MAXOBJBYTES) { /* one big object */
+    plim = p;
+  } else {
+    plim = hbp->hb_body + HBLKSIZE - sz;
+  }
+  /* Go through all words in block. */
+  for (bit_no = 0; p <= plim; bit_no += MARK_BIT_OFFSET(sz), p += sz) {
+    if (mark_bit_from_hdr(hhdr, bit_no)) {
+      ((struct enumerate_reachable_s *)ped)->proc(p, sz,
+                        ((struct enumerate_reachable_s *)ped)->client_data);
+    }
+  }
+}
+
+GC_API void GC_CALL GC_enumerate_reachable_objects_inner(
+                                                GC_reachable_object_proc proc,
+                                                void *client_data)
+{
+  struct enumerate_reachable_s ed;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  ed.proc = proc;
+  ed.client_data = client_data;
+  GC_apply_to_all_blocks(GC_do_enumerate_reachable_objects, (word)&ed);
+}
+
 /*
  * Clear all obj_link pointers in the list of free objects *flp.
  * Clear *flp.
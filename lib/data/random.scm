@@ -85,6 +85,8 @@
 (define (%rand-int n) (mt-random-integer (cdr (%random-data-state)) n))
 (define (%rand-real0) (mt-random-real0 (cdr (%random-data-state))))
 (define (%rand-real)  (mt-random-real (cdr (%random-data-state))))
+(define (%rand-normal) (mt-random-normal (cdr (%random-data-state))))
+(define (%rand-exponential) (mt-random-exponential (cdr (%random-data-state))))
 
 ;;;
 ;;; Primitive generators
@@ -174,16 +176,14 @@
 ;;
 
 ;; Normal distribution (continuous - generates real numbers)
-;; Box-Muller algorithm
-;; NB: We tested Ziggurat method, too (see git repo for the code),
-;; only to find out Box-Muller is faster about 12% - presumably
-;; the overhead of each ops is larger in Gauche than C/C++, and
-;; so the difference of cost of log or sin from the primitive
-;; addition/multiplication are negligible.
+;; We use the native Ziggurat sampler of math.mt-random.
+;; NB: We tested Ziggurat method written in Scheme, too, only to find out
+;; Box-Muller is faster about 12% - presumably the overhead of each ops is
+;; larger in Gauche than C/C++, and so the difference of cost of log or
+;; sin from the primitive addition/multiplication are negligible.
+;; In C, Ziggurat wins by far.
 (define (reals-normal$ :optional (mean 0) (deviation 1))
-  (^[] (let ([r (%sqrt (* -2 (%log (%rand-real))))]
-             [theta (* 2pi (%rand-real))])
-         (+ mean (* deviation r (%sin theta))))))
+  (^[] (+ mean (* deviation (%rand-normal)))))
 
 #|
 Simple test of gaussian sampling: Generate some data with this:
@@ -200,13 +200,16 @@ plot 'tmp' using (bin($1,binwidth)):(1.0) smooth freq with boxes
 
 ;; Exponential distribution - continuous
 (define (reals-exponential$ m)
-  (^[] (- (* m (log (%rand-real))))))
+  (^[] (* m (%rand-exponential))))
 
 ;; Draw from geometric distribution, with success probability p.
 ;; Mean is 1/p, variance is (1-p)/p^2
+;; -log(U) for uniform U is exponentially distributed, so we use the
+;; native sampler instead of log.  The sampler may return 0.0, which
+;; -log(U) never does, hence the max.
 (define (integers-geometric$ p)
-  (let1 c (/ (log (- 1.0 p)))
-    (^[] (ceiling->exact (* c (log (%rand-real)))))))
+  (let1 c (- (/ (log (- 1.0 p))))
+    (^[] (max 1 (ceiling->exact (* c (%rand-exponential)))))))
 
 ;; Draw from poisson distribution with mean L, variance L.
 ;; For small L, we use Knuth's method.  For larger L, we use rejection
@@ -0,0 +1,284 @@
+;;;
+;;; dbd.memory - An in-memory database driver
+;;;
+
+(define-module dbd.memory
+  (use dbi)
+  (use text.sql)
+  (use gauche.threads)
+  (use srfi-1)
+  (use srfi-13)
+  (use util.match)
+  (use util.relation)
+  (export <memory-driver> <memory-connection>))
+(select-module dbd.memory)
+
+;; This driver keeps tables in memory and understands a small subset
+;; of SQL:
+;;
+;;   CREATE TABLE name (column [type ...], ...)
+;;   DROP TABLE name
+;;   INSERT INTO name [(column, ...)] VALUES (expr, ...) [, (expr, ...) ...]
+;;   SELECT * | column, ... FROM name [WHERE column = expr [AND ...]]
+;;   DELETE FROM name [WHERE column = expr [AND ...]]
+;;
+;; where expr is a literal, NULL or a positional parameter '?'.
+;; It is the reference implementation of the prepared-query API:
+;; dbi-prepare parses SQL once, and execution just binds the parameters.
+;; Batched INSERT is done by a single append, without going through
+;; per-row dispatch.  Useful to test and benchmark dbi without
+;; an external database.
+;;
+;; Every connection to "dbi:memory" has its own set of tables, unless
+;; the same name is given in the options, e.g. "dbi:memory:db=foo".
+
+(define-class <memory-driver> (<dbi-driver>) ())
+
+(define-class <memory-connection> (<dbi-connection>)
+  ((tables :init-keyword :tables)       ; hash table name -> <memory-table>
+   (open?  :init-value #t)))
+
+(define-class <memory-table> ()
+  ((columns :init-keyword :columns)     ; list of symbols
+   (rows    :init-value '())            ; list of vectors, newest first
+   ))
+
+;; named databases shared among connections
+(define *databases* (make-hash-table 'equal?))
+(define *databases-mutex* (make-mutex))
+
+(define-method dbi-make-connection ((d <memory-driver>)
+                                    (options <string>)
+                                    (option-alist <list>) . _)
+  (make <memory-connection>
+    :tables (if-let1 name (assoc-ref option-alist "db")
+              (with-locking-mutex *databases-mutex*
+                (^[] (or (hash-table-get *databases* name #f)
+                         (rlet1 t (make-hash-table 'equal?)
+                           (hash-table-put! *databases* name t)))))
+              (make-hash-table 'equal?))))
+
+(define-method dbi-open? ((c <memory-connection>)) (~ c'open?))
+(define-method dbi-close ((c <memory-connection>)) (set! (~ c'open?) #f))
+
+(define-method dbi-prepare ((c <memory-connection>) (sql <string>)
+                            :key (pass-through #f))
+  (make <dbi-query> :connection c :prepared (parse-statement sql)))
+
+(define-method dbi-execute-using-connection ((c <memory-connection>)
+                                             (q <dbi-query>) params)
+  (unless (~ c'open?)
+    (error <dbi-error> "connection is already closed:" c))
+  (execute-statement c (~ q'prepared) params))
+
+(define-method dbi-execute-batch-using-connection ((c <memory-connection>)
+                                                   (q <dbi-query>)
+                                                   params-list)
+  (unless (~ c'open?)
+    (error <dbi-error> "connection is already closed:" c))
+  (match (~ q'prepared)
+    [('insert nparams table cols rows)
+     (let* ([t (find-table c table)]
+            [fill (insert-row-builder t cols)]
+            [new (append-map (^[params]
+                               (check-params nparams params)
+                               (map (^[row] (fill (bind-exprs row params)))
+                                    rows))
+                             params-list)])
+       (set! (~ t'rows) (append! (reverse! new) (~ t'rows)))
+       (length new))]
+    [stmt
+     (fold (^[params n] (+ n (execute-statement c stmt params))) 0
+           params-list)]))
+
+;;;
+;;; Parser
+;;;
+
+;; Parsed statement is one of:
+;;   (create nparams table (column ...))
+;;   (drop   nparams table)
+;;   (insert nparams table (column ...)|#f ((expr ...) ...))
+;;   (select nparams table (column ...)|#f ((column . expr) ...))
+;;   (delete nparams table ((column . expr) ...))
+;; where expr is (const . value) or (param . index).
+
+(define (parse-statement sql)
+  (define tokens (remove (cut eqv? <> #\;) (sql-tokenize sql)))
+  (define nparams
+    (count (^t (match t [('parameter (? integer?)) #t] [_ #f])) tokens))
+  (define (err . args)
+    (apply errorf <dbi-unsupported-error>
+           (string-append (car args) " in ~s")
+           (append (cdr args) (list sql))))
+  (define (kw? t name) (and (string? t) (string-ci=? t name)))
+  (define (ident t)
+    (match t
+      [(? string?) (string->symbol (string-downcase t))]
+      [('delimited x) (string->symbol x)]
+      [_ (err "identifier expected, but got ~s" t)]))
+  (define (expr t)
+    (match t
+      [('parameter (? integer? n)) `(param . ,n)]
+      [('string x) `(const . ,x)]
+      [('number x) `(const . ,(string->number x))]
+      [(? (cut kw? <> "null")) '(const . #f)]
+      [_ (err "unsupported expression ~s" t)]))
+  ;; (x , y , ...) => list and rest
+  (define (paren-list ts elt)
+    (match ts
+      [(#\( . ts)
+       (let loop ([ts ts] [r '()])
+         (match ts
+           [(x #\, . ts) (loop ts (cons (elt x) r))]
+           [(x #\) . ts) (values (reverse! (cons (elt x) r)) ts)]
+           [_ (err "malformed list")]))]
+      [_ (err "'(' expected")]))
+  ;; column definitions may have types and constraints; we only take names
+  (define (column-defs ts)
+    (match ts
+      [(#\( . ts)
+       (let loop ([ts ts] [cols '()] [depth 0] [head? #t])
+         (match ts
+           [() (err "unterminated column definitions")]
+           [(#\( . ts) (loop ts cols (+ depth 1) #f)]
+           [(#\) . ts) (if (zero? depth)
+                         (reverse! cols)
+                         (loop ts cols (- depth 1) #f))]
+           [(#\, . ts) (loop ts cols depth (zero? depth))]
+           [(t . ts) (if head?
+                       (loop ts (cons (ident t) cols) depth #f)
+                       (loop ts cols depth #f))]))]
+      [_ (err "'(' expected")]))
+  (define (where ts)
+    (match ts
+      [() '()]
+      [((? (cut kw? <> "where")) . ts)
+       (let loop ([ts ts] [r '()])
+         (match ts
+           [(c '= e) (reverse! (acons (ident c) (expr e) r))]
+           [(c '= e (? (cut kw? <> "and")) . ts)
+            (loop ts (acons (ident c) (expr e) r))]
+           [_ (err "unsupported WHERE clause")]))]
+      [_ (err "garbage at the end")]))
+  (define (values-rows ts)
+    (let loop ([ts ts] [rows '()])
+      (receive (row ts) (paren-list ts expr)
+        (match ts
+          [() (reverse! (cons row rows))]
+          [(#\, . ts) (loop ts (cons row rows))]
+          [_ (err "garbage at the end")]))))
+
+  (match tokens
+    [((? (cut kw? <> "create")) (? (cut kw? <> "table")) name . ts)
+     `(create ,nparams ,(ident name) ,(column-defs ts))]
+    [((? (cut kw? <> "drop")) (? (cut kw? <> "table")) name)
+     `(drop ,nparams ,(ident name))]
+    [((? (cut kw? <> "insert")) (? (cut kw? <> "into")) name . ts)
+     (receive (cols ts) (if (and (pair? ts) (eqv? (car ts) #\())
+                          (paren-list ts ident)
+                          (values #f ts))
+       (match ts
+         [((? (cut kw? <> "values")) . ts)
+          `(insert ,nparams ,(ident name) ,cols ,(values-rows ts))]
+         [_ (err "VALUES expected")]))]
+    [((? (cut kw? <> "select")) . ts)
+     (receive (cols ts)
+         (if (and (pair? ts) (eq? (car ts) '*))
+           (values #f (cdr ts))
+           (let loop ([ts ts] [cols '()])
+             (match ts
+               [(c #\, . ts) (loop ts (cons (ident c) cols))]
+               [(c . ts) (values (reverse! (cons (ident c) cols)) ts)]
+               [_ (err "column list expected")])))
+       (match ts
+         [((? (cut kw? <> "from")) name . ts)
+          `(select ,nparams ,(ident name) ,cols ,(where ts))]
+         [_ (err "FROM expected")]))]
+    [((? (cut kw? <> "delete")) (? (cut kw? <> "from")) name . ts)
+     `(delete ,nparams ,(ident name) ,(where ts))]
+    [_ (err "unsupported statement")]))
+
+;;;
+;;; Executor
+;;;
+
+(define (check-params nparams params)
+  (unless (= (length params) nparams)
+    (error <dbi-parameter-error>
+           "wrong number of parameters given to an SQL:" params)))
+
+(define (bind-expr e params)
+  (match e
+    [('const . v) v]
+    [('param . n) (list-ref params n)]))
+
+(define (bind-exprs es params) (map (cut bind-expr <> params) es))
+
+(define (find-table c name)
+  (or (hash-table-get (~ c'tables) name #f)
+      (error <dbi-error> "no such table:" name)))
+
+(define (column-index t col)
+  (or (list-index (cut eq? col <>) (~ t'columns))
+      (error <dbi-error> "no such column:" col)))
+
+;; Returns a procedure that takes a list of values to be inserted
+;; and returns a row vector.
+(define (insert-row-builder t cols)
+  (let1 ncols (length (~ t'columns))
+    (if cols
+      (let1 indices (map (cut column-index t <>) cols)
+        (^[vals]
+          (unless (= (length vals) (length indices))
+            (error <dbi-error> "number of values doesn't match columns:" vals))
+          (rlet1 row (make-vector ncols #f)
+            (for-each (^[i v] (vector-set! row i v)) indices vals))))
+      (^[vals]
+        (unless (= (length vals) ncols)
+          (error <dbi-error> "number of values doesn't match columns:" vals))
+        (list->vector vals)))))
+
+(define (row-filter t conds params)
+  (let1 tests (map (^[c] (cons (column-index t (car c))
+                               (bind-expr (cdr c) params)))
+                   conds)
+    (^[row] (every (^[test] (equal? (vector-ref row (car test)) (cdr test)))
+                   tests))))
+
+(define (execute-statement c stmt params)
+  (check-params (cadr stmt) params)
+  (match stmt
+    [('create _ name cols)
+     (when (hash-table-exists? (~ c'tables) name)
+       (error <dbi-error> "table already exists:" name))
+     (hash-table-put! (~ c'tables) name (make <memory-table> :columns cols))
+     0]
+    [('drop _ name)
+     (find-table c name)
+     (hash-table-delete! (~ c'tables) name)
+     0]
+    [('insert _ name cols rows)
+     (let* ([t (find-table c name)]
+            [fill (insert-row-builder t cols)])
+       (dolist [row rows]
+         (push! (~ t'rows) (fill (bind-exprs row params))))
+       (length rows))]
+    [('select _ name cols conds)
+     (let* ([t (find-table c name)]
+            [pred (row-filter t conds params)]
+            [rows (filter pred (reverse (~ t'rows)))])
+       (if cols
+         (let1 indices (map (cut column-index t <>) cols)
+           (make <simple-relation>
+             :columns cols
+             :rows (map (^[row]
+                          (list->vector (map (cut vector-ref row <>) indices)))
+                        rows)))
+         (make <simple-relation> :columns (~ t'columns) :rows rows)))]
+    [('delete _ name conds)
+     (let* ([t (find-table c name)]
+            [pred (row-filter t conds params)]
+            [n (length (~ t'rows))])
+       (set! (~ t'rows) (remove pred (~ t'rows)))
+       (- n (length (~ t'rows))))]))
@@ -46,6 +46,8 @@
           dbi-open? dbi-parse-dsn dbi-make-driver
           dbi-prepare-sql dbi-escape-sql dbi-list-drivers
           dbi-make-connection dbi-execute-using-connection
+          dbi-execute-batch dbi-execute-batch-using-connection
+          dbi-query-cache-size dbi-clear-query-cache!
           ;; compatibility
           dbi-make-query dbi-execute-query dbi-get-value
           <dbi-exception> <dbi-result-set>))
@@ -90,6 +92,7 @@
 (define-class <dbi-connection> ()
   ((open :init-value #t) ;; this slot is for backward compatibility.
                          ;; do not count on this.  will be removed.
+   (%query-cache :init-value #f) ;; <query-cache>, created on demand
    ))
 
 ;; <dbi-query> : represents a prepared query.
@@ -141,15 +144,42 @@
                                              (q <dbi-query>) params)
   (dbi-execute-query c (apply (ref q 'prepared) params)))
 
+;; Executes the query repeatedly, for each list of parameters in
+;; PARAMS-LIST.  The driver may overload dbi-execute-batch-using-connection
+;; to send multiple rows at once, e.g. multi-row INSERT.  The return value
+;; is driver-dependent.
+(define-method dbi-execute-batch ((q <dbi-query>) params-list)
+  (dbi-execute-batch-using-connection (ref q 'connection) q params-list))
+
+(define-method dbi-execute-batch-using-connection ((c <dbi-connection>)
+                                                   (q <dbi-query>)
+                                                   params-list)
+  (dolist [params params-list]
+    (dbi-execute-using-connection c q params)))
+
 ;; Does preparation and execution at once.  The driver may overload this.
+;; If dbi-query-cache-size is positive, the prepared query is kept in
+;; the connection's query cache, so executing the same SQL again skips
+;; the preparation.
 (define-method dbi-do ((c <dbi-connection>) sql options . args)
   (unless (proper-list? options)
     (error "dbi-do: bad option list:" options))
-  (apply dbi-execute (apply dbi-prepare c sql options) args))
+  (apply dbi-execute (prepare/cache c sql options) args))
 
 (define-method dbi-do ((c <dbi-connection>) sql)
   (dbi-do c sql '()))
 
+;; Maximum number of prepared queries kept per connection.  The default
+;; is 0, which disables caching; a cached query is reused by the next
+;; dbi-do of the same SQL, so the driver must allow executing a query
+;; while the result of its previous execution is still open.
+(define dbi-query-cache-size (make-parameter 0))
+
+(define (dbi-clear-query-cache! c)
+  (and-let* ([cache (slot-ref c '%query-cache)])
+    (slot-set! c '%query-cache #f)
+    (hash-table-for-each (~ cache'table) (^[k e] (dbi-close (car e))))))
+
 ;; Returns a string safe to be embedded in SQL.
 ;;   (dbi-escape-sql c "Don't know") => "'Don''t know'"
 ;; What's "safe" depends on the underlying DBMS.  The default procedure
@@ -184,6 +214,50 @@
 (define-method dbi-open? (obj) #t)
 (define-method dbi-close (obj) (undefined))
 
+;;;===================================================================
+;;; Query cache
+;;;
+
+;; LRU cache of prepared queries, keyed by the SQL text and the options
+;; given to dbi-prepare.  Each entry is (query . last-used-tick).
+;; Eviction scans the table, which is fine for the small cache size.
+(define-class <query-cache> ()
+  ((table :init-form (make-hash-table 'equal?))
+   (tick  :init-value 0)))
+
+(define (query-cache-get cache key)
+  (and-let* ([e (hash-table-get (~ cache'table) key #f)])
+    (inc! (~ cache'tick))
+    (set-cdr! e (~ cache'tick))
+    (car e)))
+
+(define (query-cache-put! cache key query limit)
+  (let1 tab (~ cache'table)
+    (when (>= (hash-table-num-entries tab) limit)
+      (let1 lru (hash-table-fold tab
+                                 (^[k e lru]
+                                   (if (or (not lru) (< (cdr e) (cddr lru)))
+                                     (cons k e)
+                                     lru))
+                                 #f)
+        (hash-table-delete! tab (car lru))
+        (dbi-close (cadr lru))))
+    (inc! (~ cache'tick))
+    (hash-table-put! tab key (cons query (~ cache'tick)))))
+
+(define (prepare/cache c sql options)
+  (let1 limit (dbi-query-cache-size)
+    (if (or (<= limit 0)
+            (get-keyword :pass-through options #f))
+      (apply dbi-prepare c sql options)
+      (let ([cache (or (slot-ref c '%query-cache)
+                       (rlet1 cache (make <query-cache>)
+                         (slot-set! c '%query-cache cache)))]
+            [key (cons sql options)])
+        (or (query-cache-get cache key)
+            (rlet1 q (apply dbi-prepare c sql options)
+              (query-cache-put! cache key q limit)))))))
+
 ;;;===================================================================
 ;;; Low-level utilities
 ;;;
@@ -161,6 +161,7 @@
 
 (define (do-it src ext-initializer sub-initializers)
   (parameterize ([omitted-code '()])
+    (disable-guarded-inline!)
     (setup ext-initializer sub-initializers)
     (with-input-from-file src
       (cut emit-toplevel-executor
@@ -307,6 +308,19 @@
 (define global-eq?? (with-module gauche.internal global-eq??))
 (define make-identifier (with-module gauche.internal make-identifier))
 
+;; We check existence of these, for the host compiler may be older.
+(define (declare-auto-inline module)
+  (and-let* ([p (global-variable-ref (find-module 'gauche.internal)
+                                     '%declare-auto-inline! #f)])
+    (p module)))
+
+;; Guarded inlining of auto-inlinable procedures embeds the procedure
+;; itself in the compiled code, which we can't serialize.
+(define (disable-guarded-inline!)
+  (and-let* ([flag (global-variable-ref (find-module 'gauche.internal)
+                                        'SCM_COMPILE_NOINLINE_AUTO #f)])
+    ((with-module gauche.internal vm-compiler-flag-set!) flag)))
+
 (define-constant SCM_VM_COMPILING 2) ;; must match with vm.h
 
 ;;================================================================
@@ -512,6 +526,8 @@
          (match x
            [('keep-private-macro . macros)
             (private-macros-to-keep (append (private-macros-to-keep) macros))]
+           [('auto-inline)
+            (declare-auto-inline (~ (current-tmodule)'module))]
            [other (error "Unknown declaration:" other)]))
        seed]
       ;; Finally, ordinary expressions.
@@ -53,6 +53,9 @@
           ))
 (select-module gauche.generator)
 
+(autoload data.heap make-heap heap-push! heap-pop! heap-peek
+                    heap-replace! heap-empty?)
+
 ;; GENERATOR is a thunk, that generates a value one at a time
 ;; for every invocation.  #<eof> is used to indicate the end
 ;; of the stream.  Standard input procedures like read or
@@ -334,7 +337,22 @@
                     (begin0 e1 (set! e1 (gen1)))
                     (begin0 e2 (set! e2 (gen2)))))))))]
     [(prec . gens)
-     (apply gmerge prec (map (cut apply gmerge prec <>) (slices gens 2)))]))
+     ;; k-way merge.  The heap holds the head element of each input,
+     ;; with the input generator as its value.  After taking the top,
+     ;; we replace it with the next element of the same input, which
+     ;; costs a single sift-down.
+     (let1 h (make-heap :less-than prec)
+       (dolist [g (map %->gen gens)]
+         (let1 v (g)
+           (unless (eof-object? v) (heap-push! h v g))))
+       (^[] (if (heap-empty? h)
+              (eof-object)
+              (receive (v g) (heap-peek h)
+                (let1 n (g)
+                  (if (eof-object? n)
+                    (heap-pop! h)
+                    (heap-replace! h n g)))
+                v))))]))
 
 ;; gmap :: (a -> b, Generator a) -> Generator b
 (define gmap
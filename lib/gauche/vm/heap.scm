@@ -0,0 +1,136 @@
+;;;
+;;; Heap - heap inspection utilities
+;;;
+;;;   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; The primitives heap-census and heap-retention-path are defined
+;; in src/libeval.scm and src/core.c.  This module provides utilities
+;; to show, save and compare their results.
+
+(define-module gauche.vm.heap
+  (use srfi-1)
+  (use srfi-13)
+  (use util.match)
+  (export heap-census-get-result heap-census-show
+          heap-census-write heap-census-read heap-census-diff
+          heap-retention-path-show)
+  )
+(select-module gauche.vm.heap)
+
+;;;==========================================================
+;;; Census
+;;;
+
+;; Returns a portable representation of the census, i.e. a list of
+;; (<name> <count> <bytes>), sorted by bytes.  <name> is a class name
+;; or one of the symbols untagged and atomic.  Entries of distinct
+;; classes with the same name (e.g. redefined ones) are merged.
+(define (heap-census-get-result :optional (census (heap-census)))
+  (let1 tab (make-hash-table 'eq?)
+    (dolist [e census]
+      (match-let1 (key count bytes) e
+        (let1 name (if (is-a? key <class>) (class-name key) key)
+          (hash-table-update! tab name
+                              (^p (list (+ (car p) count) (+ (cadr p) bytes)))
+                              '(0 0)))))
+    (sort-by (hash-table-map tab cons) caddr >)))
+
+(define (heap-census-show :key (results #f) (max-rows 50))
+  (let* ([rs (or results (heap-census-get-result))]
+         [total-count (fold (^(e s) (+ (cadr e) s)) 0 rs)]
+         [total-bytes (fold (^(e s) (+ (caddr e) s)) 0 rs)])
+    (print "Heap census:")
+    (print "Name                                        Count        Bytes     %")
+    (print "-----------------------------------------+----------+------------+-----")
+    (for-each (^e (match-let1 (name count bytes) e
+                    (format #t "~41a ~10d ~12d ~5,1f\n"
+                            (name-trim name) count bytes
+                            (if (zero? total-bytes)
+                              0
+                              (/. (* bytes 100) total-bytes)))))
+              (if (and max-rows (> (length rs) max-rows))
+                (take rs max-rows)
+                rs))
+    (format #t "~41a ~10d ~12d\n" "Total" total-count total-bytes)))
+
+(define (name-trim name)
+  (let1 s (x->string name)
+    (if (> (string-length s) 41) (string-take s 41) s)))
+
+;; Saves the census in FILE, so that it can be compared with later
+;; ones by heap-census-diff.
+(define (heap-census-write file :optional (results #f))
+  (let1 rs (or results (heap-census-get-result))
+    (with-output-to-file file
+      (^[]
+        (format #t ";; heap census ~a\n" (sys-ctime (sys-time)))
+        (dolist [e rs] (write e) (newline))))))
+
+(define (heap-census-read file)
+  (with-input-from-file file
+    (^[] (port->list read (current-input-port)))))
+
+;; Returns a list of (<name> <count-delta> <bytes-delta>) of the entries
+;; that changed from OLD to NEW, sorted by the growth of bytes.
+(define (heap-census-diff old new)
+  (let1 tab (make-hash-table 'eq?)
+    (define (add! rs sign)
+      (dolist [e rs]
+        (match-let1 (name count bytes) e
+          (hash-table-update! tab name
+                              (^p (list (+ (car p) (* sign count))
+                                        (+ (cadr p) (* sign bytes))))
+                              '(0 0)))))
+    (add! old -1)
+    (add! new 1)
+    (sort-by (filter (^e (not (and (zero? (cadr e)) (zero? (caddr e)))))
+                     (hash-table-map tab cons))
+             caddr >)))
+
+;;;==========================================================
+;;; Retention path
+;;;
+
+(define (heap-retention-path-show obj :optional (roots '()))
+  (match (heap-retention-path obj roots)
+    [#f (print "No retention path found.")]
+    [path
+     (dolist [node path]
+       (match-let1 #(o addr size index) node
+         (format #t "~a  #x~x (~d bytes)~a\n"
+                 (if o
+                   (let1 s (write-to-string o)
+                     (if (> (string-length s) 50)
+                       (string-append (string-take s 47) "...")
+                       s))
+                   "#<block>")
+                 addr size
+                 (if index (format " word ~d ->" index) ""))))]))
@@ -38,7 +38,8 @@
   (use util.match)
   (extend gauche.internal)
   (export profiler-show profiler-get-result
-          profiler-show-load-stats)
+          profiler-show-load-stats
+          alloc-profiler-show alloc-profiler-get-result)
   )
 (select-module gauche.vm.profiler)
 
@@ -83,6 +84,49 @@
       ;; show 'em.
       (show-stats (hash-table-map ht cons) sort-by max-rows))))
 
+;;
+;; Returns a portable representation of the current allocation profiler
+;; result, a list of (<site> <type> <count> <estimated-bytes> <sampled-bytes>).
+;; <site> is a list of the names of the innermost functions on the stack,
+;; innermost first.  <type> is the name of the class of the allocated
+;; objects, or one of the symbols atomic and untagged for the objects
+;; whose class can't be told (as in heap-census-get-result).
+;; Unlike profiler-get-result, this doesn't stop the profiler.
+;;
+(define (alloc-profiler-get-result)
+  ;; NB: this part depends on the result object of alloc-profiler-raw-result,
+  ;; which may be changed later.  Keep this in sync with src/prof.c.
+  (and-let* ([r (alloc-profiler-raw-result)]
+             [ht (make-hash-table 'equal?)])
+    (dolist [e r]
+      (match-let1 (stack type cnt est bytes) e
+        (let1 key (cons (map entry-name (delete #f stack))
+                        (if (is-a? type <class>) (class-name type) type))
+          (hash-table-update! ht key (cut map + <> (list cnt est bytes))
+                              '(0 0 0)))))
+    (hash-table-map ht (^(k v) (list* (car k) (cdr k) v)))))
+
+;;
+;; Show the allocation profiler result.
+;;
+;;  Keyword args:
+;;    :results - give a list of results returned by alloc-profiler-get-result
+;;               If not given, the current result is used.
+;;    :sort-by - either 'bytes or 'count
+;;    :group-by - 'site to show each call site with its callers,
+;;               'function to merge by the innermost function, or
+;;               'type to merge by the class of allocated objects.
+;;    :max-rows - # of rows to be shown.  #f to show everything.
+;;
+(define (alloc-profiler-show :key (results #f) (sort-by 'bytes)
+                                  (group-by 'site) (max-rows 50))
+  (let1 rs (if results
+             (concatenate results)
+             (or (alloc-profiler-get-result) '()))
+    (if (null? rs)
+      (print "No allocation profiling data has been gathered.")
+      (show-alloc-stats rs sort-by group-by max-rows))))
+
 ;; *EXPERIMENTAL*
 ;; Show the load statistics.
 ;; Called from the cleanup routine of main.c.  Passed STATS is a list of
@@ -155,6 +199,44 @@
     ))
 
 
+;; Show the allocation profiler result
+(define (show-alloc-stats rs sort-by group-by max-rows)
+  (define (site->string site)
+    (if (null? site)
+      "(toplevel)"
+      (string-join (map x->string site) " <- ")))
+  (define key-of
+    (case group-by
+      [(site)     (^e (list (site->string (car e)) (cadr e)))]
+      [(function) (^e (list (if (pair? (car e)) (x->string (caar e)) "(toplevel)")
+                            (cadr e)))]
+      [(type)     (^e (list "" (cadr e)))]
+      [else (error "alloc-profiler-show: group-by argument must be either one of site, function or type, but got:" group-by)]))
+  (define sorter
+    (case sort-by
+      [(bytes) (^(a b) (> (caddr a) (caddr b)))]
+      [(count) (^(a b) (> (cadr a) (cadr b)))]
+      [else (error "alloc-profiler-show: sort-by argument must be either bytes or count, but got:" sort-by)]))
+  (let* ([ht (make-hash-table 'equal?)]
+         [_  (dolist [e rs]
+               (hash-table-update! ht (key-of e)
+                                   (cut map + <> (cddr e)) '(0 0 0)))]
+         [stat (sort (hash-table-map ht cons) sorter)]
+         [num-samples (fold (^(e n) (+ (cadr e) n)) 0 stat)]
+         [total-bytes (fold (^(e n) (+ (caddr e) n)) 0 stat)])
+    (print "Allocation profiler statistics (total "num-samples" samples, "
+           "approx. "total-bytes" bytes)")
+    (print "Class                     estimated bytes     samples  Site")
+    (print "------------------------+-------------------+----------+-----------------")
+    (dolist [e (if (integer? max-rows) (take* stat max-rows) stat)]
+      (match-let1 ((site type) cnt est _) e
+        (format #t "~24a ~12d(~3d%) ~10d  ~a\n"
+                type est
+                (if (zero? total-bytes)
+                  0
+                  (exact (round (* 100 (/ est total-bytes)))))
+                cnt site)))))
+
 ;; Get a fixed-decimal notation of time/call (in us)
 ;; If the time is under 100ms:  ##.####
 ;; If the time is under 10^6ms: ###.### - ######.
@@ -52,6 +52,7 @@
           construct-json construct-json-string
 
           json-array-handler json-object-handler json-special-handler
+          json-intern-strings
 
           json-parser                   ;experimental
           ))
@@ -69,10 +70,18 @@
 (define json-array-handler   (make-parameter list->vector))
 (define json-object-handler  (make-parameter identity))
 (define json-special-handler (make-parameter identity))
+;; #t to intern all strings (both keys and values) by string-intern,
+;; or an integer to intern strings up to that length.
+(define json-intern-strings  (make-parameter #f))
 
 (define (build-array elts) ((json-array-handler) elts))
 (define (build-object pairs) ((json-object-handler) pairs))
 (define (build-special symbol) ((json-special-handler) symbol))
+(define (build-string str)
+  (let1 limit (json-intern-strings)
+    (cond [(not limit) str]
+          [(integer? limit) (string-intern str limit)]
+          [else (string-intern str)])))
 
 ;;;============================================================
 ;;; Parser
@@ -162,7 +171,7 @@
                     %unicode))]
          [%unescaped ($none-of #[\"])]
          [%body-char ($or %special-char %unescaped)]
-         [%string-body ($->rope ($many %body-char))])
+         [%string-body ($lift build-string ($->string ($many %body-char)))])
     ($between %dquote %string-body %dquote)))
 
 (define %object
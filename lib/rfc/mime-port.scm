@@ -36,8 +36,6 @@
 (define-module rfc.mime-port
   (use gauche.uvector)
   (use gauche.vport)
-  (use util.queue)
-  (use util.match)
   (export make-mime-port))
 (select-module rfc.mime-port)
 
@@ -51,107 +49,100 @@
    ))
 
 ;; Creates a procedural port, which reads from SRCPORT until it reaches
-;; either EOF or MIME boundary.  Basically it runs a DFA.
+;; either EOF or MIME boundary.
+;;
+;; We read SRCPORT by blocks into BUF, and look for the delimiter
+;; (LF followed by "--" and the boundary) with u8vector-search.  CR before
+;; the delimiter belongs to it.  The data region of BUF is [HEAD, TAIL).
+;; While no delimiter is found, we can pass all but the last DLEN bytes,
+;; which may be the beginning of a delimiter, to the reader.
+;; The bytes read from SRCPORT beyond the final boundary are discarded.
 (define (make-mime-port boundary srcport)
-  (define q (make-queue))
-  (define --boundary (string->u8vector #`"--,boundary"))
+  (define delim (string->u8vector #`"\n--,boundary"))
+  (define dlen (u8vector-length delim))
+  (define buf (make-u8vector (max 65536 (* dlen 4))))
+  (define head 0)
+  (define tail 1)
+  (define src-eof? #f)
 
   (define port (make <mime-port>))
 
-  (define eof (read-from-string ""))
-
-  (define (deq! q)
-    (if (queue-empty? q) eof (dequeue! q)))
-
-  (define (fifo! q b)
-    (enqueue! q b) (dequeue! q))
-
-  (define (getb)
-    (if (queue-empty? q)
-      (case (ref port 'state)
-        [(prologue) (skip-prologue)]
-        [(boundary eof) eof]
-        [else (newb)])
-      (dequeue! q)))
-
-  (define (newb)
-    (match (read-byte srcport)
-      [(and #x0d b) ;; CR, check to see LF
-       (let1 b2 (peek-byte srcport)
-         (if (eqv? b2 #x0a)
-           (begin
-             (read-byte srcport)
-             (enqueue! q b #x0a)
-             (check-boundary))
-           b))]
-      [(and #x0a b) ;; LF, check boundary
-       (enqueue! q b) (check-boundary)]
-      [(? eof-object?) (set! (ref port 'state) 'eof) eof]
-      [b b]))
-
-  (define (check-boundary)
-    (let loop ((b   (peek-byte srcport))
-               (ind 0)
-               (max (u8vector-length --boundary)))
-      (cond [(eof-object? b) (deq! q)]
-            [(= ind max)
-             (cond [(memv b '(#x0d #x0a)) ;;found boundary
-                    (read-byte srcport)   ;;consume LF or CRLF
-                    (when (and (eqv? #x0d b)
-                               (eqv? #x0a (peek-byte srcport)))
-                      (read-byte srcport))
-                    (dequeue-all! q)
-                    (set! (ref port 'state) 'boundary)
-                    eof]
-                   [(eqv? b #x2d) ;; maybe end boundary
-                    (enqueue! q (read-byte srcport))
-                    (cond [(eqv? (peek-byte srcport) #x2d);; yes, end boundary
-                           (read-byte srcport)
-                           (dequeue-all! q)
-                           (skip-epilogue)]
-                          [else (deq! q)])]
-                   [else (deq! q)])]
-            [(= b (u8vector-ref --boundary ind))
-             (enqueue! q (read-byte srcport))
-             (loop (peek-byte srcport) (+ ind 1) max)]
-            [(queue-empty? q) (newb)]
-            [else (dequeue! q)])))
-
-  ;; Reads past the first boundary.  The first boundary may appear
-  ;; at the beginning of the message (instead of after CRLF), so
-  ;; we need slightly different handling than the normal getb.
-  (define (skip-prologue)
-    (let loop ((b (check-boundary)))
+  ;; Moves the data to the beginning of BUF and reads more.
+  (define (refill!)
+    (when (> head 0)
+      (uvector-copy! buf 0 buf head tail)
+      (set! tail (- tail head))
+      (set! head 0))
+    (let1 n (read-block! buf srcport tail)
+      (if (eof-object? n)
+        (set! src-eof? #t)
+        (set! tail (+ tail n)))))
+
+  ;; Looks at the data at HEAD.  Returns one of:
+  ;;   an integer n > 0 - the next n bytes are part of the body.
+  ;;   boundary         - a boundary is found and consumed.
+  ;;   end              - the final boundary is found.  The rest of
+  ;;                      SRCPORT is consumed.
+  ;;   eof              - SRCPORT is exhausted.
+  (define (scan)
+    (let1 p (u8vector-search buf delim head tail)
       (cond
-       [(eof-object? b)
-        (cond [(eq? (ref port 'state) 'boundary) ; we've found the boundary
-               (set! (ref port 'state) 'body) (getb)]
-              [else                              ; no boundary found
-               (set! (ref port 'state) 'eof) eof])]
-       [(queue-empty? q) (loop (newb))]
-       [else (dequeue-all! q) (loop (newb))])))
+       [(not p)
+        (let1 safe (if src-eof? tail (- tail dlen))
+          (cond [(> safe head) (- safe head)]
+                [src-eof? 'eof]
+                [else (refill!) (scan)]))]
+       [(and (> p head)
+             (let1 e (if (= (u8vector-ref buf (- p 1)) #x0d) (- p 1) p)
+               (and (> e head) (- e head))))]
+       [(and (< (- tail (+ p dlen)) 2) (not src-eof?)) (refill!) (scan)]
+       [else
+        (let* ([a (+ p dlen)]
+               [b0 (and (< a tail) (u8vector-ref buf a))]
+               [b1 (and (< (+ a 1) tail) (u8vector-ref buf (+ a 1)))])
+          (cond [(eqv? b0 #x0a) (set! head (+ a 1)) 'boundary]
+                [(eqv? b0 #x0d)
+                 (set! head (if (eqv? b1 #x0a) (+ a 2) (+ a 1)))
+                 'boundary]
+                [(and (eqv? b0 #x2d) (eqv? b1 #x2d))
+                 (set! head tail)
+                 (skip-epilogue)
+                 'end]
+                ;; not a boundary; pass the bytes up to LF as data.
+                [else (- (+ p 1) head)]))])))
 
   (define (skip-epilogue)
-    (let loop ((b (read-byte srcport)))
-      (if (eof-object? b)
-        (begin (set! (ref port 'state) 'eof) b)
-        (loop (read-byte srcport)))))
+    (let loop ()
+      (unless (eof-object? (read-block! buf srcport))
+        (loop)))
+    (set! head 0)
+    (set! tail 0)
+    (set! src-eof? #t))
 
   ;; fills vector, until it sees either
   ;;   (1) vec got full
   ;;   (2) srcport reaches EOF
   ;;   (3) mime-boundary is read
   (define (fill vec)
-    (let1 len (u8vector-length vec)
-      (let loop ((ind 0))
-        (if (= ind len)
-          len
-          (let1 b (getb)
-            (if (eof-object? b)
-              ind
-              (begin (u8vector-set! vec ind b)
-                     (loop (+ ind 1)))))))))
-
+    (case (ref port 'state)
+      [(boundary eof) 0]
+      [(prologue)
+       (let1 r (scan)
+         (cond [(integer? r) (inc! head r) (fill vec)]
+               [(eq? r 'boundary) (set! (ref port 'state) 'body) (fill vec)]
+               [else (set! (ref port 'state) 'eof) 0]))]
+      [else
+       (let1 r (scan)
+         (cond [(integer? r)
+                (let1 n (min r (u8vector-length vec))
+                  (uvector-copy! vec 0 buf head (+ head n))
+                  (inc! head n)
+                  n)]
+               [(eq? r 'boundary) (set! (ref port 'state) 'boundary) 0]
+               [else (set! (ref port 'state) 'eof) 0]))]))
+
+  ;; The first boundary may appear at the beginning of the message,
+  ;; without preceding newline.  We pretend there's one.
+  (u8vector-set! buf 0 #x0a)
   (set! (ref port 'fill) fill)
   port)
-
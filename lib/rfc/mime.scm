@@ -55,7 +55,7 @@
           mime-decode-word mime-decode-text
           <mime-part>
           mime-parse-message mime-retrieve-body
-          mime-body->string mime-body->file
+          mime-body->string mime-body->file mime-body-for-each
           mime-make-boundary mime-compose-message mime-compose-message-string
           )
   )
@@ -68,6 +68,8 @@
 (autoload gauche.charconv
           ces-upper-compatible? ces-conversion-supported? ces-convert)
 (autoload rfc.mime-port make-mime-port)
+(autoload gauche.uvector make-u8vector read-block! u8vector-copy)
+(autoload gauche.vport <buffered-output-port>)
 (autoload srfi-27 random-integer)       ;for MIME boundary generation
 
 ;;===============================================================
@@ -435,10 +437,7 @@
             [(string-ci=? enc "quoted-printable")
              (read-text quoted-printable-decode-string)]
             [(member enc '("7bit" "8bit" "binary"))
-             (let loop ((b (read-byte inp)))
-               (unless (eof-object? b)
-                 (write-byte b outp)
-                 (loop (read-byte inp))))]
+             (copy-port inp outp :unit 65536)]
             ))))
   )
 
@@ -454,6 +453,24 @@
         (cut mime-retrieve-body packet inp outp))))
   filename)
 
+;; Calls PROC with each chunk of the decoded body, as a fresh u8vector.
+;; Unencoded bodies are read by blocks, without going through strings.
+(define (mime-body-for-each packet inp proc :key (chunk-size 65536))
+  (if (member (ref packet 'transfer-encoding) '("7bit" "8bit" "binary"))
+    (let loop ()
+      (let* ([v (make-u8vector chunk-size)]
+             [n (read-block! v inp)])
+        (unless (eof-object? n)
+          (proc (if (< n chunk-size) (u8vector-copy v 0 n) v))
+          (loop))))
+    (let1 outp (make <buffered-output-port>
+                 :buffer-size chunk-size
+                 :flush (^[buf force?]
+                          (proc (u8vector-copy buf))
+                          (u8vector-length buf)))
+      (mime-retrieve-body packet inp outp)
+      (close-output-port outp))))
+
 ;;===============================================================
 ;; MIME composer
 ;;
@@ -64,11 +64,17 @@
                  (make-csv-writer (slot-ref self 'separator))))))
 
 ;; API
-(define (make-csv-reader separator :optional (quote-char #\"))
-  (^[:optional (port (current-input-port))]
-    (csv-reader separator quote-char port)))
-
-(define (csv-reader sep quo port)
+;; If INTERN is #t, field values are interned by string-intern; if it is
+;; an integer, only the values up to that length are.  It saves memory
+;; when the data have many repeating values, e.g. category columns.
+(define (make-csv-reader separator :optional (quote-char #\") (intern #f))
+  (let1 interner (cond [(not intern) identity]
+                       [(integer? intern) (cut string-intern <> intern)]
+                       [else string-intern])
+    (^[:optional (port (current-input-port))]
+      (csv-reader separator quote-char interner port))))
+
+(define (csv-reader sep quo interner port)
   (define (eor? ch) (or (eqv? ch #\newline) (eof-object? ch)))
 
   (define (start fields)
@@ -87,7 +93,7 @@
             [else (let1 chs (cons ch chs)
                     (loop (read-char port) chs chs))])))
 
-  (define (finish rchrs) (list->string (reverse! rchrs)))
+  (define (finish rchrs) (interner (list->string (reverse! rchrs))))
 
   (define (quoted fields)
     (let loop ([ch (read-char port)] [chs '()])
@@ -39,17 +39,19 @@
 (select-module text.html-lite)
 
 ;; Escaping ---------------------------------------------
+;; The escaping is done in C on byte sequences, which is safe since
+;; the special characters never appear in multibyte characters.
+(define %escape (with-module gauche.internal %string-escape-markup))
+
 (define (html-escape)
-  (generator-for-each (^c (case c
-                            [(#\<) (display "&lt;")]
-                            [(#\>) (display "&gt;")]
-                            [(#\&) (display "&amp;")]
-                            [(#\") (display "&quot;")]
-                            [else (display c)]))
-                      read-char))
+  (let loop ()
+    (let1 chunk (read-block 4096)
+      (unless (eof-object? chunk)
+        (display (%escape chunk))
+        (loop)))))
 
 (define (html-escape-string string)
-  (with-string-io (x->string string) html-escape))
+  (%escape (x->string string)))
 
 ;; Doctype ----------------------------------------------
 
@@ -106,8 +108,7 @@
                     (get-attr (cddr args) (list* (car args) " " attrs)))
                    (else
                     (get-attr (cddr args)
-                              (list* (format #f "=\"~a\""
-                                             (html-escape-string (x->string (cadr args))))
+                              (list* (list "=\"" (html-escape-string (cadr args)) "\"")
                                      (car args)
                                      " "
                                      attrs)))))
@@ -13,15 +13,14 @@
 (define-method write-tree (tree)
   (write-tree tree (current-output-port)))
 
+;; The tree is walked in C.  Strings, symbols, characters and numbers are
+;; written directly; other leaves are dispatched to write-tree.
 (define-method write-tree ((tree <list>) out)
-  (let loop ((tree tree))
-    (cond ((null? tree))
-          ((pair? tree) (write-tree (car tree) out) (loop (cdr tree)))
-          (else (write-tree tree out)))))
+  ((with-module gauche.internal %write-tree) tree out write-tree))
 
 (define-method write-tree ((tree <top>) out)
   (display tree out))
 
 (define (tree->string tree)
-  (with-output-to-string (lambda () (write-tree tree))))
+  (call-with-output-string (cut write-tree tree <>)))
 
@@ -63,11 +63,18 @@
 ;;;
 ;;;  - Codd's relational operations
 ;;;  - A relation that wraps existing relations, adding index operation.
+;;;
+;;; Some of the operations (filter, project, lookup, range and group-by)
+;;; are provided as generic functions.  The default methods work on any
+;;; relation, going through the row accessors.  <columnar-relation> keeps
+;;; each column in a vector or a uniform vector, and implements them
+;;; by scanning the column storage directly and with optional indexes.
 
 (define-module util.relation
   (use gauche.sequence)
   (use srfi-1)
   (use util.list)
+  (use util.match)
   (export <relation>
           relation-column-names relation-column-name?
           relation-column-getter relation-column-setter
@@ -78,7 +85,11 @@
           relation-insertable? relation-insert!
           relation-deletable? relation-delete!
           relation-fold
+          relation-filter relation-project relation-lookup relation-range
+          relation-group-by relation-add-index!
           <simple-relation> <object-set-relation>
+          <columnar-relation> relation->columnar-relation
+          columnar-relation-column
           ))
 (select-module util.relation)
 
@@ -174,8 +185,6 @@
 ;; Cf. E.F.Codd: Extending the database relational model to capture
 ;; more meaning, ACM trans. on database systems 4(4) pp.397--434, Dec. 1979.
 
-;; project
-;; select
 ;; join
 
 (define-method relation-fold ((r <relation>) proc seed . columns)
@@ -187,6 +196,93 @@
                                     getters)))
           seed (relation-rows r))))
 
+;; Relational operators.  They return a new relation, leaving R intact.
+;; The default methods return a <simple-relation> whose rows are vectors,
+;; in the same order as R.
+
+;; Returns a list of rows of R that satisfy PRED, coerced to vectors.
+;; PRED is called with the values of COLUMNS.
+(define (%filter-rows r pred columns)
+  (let ([getters (map (cut relation-column-getter r <>) columns)]
+        [coerce (relation-coercer r)])
+    (reverse! (fold (lambda (row acc)
+                      (if (apply pred (map (cut <> row) getters))
+                        (cons (coerce-to <vector> (coerce row)) acc)
+                        acc))
+                    '() (relation-rows r)))))
+
+(define-method relation-filter ((r <relation>) pred . columns)
+  (make <simple-relation>
+    :columns (coerce-to <list> (relation-column-names r))
+    :rows (%filter-rows r pred columns)))
+
+(define-method relation-project ((r <relation>) columns)
+  (let1 getters (map (cut relation-column-getter r <>) columns)
+    (make <simple-relation>
+      :columns columns
+      :rows (reverse! (fold (lambda (row acc)
+                              (cons (map-to <vector> (cut <> row) getters) acc))
+                            '() (relation-rows r))))))
+
+;; Rows whose COLUMN is equal? to VALUE.
+(define-method relation-lookup ((r <relation>) column value)
+  (relation-filter r (cut equal? <> value) column))
+
+;; Rows whose COLUMN is in [LO, HI), compared by compare.  LO and/or HI
+;; can be #f to leave that side unbounded.
+(define-method relation-range ((r <relation>) column lo hi)
+  (relation-filter r (cut %in-range? <> lo hi) column))
+
+(define (%in-range? v lo hi)
+  (and (or (not lo) (>= (compare v lo) 0))
+       (or (not hi) (< (compare v hi) 0))))
+
+;; AGGREGATES is a list of (NAME OP COLUMN), where OP is one of
+;; count, sum, min, max and mean, or a procedure that takes a list of
+;; the values of COLUMN in the group.  COLUMN can be omitted for count.
+;; The result has the columns KEYS followed by NAMEs, one row per group,
+;; in the order the groups first appear.
+(define-method relation-group-by ((r <relation>) keys aggregates)
+  (let ([kgetters (map (cut relation-column-getter r <>) keys)]
+        [agetters (map (^[spec] (and (pair? (cddr spec))
+                                     (relation-column-getter r (caddr spec))))
+                       aggregates)]
+        [groups (make-hash-table 'equal?)])
+    (define order
+      (reverse!
+       (fold (lambda (row order)
+               (let1 k (map (cut <> row) kgetters)
+                 (hash-table-update! groups k (cut cons row <>) '())
+                 (if (null? (cdr (hash-table-get groups k))) (cons k order) order)))
+             '() (relation-rows r))))
+    (make <simple-relation>
+      :columns (append keys (map car aggregates))
+      :rows (map (^[k]
+                   (let1 rows (reverse (hash-table-get groups k))
+                     (list->vector
+                      (append k
+                              (map (^[spec getter]
+                                     (%aggregate (cadr spec)
+                                                 (if getter (map getter rows) rows)))
+                                   aggregates agetters)))))
+                 order))))
+
+(define (%aggregate op vals)
+  (case op
+    [(count) (length vals)]
+    [(sum)   (apply + vals)]
+    [(min)   (apply min vals)]
+    [(max)   (apply max vals)]
+    [(mean)  (/ (apply + vals) (length vals))]
+    [else (if (procedure? op)
+            (op vals)
+            (error "invalid aggregate operation:" op))]))
+
+;; Requests the relation to keep an index on COLUMN.  KIND is either
+;; hash (for relation-lookup) or sorted (for relation-range).  Returns #t
+;; if the relation supports indexes, #f otherwise.
+(define-method relation-add-index! ((r <relation>) column . kind) #f)
+
 ;;;=============================================================
 ;;; Concrete implementations
 ;;;
@@ -302,3 +398,390 @@
 
 
 
+
+;;
+;; <columnar-relation>
+;;
+
+;; Each column is stored in a vector, or in a uniform vector if its type
+;; is given as a uvector class (e.g. <f64vector>).  A row is represented
+;; by its index.  Rows are appended at the end; the storage grows by
+;; doubling.
+;;
+;; Indexes are created on demand by relation-add-index!.  A hash index
+;; is kept up to date on insertion; other changes just invalidate the
+;; index, which is rebuilt when it is used next time.
+
+(define-class <columnar-relation> (<relation> <collection>)
+  ((columns :init-keyword :columns :init-value '()) ;; list of symbols
+   (types   :init-keyword :types :init-value #f)  ;; list of #f or uvector class
+   (rows    :init-keyword :rows :init-value '())  ;; initial rows
+   (size    :init-value 0)
+   (store   :init-value #f)    ;; vector of column storages
+   (procs   :init-value #f)    ;; vector of column-procs
+   (indexes :init-value '())   ;; ((column kind . table-or-#f) ...)
+   ))
+
+;; The operations on the column storage of each type.  Uniform vector
+;; procedures are looked up at runtime, so that we don't need to load
+;; gauche.uvector unless a uvector column is used (in which case the
+;; user already has it).
+(define-class <column-procs> ()
+  ((make  :init-keyword :make)  ;; (make n)
+   (ref   :init-keyword :ref)   ;; (ref storage i)
+   (set   :init-keyword :set)   ;; (set storage i v)
+   (copy  :init-keyword :copy)  ;; (copy storage start end)
+   (grow  :init-keyword :grow)  ;; (grow storage new-size)
+   (key   :init-keyword :key)   ;; normalizes a lookup key (a real number
+                                ;;  for uvector columns)
+   ))
+
+(define *vector-column-procs*
+  (make <column-procs>
+    :make (cut make-vector <> #f) :ref vector-ref :set vector-set!
+    :copy vector-copy :grow (cut vector-copy <> 0 <> #f) :key identity))
+
+(define *uvector-column-procs* (make-hash-table 'eq?))
+
+(define (%column-procs type)
+  (cond
+   [(not type) *vector-column-procs*]
+   [(hash-table-get *uvector-column-procs* type #f)]
+   [(#/^<([sucf]\d+)vector>$/ (symbol->string (class-name type)))
+    => (^m (let* ([mod (find-module 'gauche.uvector)]
+                  [tag (m 1)]
+                  [proc (^[fmt] (global-variable-ref
+                                 mod (string->symbol (format fmt tag))))]
+                  [mk (proc "make-~avector")]
+                  [copy! (global-variable-ref mod 'uvector-copy!)])
+             (rlet1 procs
+                 (make <column-procs>
+                   :make mk :ref (proc "~avector-ref")
+                   :set (proc "~avector-set!") :copy (proc "~avector-copy")
+                   :grow (^[v n] (rlet1 v2 (mk n) (copy! v2 0 v)))
+                   ;; infinities and NaN can't be in an integer column,
+                   ;; and exact would reject them.
+                   :key (if (eqv? (string-ref tag 0) #\f)
+                          inexact
+                          (^v (if (finite? v) (exact v) v))))
+               (hash-table-put! *uvector-column-procs* type procs))))]
+   [else (error "columnar-relation: invalid column type:" type)]))
+
+(define-method initialize ((r <columnar-relation>) initargs)
+  (next-method)
+  (let* ([columns (coerce-to <list> (~ r'columns))]
+         [ncols (length columns)]
+         [types (or (~ r'types) (make-list ncols #f))])
+    (unless (= (length types) ncols)
+      (error "columnar-relation: types don't match columns:" types))
+    (set! (~ r'columns) columns)
+    (set! (~ r'types) types)
+    (set! (~ r'procs) (map-to <vector> %column-procs types))
+    (set! (~ r'store)
+          (map-to <vector> (^[p] ((~ p'make) 16)) (~ r'procs)))
+    (for-each (cut %columnar-append! r <>) (~ r'rows))
+    (set! (~ r'rows) '())))
+
+;; Internal constructor from the column storages.  STORES are adopted.
+(define (%make-columnar columns types stores size)
+  (rlet1 r (make <columnar-relation> :columns columns :types types)
+    (set! (~ r'store) (list->vector stores))
+    (set! (~ r'size) size)))
+
+(define (%column-index r column)
+  (or (find-index (cut eq? <> column) (~ r'columns))
+      (error "columnar-relation: invalid column:" column)))
+
+(define (%columnar-append! r row)
+  (let ([n (~ r'size)]
+        [store (~ r'store)]
+        [procs (~ r'procs)])
+    (unless (= (size-of row) (vector-length store))
+      (error "columnar-relation: attempt to insert a row that doesn't match the relation:" row))
+    (when (= n (%capacity r))
+      (dotimes [k (vector-length store)]
+        (vector-set! store k ((~ (vector-ref procs k)'grow)
+                              (vector-ref store k) (* (max n 8) 2)))))
+    (for-each-with-index
+     (^[k v] ((~ (vector-ref procs k)'set) (vector-ref store k) n v))
+     row)
+    (set! (~ r'size) (+ n 1))
+    n))
+
+(define (%capacity r)
+  (let1 store (~ r'store)
+    (if (zero? (vector-length store))
+      (greatest-fixnum)
+      (size-of (vector-ref store 0)))))
+
+(define-method call-with-iterator ((r <columnar-relation>) proc . keys)
+  (let ([i 0] [n (~ r'size)])
+    (proc (^[] (>= i n)) (^[] (begin0 i (inc! i))))))
+
+(define-method size-of ((r <columnar-relation>)) (~ r'size))
+
+(define-method relation-rows ((r <columnar-relation>)) (iota (~ r'size)))
+
+(define-method relation-column-names ((r <columnar-relation>)) (~ r'columns))
+
+(define-method relation-column-getter ((r <columnar-relation>) column)
+  (let* ([k (%column-index r column)]
+         [ref (~ (vector-ref (~ r'procs) k)'ref)])
+    (^[row] (ref (vector-ref (~ r'store) k) row))))
+
+(define-method relation-column-setter ((r <columnar-relation>) column)
+  (let* ([k (%column-index r column)]
+         [set (~ (vector-ref (~ r'procs) k)'set)])
+    (^[row v]
+      (%invalidate-indexes! r column)
+      (set (vector-ref (~ r'store) k) row v))))
+
+(define-method relation-accessor ((r <columnar-relation>))
+  (^[row column . maybe-default]
+    (cond
+     [(find-index (cut eq? <> column) (~ r'columns))
+      => (^k ((~ (vector-ref (~ r'procs) k)'ref) (vector-ref (~ r'store) k) row))]
+     [(pair? maybe-default) (car maybe-default)]
+     [else (error "columnar-relation: invalid column:" column)])))
+
+(define-method relation-modifier ((r <columnar-relation>))
+  (^[row column v] ((relation-column-setter r column) row v)))
+
+(define-method relation-coercer ((r <columnar-relation>))
+  (let1 getters (relation-column-getters r)
+    (^[row] (map-to <vector> (cut <> row) getters))))
+
+(define-method relation-insertable? ((r <columnar-relation>)) #t)
+(define-method relation-insert! ((r <columnar-relation>) (row <sequence>))
+  (rlet1 i (%columnar-append! r row)
+    (dolist [ix (~ r'indexes)]
+      (if (and (eq? (cadr ix) 'hash) (cddr ix))
+        (let1 k (%column-index r (car ix))
+          (hash-table-push! (cddr ix)
+                            ((~ (vector-ref (~ r'procs) k)'ref)
+                             (vector-ref (~ r'store) k) i)
+                            i))
+        (set-cdr! (cdr ix) #f)))))
+
+;; ROW is a row index.  Rows after it are shifted.
+(define-method relation-deletable? ((r <columnar-relation>)) #t)
+(define-method relation-delete! ((r <columnar-relation>) row)
+  (let ([n (~ r'size)]
+        [store (~ r'store)]
+        [procs (~ r'procs)])
+    (unless (and (exact-integer? row) (< -1 row n))
+      (error "columnar-relation: invalid row:" row))
+    (dotimes [k (vector-length store)]
+      (let ([ref (~ (vector-ref procs k)'ref)]
+            [set (~ (vector-ref procs k)'set)]
+            [s (vector-ref store k)])
+        (do ([i row (+ i 1)]) [(= i (- n 1))]
+          (set s i (ref s (+ i 1))))))
+    (set! (~ r'size) (- n 1))
+    (%invalidate-indexes! r #f)))
+
+;; API
+(define (relation->columnar-relation r :optional (types #f))
+  (let ([coerce (relation-coercer r)]
+        [rel (make <columnar-relation>
+               :columns (coerce-to <list> (relation-column-names r))
+               :types types)])
+    (for-each (^[row] (%columnar-append! rel (coerce row))) (relation-rows r))
+    rel))
+
+;; API
+;; Returns a fresh vector or uvector of the values of COLUMN.
+(define (columnar-relation-column r column)
+  (let1 k (%column-index r column)
+    ((~ (vector-ref (~ r'procs) k)'copy) (vector-ref (~ r'store) k)
+     0 (~ r'size))))
+
+;;
+;; Scans and gathers.  A selection is a vector of row indexes in
+;; ascending order.
+;;
+
+(define (%select r pred columns)
+  (let ([n (~ r'size)]
+        [acc '()])
+    (match (map (^c (let1 k (%column-index r c)
+                      (cons (~ (vector-ref (~ r'procs) k)'ref)
+                            (vector-ref (~ r'store) k))))
+                columns)
+      [((ref . s))
+       (dotimes [i n] (when (pred (ref s i)) (push! acc i)))]
+      [((ref0 . s0) (ref1 . s1))
+       (dotimes [i n] (when (pred (ref0 s0 i) (ref1 s1 i)) (push! acc i)))]
+      [cols
+       (dotimes [i n]
+         (when (apply pred (map (^[c] ((car c) (cdr c) i)) cols))
+           (push! acc i)))])
+    (list->vector (reverse! acc))))
+
+;; Creates a new relation of the rows in SEL.
+(define (%gather r sel :optional (columns (~ r'columns)))
+  (let1 m (vector-length sel)
+    (%make-columnar
+     columns
+     (map (^c (list-ref (~ r'types) (%column-index r c))) columns)
+     (map (^c (let* ([k (%column-index r c)]
+                     [p (vector-ref (~ r'procs) k)]
+                     [ref (~ p'ref)] [set (~ p'set)]
+                     [s (vector-ref (~ r'store) k)])
+                (rlet1 d ((~ p'make) m)
+                  (dotimes [i m] (set d i (ref s (vector-ref sel i)))))))
+          columns)
+     m)))
+
+(define-method relation-filter ((r <columnar-relation>) pred . columns)
+  (%gather r (%select r pred columns)))
+
+(define-method relation-project ((r <columnar-relation>) columns)
+  (%make-columnar columns
+                  (map (^c (list-ref (~ r'types) (%column-index r c))) columns)
+                  (map (cut columnar-relation-column r <>) columns)
+                  (~ r'size)))
+
+;;
+;; Indexes
+;;
+
+(define-method relation-add-index! ((r <columnar-relation>) column . opt)
+  (define kind (if (pair? opt) (car opt) 'hash))
+  (unless (memq kind '(hash sorted))
+    (error "columnar-relation: index kind must be hash or sorted:" kind))
+  (%column-index r column)
+  (unless (find (^[ix] (and (eq? (car ix) column) (eq? (cadr ix) kind)))
+                (~ r'indexes))
+    (push! (~ r'indexes) (list* column kind #f)))
+  #t)
+
+(define (%invalidate-indexes! r column)
+  (dolist [ix (~ r'indexes)]
+    (when (or (not column) (eq? (car ix) column))
+      (set-cdr! (cdr ix) #f))))
+
+;; Returns the index table of KIND on COLUMN, building it if necessary,
+;; or #f if there's no such index.
+(define (%index r column kind)
+  (and-let* ([ix (find (^[ix] (and (eq? (car ix) column) (eq? (cadr ix) kind)))
+                       (~ r'indexes))])
+    (or (cddr ix)
+        (rlet1 table (%build-index r column kind)
+          (set-cdr! (cdr ix) table)))))
+
+;; A hash index maps a value to the list of row indexes in descending
+;; order.  A sorted index is a vector of row indexes sorted by the value.
+(define (%build-index r column kind)
+  (let* ([k (%column-index r column)]
+         [ref (~ (vector-ref (~ r'procs) k)'ref)]
+         [s (vector-ref (~ r'store) k)]
+         [n (~ r'size)])
+    (case kind
+      [(hash)
+       (rlet1 tab (make-hash-table (if (list-ref (~ r'types) k) 'eqv? 'equal?))
+         (dotimes [i n] (hash-table-push! tab (ref s i) i)))]
+      [(sorted)
+       (sort! (list->vector (iota n))
+              (^[i j] (< (compare (ref s i) (ref s j)) 0)))])))
+
+(define-method relation-lookup ((r <columnar-relation>) column value)
+  (let1 k (%column-index r column)
+    (if (and (list-ref (~ r'types) k) (not (real? value)))
+      (%gather r '#())                  ; never in a uvector column
+      (let1 key ((~ (vector-ref (~ r'procs) k)'key) value)
+        (if-let1 tab (%index r column 'hash)
+          (%gather r (list->vector (reverse (hash-table-get tab key '()))))
+          (%gather r (%select r (cut equal? <> key) (list column))))))))
+
+(define-method relation-range ((r <columnar-relation>) column lo hi)
+  (if-let1 perm (%index r column 'sorted)
+    (let* ([k (%column-index r column)]
+           [ref (~ (vector-ref (~ r'procs) k)'ref)]
+           [s (vector-ref (~ r'store) k)]
+           [n (vector-length perm)])
+      ;; first position in perm whose value isn't less than x
+      (define (lower-bound x)
+        (let loop ([lo 0] [hi n])
+          (if (>= lo hi)
+            lo
+            (let1 mid (ash (+ lo hi) -1)
+              (if (< (compare (ref s (vector-ref perm mid)) x) 0)
+                (loop (+ mid 1) hi)
+                (loop lo mid))))))
+      (let ([start (if lo (lower-bound lo) 0)]
+            [end   (if hi (lower-bound hi) n)])
+        (%gather r (sort! (vector-copy perm start (max start end))))))
+    (%gather r (%select r (cut %in-range? <> lo hi) (list column)))))
+
+;;
+;; Grouping.  We assign a group id to each row in one pass over the key
+;; columns, then compute each aggregate in one pass over its column.
+;;
+
+(define-method relation-group-by ((r <columnar-relation>) keys aggregates)
+  (let* ([n (~ r'size)]
+         [kgetters (map (cut relation-column-getter r <>) keys)]
+         [gids (make-vector n 0)]
+         [groups (make-hash-table
+                  (if (and (pair? keys) (null? (cdr keys))
+                           (list-ref (~ r'types) (%column-index r (car keys))))
+                    'eqv? 'equal?))]
+         [firsts '()]
+         [ngroups 0])
+    ;; With no keys, every row has the key () and falls in one group.
+    (define key-of
+      (if (and (pair? kgetters) (null? (cdr kgetters)))
+        (car kgetters)
+        (^[i] (map (cut <> i) kgetters))))
+    (dotimes [i n]
+      (let1 key (key-of i)
+        (vector-set! gids i
+                     (or (hash-table-get groups key #f)
+                         (rlet1 g ngroups
+                           (hash-table-put! groups key g)
+                           (push! firsts i)
+                           (inc! ngroups))))))
+    (let ([keyrel (%gather r (list->vector (reverse! firsts)) keys)]
+          [counts (make-vector ngroups 0)])
+      (dotimes [i n]
+        (let1 g (vector-ref gids i)
+          (vector-set! counts g (+ (vector-ref counts g) 1))))
+      (%make-columnar
+       (append keys (map car aggregates))
+       (append (~ keyrel'types) (map (^_ #f) aggregates))
+       (append (vector->list (~ keyrel'store))
+               (map (^[spec]
+                      (%aggregate-columnar r gids ngroups counts spec))
+                    aggregates))
+       ngroups))))
+
+(define (%aggregate-columnar r gids ngroups counts spec)
+  (match-let1 (name op . maybe-column) spec
+    (if (eq? op 'count)
+      (vector-copy counts)
+      (let* ([getter (relation-column-getter r (car maybe-column))]
+             [n (vector-length gids)])
+        (define (fold-column init proc)
+          (rlet1 acc (make-vector ngroups init)
+            (dotimes [i n]
+              (let1 g (vector-ref gids i)
+                (vector-set! acc g (proc (getter i) (vector-ref acc g)))))))
+        (case op
+          [(sum) (fold-column 0 +)]
+          [(mean) (rlet1 acc (fold-column 0 +)
+                    (dotimes [g ngroups]
+                      (vector-set! acc g (/ (vector-ref acc g)
+                                            (vector-ref counts g)))))]
+          [(min) (fold-column #f (^[v a] (if (or (not a) (< v a)) v a)))]
+          [(max) (fold-column #f (^[v a] (if (or (not a) (> v a)) v a)))]
+          [else
+           (unless (procedure? op)
+             (error "invalid aggregate operation:" op))
+           ;; collect values in the row order
+           (rlet1 acc (make-vector ngroups '())
+             (do ([i (- n 1) (- i 1)]) [(< i 0)]
+               (let1 g (vector-ref gids i)
+                 (vector-set! acc g (cons (getter i) (vector-ref acc g)))))
+             (dotimes [g ngroups]
+               (vector-set! acc g (op (vector-ref acc g)))))])))))
@@ -41,10 +41,13 @@
   (use gauche.sequence)
   (use gauche.dictionary)
   (use util.list)
+  (use gauche.uvector)
+  (use data.trie)
   (export <trie>
           make-trie trie trie-with-keys
           trie? trie-num-entries trie-exists?
           trie-get trie-put! trie-update! trie-delete!
+          trie-longest-match
           trie-common-prefix
           trie-common-prefix-keys
           trie-common-prefix-values
@@ -83,13 +86,22 @@
 ;;                  subsequent opration.
 ;;   tab-fold    table, (key, node, seed -> seed), seed -> seed
 ;;                  iterator on the table entries.
+;;
+;; If none of the table procedures is given, complete strings and
+;; u8vectors are not stored in the tree above, but in a byte trie
+;; (data.trie) kept in the native slot, which takes a fraction of the
+;; memory and visits the keys in order.  Other keys still go to the
+;; tree.  Prefix searches look at both, so that, e.g., the prefix
+;; (#\k) finds the string key "kana" as it did when strings were in
+;; the tree.
 
 (define-class <trie-meta> (<class>)
   ())
 
 (define-class <trie> (<dictionary>)
   ((root :init-form (%make-node))
-   (size :init-value 0)
+   (size :init-value 0)                 ; # of entries in the tree
+   (native :init-value #f)              ; byte trie, or #f
    (tab-make :init-keyword :tab-make
              :init-value (cut make-hash-table 'eqv?))
    (tab-get  :init-keyword :tab-get
@@ -105,6 +117,12 @@
    )
   :metaclass <trie-meta>)
 
+(define-method initialize ((trie <trie>) initargs)
+  (next-method)
+  (unless (any (cut get-keyword <> initargs #f)
+               '(:tab-make :tab-get :tab-put! :tab-fold))
+    (slot-set! trie 'native (make-byte-trie))))
+
 ;;;===========================================================
 ;;; Constructors etc.
 ;;;
@@ -130,7 +148,8 @@
   (is-a? x <trie>))
 
 (define (trie-num-entries trie)
-  (slot-ref trie 'size))
+  (+ (slot-ref trie 'size)
+     (if-let1 bt (slot-ref trie 'native) (byte-trie-size bt) 0)))
 
 ;;;===========================================================
 ;;; Lookup and modification
@@ -154,6 +173,15 @@
 (define (%no-key seq)
   (error "Trie does not have an entry for a key:" seq))
 
+;; Returns the byte trie if SEQ is to be stored in it, or #f.
+(define (%native trie seq)
+  (and-let* ([bt (slot-ref trie 'native)]
+             [ (or (and (string? seq) (not (string-incomplete? seq)))
+                   (u8vector? seq)) ])
+    bt))
+
+(define %absent (list 'absent))
+
 ;; internal:  Trie, [a] -> Maybe Node
 (define (%trie-get-node trie seq create?)
   (define (lookup parent tab elt)
@@ -179,45 +207,82 @@
             (slot-ref trie 'root)
             seq))))
 
-(define (trie-exists? trie seq) (boolean (%trie-get-node trie seq #f)))
+(define (trie-exists? trie seq)
+  (if-let1 bt (%native trie seq)
+    (byte-trie-exists? bt seq)
+    (boolean (and-let* ([node (%trie-get-node trie seq #f)])
+               (%node-find-terminal node seq)))))
 
 (define (trie-get trie seq . opt)
-  (or (and-let* ([node (%trie-get-node trie seq #f)]
-                 [p    (%node-find-terminal node seq)])
-        (cdr p))
-      (get-optional opt (%no-key seq))))
+  (if-let1 bt (%native trie seq)
+    (let1 v (byte-trie-ref bt seq %absent)
+      (if (eq? v %absent) (get-optional opt (%no-key seq)) v))
+    (or (and-let* ([node (%trie-get-node trie seq #f)]
+                   [p    (%node-find-terminal node seq)])
+          (cdr p))
+        (get-optional opt (%no-key seq)))))
 
 (define (trie-put! trie seq val)
-  (let* ([node (%trie-get-node trie seq #t)]
-         [p (%node-find-terminal node seq)])
-    (cond [p (set-cdr! p val)]
-          [else
-           (push! (%node-terminals node) (cons seq val))
-           (inc! (slot-ref trie 'size))]))
+  (if-let1 bt (%native trie seq)
+    (byte-trie-put! bt seq val)
+    (let* ([node (%trie-get-node trie seq #t)]
+           [p (%node-find-terminal node seq)])
+      (cond [p (set-cdr! p val)]
+            [else
+             (push! (%node-terminals node) (cons seq val))
+             (inc! (slot-ref trie 'size))])))
   (undefined))
 
 (define (trie-update! trie seq proc . opt)
-  (let* ([node (%trie-get-node trie seq #t)]
-         [p    (%node-find-terminal node seq)])
-    (cond [p (update! (cdr p) proc)]
-          [else
-           (push! (%node-terminals node)
-                  (cons seq (proc (get-optional opt (%no-key seq)))))
-           (inc! (slot-ref trie 'size))])
-    (undefined)))
+  (if-let1 bt (%native trie seq)
+    (let1 v (byte-trie-ref bt seq %absent)
+      (byte-trie-put! bt seq
+                      (proc (if (eq? v %absent)
+                              (get-optional opt (%no-key seq))
+                              v))))
+    (let* ([node (%trie-get-node trie seq #t)]
+           [p    (%node-find-terminal node seq)])
+      (cond [p (update! (cdr p) proc)]
+            [else
+             (push! (%node-terminals node)
+                    (cons seq (proc (get-optional opt (%no-key seq)))))
+             (inc! (slot-ref trie 'size))])))
+  (undefined))
 
 (define (trie-delete! trie seq)
   ;; TODO: prune a table if it becomes empty
-  (and-let* ([c (class-of seq)]
-             [node (%trie-get-node trie seq #f)])
-    (update! (cdr node)
-             (^[terminals]
-               (remove (^p (and (eq? (class-of (car p)) c)
-                                (dec! (slot-ref trie 'size))
-                                #t))
-                       terminals))))
+  (if-let1 bt (%native trie seq)
+    (byte-trie-delete! bt seq)
+    (and-let* ([c (class-of seq)]
+               [node (%trie-get-node trie seq #f)])
+      (update! (cdr node)
+               (^[terminals]
+                 (remove (^p (and (eq? (class-of (car p)) c)
+                                  (dec! (slot-ref trie 'size))
+                                  #t))
+                         terminals)))))
   (undefined))
 
+;; Returns (key . value) of the entry whose key is the longest prefix
+;; of SEQ, including SEQ itself, or #f if there's no such entry.
+;; As with the other operations, only the keys of the same type as
+;; SEQ are considered.
+(define (trie-longest-match trie seq)
+  (if-let1 bt (%native trie seq)
+    (byte-trie-longest-match bt seq)
+    (let ([tab-get (slot-ref trie 'tab-get)])
+      (let loop ([node (slot-ref trie 'root)]
+                 [elts (coerce-to <list> seq)]
+                 [best #f])
+        (let1 best (or (and-let* ([p (%node-find-terminal node seq)])
+                         (cons (car p) (cdr p)))
+                       best)
+          (if-let1 next (and (pair? elts)
+                             (%node-table node)
+                             (tab-get (%node-table node) (car elts)))
+            (loop next (cdr elts) best)
+            best))))))
+
 ;;;===========================================================
 ;;; Scanning
 ;;;
@@ -237,12 +302,27 @@
           (%node-terminals node)))
   (fold-siblings (fold-descendants seed)))
 
+;; iterate keys in the byte trie that begin with PREFIX, in order.
+;; PREFIX can be any sequence; a sequence of characters selects string
+;; keys, and a sequence of integers between 0 and 255 selects u8vector
+;; keys, as they would in the tree.
+(define (%trie-native-fold trie prefix proc seed)
+  (define (byte? e) (and (exact-integer? e) (<= 0 e 255)))
+  (if-let1 bt (slot-ref trie 'native)
+    (cond [(zero? (size-of prefix)) (byte-trie-fold bt proc seed)]
+          [(%native trie prefix) (byte-trie-fold bt proc seed prefix)]
+          [(string? prefix) seed]       ;incomplete string
+          [else
+           (let1 elts (coerce-to <list> prefix)
+             (cond [(every char? elts)
+                    (byte-trie-fold bt proc seed (list->string elts))]
+                   [(every byte? elts)
+                    (byte-trie-fold bt proc seed (list->u8vector elts))]
+                   [else seed]))])
+    seed))
+
 (define (%trie-prefix-collect trie prefix collector)
-  (or (and-let* ([node (%trie-get-node trie prefix #f)])
-        ;; NB: we don't need to reverse, since the order of entries
-        ;; are unspecified anyway.
-        (%trie-node-fold trie node collector '()))
-      '()))
+  (reverse! (trie-common-prefix-fold trie prefix collector '())))
 
 (define (trie-common-prefix trie prefix)
   (%trie-prefix-collect trie prefix acons))
@@ -254,12 +334,13 @@
   (%trie-prefix-collect trie prefix (^[k v s] (cons v s))))
 
 (define (trie-common-prefix-fold trie prefix proc seed)
-  (%trie-node-fold trie (or (%trie-get-node trie prefix #f) '()) proc seed))
+  (let1 seed (%trie-native-fold trie prefix proc seed)
+    (if-let1 node (%trie-get-node trie prefix #f)
+      (%trie-node-fold trie node proc seed)
+      seed)))
 
 (define (trie-common-prefix-map trie prefix proc)
-  (trie-common-prefix-fold trie prefix
-                           (^[k v s] (cons (proc k v) s))
-                           '()))
+  (%trie-prefix-collect trie prefix (^[k v s] (cons (proc k v) s))))
 
 (define (trie-common-prefix-for-each trie prefix proc)
   (trie-common-prefix-fold trie prefix
@@ -293,17 +374,27 @@
 ;;; Collection framework
 ;;;
 
+;; Entries in the byte trie come first, in order.
 (define-method call-with-iterator ((trie <trie>) proc . opts)
   (define count 0)
-  (define (next)
+  (define native-next
+    (and-let* ([bt (slot-ref trie 'native)]) (%byte-trie-iter bt)))
+  (define (tree-next)
     (let/cc return
       (%trie-node-fold trie (slot-ref trie 'root)
                        (^[key value seed]
                          (let/cc restart
                            (inc! count)
-                           (set! next (^[] (restart #f)))
+                           (set! tree-next (^[] (restart #f)))
                            (return (cons key value))))
                        #f)))
+  (define (next)
+    (or (and native-next
+             (receive (key value) (native-next (eof-object))
+               (if (eof-object? key)
+                 (begin (set! native-next #f) #f)
+                 (begin (inc! count) (cons key value)))))
+        (tree-next)))
   (proc (^[] (= count (trie-num-entries trie)))
         (^[] (next))))
 
@@ -137,7 +137,12 @@
           debug-print-width debug-source-info
           debug-print-pre debug-print-post)
 
-(autoload gauche.vm.profiler profiler-show profiler-show-load-stats)
+(autoload gauche.vm.profiler profiler-show profiler-show-load-stats
+          alloc-profiler-show)
+
+(autoload gauche.vm.heap heap-census-get-result heap-census-show
+          heap-census-write heap-census-read heap-census-diff
+          heap-retention-path-show)
 
 (autoload srfi-0  (:macro cond-expand))
 (autoload srfi-7  (:macro program))
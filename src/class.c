@@ -38,6 +38,7 @@
 #include "gauche/code.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/writerP.h"
+#include "gauche/priv/atomicP.h"
 
 /* Some routines uses small array on stack to keep data about
    arguments to dispatch.  If the # of args used for dispach is bigger
@@ -396,6 +397,7 @@ static ScmObj class_allocate(ScmClass *klass, ScmObj initargs)
     (void)SCM_INTERNAL_MUTEX_INIT(instance->mutex);
     (void)SCM_INTERNAL_COND_INIT(instance->cv);
     instance->data = NULL;      /* see the above note on the 'data' member */
+    instance->initPlan = NULL;
     return SCM_OBJ(instance);
 }
 
@@ -1938,16 +1940,219 @@ static SCM_DEFINE_METHOD(object_initialize_rec,
                          object_initialize_SPEC,
                          object_initialize, NULL);
 
+/*
+ * Instance initialization plan
+ *
+ *   When an instance of a Scheme-defined class is allocated and
+ *   initialized by the default methods, all (make class . initargs) does
+ *   is to fill the slot vector.  For such a class we compute, once, what
+ *   goes into each slot: a template of :init-values, a table from
+ *   :init-keywords to slot indexes, and the slots that need :init-thunk.
+ *   Then make just copies the template, scans initargs once, and calls
+ *   the necessary thunks, without dispatching allocate-instance and
+ *   initialize.
+ *
+ *   The plan is cached in klass->initPlan.  Adding or deleting a method
+ *   of allocate-instance or initialize bumps init_plan_epoch, which makes
+ *   all plans stale.  The epoch is bumped atomically after the method
+ *   list is updated, and read before a plan is computed, so a plan that
+ *   misses a new method never carries the new epoch.  A redefined class
+ *   is never instantiated by its plan; we leave it to the generic path
+ *   to deal with it.
+ *
+ *   Only classes of SCM_CLASS_SCHEME category have the plan; C-defined
+ *   classes may be compiled with an older ScmClass without initPlan.
+ */
+typedef struct InitPlanRec {
+    AO_t epoch;
+    int usable;                 /* FALSE if we have to use generic path */
+    int numSlots;
+    ScmObj *values;             /* :init-value, or SCM_UNBOUND */
+    int numKeys;
+    ScmObj *keys;               /* :init-keyword */
+    int *keySlots;              /* slot index of each key */
+    int numThunks;
+    ScmObj *thunks;             /* :init-thunk */
+    int *thunkSlots;            /* slot index of each thunk */
+    int *thunkKeys;             /* index of the slot's key, or -1 */
+} InitPlan;
+
+static AO_t init_plan_epoch = 0;
+
+static void init_plan_invalidate(ScmGeneric *gf)
+{
+    if (gf == &Scm_GenericInitialize || gf == &Scm_GenericAllocate) {
+        (void)AO_fetch_and_add1_full(&init_plan_epoch);
+    }
+}
+
+/* Returns TRUE if no method of GF but DFLT is applicable to an instance
+   of K as the first argument. */
+static int only_default_method_p(ScmGeneric *gf, ScmClass *k, ScmMethod *dflt)
+{
+    ScmObj mp;
+    SCM_FOR_EACH(mp, gf->methods) {
+        ScmMethod *m = SCM_METHOD(SCM_CAR(mp));
+        if (m == dflt) continue;
+        if (SCM_PROCEDURE_REQUIRED(m) == 0
+            || Scm_SubtypeP(k, m->specializers[0])) return FALSE;
+    }
+    return TRUE;
+}
+
+static InitPlan *compute_init_plan(ScmClass *klass)
+{
+    InitPlan *plan = SCM_NEW(InitPlan);
+    int nslots = klass->numInstanceSlots, nkeys = 0, nthunks = 0;
+    ScmObj ap;
+
+    plan->epoch = AO_load_acquire(&init_plan_epoch);
+    plan->usable = FALSE;
+    if (klass->allocate != Scm_ObjectAllocate
+        || klass->coreSize != sizeof(ScmInstance)
+        || !only_default_method_p(&Scm_GenericAllocate,
+                                  Scm_ClassOf(SCM_OBJ(klass)),
+                                  &class_allocate_rec)
+        || !only_default_method_p(&Scm_GenericInitialize, klass,
+                                  &object_initialize_rec)) {
+        return plan;
+    }
+    SCM_FOR_EACH(ap, klass->accessors) {
+        ScmSlotAccessor *sa = SCM_SLOT_ACCESSOR(SCM_CDAR(ap));
+        if (sa->setter || sa->slotNumber < 0 || sa->slotNumber >= nslots) {
+            return plan;
+        }
+        if (SCM_KEYWORDP(sa->initKeyword)) nkeys++;
+        if (sa->initializable && SCM_UNBOUNDP(sa->initValue)
+            && SCM_PROCEDUREP(sa->initThunk)) nthunks++;
+    }
+    /* we keep track of keywords seen in initargs with a bitmask */
+    if (nkeys > SCM_WORD_BITS) return plan;
+
+    plan->numSlots = nslots;
+    plan->values = SCM_NEW_ARRAY(ScmObj, nslots);
+    for (int i=0; i<nslots; i++) plan->values[i] = SCM_UNBOUND;
+    plan->numKeys = nkeys;
+    plan->keys = SCM_NEW_ARRAY(ScmObj, nkeys);
+    plan->keySlots = SCM_NEW_ATOMIC_ARRAY(int, nkeys);
+    plan->numThunks = nthunks;
+    plan->thunks = SCM_NEW_ARRAY(ScmObj, nthunks);
+    plan->thunkSlots = SCM_NEW_ATOMIC_ARRAY(int, nthunks);
+    plan->thunkKeys = SCM_NEW_ATOMIC_ARRAY(int, nthunks);
+
+    nkeys = nthunks = 0;
+    SCM_FOR_EACH(ap, klass->accessors) {
+        ScmSlotAccessor *sa = SCM_SLOT_ACCESSOR(SCM_CDAR(ap));
+        int key = -1;
+        if (SCM_KEYWORDP(sa->initKeyword)) {
+            key = nkeys++;
+            plan->keys[key] = sa->initKeyword;
+            plan->keySlots[key] = sa->slotNumber;
+        }
+        if (!sa->initializable) continue;
+        if (!SCM_UNBOUNDP(sa->initValue)) {
+            plan->values[sa->slotNumber] = sa->initValue;
+        } else if (SCM_PROCEDUREP(sa->initThunk)) {
+            plan->thunks[nthunks] = sa->initThunk;
+            plan->thunkSlots[nthunks] = sa->slotNumber;
+            plan->thunkKeys[nthunks] = key;
+            nthunks++;
+        }
+    }
+    plan->usable = TRUE;
+    return plan;
+}
+
+static ScmObj init_plan_thunks(ScmObj obj, InitPlan *plan, int i, u_long seen);
+
+static ScmObj init_plan_thunk_cc(ScmObj result, void **data)
+{
+    ScmObj obj = SCM_OBJ(data[0]);
+    InitPlan *plan = (InitPlan*)data[1];
+    int i = (int)(intptr_t)data[2];
+    SCM_INSTANCE_SLOTS(obj)[plan->thunkSlots[i]] = result;
+    return init_plan_thunks(obj, plan, i+1, (u_long)data[3]);
+}
+
+static ScmObj init_plan_thunks(ScmObj obj, InitPlan *plan, int i, u_long seen)
+{
+    for (; i<plan->numThunks; i++) {
+        int key = plan->thunkKeys[i];
+        if (key >= 0 && (seen & (1UL<<key))) continue;
+        void *data[4];
+        data[0] = obj;
+        data[1] = plan;
+        data[2] = (void*)(intptr_t)i;
+        data[3] = (void*)seen;
+        Scm_VMPushCC(init_plan_thunk_cc, data, 4);
+        return Scm_VMApply0(plan->thunks[i]);
+    }
+    return obj;
+}
+
+/* Called from the default make method.  If KLASS can be instantiated
+   by the plan, allocate and initialize an instance and returns it.
+   Otherwise returns #f, and the caller should go through the generic
+   path. */
+ScmObj Scm__VMMakeInstanceByPlan(ScmClass *klass, ScmObj initargs)
+{
+    /* The class isn't sealed yet; its slots may still change. */
+    if (SCM_CLASS_MALLEABLE_P(klass)) return SCM_FALSE;
+    /* Static classes may not have initPlan; see above. */
+    if (SCM_CLASS_CATEGORY(klass) != SCM_CLASS_SCHEME) return SCM_FALSE;
+
+    InitPlan *plan = (InitPlan*)klass->initPlan;
+    if (plan == NULL || plan->epoch != AO_load_acquire(&init_plan_epoch)) {
+        plan = compute_init_plan(klass);
+        klass->initPlan = plan;
+    }
+    if (!plan->usable || !SCM_FALSEP(klass->redefined)) return SCM_FALSE;
+
+    int nslots = plan->numSlots;
+    ScmObj *slots = SCM_NEW_ARRAY(ScmObj, nslots);
+    memcpy(slots, plan->values, nslots*sizeof(ScmObj));
+    ScmObj obj = SCM_NEW2(ScmObj, sizeof(ScmInstance));
+    SCM_SET_CLASS(obj, klass);
+    SCM_INSTANCE(obj)->slots = slots;
+
+    u_long seen = 0;            /* keys given with a value */
+    u_long matched = 0;         /* keys whose first occurrence we've seen */
+    if (plan->numKeys > 0) {
+        ScmObj cp;
+        SCM_FOR_EACH(cp, initargs) {
+            if (!SCM_PAIRP(SCM_CDR(cp))) {
+                Scm_Error("incomplete key list: %S", initargs);
+            }
+            for (int k=0; k<plan->numKeys; k++) {
+                if (SCM_EQ(plan->keys[k], SCM_CAR(cp))
+                    && !(matched & (1UL<<k))) {
+                    matched |= (1UL<<k);
+                    /* As the generic path looks up the key with
+                       Scm_GetKeyword(key, initargs, SCM_UNDEFINED),
+                       #<undef> counts as the key isn't given, and the
+                       slot gets :init-value or :init-form. */
+                    if (!SCM_UNDEFINEDP(SCM_CADR(cp))) {
+                        slots[plan->keySlots[k]] = SCM_CADR(cp);
+                        seen |= (1UL<<k);
+                    }
+                }
+            }
+            cp = SCM_CDR(cp);
+        }
+    }
+    return init_plan_thunks(obj, plan, 0, seen);
+}
+
 /* Default equal? delegates compare action to generic function object-equal?.
    We can't use VMApply here */
 static int object_compare(ScmObj x, ScmObj y, int equalp)
 {
     ScmObj r;
     if (equalp) {
-        r = Scm_ApplyRec(SCM_OBJ(&Scm_GenericObjectEqualP), SCM_LIST2(x, y));
+        r = Scm_ApplyRec2(SCM_OBJ(&Scm_GenericObjectEqualP), x, y);
         return (SCM_FALSEP(r)? -1 : 0);
     } else {
-        r = Scm_ApplyRec(SCM_OBJ(&Scm_GenericObjectCompare), SCM_LIST2(x, y));
+        r = Scm_ApplyRec2(SCM_OBJ(&Scm_GenericObjectCompare), x, y);
         if (SCM_INTP(r)) {
             int ri = SCM_INT_VALUE(r);
             if (ri < 0) return -1;
@@ -2438,6 +2643,7 @@ ScmObj Scm_UpdateDirectMethod(ScmMethod *m, ScmClass *old, ScmClass *newc)
     if (SCM_FALSEP(Scm_Memq(SCM_OBJ(m), newc->directMethods))) {
         newc->directMethods = Scm_Cons(SCM_OBJ(m), newc->directMethods);
     }
+    if (m->generic) init_plan_invalidate(m->generic);
     return SCM_OBJ(m);
 }
 
@@ -2505,6 +2711,7 @@ ScmObj Scm_AddMethod(ScmGeneric *gf, ScmMethod *method)
         gf->maxReqargs = reqs;
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    init_plan_invalidate(gf);
     return SCM_UNDEFINED;
 }
 
@@ -2554,6 +2761,7 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
         }
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    init_plan_invalidate(gf);
     return SCM_UNDEFINED;
 }
 
@@ -2972,6 +3180,63 @@ static void initialize_builtin_cpl(ScmClass *klass, ScmObj supers)
     }
 }
 
+/*
+ * Registry of statically allocated classes.  Heap census (see core.c)
+ * finds class tags in raw heap words, and needs a way to tell whether
+ * such a word really points to a class before dereferencing it.
+ * Classes allocated in the GC heap can be checked with GC_base, but
+ * static ones can't, so we keep track of them here.  The table is
+ * malloc'ed, since it only refers to static data.
+ */
+static struct {
+    ScmByte **tags;             /* instance tag of each class */
+    ScmClass **classes;
+    int num;
+    int size;
+    ScmInternalMutex mutex;
+} static_classes = { NULL, NULL, 0, 0, SCM_INTERNAL_MUTEX_INITIALIZER };
+
+static void register_static_class(ScmClass *klass)
+{
+#if !defined(GAUCHE_BROKEN_LINKER_WORKAROUND)
+    ScmByte *tag = SCM_CLASS2TAG(klass);
+#else
+    ScmByte *tag = SCM_CLASS2TAG(klass->classPtr);
+#endif
+    (void)SCM_INTERNAL_MUTEX_LOCK(static_classes.mutex);
+    if (static_classes.num == static_classes.size) {
+        int nsize = static_classes.size ? static_classes.size * 2 : 256;
+        ScmByte **nt = realloc(static_classes.tags, nsize*sizeof(ScmByte*));
+        ScmClass **nc = realloc(static_classes.classes,
+                                nsize*sizeof(ScmClass*));
+        if (nt) static_classes.tags = nt;
+        if (nc) static_classes.classes = nc;
+        if (nt && nc) static_classes.size = nsize;
+    }
+    if (static_classes.num < static_classes.size) {
+        static_classes.tags[static_classes.num] = tag;
+        static_classes.classes[static_classes.num] = klass;
+        static_classes.num++;
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(static_classes.mutex);
+}
+
+/* Returns a static class whose instance carries TAG in its header,
+   or NULL if there's no such class. */
+ScmClass *Scm__StaticClassFromTag(ScmByte *tag)
+{
+    ScmClass *k = NULL;
+    (void)SCM_INTERNAL_MUTEX_LOCK(static_classes.mutex);
+    for (int i=0; i<static_classes.num; i++) {
+        if (static_classes.tags[i] == tag) {
+            k = static_classes.classes[i];
+            break;
+        }
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(static_classes.mutex);
+    return k;
+}
+
 /*
  * A common part for builtin class initialization
  */
@@ -2991,6 +3256,7 @@ static void init_class(ScmClass *klass,
 
     klass->name = SCM_INTERN(name);
     initialize_builtin_cpl(klass, supers);
+    register_static_class(klass);
 
     /* On Windows, mutex and cv must be initialized at runtime. */
     SCM_INTERNAL_MUTEX_INIT(klass->mutex);
@@ -211,7 +211,7 @@ static void sort_q(ScmObj *elts, int lo, int hi, int depth, int limit,
 
 static int cmp_scm(ScmObj x, ScmObj y, ScmObj fn)
 {
-    ScmObj r = Scm_ApplyRec(fn, SCM_LIST2(x, y));
+    ScmObj r = Scm_ApplyRec2(fn, x, y);
     if (SCM_TRUEP(r) || (SCM_INTP(r) && SCM_INT_VALUE(r) < 0))
         return -1;
     else
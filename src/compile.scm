@@ -1467,9 +1467,20 @@
            (call-syntax-handler gval program cenv)]
           [(inline)
            (pass1/expand-inliner id gval)]
+          [(guarded-inline)
+           (pass1/guarded-inline id gval)]
           )
         (pass1/call program ($gref id) (cdr program) cenv))))
 
+  ;; Expand a call to a procedure defined in auto-inline module.
+  ;; If the argument count doesn't match, we just leave it as a normal
+  ;; call so that the error is reported at runtime.
+  (define (pass1/guarded-inline id proc)
+    (let1 args (cdr program)
+      (if (argcount-ok? args (slot-ref proc 'required) (slot-ref proc 'optional))
+        (expand-guarded-inline program id proc (imap (cut pass1 <> cenv) args))
+        (pass1/call program ($gref id) args cenv))))
+
   ;; Expand inlinable procedure.  Inliner may be...
   ;;   - An integer.  This must be the VM instruction number.
   ;;     (It is useful to initialize the inliner statically in .stub file).
@@ -1711,6 +1722,22 @@
     (for-each (^[lv a] (lvar-initval-set! lv a)) lvars args)
     ($let src 'let lvars args ($lambda-body iform))))
 
+;; Inline a call to the auto-inlinable procedure PROC, which is currently
+;; bound to ID, guarded by a runtime check that ID still holds PROC.
+;; Arguments are evaluated once before the check.
+;;
+;;   (let ((t0 arg0) ...)
+;;     (if (eq? id 'PROC) <inlined body of PROC> (id t0 ...)))
+(define (expand-guarded-inline src id proc iargs)
+  (let1 tmps (imap (^_ (make-lvar 'arg)) iargs)
+    (ifor-each2 (^[lv in] (lvar-initval-set! lv in)) tmps iargs)
+    ($let src 'let tmps iargs
+          ($if src ($asm #f `(,EQ) (list ($gref id) ($const proc)))
+               (expand-inlined-procedure src
+                                         (unpack-iform (%procedure-inliner proc))
+                                         (imap (^v ($lref v)) tmps))
+               ($call src ($gref id) (imap (^v ($lref v)) tmps))))))
+
 ;; Adjust argument list according to reqargs and optarg count.
 ;; Used in procedure inlining and local call optimization.
 (define (adjust-arglist reqargs optarg iargs name)
@@ -1743,6 +1770,9 @@
 (define eager.  (global-id 'eager))
 (define values. (global-id 'values))
 (define begin.  (global-id 'begin))
+(define error.  (global-id 'error))
+(define map.    (global-id 'map))
+(define for-each. (global-id 'for-each))
 
 ;; Definitions ........................................
 
@@ -1786,12 +1816,39 @@
                    oform flags extended? module cenv)]
     [(_ name expr)
      (unless (variable? name) (error "syntax-error:" oform))
-     (let1 cenv (cenv-add-name cenv (variable-name name))
+     (let* ([cenv (cenv-add-name cenv (variable-name name))]
+            [iform (pass1 expr cenv)])
+       (when (and (null? flags) (auto-inline-module? module))
+         (pass1/mark-auto-inlinable! iform))
        ($define oform flags
                 (make-identifier (unwrap-syntax name) module '())
-                (pass1 expr cenv)))]
+                iform))]
     [_ (error "syntax-error:" oform)]))
 
+;; Auto-inlining (experimental)
+;;   If a module has (declare (auto-inline)), we record the IForm of
+;;   small toplevel procedures defined in it, as define-inline does.
+;;   Unlike define-inline, the binding isn't marked inlinable, so the
+;;   procedure can be redefined freely.  Calls to such procedures from
+;;   other code are inlined with a guard that checks the binding still
+;;   holds the original procedure at runtime (see expand-guarded-inline).
+;;   The recorded IForm is kept in the compiled code, so it also works
+;;   for precompiled modules.
+(define *auto-inline-modules* (make-hash-table 'eq?))
+
+(define (%declare-auto-inline! module)
+  (hash-table-put! *auto-inline-modules* module #t))
+
+(define (auto-inline-module? module)
+  (hash-table-get *auto-inline-modules* module #f))
+
+(define (pass1/mark-auto-inlinable! iform)
+  (when (and (has-tag? iform $LAMBDA)
+             (not (vector? ($lambda-flag iform)))
+             (< (iform-count-size-upto iform SMALL_LAMBDA_SIZE)
+                SMALL_LAMBDA_SIZE))
+    ($lambda-flag-set! iform (pack-iform iform))))
+
 ;; Inlinable procedure.
 ;;   Inlinable procedure has both properties of a macro and a procedure.
 ;;   It is a bit tricky since the inliner information has to exist
@@ -2699,6 +2756,17 @@
   (%export-all (cenv-module cenv))
   ($const-undef))
 
+;; The form (declare ...) may be used in wider purpose.  For the time
+;; being we use it in limited purposes for compilers.  The precompiler
+;; handles it by itself; here we only recognize (auto-inline) and ignore
+;; the rest.
+(define-pass1-syntax (declare form cenv) :gauche
+  (dolist [decl (cdr form)]
+    (match (unwrap-syntax decl)
+      [('auto-inline) (%declare-auto-inline! (cenv-module cenv))]
+      [_ #f]))
+  ($const-undef))
+
 (define-pass1-syntax (import form cenv) :gauche
   (define (ensure m) (or (find-module m) (error "unknown module" m)))
   (define (symbol-but-not-keyword? x)
@@ -5740,6 +5808,76 @@
                       ))))))]
       [_ (undefined)])))
 
+;; map and for-each
+;;   When the procedure argument is a literal lambda form, the call is
+;;   expanded into a local loop, into which the lambda body is inlined.
+;;   Pass 2 then embeds the loop itself, so neither the lambda nor the
+;;   loop escapes; no closure is created and the enclosing environment
+;;   frames aren't moved to the heap.  The expanded loop follows the
+;;   definitions in liblist.scm, including the error cases.  Otherwise,
+;;   we just make a normal call.
+
+(define (inline-map-for-each form cenv map?)
+  (match form
+    [(_ proc lis . more)
+     (let ([iproc (pass1 proc (cenv-sans-name cenv))]
+           [ilis  (imap (cut pass1 <> (cenv-sans-name cenv)) (cons lis more))])
+       (if (and (has-tag? iproc $LAMBDA)
+                (= ($lambda-reqargs iproc) (length ilis))
+                (= ($lambda-optarg iproc) 0))
+         (expand-map-for-each form iproc ilis map?)
+         ($call form ($gref (if map? map. for-each.)) (cons iproc ilis))))]
+    [_ (undefined)]))
+
+(define (expand-map-for-each form iproc ilis map?)
+  (let* ([lists (imap (^_ (make-lvar 'lis)) ilis)]
+         [xs    (imap (^_ (make-lvar 'xs)) ilis)]
+         [r     (and map? (make-lvar 'r))]
+         [loop  (make-lvar (if map? 'map-loop 'for-each-loop))])
+    (define (done)
+      (if map?
+        ($asm #f `(,REVERSE) (list ($lref r)))
+        ($const-undef)))
+    (define (improper x)
+      ($call #f ($gref error.)
+             (if (null? (cdr xs))
+               (list ($const "improper list not allowed:") ($lref (car lists)))
+               (list ($const "argument lists contained an improper list \
+                              ending with:")
+                     ($lref x)))))
+    (define (step)
+      (let* ([cars (imap (^x ($asm #f `(,CAR) (list ($lref x)))) xs)]
+             [cdrs (imap (^x ($asm #f `(,CDR) (list ($lref x)))) xs)]
+             [body (expand-inlined-procedure form iproc cars)])
+        (if map?
+          ($call #f ($lref loop)
+                 `(,@cdrs ,($asm #f `(,CONS) (list body ($lref r)))))
+          ($seq (list body ($call #f ($lref loop) cdrs))))))
+    (define (dispatch xs)
+      (if (null? xs)
+        (step)
+        ($if #f ($asm #f `(,PAIRP) (list ($lref (car xs))))
+             (dispatch (cdr xs))
+             ($if #f ($asm #f `(,NULLP) (list ($lref (car xs))))
+                  (done)
+                  (improper (car xs))))))
+    (let1 lmda ($lambda form (lvar-name loop) (+ (length xs) (if map? 1 0)) 0
+                        (if map? `(,@xs ,r) xs)
+                        (dispatch xs))
+      (ifor-each2 (^[lv in] (lvar-initval-set! lv in)) lists ilis)
+      (lvar-initval-set! loop lmda)
+      ($let form 'let lists ilis
+            ($let form 'rec (list loop) (list lmda)
+                  ($call form ($lref loop)
+                         `(,@(imap (^v ($lref v)) lists)
+                           ,@(if map? (list ($const-nil)) '()))))))))
+
+(define-builtin-inliner map
+  (^[form cenv] (inline-map-for-each form cenv #t)))
+
+(define-builtin-inliner for-each
+  (^[form cenv] (inline-map-for-each form cenv #f)))
+
 ;;--------------------------------------------------------
 ;; Customizable inliner interface
 ;;
@@ -5879,6 +6017,14 @@
                      (not (SCM_VM_COMPILER_FLAG_IS_SET
                            (Scm_VM) SCM_COMPILE_NOINLINE_GLOBALS)))
                 (set! SCM_RESULT0 gval SCM_RESULT1 'inline)]
+               [(and (SCM_PROCEDUREP gval)
+                     (SCM_PROCEDURE_INLINER gval)
+                     (SCM_VECTORP (SCM_PROCEDURE_INLINER gval))
+                     (not (SCM_VM_COMPILER_FLAG_IS_SET
+                           (Scm_VM) SCM_COMPILE_NOINLINE_GLOBALS))
+                     (not (SCM_VM_COMPILER_FLAG_IS_SET
+                           (Scm_VM) SCM_COMPILE_NOINLINE_AUTO)))
+                (set! SCM_RESULT0 gval SCM_RESULT1 'guarded-inline)]
                [else (goto normal)])
          (.if "defined(RECORD_DEPENDED_MODULES)"
               (begin
@@ -6062,6 +6208,7 @@
  (define-enum SCM_COMPILE_NO_LIFTING)
  (define-enum SCM_COMPILE_INCLUDE_VERBOSE)
  (define-enum SCM_COMPILE_ENABLE_CEXPR)
+ (define-enum SCM_COMPILE_NOINLINE_AUTO)
 
  ;; Set/get VM's current module info. (temporary)
  (define-cproc vm-current-module () (result (SCM_OBJ (-> (Scm_VM) module))))
@@ -6083,7 +6230,7 @@
 
 (select-module gauche)
 
-(declare (keep-private-macro inline-stub define-cproc declare))
+(declare (keep-private-macro inline-stub define-cproc))
 
 ;; The form (inline-stub ...) allows genstub directives embedded
 ;; within a Scheme source.  It is only valid when the source is
@@ -6104,7 +6251,3 @@
          to be pre-compiled.  Since you're loading the file without \
          pre-compilation, the definition is ignored."))
 
-;; The form (declare ...) may be used in wider purpose.  For the time
-;; being we use it in limited purposes for compilers.  In interpreter
-;; we just ignore it.
-(define-macro (declare . _) #f)
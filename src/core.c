@@ -34,7 +34,10 @@
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/paths.h"
+#include "gauche/class.h"
+#include "gauche/module.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gc_mark.h"
 
 /* GC_print_static_roots() is declared in private/gc_priv.h.  It is too much
    hassle to include it with other GC internal baggages, so we just declare
@@ -66,6 +69,7 @@ static struct {
 extern void Scm__InitModule(void);
 extern void Scm__InitModulePost(void);
 extern void Scm__InitSymbol(void);
+extern void Scm__InitString(void);
 extern void Scm__InitNumber(void);
 extern void Scm__InitChar(void);
 extern void Scm__InitClass(void);
@@ -114,6 +118,12 @@ extern void Scm_Init_libomega(void);
 
 static void finalizable(void);
 static void init_cond_features(void);
+static void init_gc_mode(void);
+
+/* The GC adds a byte at the end of each object for one-past-the-end
+   pointers if it recognizes interior pointers.  The allocator in
+   gauche/priv/allocP.h needs to do the same. */
+int Scm__GCExtraBytes = 1;
 
 #ifdef GAUCHE_USE_PTHREADS
 /* a trick to make sure the gc thread object is linked */
@@ -131,6 +141,10 @@ void Scm_Init(const char *signature)
                   GAUCHE_SIGNATURE, signature);
     }
 
+    /* Incremental mode should be turned on before the heap is populated.
+       See init_gc_mode() below. */
+    init_gc_mode();
+
     /* Some platforms require this.  It is harmless if GC is
        already initialized, so we call it here just in case. */
     GC_init();
@@ -141,6 +155,7 @@ void Scm_Init(const char *signature)
     GC_oom_fn = oom_handler;
     GC_finalize_on_demand = TRUE;
     GC_finalizer_notifier = finalizable;
+    Scm__GCExtraBytes = GC_get_all_interior_pointers()? 1 : 0;
 
     (void)SCM_INTERNAL_MUTEX_INIT(cond_features.mutex);
 
@@ -149,6 +164,7 @@ void Scm_Init(const char *signature)
     Scm__InitParameter();
     Scm__InitVM();
     Scm__InitSymbol();
+    Scm__InitString();
     Scm__InitModule();
     Scm__InitNumber();
     Scm__InitChar();
@@ -218,6 +234,46 @@ void Scm_GC()
     GC_gcollect();
 }
 
+/* Incremental collection
+ *
+ *  By default the GC stops the world for the whole mark phase, whose
+ *  pause grows with the live heap.  If the environment variable
+ *  GAUCHE_GC_INCREMENTAL is set, we turn on the incremental and
+ *  generational mode of GC, which marks in small steps between
+ *  allocations and uses virtual dirty bits to find the pages modified
+ *  in the meantime.  If its value is a positive integer, it is the
+ *  target pause time in milliseconds of each step.
+ *
+ *  On most Unix platforms the dirty bits are implemented by write-protecting
+ *  the pages that contain pointers and catching SIGSEGV (or SIGBUS).  It has
+ *  a few consequences:
+ *
+ *   - A system call can't write into such a page; it fails with EFAULT
+ *     instead of raising the signal.  The code that passes a buffer in
+ *     a heap object to a system call must pass an atomic buffer, or
+ *     use a buffer on the C stack and copy it afterwards.
+ *   - We must not block SIGSEGV nor SIGBUS, and must not override the
+ *     handlers.  See signal.c.
+ *   - Our custom mark procedure of VM stacks (vm_stack_mark in vm.c) can
+ *     be called while the owner thread is running.
+ */
+static int gc_incremental = FALSE;
+
+static void init_gc_mode(void)
+{
+    const char *e = getenv("GAUCHE_GC_INCREMENTAL");
+    if (e == NULL) return;
+    long ms = strtol(e, NULL, 10);
+    if (ms > 0) GC_set_time_limit((unsigned long)ms);
+    GC_enable_incremental();
+    gc_incremental = TRUE;
+}
+
+int Scm_GCIncrementalP(void)
+{
+    return gc_incremental;
+}
+
 void Scm_PrintStaticRoots()
 {
     GC_print_static_roots();
@@ -258,6 +314,392 @@ void Scm_GCSentinel(void *obj, const char *name)
 }
 
 
+/*=============================================================
+ * Heap census
+ */
+
+/* Heap census walks all the live objects in the GC heap right after
+ * a full collection, and tallies them by the class tag found in their
+ * first word.
+ *
+ * The walk runs with the GC allocation lock held, so the callback must
+ * not touch the GC heap allocator.  We tally into a malloc'ed
+ * open-addressing table keyed by the raw tag word, and resolve tags into
+ * classes after the lock is released.  A word that looks like a tag is
+ * only dereferenced when it points to a registered static class or
+ * to the beginning of a GC heap object.
+ *
+ * Objects without a class tag can't be identified precisely.  The ones
+ * with the size of ScmPair are counted as <pair>, which may include
+ * other two-word blocks.  The rest are counted as `untagged', and
+ * pointer-free blocks (string bodies, uvector storage, etc.) as `atomic'.
+ */
+
+typedef struct census_entry_rec {
+    ScmWord tag;                /* raw tag word; 0 for an empty slot */
+    u_long count;
+    u_long bytes;
+} census_entry;
+
+typedef struct census_rec {
+    census_entry *entries;
+    u_long size;                /* # of slots; always power of 2 */
+    u_long used;
+    u_long pair_count, pair_bytes;
+    u_long untagged_count, untagged_bytes;
+    u_long atomic_count, atomic_bytes;
+} census;
+
+#define CENSUS_HASH(tag, size) \
+    ((u_long)(((tag)>>3) * 2654435761UL) & ((size)-1))
+
+static census_entry *census_lookup(census_entry *entries, u_long size,
+                                   ScmWord tag)
+{
+    u_long i = CENSUS_HASH(tag, size);
+    while (entries[i].tag != 0 && entries[i].tag != tag) {
+        i = (i+1) & (size-1);
+    }
+    return &entries[i];
+}
+
+/* Called with the allocation lock held.  Returns FALSE if we couldn't
+   extend the table. */
+static int census_add(census *c, ScmWord tag, size_t bytes)
+{
+    if (c->used*2 >= c->size) {
+        u_long nsize = c->size*2;
+        census_entry *ne = calloc(nsize, sizeof(census_entry));
+        if (ne == NULL) return FALSE;
+        for (u_long i=0; i<c->size; i++) {
+            if (c->entries[i].tag == 0) continue;
+            *census_lookup(ne, nsize, c->entries[i].tag) = c->entries[i];
+        }
+        free(c->entries);
+        c->entries = ne;
+        c->size = nsize;
+    }
+    census_entry *e = census_lookup(c->entries, c->size, tag);
+    if (e->tag == 0) {
+        e->tag = tag;
+        c->used++;
+    }
+    e->count++;
+    e->bytes += bytes;
+    return TRUE;
+}
+
+static void GC_CALLBACK census_proc(void *obj, size_t bytes, void *data)
+{
+    census *c = (census*)data;
+    if (GC_get_kind_and_size(obj, NULL) == GC_I_PTRFREE) {
+        c->atomic_count++;
+        c->atomic_bytes += bytes;
+        return;
+    }
+    ScmWord w = *(ScmWord*)obj;
+    if ((w & 7) == 7 && census_add(c, w, bytes)) return;
+    if (bytes == sizeof(ScmPair)) {
+        c->pair_count++;
+        c->pair_bytes += bytes;
+    } else {
+        c->untagged_count++;
+        c->untagged_bytes += bytes;
+    }
+}
+
+static void *census_walk(void *data)
+{
+    GC_enumerate_reachable_objects_inner(census_proc, data);
+    return NULL;
+}
+
+/* Returns the class designated by a tag word, or NULL if TAG doesn't
+   look like a valid class tag.  A class allocated in heap is accepted
+   if its own class (metaclass) is valid and inherits <class>; DEPTH
+   limits how far we follow such chain. */
+static ScmClass *census_tag_to_class(ScmWord tag, int depth)
+{
+    ScmClass *k = Scm__StaticClassFromTag((ScmByte*)tag);
+    if (k != NULL) return k;
+#if !defined(GAUCHE_BROKEN_LINKER_WORKAROUND)
+    /* With broken linker workaround the tag points to an indirection
+       cell, which we can't validate; we only recognize static classes. */
+    if (depth > 0) {
+        void *cell = (void*)(tag - 7);
+        if (GC_base(cell) == cell && GC_size(cell) >= sizeof(ScmClass)) {
+            ScmWord mtag = *(ScmWord*)cell;
+            if ((mtag & 7) == 7) {
+                ScmClass *meta = census_tag_to_class(mtag, depth-1);
+                if (meta && Scm_SubtypeP(meta, SCM_CLASS_CLASS)) {
+                    return SCM_CLASS(cell);
+                }
+            }
+        }
+    }
+#endif
+    return NULL;
+}
+
+/* Returns the class of a pointer-containing object OBJ of SIZE bytes
+   in the GC heap, in the same way as the census counts it, or NULL if
+   we can't tell (census counts it as untagged).  Used by the allocation
+   profiler; see prof.c. */
+ScmClass *Scm__HeapObjectClass(void *obj, size_t size)
+{
+    ScmWord w = *(ScmWord*)obj;
+    if ((w & 7) == 7) return census_tag_to_class(w, 3);
+    if (size == sizeof(ScmPair)) return SCM_CLASS_PAIR;
+    return NULL;
+}
+
+typedef struct census_result_rec {
+    ScmObj key;
+    u_long count;
+    u_long bytes;
+} census_result;
+
+static int census_result_cmp(const void *a, const void *b)
+{
+    u_long x = ((const census_result*)a)->bytes;
+    u_long y = ((const census_result*)b)->bytes;
+    return (x < y)? 1 : (x > y)? -1 : 0;
+}
+
+ScmObj Scm_HeapCensus(void)
+{
+    census c;
+    memset(&c, 0, sizeof(c));
+    c.size = 1024;
+    c.entries = calloc(c.size, sizeof(census_entry));
+    if (c.entries == NULL) Scm_Error("heap-census: out of memory");
+
+    GC_gcollect();
+    GC_call_with_alloc_lock(census_walk, &c);
+
+    census_result *r = malloc((c.used + 3) * sizeof(census_result));
+    if (r == NULL) {
+        free(c.entries);
+        Scm_Error("heap-census: out of memory");
+    }
+    int n = 0;
+    for (u_long i=0; i<c.size; i++) {
+        census_entry *e = &c.entries[i];
+        if (e->tag == 0) continue;
+        ScmClass *k = census_tag_to_class(e->tag, 3);
+        if (k == NULL) {
+            c.untagged_count += e->count;
+            c.untagged_bytes += e->bytes;
+        } else {
+            r[n].key = SCM_OBJ(k);
+            r[n].count = e->count;
+            r[n].bytes = e->bytes;
+            n++;
+        }
+    }
+    free(c.entries);
+    if (c.pair_count > 0) {
+        r[n].key = SCM_OBJ(SCM_CLASS_PAIR);
+        r[n].count = c.pair_count;
+        r[n].bytes = c.pair_bytes;
+        n++;
+    }
+    if (c.untagged_count > 0) {
+        r[n].key = SCM_INTERN("untagged");
+        r[n].count = c.untagged_count;
+        r[n].bytes = c.untagged_bytes;
+        n++;
+    }
+    if (c.atomic_count > 0) {
+        r[n].key = SCM_INTERN("atomic");
+        r[n].count = c.atomic_count;
+        r[n].bytes = c.atomic_bytes;
+        n++;
+    }
+    qsort(r, n, sizeof(census_result), census_result_cmp);
+
+    /* NB: The keys in R are static classes, symbols, or heap classes
+       that are reachable from live instances, so it's safe to keep
+       them in malloc'ed area while we cons up the result. */
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (int i=0; i<n; i++) {
+        SCM_APPEND1(h, t, SCM_LIST3(r[i].key,
+                                    Scm_MakeIntegerU(r[i].count),
+                                    Scm_MakeIntegerU(r[i].bytes)));
+    }
+    free(r);
+    return h;
+}
+
+/*
+ * Retention path
+ *
+ * Finds a chain of references from ROOTS to TARGET by a breadth-first
+ * search over the heap.  Each object is scanned conservatively: every
+ * word that points into a GC heap object is regarded as a reference.
+ * The collector is disabled during the search so that no object we
+ * visit is reclaimed under us; the visited table is kept in malloc'ed
+ * memory, for it is large and mustn't be scanned by GC.
+ *
+ * The result is a list of vectors #(OBJ ADDRESS SIZE INDEX), from a
+ * root to the target.  OBJ is the object itself if it carries a valid
+ * class tag, or #f for blocks we can't safely expose (pairs and raw
+ * arrays are indistinguishable).  INDEX is the word offset in the block
+ * where the reference to the next element is found; #f for the last one.
+ */
+
+typedef struct rpath_entry_rec {
+    void *obj;                  /* NULL for an empty slot */
+    void *parent;               /* NULL for roots */
+    u_long index;               /* word index of the reference in parent */
+} rpath_entry;
+
+typedef struct rpath_rec {
+    rpath_entry *entries;
+    u_long size;                /* always power of 2 */
+    u_long used;
+    void **queue;
+    u_long qhead, qtail, qsize;
+} rpath;
+
+#define RPATH_HASH(p, size) \
+    ((u_long)(((ScmWord)(p)>>3) * 2654435761UL) & ((size)-1))
+
+static rpath_entry *rpath_lookup(rpath_entry *entries, u_long size, void *p)
+{
+    u_long i = RPATH_HASH(p, size);
+    while (entries[i].obj != NULL && entries[i].obj != p) {
+        i = (i+1) & (size-1);
+    }
+    return &entries[i];
+}
+
+/* Registers P as visited and enqueue it.  Returns -1 if we run out of
+   memory, 0 if P has already been visited, 1 otherwise. */
+static int rpath_visit(rpath *r, void *p, void *parent, u_long index)
+{
+    if (r->used*2 >= r->size) {
+        u_long nsize = r->size*2;
+        rpath_entry *ne = calloc(nsize, sizeof(rpath_entry));
+        if (ne == NULL) return -1;
+        for (u_long i=0; i<r->size; i++) {
+            if (r->entries[i].obj == NULL) continue;
+            *rpath_lookup(ne, nsize, r->entries[i].obj) = r->entries[i];
+        }
+        free(r->entries);
+        r->entries = ne;
+        r->size = nsize;
+    }
+    rpath_entry *e = rpath_lookup(r->entries, r->size, p);
+    if (e->obj != NULL) return 0;
+    if (r->qtail == r->qsize) {
+        u_long nqsize = r->qsize*2;
+        void **nq = realloc(r->queue, nqsize*sizeof(void*));
+        if (nq == NULL) return -1;
+        r->queue = nq;
+        r->qsize = nqsize;
+    }
+    e->obj = p;
+    e->parent = parent;
+    e->index = index;
+    r->used++;
+    r->queue[r->qtail++] = p;
+    return 1;
+}
+
+/* Returns TRUE if found, FALSE if not found, -1 if out of memory. */
+static int rpath_search(rpath *r, void *target)
+{
+    while (r->qhead < r->qtail) {
+        void *p = r->queue[r->qhead++];
+        size_t size;
+        if (p == target) return TRUE;
+        if (GC_get_kind_and_size(p, &size) == GC_I_PTRFREE) continue;
+        for (u_long i=0; i<size/sizeof(ScmWord); i++) {
+            void *q = GC_base((void*)((ScmWord*)p)[i]);
+            if (q == NULL) continue;
+            int s = rpath_visit(r, q, p, i);
+            if (s < 0) return -1;
+            if (s > 0 && q == target) return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static ScmObj rpath_node(void *p, ScmObj index)
+{
+    ScmObj obj = SCM_FALSE;
+    ScmWord w = *(ScmWord*)p;
+    if ((w & 7) == 7
+        && GC_get_kind_and_size(p, NULL) != GC_I_PTRFREE
+        && census_tag_to_class(w, 3) != NULL) {
+        obj = SCM_OBJ(p);
+    }
+    ScmObj v = Scm_MakeVector(4, SCM_FALSE);
+    SCM_VECTOR_ELEMENT(v, 0) = obj;
+    SCM_VECTOR_ELEMENT(v, 1) = Scm_MakeIntegerU((u_long)(ScmWord)p);
+    SCM_VECTOR_ELEMENT(v, 2) = Scm_MakeIntegerU(GC_size(p));
+    SCM_VECTOR_ELEMENT(v, 3) = index;
+    return v;
+}
+
+ScmObj Scm_HeapRetentionPath(ScmObj target, ScmObj roots)
+{
+    void *tp = SCM_HPTRP(target)? GC_base(target) : NULL;
+    if (tp == NULL) {
+        Scm_Error("heap-retention-path: not a heap-allocated object: %S",
+                  target);
+    }
+    if (!SCM_LISTP(roots)) {
+        Scm_Error("heap-retention-path: list of roots required, but got %S",
+                  roots);
+    }
+    if (SCM_NULLP(roots)) {
+        roots = Scm_Cons(SCM_OBJ(Scm_VM()), Scm_AllModules());
+    }
+
+    rpath r;
+    memset(&r, 0, sizeof(r));
+    r.size = 4096;
+    r.qsize = 4096;
+    r.entries = calloc(r.size, sizeof(rpath_entry));
+    r.queue = malloc(r.qsize * sizeof(void*));
+    if (r.entries == NULL || r.queue == NULL) {
+        free(r.entries);
+        free(r.queue);
+        Scm_Error("heap-retention-path: out of memory");
+    }
+
+    GC_disable();
+    int found = FALSE;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, roots) {
+        void *p = SCM_HPTRP(SCM_CAR(cp))? GC_base(SCM_CAR(cp)) : NULL;
+        if (p == NULL) continue;
+        if (rpath_visit(&r, p, NULL, 0) < 0) { found = -1; break; }
+    }
+    if (found == 0) found = rpath_search(&r, tp);
+
+    ScmObj path = SCM_FALSE;
+    if (found > 0) {
+        /* The collector is still disabled, so the objects on the path
+           stay put while we build the result. */
+        ScmObj index = SCM_FALSE;
+        path = SCM_NIL;
+        for (void *p = tp; p != NULL;) {
+            rpath_entry *e = rpath_lookup(r.entries, r.size, p);
+            path = Scm_Cons(rpath_node(p, index), path);
+            index = Scm_MakeIntegerU(e->index);
+            p = e->parent;
+        }
+    }
+    free(r.entries);
+    free(r.queue);
+    GC_enable();
+    if (found < 0) Scm_Error("heap-retention-path: out of memory");
+    return path;
+}
+
 /*=============================================================
  * Finalization.  Scheme finalizers are added as NO_ORDER.
  */
@@ -459,9 +459,15 @@ typedef struct ScmInstanceRec {
 #define SCM_INSTANCE(obj)        ((ScmInstance*)(obj))
 #define SCM_INSTANCE_SLOTS(obj)  (SCM_INSTANCE(obj)->slots)
 
-/* Fundamental allocators */
-#define SCM_MALLOC(size)          GC_MALLOC(size)
-#define SCM_MALLOC_ATOMIC(size)   GC_MALLOC_ATOMIC(size)
+/* Fundamental allocators.
+   SCM_MALLOC and SCM_MALLOC_ATOMIC go through Scm__Malloc and
+   Scm__MallocAtomic, where the allocation profiler takes its samples.
+   See prof.c. */
+SCM_EXTERN void *Scm__Malloc(size_t size);
+SCM_EXTERN void *Scm__MallocAtomic(size_t size);
+
+#define SCM_MALLOC(size)          Scm__Malloc(size)
+#define SCM_MALLOC_ATOMIC(size)   Scm__MallocAtomic(size)
 #define SCM_STRDUP(s)             GC_STRDUP(s)
 #define SCM_STRDUP_PARTIAL(s, n)  Scm_StrdupPartial(s, n)
 
@@ -700,6 +706,11 @@ struct ScmClassRec {
     ScmInternalCond cv;         /* wait on this while a class being updated */
     void   *data;               /* extra data to do nasty trick.  See the note
                                    in class.c */
+    void   *initPlan;           /* cached instance initialization plan.
+                                   See class.c.  NB: This member changes
+                                   the size of ScmClass; extensions
+                                   that define static classes must be
+                                   recompiled. */
 } SCM_ALIGN8;
 
 typedef struct ScmClassStaticSlotSpecRec ScmClassStaticSlotSpec;
@@ -1764,6 +1775,10 @@ SCM_EXTERN void   Scm_ProfilerStart(void);
 SCM_EXTERN int    Scm_ProfilerStop(void);
 SCM_EXTERN void   Scm_ProfilerReset(void);
 
+SCM_EXTERN void   Scm_AllocProfilerStart(long interval);
+SCM_EXTERN int    Scm_AllocProfilerStop(void);
+SCM_EXTERN void   Scm_AllocProfilerReset(void);
+
 /*---------------------------------------------------
  * UTILITY STUFF
  */
@@ -1781,10 +1796,13 @@ SCM_EXTERN void Scm_SimpleMain(int argc, const char *argv[],
                                const char *script, u_long flags);
 
 SCM_EXTERN void Scm_GC(void);
+SCM_EXTERN int  Scm_GCIncrementalP(void);
 SCM_EXTERN void Scm_PrintStaticRoots(void);
 SCM_EXTERN void Scm_RegisterDL(void *data_start, void *data_end,
                                void *bss_start, void *bss_end);
 SCM_EXTERN void Scm_GCSentinel(void *obj, const char *name);
+SCM_EXTERN ScmObj Scm_HeapCensus(void);
+SCM_EXTERN ScmObj Scm_HeapRetentionPath(ScmObj target, ScmObj roots);
 
 SCM_EXTERN ScmObj Scm_GetFeatures(void);
 SCM_EXTERN void   Scm_AddFeature(const char *feature, const char *mod);
@@ -111,6 +111,7 @@ SCM_EXTERN ScmObj Scm__AllocateAndInitializeInstance(ScmClass *klass,
                                                      ScmObj *inits,
                                                      int numInits,
                                                      u_long flags);
+SCM_EXTERN ScmObj Scm__VMMakeInstanceByPlan(ScmClass *klass, ScmObj initargs);
 SCM_EXTERN ScmObj Scm_ComputeCPL(ScmClass *klass);
 SCM_EXTERN int    Scm_MethodApplicableForClasses(ScmMethod *m,
                                                  ScmClass *types[],
@@ -157,6 +158,7 @@ SCM_EXTERN void   Scm_DeleteDirectSubclass(ScmClass *super, ScmClass *sub);
 SCM_EXTERN void   Scm_DeleteDirectMethod(ScmClass *super, ScmMethod *m);
 
 SCM_EXTERN ScmObj Scm__InternalClassName(ScmClass *klass);
+SCM_EXTERN ScmClass *Scm__StaticClassFromTag(ScmByte *tag);
 
 SCM_EXTERN ScmGeneric Scm_GenericApplyGeneric;
 SCM_EXTERN ScmGeneric Scm_GenericObjectHash;
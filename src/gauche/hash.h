@@ -151,6 +151,14 @@ SCM_EXTERN ScmObj Scm_HashTableValues(ScmHashTable *table);
 
 SCM_EXTERN ScmObj Scm_HashTableStat(ScmHashTable *table);
 
+SCM_EXTERN void   Scm_HashTableUpdateAll(ScmHashTable *ht, ScmObj proc);
+SCM_EXTERN int    Scm_HashTableFilter(ScmHashTable *ht, ScmObj pred);
+SCM_EXTERN void   Scm_HashTablePutAll(ScmHashTable *ht, ScmVector *keys,
+                                      ScmVector *values, int flags);
+SCM_EXTERN void   Scm_HashTableMerge(ScmHashTable *dst, ScmHashTable *src,
+                                     ScmObj proc);
+SCM_EXTERN ScmObj Scm_HashTableToVector(ScmHashTable *ht);
+
 
 /*====================================================================
  * For backward compatibility.  DEPRECATED.
@@ -372,6 +372,9 @@ SCM_EXTERN int    Scm_PeekbUnsafe(ScmPort *port);
 
 SCM_EXTERN ScmObj Scm_ReadLine(ScmPort *port);
 SCM_EXTERN ScmObj Scm_ReadLineUnsafe(ScmPort *port);
+SCM_EXTERN ScmObj Scm_ReadLineInterned(ScmPort *port, ScmSmallInt limit);
+SCM_EXTERN ScmObj Scm_ReadLineInternedUnsafe(ScmPort *port,
+                                             ScmSmallInt limit);
 
 #if 0
 #define SCM_PORT_CURIN  (1<<0)
@@ -411,6 +414,10 @@ SCM_EXTERN ScmObj Scm_SetCurrentErrorPort(ScmPort *port);
 
 SCM_EXTERN ScmObj Scm_MakeInputStringPort(ScmString *str, int privatep);
 SCM_EXTERN ScmObj Scm_MakeOutputStringPort(int privatep);
+SCM_EXTERN void   Scm_ReserveOutputString(ScmPort *port, int size);
+SCM_EXTERN ScmObj Scm_GetOutputStringChunks(ScmPort *port, int flags);
+SCM_EXTERN ScmObj Scm_GetOutputU8Vector(ScmPort *port);
+SCM_EXTERN void   Scm_WriteOutputStringChunks(ScmPort *src, ScmPort *dst);
 
 #if !defined(GAUCHE_API_PRE_0_9)
 SCM_EXTERN ScmObj Scm_GetOutputString(ScmPort *port, int flags);
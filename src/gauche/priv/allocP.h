@@ -0,0 +1,88 @@
+/*
+ * allocP.h - Per-VM allocation of small objects
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_ALLOCP_H
+#define GAUCHE_PRIV_ALLOCP_H
+
+#include "gc_inline.h"
+#include "gc_mark.h"
+
+/* The hot allocation paths (pairs, flonums, closures and the frames
+   the VM moves to the heap) take small objects from the free lists
+   in ScmVM, which is only touched by the thread that owns the VM.
+   An empty list is refilled by GC_generic_malloc_many, which grabs
+   the allocation lock once for a batch of objects, instead of once
+   per object.  Like GC_malloc_many, we add the extra byte the GC
+   expects at the end of an object (Scm__GCExtraBytes) before rounding
+   up to granules, so that the objects are laid out the same as the
+   ones by GC_MALLOC.
+
+   The free lists are pointer-containing objects linked through their
+   first words, reachable from ScmVM; so the GC keeps them, and we don't
+   need to return them.  An object we hand out is cleared.
+
+   We can't use this for atomic objects, since the GC wouldn't trace
+   the links.  If the allocation profiler is running, or the caller's
+   thread doesn't have a VM, we fall back to SCM_MALLOC, so that the
+   profiler can see the allocation. */
+
+extern int Scm__GCExtraBytes;
+extern int Scm__AllocProfilerRunning; /* prof.c */
+
+static inline void *Scm__VMMalloc(ScmVM *vm, size_t size)
+{
+    size_t grans = (size + Scm__GCExtraBytes + GC_GRANULE_BYTES - 1)
+        / GC_GRANULE_BYTES;
+
+    if (GC_EXPECT(vm != NULL && grans < SCM_VM_FREE_LISTS
+                  && !Scm__AllocProfilerRunning, TRUE)) {
+        void **fl = &vm->freeLists[grans];
+        void *p = *fl;
+        if (GC_EXPECT(p == NULL, FALSE)) {
+            GC_generic_malloc_many(grans * GC_GRANULE_BYTES, GC_I_NORMAL, fl);
+            p = *fl;
+            if (p == NULL) return GC_MALLOC(size); /* let GC report OOM */
+        }
+        *fl = *(void**)p;
+        *(void**)p = NULL;
+        return p;
+    }
+    return SCM_MALLOC(size);
+}
+
+#define SCM_VM_NEW(vm, type) \
+    ((type*)Scm__VMMalloc(vm, sizeof(type)))
+#define SCM_VM_NEW2(vm, type, size) \
+    ((type)Scm__VMMalloc(vm, size))
+
+#endif /*GAUCHE_PRIV_ALLOCP_H*/
@@ -0,0 +1,84 @@
+/*
+ * atomicP.h - Atomic operations
+ *
+ *   Copyright (c) 2014  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_ATOMICP_H
+#define GAUCHE_PRIV_ATOMICP_H
+
+/* We use libatomic_ops bundled with Boehm GC.  Some platforms need
+   to fall back to the pthread implementation; see below. */
+
+/* Workaround for sh4 */
+/*
+ * ABI wise, I'd say SuperH is difficult to support, and libatomic_ops
+ * is not well supported.
+ *
+ * I believe that using gUSA, we could improve libatomic_ops
+ * implementation for SH-4 (compare_and_swap, etc.).  But, those
+ * are imcompatible to SH-4A, SMP machines.
+ *
+ * I believe that SH-4A, architecture wise, breaks SH-4 ABI already.
+ * 
+ * If SH-4A machine insists as if it were SH4 (ABI), we can't use
+ * gUSA, nor ll/sc equivalents (movli.l/movco.l, IIRC), either.
+ * That's totally a mess.
+ *
+ * Only workaround for both of SH-4 and SH-4A is to downgrade to
+ * pthread implementation, so that it will work reliably.
+ * 
+ * -- gniibe  2012-11-27
+ *
+ */
+#if defined(__SH4__)
+#define AO_USE_PTHREAD_DEFS 1
+#endif
+/* Workaround for armel */
+/*
+ * It is unfortunate that libatomic_ops is not well supported
+ * for ARM architectures.  It could be understandable as there
+ * are so many variants in "ARM".
+ *
+ * For __ARMEL__ (which means ARM_ARCH_4T, in Debian), there is no 
+ * hardware support for atomic operations, unfortunatelly.
+ *
+ * NOTE:
+ * It is ARMv6 which introduced LDREX/STREX (exclusives).
+ * It is ARMv7 which introduced DMB/DSB instructions (memory barrier).
+ *
+ *      -- gniibe  2012-11-27
+ */
+#if defined(__ARMEL__)
+#define AO_USE_PTHREAD_DEFS 1
+#endif
+#include "atomic_ops.h"
+
+#endif /*GAUCHE_PRIV_ATOMICP_H*/
@@ -48,6 +48,7 @@ struct ScmWriteContextRec {
 
 SCM_EXTERN ScmObj Scm__WritePrimitive(ScmObj obj, ScmPort *port,
                                       ScmWriteContext *ctx);
+SCM_EXTERN ScmObj Scm__WriteStats(int resetp);
 
 /* For now, let's keep ScmWrteContext class stuff private. */
 #define SCM_WRITE_CONTEXT(obj)    ((ScmWriteContext*)(obj))
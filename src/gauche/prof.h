@@ -50,6 +50,13 @@
  * execution on the thread.   Each entry just records the address of
  * the called object.
  *
+ * Besides those, there's an allocation profiler, which samples the
+ * allocations made through SCM_NEW and friends every N bytes, recording
+ * the class of the allocated object and the innermost functions of
+ * the Scheme stack.
+ * It is independent from the other two and can be started and stopped
+ * separately.
+ *
  * TODO: It is not known if sampling profiler works when more than one
  * thread requests profiling.  Should be considrered later.
  *
@@ -98,6 +105,34 @@ typedef struct ScmProfCountRec {
 /* # of on-memory samples for the call counter. */
 #define SCM_PROF_COUNTER_IN_BUFFER  12000
 
+/* A sample of allocation profiler.
+ * Every time the VM allocates SCM_PROF_ALLOC_INTERVAL bytes (adjustable
+ * by Scm_AllocProfilerStart), the allocation being made is recorded
+ * with the innermost SCM_PROF_ALLOC_STACK_DEPTH functions of the
+ * Scheme stack.  ESTIMATE is the number of bytes the sample represents,
+ * that is, the interval times the number of intervals the allocation
+ * spans.
+ */
+#define SCM_PROF_ALLOC_STACK_DEPTH 3
+
+typedef struct ScmProfAllocSampleRec {
+    ScmObj stack[SCM_PROF_ALLOC_STACK_DEPTH]; /* ScmCompiledCode, ScmSubr,
+                                                 or #f */
+    void *obj;                  /* the sampled object.  We can only tell
+                                   its class after the allocator returns,
+                                   so it is kept until the buffer is
+                                   flushed. */
+    int atomic;                 /* TRUE if allocated by SCM_NEW_ATOMIC etc. */
+    size_t estimate;            /* estimated bytes (see above) */
+    size_t size;                /* actual size of the sampled allocation */
+} ScmProfAllocSample;
+
+/* # of on-memory samples for the allocation profiler. */
+#define SCM_PROF_ALLOC_SAMPLES_IN_BUFFER  1000
+
+/* Default sampling interval of the allocation profiler, in bytes. */
+#define SCM_PROF_ALLOC_INTERVAL  65536
+
 /* Profiling buffer.
  * It is allocated when profiler-start is called on this thread
  * for the first time.
@@ -115,9 +150,24 @@ struct ScmVMProfilerRec {
 
     ScmProfSample samples[SCM_PROF_SAMPLES_IN_BUFFER];
     ScmProfCount  counts[SCM_PROF_COUNTER_IN_BUFFER];
+
+    /* allocation profiler */
+    int allocState;             /* allocation profiler state */
+    int allocFlushing;          /* TRUE while we're collecting samples;
+                                   allocations in it aren't sampled. */
+    long allocInterval;         /* sampling interval in bytes */
+    long allocCountdown;        /* bytes to be allocated until next sample */
+    int currentAllocSample;     /* index to the current alloc sample */
+    int totalAllocSamples;      /* total # of alloc samples */
+    ScmHashTable *allocHash;    /* collected data.  Maps the innermost
+                                   function to a list of
+                                   #(<class> <stack> <count> <estimate> <bytes>) */
+    ScmProfAllocSample allocSamples[SCM_PROF_ALLOC_SAMPLES_IN_BUFFER];
 };
 
 SCM_EXTERN ScmObj Scm_ProfilerRawResult(void);
+SCM_EXTERN ScmObj Scm_AllocProfilerRawResult(void);
+SCM_EXTERN ScmClass *Scm__HeapObjectClass(void *obj, size_t size);
 
 /* Call Counter API */
 
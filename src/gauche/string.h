@@ -156,6 +156,11 @@ SCM_EXTERN ScmObj  Scm_MakeString(const char *str,
 SCM_EXTERN ScmObj  Scm_MakeFillString(ScmSmallInt len, ScmChar fill);
 SCM_EXTERN ScmObj  Scm_CopyStringWithFlags(ScmString *str, int flags, int mask);
 
+SCM_EXTERN ScmObj  Scm_StringIntern(ScmString *str);
+SCM_EXTERN ScmObj  Scm_MakeInternedString(const char *str,
+                                          ScmSmallInt size, ScmSmallInt len,
+                                          int flags);
+
 #define SCM_MAKE_STR(cstr) \
     Scm_MakeString(cstr, -1, -1, 0)
 #define SCM_MAKE_STR_COPYING(cstr) \
@@ -198,6 +203,7 @@ SCM_EXTERN ScmObj  Scm_StringIncompleteToComplete(ScmString *str,
                                                   ScmChar substitute);
 
 SCM_EXTERN ScmObj  Scm_StringToList(ScmString *str);
+SCM_EXTERN ScmObj  Scm_StringEscapeMarkup(ScmString *str);
 SCM_EXTERN ScmObj  Scm_ListToString(ScmObj chars);
 
 /*
@@ -329,6 +335,8 @@ SCM_EXTERN int         Scm_DStringSize(ScmDString *dstr);
 SCM_EXTERN ScmObj      Scm_DStringGet(ScmDString *dstr, int flags);
 SCM_EXTERN const char *Scm_DStringGetz(ScmDString *dstr);
 SCM_EXTERN const char *Scm_DStringPeek(ScmDString *dstr, int *size, int *len);
+SCM_EXTERN ScmObj      Scm_DStringGetChunks(ScmDString *dstr, int flags);
+SCM_EXTERN void        Scm_DStringReserve(ScmDString *dstr, int size);
 SCM_EXTERN void        Scm_DStringPutz(ScmDString *dstr, const char *str,
                                        int siz);
 SCM_EXTERN void        Scm_DStringAdd(ScmDString *dstr, ScmString *str);
@@ -40,6 +40,10 @@
 /* Maximum # of values allowed for multiple value return */
 #define SCM_VM_MAX_VALUES      20
 
+/* # of per-VM free lists of small objects, indexed by size in
+   GC granules.  See gauche/priv/allocP.h */
+#define SCM_VM_FREE_LISTS      8
+
 /* Finalizer queue size */
 #define SCM_VM_FINQ_SIZE       32
 
@@ -209,6 +213,10 @@ SCM_EXTERN int    Scm_FreeVariableEqv(ScmObj var, ScmObj sym, ScmObj env);
 typedef struct ScmCStackRec {
     struct ScmCStackRec *prev;
     ScmContFrame *cont;
+    int lazy;                   /* nonzero if jbuf isn't set yet.  Such
+                                   a record is never the target of
+                                   siglongjmp.  See user_eval_inner()
+                                   in vm.c. */
     sigjmp_buf jbuf;
     sigset_t mask;
 } ScmCStack;
@@ -275,6 +283,11 @@ typedef struct ScmEscapePointRec {
                                    with-error-handler uses the latter model,
                                    but SRFI-34's guard needs the former model.
                                 */
+    int reusable;               /* TRUE if this EP can be recycled when
+                                   with-error-handler returns.  Cleared
+                                   when the EP may be referenced from
+                                   elsewhere.  See with_error_handler()
+                                   in vm.c. */
 } ScmEscapePoint;
 
 /* Link management */
@@ -491,6 +504,10 @@ struct ScmVMRec {
                                 /* reverse link of escape point chain
                                    to keep 'active' EPs.
                                    See ScmEscapePoint definition above. */
+    ScmEscapePoint *escapePointPool;
+                                /* recycled EPs of with-error-handler,
+                                   linked by prev. */
+    int escapePointPoolSize;
     int escapeReason;           /* temporary storage to pass data across
                                    longjmp(). */
     void *escapeData[2];        /* ditto. */
@@ -513,6 +530,9 @@ struct ScmVMRec {
     int profilerRunning;
     ScmVMProfiler *prof;
 
+    /* Allocation */
+    void *freeLists[SCM_VM_FREE_LISTS]; /* only touched by the owner thread */
+
 #if defined(GAUCHE_USE_WTHREADS)
     ScmWinCleanup *winCleanup; /* mimic pthread_cleanup_* */
 #endif /*defined(GAUCHE_USE_WTHREADS)*/
@@ -604,20 +624,14 @@ typedef enum {
        ScmCStack cstack;                        \
        cstack.prev = Scm_VM()->cstack;          \
        cstack.cont = NULL;                      \
+       cstack.lazy = 0;                         \
        Scm_VM()->cstack = &cstack;              \
        if (sigsetjmp(cstack.jbuf, FALSE) == 0) {
 
 #define SCM_WHEN_ERROR                          \
        } else {
 
-#define SCM_NEXT_HANDLER                                        \
-           do {                                                 \
-               if (Scm_VM()->cstack->prev) {                    \
-                   Scm_VM()->cstack = Scm_VM()->cstack->prev;   \
-                   siglongjmp(Scm_VM()->cstack->jbuf, 1);       \
-               }                                                \
-               else Scm_Exit(1);                                \
-           } while (0)
+#define SCM_NEXT_HANDLER   Scm_VMNextHandler(Scm_VM())
 
 #define SCM_END_PROTECT                                 \
        }                                                \
@@ -678,7 +692,9 @@ enum {
     SCM_COMPILE_NO_LIFTING = (1L<<7),      /* Do not run lambda lifting pass
                                               (pass4). */
     SCM_COMPILE_INCLUDE_VERBOSE = (1L<<8), /* Report expansion of 'include' */
-    SCM_COMPILE_ENABLE_CEXPR = (1L<<9)     /* Support C-expressions by reader */
+    SCM_COMPILE_ENABLE_CEXPR = (1L<<9),    /* Support C-expressions by reader */
+    SCM_COMPILE_NOINLINE_AUTO = (1L<<10)   /* Do not inline auto-inlinable
+                                              procs with runtime guard */
 };
 
 #define SCM_VM_COMPILER_FLAG_IS_SET(vm, flag) ((vm)->compilerFlags & (flag))
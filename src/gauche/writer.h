@@ -62,6 +62,7 @@ SCM_EXTERN int Scm_WriteContextCase(const ScmWriteContext *ctx);
 SCM_EXTERN void Scm_Write(ScmObj obj, ScmObj port, int mode);
 SCM_EXTERN int Scm_WriteCircular(ScmObj obj, ScmObj port, int mode, int width);
 SCM_EXTERN int Scm_WriteLimited(ScmObj obj, ScmObj port, int mode, int width);
+SCM_EXTERN void Scm_WriteTree(ScmObj tree, ScmObj port, ScmObj leaf_writer);
 SCM_EXTERN void Scm_Format(ScmPort *port, ScmString *fmt, ScmObj args, int ss);
 SCM_EXTERN void Scm_Printf(ScmPort *port, const char *fmt, ...);
 SCM_EXTERN void Scm_PrintfShared(ScmPort *port, const char *fmt, ...);
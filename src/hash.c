@@ -186,8 +186,7 @@ u_long Scm_Hash(ScmObj obj)
         goto string_hash;
     } else {
         /* Call specialized object-hash method */
-        ScmObj r = Scm_ApplyRec(SCM_OBJ(&Scm_GenericObjectHash),
-                                SCM_LIST1(obj));
+        ScmObj r = Scm_ApplyRec1(SCM_OBJ(&Scm_GenericObjectHash), obj);
         if (SCM_INTP(r)) {
             return (u_long)SCM_INT_VALUE(r);
         }
@@ -250,6 +249,27 @@ u_long Scm_HashString(ScmString *str, u_long modulo)
 /*
  * Common function called when the accessor function needs to add an entry.
  */
+static void extend_table(ScmHashCore *table, int newsize, int newbits)
+{
+    Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
+    for (int i=0; i<newsize; i++) newb[i] = NULL;
+
+    ScmHashIter iter;
+    Entry *f;
+    Scm_HashIterInit(&iter, table);
+    while ((f = (Entry*)Scm_HashIterNext(&iter)) != NULL) {
+        int index = HASH2INDEX(newsize, newbits, f->hashval);
+        f->next = newb[index];
+        newb[index] = f;
+    }
+    /* gc friendliness */
+    for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
+
+    table->numBuckets = newsize;
+    table->numBucketsLog2 = newbits;
+    table->buckets = (void**)newb;
+}
+
 static Entry *insert_entry(ScmHashCore *table,
                            intptr_t key,
                            u_long   hashval,
@@ -265,31 +285,27 @@ static Entry *insert_entry(ScmHashCore *table,
     table->numEntries++;
 
     if (table->numEntries > table->numBuckets*MAX_AVG_CHAIN_LIMITS) {
-        /* Extend the table */
-        int newsize = (table->numBuckets << EXTEND_BITS);
-        int newbits = table->numBucketsLog2 + EXTEND_BITS;
-
-        Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
-        for (int i=0; i<newsize; i++) newb[i] = NULL;
-
-        ScmHashIter iter;
-        Entry *f;
-        Scm_HashIterInit(&iter, table);
-        while ((f = (Entry*)Scm_HashIterNext(&iter)) != NULL) {
-            index = HASH2INDEX(newsize, newbits, f->hashval);
-            f->next = newb[index];
-            newb[index] = f;
-        }
-        /* gc friendliness */
-        for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
-
-        table->numBuckets = newsize;
-        table->numBucketsLog2 = newbits;
-        table->buckets = (void**)newb;
+        extend_table(table,
+                     table->numBuckets << EXTEND_BITS,
+                     table->numBucketsLog2 + EXTEND_BITS);
     }
     return e;
 }
 
+/* Extend the table at once so that it can hold COUNT entries without
+   further extension, to avoid rehashing repeatedly on bulk insertion.
+   We grow by the same step as insert_entry, so the resulting table
+   is the same as the one we'd get by inserting one by one. */
+static void reserve_entries(ScmHashCore *table, int count)
+{
+    int newsize = table->numBuckets, newbits = table->numBucketsLog2;
+    while (count > newsize*MAX_AVG_CHAIN_LIMITS) {
+        newsize <<= EXTEND_BITS;
+        newbits += EXTEND_BITS;
+    }
+    if (newsize > table->numBuckets) extend_table(table, newsize, newbits);
+}
+
 /* NB: Deleting entry E doesn't modify E's key and value, but cut
    the "next" link for the sake of weak-gc robustness.  The hash core
    iterator prefetches a pointer to the next entry, so deleting the
@@ -761,6 +777,113 @@ ScmObj Scm_HashTableValues(ScmHashTable *table)
     return h;
 }
 
+/*
+ * Bulk operations
+ *
+ *  These walk the buckets directly, instead of going through
+ *  ScmHashIter and consing an intermediate list.  PROC and PRED
+ *  shouldn't add entries to the table; if they do, some entries may
+ *  be visited twice or skipped, though it won't break the table.
+ */
+
+/* Replace each value with the result of (PROC key value). */
+void Scm_HashTableUpdateAll(ScmHashTable *ht, ScmObj proc)
+{
+    ScmHashCore *c = SCM_HASH_TABLE_CORE(ht);
+    for (int i=0; i<c->numBuckets; i++) {
+        for (Entry *e = BUCKETS(c)[i], *next; e; e = next) {
+            next = e->next;     /* PROC may delete E */
+            ScmObj v = Scm_ApplyRec2(proc, SCM_DICT_KEY(e), SCM_DICT_VALUE(e));
+            (void)SCM_DICT_SET_VALUE(e, v);
+        }
+    }
+}
+
+/* Delete entries for which (PRED key value) returns #f.  Returns
+   the number of deleted entries. */
+int Scm_HashTableFilter(ScmHashTable *ht, ScmObj pred)
+{
+    ScmHashCore *c = SCM_HASH_TABLE_CORE(ht);
+    int ndeleted = 0;
+    for (int i=0; i<c->numBuckets; i++) {
+        Entry *e = BUCKETS(c)[i], *prev = NULL, *next;
+        for (; e; e = next) {
+            next = e->next;
+            ScmObj r = Scm_ApplyRec2(pred, SCM_DICT_KEY(e), SCM_DICT_VALUE(e));
+            if (SCM_FALSEP(r)) {
+                /* PRED may have modified the chain; look E up again. */
+                if ((prev ? prev->next : BUCKETS(c)[i]) == e) {
+                    delete_entry(c, e, prev, i);
+                    ndeleted++;
+                } else if (Scm_HashCoreSearch(c, e->key, SCM_DICT_DELETE)) {
+                    ndeleted++;
+                }
+            } else {
+                prev = e;
+            }
+        }
+    }
+    return ndeleted;
+}
+
+/* Insert KEYS[i] => VALUES[i] for each i.  The table is extended
+   beforehand to hold them all. */
+void Scm_HashTablePutAll(ScmHashTable *ht, ScmVector *keys, ScmVector *values,
+                         int flags)
+{
+    ScmSmallInt n = SCM_VECTOR_SIZE(keys);
+    if (SCM_VECTOR_SIZE(values) != n) {
+        Scm_Error("keys and values must be of the same length, but got "
+                  "%ld keys and %ld values", n, SCM_VECTOR_SIZE(values));
+    }
+    ScmHashCore *c = SCM_HASH_TABLE_CORE(ht);
+    reserve_entries(c, c->numEntries + n);
+    for (ScmSmallInt i=0; i<n; i++) {
+        Scm_HashTableSet(ht, SCM_VECTOR_ELEMENT(keys, i),
+                         SCM_VECTOR_ELEMENT(values, i), flags);
+    }
+}
+
+/* Insert all entries of SRC into DST.  If a key is in both, the value
+   is the one in SRC if PROC is #f, or the result of
+   (PROC key dst-value src-value) otherwise. */
+void Scm_HashTableMerge(ScmHashTable *dst, ScmHashTable *src, ScmObj proc)
+{
+    ScmHashCore *d = SCM_HASH_TABLE_CORE(dst);
+    ScmHashCore *s = SCM_HASH_TABLE_CORE(src);
+    if (d == s) return;
+    /* Assume mostly disjoint keys; at worst we have sparser buckets. */
+    reserve_entries(d, d->numEntries + s->numEntries);
+    for (int i=0; i<s->numBuckets; i++) {
+        for (Entry *e = BUCKETS(s)[i], *next; e; e = next) {
+            next = e->next;
+            ScmDictEntry *de = Scm_HashCoreSearch(d, e->key, SCM_DICT_CREATE);
+            if (de->value && !SCM_FALSEP(proc)) {
+                ScmObj v = Scm_ApplyRec3(proc, SCM_DICT_KEY(e),
+                                         SCM_DICT_VALUE(de),
+                                         SCM_DICT_VALUE(e));
+                (void)SCM_DICT_SET_VALUE(de, v);
+            } else {
+                (void)SCM_DICT_SET_VALUE(de, SCM_DICT_VALUE(e));
+            }
+        }
+    }
+}
+
+/* Returns a vector of (key . value). */
+ScmObj Scm_HashTableToVector(ScmHashTable *ht)
+{
+    ScmHashCore *c = SCM_HASH_TABLE_CORE(ht);
+    ScmObj v = Scm_MakeVector(c->numEntries, SCM_FALSE);
+    ScmObj *vp = SCM_VECTOR_ELEMENTS(v);
+    for (int i=0; i<c->numBuckets; i++) {
+        for (Entry *e = BUCKETS(c)[i]; e; e = e->next) {
+            *vp++ = Scm_Cons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e));
+        }
+    }
+    return v;
+}
+
 ScmObj Scm_HashTableStat(ScmHashTable *table)
 {
     ScmObj h = SCM_NIL, t = SCM_NIL;
@@ -192,6 +192,20 @@
 (define-cproc hash-table-values (hash::<hash-table>) Scm_HashTableValues)
 (define-cproc hash-table-stat (hash::<hash-table>)   Scm_HashTableStat)
 
+;; bulk operations
+(define-cproc hash-table-update-all! (hash::<hash-table> proc) ::<void>
+  Scm_HashTableUpdateAll)
+(define-cproc hash-table-filter! (hash::<hash-table> pred) ::<int>
+  Scm_HashTableFilter)
+(define-cproc hash-table-put-all! (hash::<hash-table>
+                                   keys::<vector> values::<vector>) ::<void>
+  (Scm_HashTablePutAll hash keys values 0))
+(define-cproc hash-table-merge! (dst::<hash-table> src::<hash-table>
+                                 :optional (proc #f))
+  (Scm_HashTableMerge dst src proc)
+  (result (SCM_OBJ dst)))
+(define-cproc hash-table->vector (hash::<hash-table>) Scm_HashTableToVector)
+
 ;; conversion to/from hash-table
 (define (alist->hash-table a . opt-eq)
   (rlet1 tb (apply make-hash-table opt-eq)
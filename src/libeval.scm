@@ -366,12 +366,22 @@
     (list ':bytes-since-gc
           (Scm_MakeIntegerFromUI (cast u_long (GC_get_bytes_since_gc))))
     (list ':total-bytes
-          (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes)))))))
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes))))
+    (list ':gc-count
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_gc_no))))
+    (list ':incremental
+          (SCM_MAKE_BOOL (Scm_GCIncrementalP))))))
 
 (select-module gauche.internal)
 ;; for diagnostics
 (define-cproc gc-print-static-roots () ::<void> Scm_PrintStaticRoots)
 
+(select-module gauche)
+;; Heap inspection.  See lib/gauche/vm/heap.scm for the utilities.
+(define-cproc heap-census () Scm_HeapCensus)
+(define-cproc heap-retention-path (obj :optional (roots '()))
+  Scm_HeapRetentionPath)
+
 ;;;
 ;;; Some system introspection
 ;;;
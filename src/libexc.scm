@@ -55,6 +55,11 @@
     (result (Scm_VMWithGuardHandler handler thunk))
     (result (Scm_VMWithErrorHandler handler thunk))))
 
+;; Used by guard.  Same as (with-error-handler handler thunk
+;; :rewind-before #t), without consing keyword arguments.
+(define-cproc %with-guard-handler (handler thunk)
+  (result (Scm_VMWithGuardHandler handler thunk)))
+
 (define-cproc report-error (exception) ::<void> Scm_ReportError)
 
 ;;;
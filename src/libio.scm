@@ -36,6 +36,7 @@
 (inline-stub
  (declcode (.include <gauche/vminsn.h>
                      <gauche/priv/portP.h>
+                     <gauche/priv/writerP.h>
                      <stdlib.h>
                      <fcntl.h>)))
 
@@ -331,8 +332,12 @@
 (define-cproc open-input-string (string::<string> :key (private?::<boolean> #f))
   Scm_MakeInputStringPort)
 
-(define-cproc open-output-string (:key (private?::<boolean> #f))
-  Scm_MakeOutputStringPort)
+(define-cproc open-output-string (:key (private?::<boolean> #f)
+                                       (size-hint::<fixnum> 0))
+  (let* ([p (Scm_MakeOutputStringPort private?)])
+    (when (> size-hint 0)
+      (Scm_ReserveOutputString (SCM_PORT p) (cast int size-hint)))
+    (result p)))
 
 (define-cproc get-output-string (oport::<output-port>) ;SRFI-6
   (result (Scm_GetOutputString oport 0)))
@@ -340,6 +345,16 @@
 (define-cproc get-output-byte-string (oport::<output-port>)
   (result (Scm_GetOutputString oport SCM_STRING_INCOMPLETE)))
 
+(define-cproc get-output-string-chunks (oport::<output-port>)
+  (result (Scm_GetOutputStringChunks oport 0)))
+
+(define-cproc get-output-u8vector (oport::<output-port>)
+  Scm_GetOutputU8Vector)
+
+(define-cproc write-output-string-chunks (oport::<output-port>
+                                          dest::<output-port>) ::<void>
+  Scm_WriteOutputStringChunks)
+
 (define-cproc get-remaining-input-string (iport::<input-port>)
   (result (Scm_GetRemainingInputString iport 0)))
 
@@ -476,8 +491,16 @@
     (result (?: (< b 0) SCM_EOF (SCM_MAKE_INT b)))))
 
 (define-cproc read-line (:optional (port::<input-port> (current-input-port))
-                                   (allowbytestr #f))
-  (let* ([r (Scm_ReadLine port)])
+                                   (allowbytestr #f)
+                                   (intern #f))
+  ;; INTERN may be #t to intern every line, or a fixnum to intern
+  ;; lines up to that length.
+  (let* ([r SCM_UNDEFINED])
+    (cond [(SCM_FALSEP intern) (set! r (Scm_ReadLine port))]
+          [(SCM_TRUEP intern) (set! r (Scm_ReadLineInterned port -1))]
+          [(not (SCM_INTP intern)) (SCM_TYPE_ERROR intern "#f, #t or a fixnum")]
+          [(< (SCM_INT_VALUE intern) 0) (set! r (Scm_ReadLine port))]
+          [else (set! r (Scm_ReadLineInterned port (SCM_INT_VALUE intern)))])
     (when (and (SCM_FALSEP allowbytestr)
                (SCM_STRINGP r)
                (SCM_STRING_INCOMPLETE_P r))
@@ -665,6 +688,14 @@
         ))))
 
 (select-module gauche.internal)
+;; for diagnostics
+(define-cproc %write-stats (:optional (reset::<boolean> #f))
+  (return (Scm__WriteStats reset)))
+
+;; Text tree writer.  The leaves other than strings, symbols, characters
+;; and numbers are passed to LEAF-WRITER.  See lib/text/tree.scm.
+(define-cproc %write-tree (tree port::<output-port> leaf-writer) ::<void>
+  (Scm_WriteTree tree (SCM_OBJ port) leaf-writer))
 
 ;; srfi-38
 (define-in-module gauche (write-with-shared-structure obj :optional (port (current-output-port)))
@@ -48,13 +48,17 @@
 ;;   to make a method specialized for <class>, i.e. the most common "make".
 ;;   However, we can't say (make <method> ...) before we have a make method.
 ;;   So we have to "hard wire" the method creation.
+;;   For most user-defined classes, allocate-instance and initialize only
+;;   have the default methods; %make-instance-by-plan creates an instance
+;;   of such a class without dispatching them.  See class.c.
 
 (let ([%make (^[class . initargs]
                (rlet1 obj (allocate-instance class initargs)
                  (initialize obj initargs)))]
       [body  (^[class initargs next-method]
-               (rlet1 obj (allocate-instance class initargs)
-                 (initialize obj initargs)))])
+               (or (%make-instance-by-plan class initargs)
+                   (rlet1 obj (allocate-instance class initargs)
+                     (initialize obj initargs))))])
   (add-method! make
                (%make <method>
                       :generic make
@@ -516,6 +520,9 @@
 (define-cproc %finish-class-initialization! (klass::<class>) ::<void>
   (Scm_ClassMalleableSet klass FALSE))
 
+(define-cproc %make-instance-by-plan (klass::<class> initargs)
+  Scm__VMMakeInstanceByPlan)
+
 ;;
 ;; Record related builtins
 ;;
@@ -215,10 +215,16 @@
 (define-cproc profiler-stop  () ::<int>  Scm_ProfilerStop)
 (define-cproc profiler-reset () ::<void> Scm_ProfilerReset)
 
+(define-cproc alloc-profiler-start (:optional (interval::<long> 0)) ::<void>
+  Scm_AllocProfilerStart)
+(define-cproc alloc-profiler-stop  () ::<int>  Scm_AllocProfilerStop)
+(define-cproc alloc-profiler-reset () ::<void> Scm_AllocProfilerReset)
+
 (select-module gauche.internal)
 ;; Autoloaded profiler-get-result will use this.
 ;; See lib/gauche/vm/profiler.scm
 (define-cproc profiler-raw-result () Scm_ProfilerRawResult)
+(define-cproc alloc-profiler-raw-result () Scm_AllocProfilerRawResult)
 
 ;;;
 ;;; Introspection
@@ -65,6 +65,15 @@
 (define-cproc string-append (:rest args) Scm_StringAppend)
 
 (select-module gauche)
+;; Returns an immutable string shared among the strings of the same content.
+;; If LIMIT is given, strings longer than it are returned as they are.
+(define-cproc string-intern (str::<string> :optional (limit #f))
+  (cond [(SCM_FALSEP limit) (result (Scm_StringIntern str))]
+        [(not (SCM_INTP limit)) (SCM_TYPE_ERROR limit "#f or a fixnum")]
+        [(<= (SCM_STRING_LENGTH str) (SCM_INT_VALUE limit))
+         (result (Scm_StringIntern str))]
+        [else (result (SCM_OBJ str))]))
+
 (define-cproc string-join (strs::<list>
                            :optional (delim::<string> " ") (grammar infix))
   (let* ([gm::int 0])
@@ -353,3 +362,6 @@
 (select-module gauche.internal)
 (define-cproc %string-pointer-dump (sp::<string-pointer>) ::<void>
   Scm_StringPointerDump)
+
+;; Used by text.html-lite
+(define-cproc %string-escape-markup (str::<string>) Scm_StringEscapeMarkup)
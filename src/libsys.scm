@@ -599,10 +599,14 @@
  ;; Commn code for stat and lstat.
  (define-cise-stmt stat-common
    [(_ statfn)
+    ;; We don't let stat write directly into the heap object; see
+    ;; "Incremental collection" in core.c.
     `(let* ([s::ScmSysStat* (SCM_SYS_STAT (Scm_MakeSysStat))] [r::int]
+            [buf::(struct stat)]
             [p::(const char*) (check-trailing-separator path)])
-       (SCM_SYSCALL r (,statfn p (SCM_SYS_STAT_STAT s)))
+       (SCM_SYSCALL r (,statfn p (& buf)))
        (when (< r 0) (Scm_SysError "%s failed for %s" ,(x->string statfn) p))
+       (set! (* (SCM_SYS_STAT_STAT s)) buf)
        (result s))])
 
  ;; On Windows stat() fails if PATH has a trailing directory separator,
@@ -657,10 +661,12 @@
 (define-cproc sys-fstat (port-or-fd)
   (let* ([s::ScmSysStat* (SCM_SYS_STAT (Scm_MakeSysStat))]
          [fd::int (Scm_GetPortFd port-or-fd FALSE)]
+         [buf::(struct stat)]
          [r::int])
     (cond [(< fd 0) (result SCM_FALSE)]
-          [else (SCM_SYSCALL r (fstat fd (SCM_SYS_STAT_STAT s)))
+          [else (SCM_SYSCALL r (fstat fd (& buf)))
                 (when (< r 0) (Scm_SysError "fstat failed for %d" fd))
+                (set! (* (SCM_SYS_STAT_STAT s)) buf)
                 (result (SCM_OBJ s))])))
 
 (define-cproc file-exists? (path::<const-cstring>) ::<boolean>
@@ -47,6 +47,7 @@ int batch_mode = FALSE;         /* force batch mode */
 int interactive_mode = FALSE;   /* force interactive mode */
 int test_mode = FALSE;          /* add . and ../lib implicitly  */
 int profiling_mode = FALSE;     /* profile the script? */
+int alloc_profiling_mode = FALSE; /* profile allocations of the script? */
 int stats_mode = FALSE;         /* collect stats (EXPERIMENTAL) */
 
 ScmObj pre_cmds = SCM_NIL;      /* assoc list of commands that needs to be
@@ -208,9 +209,12 @@ void profiler_options(const char *optarg)
     else if (strcmp(optarg, "load") == 0) {
         SCM_VM_RUNTIME_FLAG_SET(vm, SCM_COLLECT_LOAD_STATS);
     }
+    else if (strcmp(optarg, "alloc") == 0) {
+        alloc_profiling_mode = TRUE;
+    }
     else {
         fprintf(stderr, "unknown -p option: %s\n", optarg);
-        fprintf(stderr, "supported profiling options are: -ptime\n");
+        fprintf(stderr, "supported profiling options are: -ptime, -pload, -palloc\n");
     }
 }
 
@@ -321,6 +325,12 @@ void cleanup_main(void *data)
                         SCM_OBJ(Scm_GaucheModule()),
                         NULL); /* ignore errors */
     }
+    if (alloc_profiling_mode) {
+        Scm_AllocProfilerStop();
+        Scm_EvalCString("(alloc-profiler-show)",
+                        SCM_OBJ(Scm_GaucheModule()),
+                        NULL); /* ignore errors */
+    }
 
     /* EXPERIMENTAL */
     if (stats_mode) {
@@ -621,11 +631,12 @@ int main(int ac, char **av)
 
     /* Set up instruments. */
     ScmLoadPacket lpak;
-    if (profiling_mode) {
+    if (profiling_mode || alloc_profiling_mode) {
         if (Scm_Require(SCM_MAKE_STR("gauche/vm/profiler"), 0, &lpak) < 0) {
             error_exit(lpak.exception);
         }
-        Scm_ProfilerStart();
+        if (profiling_mode) Scm_ProfilerStart();
+        if (alloc_profiling_mode) Scm_AllocProfilerStart(0);
     }
     Scm_AddCleanupHandler(cleanup_main, NULL);
 
@@ -40,6 +40,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
+#if defined(HAVE_SYS_UIO_H)
+#include <sys/uio.h>
+#endif
 
 #undef MAX
 #undef MIN
@@ -1079,6 +1083,156 @@ ScmObj Scm_GetOutputStringUnsafe(ScmPort *port, int flags)
     return Scm_DStringGet(&SCM_PORT(port)->src.ostr, flags);
 }
 
+/* Preallocates the buffer of output string port so that SIZE bytes
+   can be written without extending it. */
+void Scm_ReserveOutputString(ScmPort *port, int size)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_OSTR)
+        Scm_Error("output string port required, but got %S", port);
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    Scm_DStringReserve(&SCM_PORT(port)->src.ostr, size);
+    PORT_UNLOCK(port);
+}
+
+/* Returns the accumulated content as a list of immutable strings,
+   without concatenating them.  See Scm_DStringGetChunks. */
+ScmObj Scm_GetOutputStringChunks(ScmPort *port, int flags)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_OSTR)
+        Scm_Error("output string port required, but got %S", port);
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    ScmObj r = Scm_DStringGetChunks(&SCM_PORT(port)->src.ostr, flags);
+    PORT_UNLOCK(port);
+    return r;
+}
+
+/* Returns the accumulated content as an immutable u8vector.
+   If the content fits in one chunk (which is usually the case when
+   the port is created with a proper size hint), the u8vector shares
+   the storage with the port.  Otherwise the content is copied once. */
+ScmObj Scm_GetOutputU8Vector(ScmPort *port)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_OSTR)
+        Scm_Error("output string port required, but got %S", port);
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    ScmDString *ds = &SCM_PORT(port)->src.ostr;
+    int size = Scm_DStringSize(ds);
+    void *elts;
+    if (ds->anchor != NULL && ds->init.bytes == 0
+        && ds->anchor->next == NULL) {
+        elts = ds->anchor->chunk->data;
+    } else {
+        int len;
+        elts = (void*)Scm_DStringPeek(ds, &size, &len);
+        if (ds->anchor == NULL) elts = SCM_STRDUP_PARTIAL(elts, size);
+    }
+    PORT_UNLOCK(port);
+    return Scm_MakeUVectorFull(SCM_CLASS_U8VECTOR, size, elts, TRUE, NULL);
+}
+
+#if defined(HAVE_WRITEV)
+#if !defined(IOV_MAX)
+#define IOV_MAX 16
+#endif
+
+/* Write out IOV to the file port P, bypassing its buffer.
+   P must be locked. */
+static void file_writev(ScmPort *p, struct iovec *iov, int iovcnt)
+{
+    int fd = (int)(intptr_t)p->src.buf.data;
+    SCM_ASSERT(fd >= 0);
+    bufport_flush(p, 0, TRUE);
+    while (iovcnt > 0) {
+        ssize_t r;
+        errno = 0;
+        SCM_SYSCALL(r, writev(fd, iov, (iovcnt > IOV_MAX)? IOV_MAX : iovcnt));
+        if (r < 0) {
+            if (SCM_PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) Scm_Exit(1);
+            p->error = TRUE;
+            Scm_SysError("writev failed on %S", p);
+        }
+        /* skip what's written; the last one may be written partially */
+        while (iovcnt > 0 && (size_t)r >= iov->iov_len) {
+            r -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (r > 0) {
+            iov->iov_base = (char*)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+}
+#endif /*HAVE_WRITEV*/
+
+/* Writes the content of output string port SRC to the port DST chunk by
+   chunk, without concatenating them first.  If DST is a file port and
+   writev(2) is available, the chunks are passed to the kernel directly
+   after DST's buffer is flushed. */
+void Scm_WriteOutputStringChunks(ScmPort *src, ScmPort *dst)
+{
+    if (SCM_PORT_TYPE(src) != SCM_PORT_OSTR)
+        Scm_Error("output string port required, but got %S", src);
+    ScmVM *vm = Scm_VM();
+    ScmDString *ds = &src->src.ostr;
+    char ibuf[SCM_DSTRING_INIT_CHUNK_SIZE];
+    int isize, tailbytes = 0, nchunks = 1;
+    ScmDStringChain *anchor, *tail;
+
+    /* Take a snapshot of the chunk chain.  The content written so far
+       won't be altered by further output to SRC, except the initial
+       chunk which can be reused, so we copy it. */
+    PORT_LOCK(src, vm);
+    (void)Scm_DStringSize(ds);
+    anchor = ds->anchor;
+    tail = ds->tail;
+    if (anchor) {
+        isize = ds->init.bytes;
+        tailbytes = tail->chunk->bytes;
+        for (ScmDStringChain *c = anchor; c != tail; c = c->next) nchunks++;
+        nchunks++;
+    } else {
+        isize = (int)(ds->current - ds->init.data);
+    }
+    memcpy(ibuf, ds->init.data, isize);
+    PORT_UNLOCK(src);
+
+#if defined(HAVE_WRITEV)
+    if (SCM_PORT_TYPE(dst) == SCM_PORT_FILE
+        && SCM_PORT_DIR(dst) & SCM_PORT_OUTPUT
+        && dst->src.buf.flusher == file_flusher
+        && !PORT_WALKER_P(dst)) {
+        struct iovec *iov = SCM_NEW_ATOMIC_ARRAY(struct iovec, nchunks);
+        int i = 0;
+        iov[i].iov_base = ibuf;
+        iov[i++].iov_len = isize;
+        for (ScmDStringChain *c = anchor; c; c = c->next) {
+            iov[i].iov_base = c->chunk->data;
+            iov[i++].iov_len = (c == tail)? tailbytes : c->chunk->bytes;
+            if (c == tail) break;
+        }
+        PORT_LOCK(dst, vm);
+        if (SCM_PORT_CLOSED_P(dst)) {
+            PORT_UNLOCK(dst);
+            Scm_PortError(dst, SCM_PORT_ERROR_CLOSED,
+                          "I/O attempted on closed port: %S", dst);
+        }
+        PORT_SAFE_CALL(dst, file_writev(dst, iov, nchunks), /*no cleanup*/);
+        PORT_UNLOCK(dst);
+        return;
+    }
+#endif /*HAVE_WRITEV*/
+    if (isize > 0) Scm_Putz(ibuf, isize, dst);
+    for (ScmDStringChain *c = anchor; c; c = c->next) {
+        int n = (c == tail)? tailbytes : c->chunk->bytes;
+        if (n > 0) Scm_Putz(c->chunk->data, n, dst);
+        if (c == tail) break;
+    }
+}
+
 /* For backward compatibility */
 ScmObj Scm__GetOutputStringCompat(ScmPort *port)
 {
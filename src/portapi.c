@@ -784,7 +784,24 @@ int Scm_GetzUnsafe(char *buf, int buflen, ScmPort *p)
 /* NB: this routine reads bytes, not chars.  It allows to readline
    from a port in unknown character encoding (e.g. reading the first
    line of xml doc to find out charset parameter). */
-ScmObj readline_body(ScmPort *p)
+
+/* If INTERN is true, a line up to LIMIT characters (or any line if LIMIT
+   is negative) is looked up in the intern table directly from the
+   buffer, so we don't make a string only to find its interned copy. */
+static ScmObj readline_string(ScmDString *ds, int intern, ScmSmallInt limit)
+{
+    if (intern) {
+        int size, len;
+        const char *s = Scm_DStringPeek(ds, &size, &len);
+        if (len < 0) len = Scm_MBLen(s, s+size);
+        if (limit < 0 || (len < 0 ? size : len) <= limit) {
+            return Scm_MakeInternedString(s, size, len, 0);
+        }
+    }
+    return Scm_DStringGet(ds, 0);
+}
+
+ScmObj readline_body(ScmPort *p, int intern, ScmSmallInt limit)
 {
     ScmDString ds;
 
@@ -792,7 +809,7 @@ ScmObj readline_body(ScmPort *p)
     int b1 = Scm_GetbUnsafe(p);
     if (b1 == EOF) return SCM_EOF;
     for (;;) {
-        if (b1 == EOF) return Scm_DStringGet(&ds, 0);
+        if (b1 == EOF) return readline_string(&ds, intern, limit);
         if (b1 == '\n') break;
         if (b1 == '\r') {
             int b2 = Scm_GetbUnsafe(p);
@@ -804,7 +821,7 @@ ScmObj readline_body(ScmPort *p)
         b1 = Scm_GetbUnsafe(p);
     }
     p->line++;
-    return Scm_DStringGet(&ds, 0);
+    return readline_string(&ds, intern, limit);
 }
 #endif /* READLINE_AUX */
 
@@ -819,7 +836,26 @@ ScmObj Scm_ReadLineUnsafe(ScmPort *p)
     SHORTCUT(p, return Scm_ReadLineUnsafe(p));
 
     LOCK(p);
-    SAFE_CALL(p, r = readline_body(p));
+    SAFE_CALL(p, r = readline_body(p, FALSE, 0));
+    UNLOCK(p);
+    return r;
+}
+
+/* Like Scm_ReadLine, but returns an interned string (see Scm_StringIntern)
+   if the line has up to LIMIT characters.  Negative LIMIT interns every
+   line. */
+#ifdef SAFE_PORT_OP
+ScmObj Scm_ReadLineInterned(ScmPort *p, ScmSmallInt limit)
+#else
+ScmObj Scm_ReadLineInternedUnsafe(ScmPort *p, ScmSmallInt limit)
+#endif
+{
+    ScmObj r = SCM_UNDEFINED;
+    VMDECL;
+    SHORTCUT(p, return Scm_ReadLineInternedUnsafe(p, limit));
+
+    LOCK(p);
+    SAFE_CALL(p, r = readline_body(p, TRUE, limit));
     UNLOCK(p);
     return r;
 }
@@ -38,8 +38,15 @@
 #include "gauche/vminsn.h"
 #include "gauche/prof.h"
 
+/* Number of VMs running the allocation profiler.  Scm__Malloc and
+   the per-VM allocator (priv/allocP.h) check this.  Extensions don't
+   need to know it; they allocate through Scm__Malloc. */
+int Scm__AllocProfilerRunning = 0;
+
 #ifdef GAUCHE_PROFILE
 
+static ScmInternalMutex alloc_prof_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
+
 /* WARNING: duplicated code - see signal.c; we should integrate them later */
 #ifdef GAUCHE_USE_PTHREADS
 #define SIGPROCMASK pthread_sigmask
@@ -201,28 +208,190 @@ void Scm_ProfilerCountBufferFlush(ScmVM *vm)
     SIGPROCMASK(SIG_UNBLOCK, &set, NULL);
 }
 
+/*=============================================================
+ * Allocation profiler
+ */
+
+/* SCM_MALLOC and friends come here (see gauche.h).  While
+   Scm__AllocProfilerRunning > 0, the allocations are counted by
+   alloc_count.  We may be called from any thread, while only the
+   threads that started the allocation profiler take samples. */
+static void alloc_count(void *p, size_t size, int atomic);
+static void alloc_sample(ScmVM *vm, void *obj, int atomic,
+                         size_t size, size_t estimate);
+
+void *Scm__Malloc(size_t size)
+{
+    void *p = GC_MALLOC(size);
+    if (Scm__AllocProfilerRunning) alloc_count(p, size, FALSE);
+    return p;
+}
+
+void *Scm__MallocAtomic(size_t size)
+{
+    void *p = GC_MALLOC_ATOMIC(size);
+    if (Scm__AllocProfilerRunning) alloc_count(p, size, TRUE);
+    return p;
+}
+
+static void alloc_count(void *p, size_t size, int atomic)
+{
+    ScmVM *vm = Scm_VM();
+    if (vm == NULL || vm->prof == NULL) return;
+
+    ScmVMProfiler *prof = vm->prof;
+    if (prof->allocState != SCM_PROFILER_RUNNING || prof->allocFlushing) {
+        return;
+    }
+    prof->allocCountdown -= (long)size;
+    if (prof->allocCountdown > 0) return;
+
+    /* A big allocation may span more than one interval. */
+    long nintervals = 1 + (-prof->allocCountdown / prof->allocInterval);
+    prof->allocCountdown = prof->allocInterval
+        - (-prof->allocCountdown % prof->allocInterval);
+    alloc_sample(vm, p, atomic, size,
+                 (size_t)(nintervals * prof->allocInterval));
+}
+
+/* Symbols for the objects whose class we can't tell, as heap census
+   reports them.  Interned by Scm_AllocProfilerStart, since we can't
+   intern while flushing (see alloc_flush). */
+static ScmObj sym_atomic = SCM_FALSE;
+static ScmObj sym_untagged = SCM_FALSE;
+
+/* Returns the class of the sampled object, or one of the symbols
+   atomic and untagged.  By the time the buffer is flushed, the
+   allocators have returned and set up the objects, except an object
+   whose constructor makes another allocation that triggers the flush
+   before it sets the class; such an object is counted as untagged. */
+static ScmObj alloc_class(ScmProfAllocSample *s)
+{
+    if (s->atomic) return sym_atomic;
+    ScmClass *k = Scm__HeapObjectClass(s->obj, s->size);
+    return k? SCM_OBJ(k) : sym_untagged;
+}
+
+static int alloc_entry_match(ScmObj entry, ScmObj klass,
+                             ScmProfAllocSample *s)
+{
+    if (!SCM_EQ(SCM_VECTOR_ELEMENT(entry, 0), klass)) return FALSE;
+    ScmObj st = SCM_VECTOR_ELEMENT(entry, 1);
+    for (int i=0; i<SCM_PROF_ALLOC_STACK_DEPTH; i++, st = SCM_CDR(st)) {
+        if (!SCM_EQ(SCM_CAR(st), s->stack[i])) return FALSE;
+    }
+    return TRUE;
+}
+
+/* Register samples in the buffer into allocHash.  We allocate here,
+   so allocations are not sampled while we're in it.
+   NB: This can be called from within SCM_MALLOC, while the caller
+   may be holding some lock (e.g. the symbol table).  So we must not
+   call anything that may take such a lock, such as Scm_Intern. */
+static void alloc_flush(ScmVMProfiler *prof)
+{
+    prof->allocFlushing = TRUE;
+    for (int i=0; i<prof->currentAllocSample; i++) {
+        ScmProfAllocSample *s = &prof->allocSamples[i];
+        ScmObj klass = alloc_class(s);
+        ScmObj entries = Scm_HashTableRef(prof->allocHash, s->stack[0],
+                                          SCM_NIL);
+        ScmObj e = SCM_FALSE, cp;
+        SCM_FOR_EACH(cp, entries) {
+            if (alloc_entry_match(SCM_CAR(cp), klass, s)) {
+                e = SCM_CAR(cp);
+                break;
+            }
+        }
+        if (SCM_FALSEP(e)) {
+            e = Scm_MakeVector(5, SCM_MAKE_INT(0));
+            SCM_VECTOR_ELEMENT(e, 0) = klass;
+            SCM_VECTOR_ELEMENT(e, 1) =
+                Scm_ArrayToList(s->stack, SCM_PROF_ALLOC_STACK_DEPTH);
+            Scm_HashTableSet(prof->allocHash, s->stack[0],
+                             Scm_Cons(e, entries), 0);
+        }
+        SCM_VECTOR_ELEMENT(e, 2) =
+            Scm_Add(SCM_VECTOR_ELEMENT(e, 2), SCM_MAKE_INT(1));
+        SCM_VECTOR_ELEMENT(e, 3) =
+            Scm_Add(SCM_VECTOR_ELEMENT(e, 3), Scm_MakeIntegerU(s->estimate));
+        SCM_VECTOR_ELEMENT(e, 4) =
+            Scm_Add(SCM_VECTOR_ELEMENT(e, 4), Scm_MakeIntegerU(s->size));
+        /* release references */
+        for (int j=0; j<SCM_PROF_ALLOC_STACK_DEPTH; j++) {
+            s->stack[j] = SCM_FALSE;
+        }
+        s->obj = NULL;
+    }
+    prof->currentAllocSample = 0;
+    prof->allocFlushing = FALSE;
+}
+
+static void alloc_sample(ScmVM *vm, void *obj, int atomic,
+                         size_t size, size_t estimate)
+{
+    ScmVMProfiler *prof = vm->prof;
+    if (prof->currentAllocSample >= SCM_PROF_ALLOC_SAMPLES_IN_BUFFER) {
+        alloc_flush(prof);
+    }
+    ScmProfAllocSample *s = &prof->allocSamples[prof->currentAllocSample++];
+    /* Record the current code, then the ones in the continuation frames.
+       Consecutive frames of the same code (e.g. recursion) are folded. */
+    int i = 0;
+    ScmObj last = SCM_FALSE;
+    if (vm->base) {
+        s->stack[i++] = last = SCM_OBJ(vm->base);
+    }
+    for (ScmContFrame *c = vm->cont;
+         c && i < SCM_PROF_ALLOC_STACK_DEPTH;
+         c = c->prev) {
+        if (c->base == NULL || SCM_EQ(SCM_OBJ(c->base), last)) continue;
+        s->stack[i++] = last = SCM_OBJ(c->base);
+    }
+    for (; i<SCM_PROF_ALLOC_STACK_DEPTH; i++) s->stack[i] = SCM_FALSE;
+    s->obj = obj;
+    s->atomic = atomic;
+    s->estimate = estimate;
+    s->size = size;
+    prof->totalAllocSamples++;
+}
+
 /*=============================================================
  * External API
  */
+
+/* Allocates profiler buffer of VM if it hasn't been. */
+static void ensure_profiler(ScmVM *vm)
+{
+    if (vm->prof) return;
+    vm->prof = SCM_NEW(ScmVMProfiler);
+    vm->prof->state = SCM_PROFILER_INACTIVE;
+    vm->prof->samplerFd = -1;
+    vm->prof->currentSample = 0;
+    vm->prof->totalSamples = 0;
+    vm->prof->errorOccurred = 0;
+    vm->prof->currentCount = 0;
+    vm->prof->statHash =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    vm->prof->allocState = SCM_PROFILER_INACTIVE;
+    vm->prof->allocFlushing = FALSE;
+    vm->prof->allocInterval = SCM_PROF_ALLOC_INTERVAL;
+    vm->prof->allocCountdown = SCM_PROF_ALLOC_INTERVAL;
+    vm->prof->currentAllocSample = 0;
+    vm->prof->totalAllocSamples = 0;
+    vm->prof->allocHash =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+}
+
 void Scm_ProfilerStart(void)
 {
     ScmVM *vm = Scm_VM();
     char templat[] = "/tmp/gauche-profXXXXXX";
 
-    if (!vm->prof) {
-        vm->prof = SCM_NEW(ScmVMProfiler);
-        vm->prof->state = SCM_PROFILER_INACTIVE;
+    ensure_profiler(vm);
+    if (vm->prof->samplerFd < 0) {
         vm->prof->samplerFd = Scm_Mkstemp(templat);
-        vm->prof->currentSample = 0;
-        vm->prof->totalSamples = 0;
-        vm->prof->errorOccurred = 0;
-        vm->prof->currentCount = 0;
-        vm->prof->statHash =
-            SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
         unlink(templat);       /* keep anonymous tmpfile */
-    } else if (vm->prof->samplerFd < 0) {
-        vm->prof->samplerFd = Scm_Mkstemp(templat);
-        unlink(templat);
     }
 
     if (vm->prof->state == SCM_PROFILER_RUNNING) return;
@@ -313,7 +482,110 @@ ScmObj Scm_ProfilerRawResult(void)
     return SCM_OBJ(vm->prof->statHash);
 }
 
+/* Starts the allocation profiler, taking a sample every time
+   INTERVAL bytes are allocated.  If INTERVAL <= 0, the default
+   interval is used. */
+void Scm_AllocProfilerStart(long interval)
+{
+    ScmVM *vm = Scm_VM();
+
+    ensure_profiler(vm);
+    if (SCM_FALSEP(sym_atomic)) {
+        sym_untagged = SCM_INTERN("untagged");
+        sym_atomic = SCM_INTERN("atomic");
+    }
+    if (interval <= 0) interval = SCM_PROF_ALLOC_INTERVAL;
+    vm->prof->allocInterval = interval;
+    vm->prof->allocCountdown = interval;
+    if (vm->prof->allocState == SCM_PROFILER_RUNNING) return;
+    vm->prof->allocState = SCM_PROFILER_RUNNING;
+    (void)SCM_INTERNAL_MUTEX_LOCK(alloc_prof_mutex);
+    Scm__AllocProfilerRunning++;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(alloc_prof_mutex);
+}
+
+int Scm_AllocProfilerStop(void)
+{
+    ScmVM *vm = Scm_VM();
+    if (vm->prof == NULL) return 0;
+    if (vm->prof->allocState != SCM_PROFILER_RUNNING) return 0;
+    vm->prof->allocState = SCM_PROFILER_PAUSING;
+    (void)SCM_INTERNAL_MUTEX_LOCK(alloc_prof_mutex);
+    Scm__AllocProfilerRunning--;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(alloc_prof_mutex);
+    return vm->prof->totalAllocSamples;
+}
+
+void Scm_AllocProfilerReset(void)
+{
+    ScmVM *vm = Scm_VM();
+
+    if (vm->prof == NULL) return;
+    if (vm->prof->allocState == SCM_PROFILER_INACTIVE) return;
+    if (vm->prof->allocState == SCM_PROFILER_RUNNING) Scm_AllocProfilerStop();
+
+    for (int i=0; i<vm->prof->currentAllocSample; i++) {
+        for (int j=0; j<SCM_PROF_ALLOC_STACK_DEPTH; j++) {
+            vm->prof->allocSamples[i].stack[j] = SCM_FALSE;
+        }
+        vm->prof->allocSamples[i].obj = NULL;
+    }
+    vm->prof->currentAllocSample = 0;
+    vm->prof->totalAllocSamples = 0;
+    vm->prof->allocHash =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    vm->prof->allocState = SCM_PROFILER_INACTIVE;
+}
+
+/* Returns the collected allocation samples as a list of
+   (<stack> <class> <count> <estimate> <bytes>), where <stack> is
+   a list of functions, innermost first, <class> is the class of the
+   allocated objects, or one of the symbols atomic and untagged if we
+   can't tell it (see Scm__HeapObjectClass), <count> is the number of samples,
+   <estimate> is the estimated number of bytes allocated, and <bytes> is
+   the total size of the sampled allocations.  Unlike Scm_ProfilerRawResult,
+   this doesn't stop the profiler, so that a long-running process can
+   examine the result periodically. */
+ScmObj Scm_AllocProfilerRawResult(void)
+{
+    ScmVM *vm = Scm_VM();
+
+    if (vm->prof == NULL) return SCM_FALSE;
+    if (vm->prof->allocState == SCM_PROFILER_INACTIVE) return SCM_FALSE;
+
+    alloc_flush(vm->prof);
+
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    vm->prof->allocFlushing = TRUE;
+    Scm_HashIterInit(&iter, SCM_HASH_TABLE_CORE(vm->prof->allocHash));
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        ScmObj cp;
+        SCM_FOR_EACH(cp, SCM_DICT_VALUE(e)) {
+            ScmObj v = SCM_CAR(cp);
+            SCM_APPEND1(h, t, SCM_LIST5(SCM_VECTOR_ELEMENT(v, 1),
+                                        SCM_VECTOR_ELEMENT(v, 0),
+                                        SCM_VECTOR_ELEMENT(v, 2),
+                                        SCM_VECTOR_ELEMENT(v, 3),
+                                        SCM_VECTOR_ELEMENT(v, 4)));
+        }
+    }
+    vm->prof->allocFlushing = FALSE;
+    return h;
+}
+
 #else  /* !GAUCHE_PROFILE */
+void *Scm__Malloc(size_t size)
+{
+    return GC_MALLOC(size);
+}
+
+void *Scm__MallocAtomic(size_t size)
+{
+    return GC_MALLOC_ATOMIC(size);
+}
+
 void Scm_ProfilerStart(void)
 {
     Scm_Error("profiler is not supported.");
@@ -335,4 +607,26 @@ ScmObj Scm_ProfilerRawResult(void)
     Scm_Error("profiler is not supported.");
     return SCM_FALSE;
 }
+
+void Scm_AllocProfilerStart(long interval)
+{
+    Scm_Error("profiler is not supported.");
+}
+
+int Scm_AllocProfilerStop(void)
+{
+    Scm_Error("profiler is not supported.");
+    return 0;
+}
+
+void Scm_AllocProfilerReset(void)
+{
+    Scm_Error("profiler is not supported.");
+}
+
+ScmObj Scm_AllocProfilerRawResult(void)
+{
+    Scm_Error("profiler is not supported.");
+    return SCM_FALSE;
+}
 #endif /* !GAUCHE_PROFILE */
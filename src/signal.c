@@ -738,6 +738,20 @@ sigset_t Scm_GetMasterSigmask(void)
 {
     struct sigdesc *desc = sigDesc;
     struct sigaction acton, actoff;
+    sigset_t master;
+
+    /* Incremental GC catches SIGSEGV (or SIGBUS) to track writes to the
+       heap.  We shouldn't take them, since we may block the master
+       signals, e.g. in Scm_SigCheck(), and a fault while blocking
+       one of them kills the process. */
+    if (Scm_GCIncrementalP()) {
+        master = *set;
+        sigdelset(&master, SIGSEGV);
+#ifdef SIGBUS
+        sigdelset(&master, SIGBUS);
+#endif
+        set = &master;
+    }
 
     acton.sa_handler = (void(*)(int))sig_handle;
     acton.sa_mask = *set;
@@ -830,7 +844,7 @@ void Scm_SetSigmask(sigset_t *mask)
 ScmObj Scm_SysSigmask(int how, ScmSysSigset *newmask)
 {
     ScmSysSigset *oldmask = make_sigset();
-    sigset_t *newset = NULL;
+    sigset_t *newset = NULL, oldset;
 
     if (newmask) {
         newset = &(newmask->set);
@@ -838,9 +852,12 @@ ScmObj Scm_SysSigmask(int how, ScmSysSigset *newmask)
             Scm_Error("bad 'how' argument for signal mask action: %d", how);
         }
     }
-    if (SIGPROCMASK(how, newset, &(oldmask->set)) != 0) {
+    /* We don't let the kernel write into the heap object; see
+       "Incremental collection" in core.c. */
+    if (SIGPROCMASK(how, newset, &oldset) != 0) {
         Scm_SysError("sigprocmask failed");
     }
+    oldmask->set = oldset;
     return SCM_OBJ(oldmask);
 }
 
@@ -1229,6 +1229,161 @@ ScmObj Scm_StringSplitByChar(ScmString *str, ScmChar ch)
     return Scm_StringSplitByCharWithLimit(str, ch, -1);
 }
 
+/*----------------------------------------------------------------
+ * Interning
+ */
+
+/* A process-wide table of immutable strings, to share one body among
+ * strings of the same content.  It is useful when a program reads lots
+ * of short, repeating strings (e.g. CSV column values or JSON object
+ * keys) and keeps them.
+ *
+ * Each entry refers to the interned string through a weak box, so the
+ * table doesn't keep strings alive.  Entries whose string has been
+ * collected are unlinked lazily, when we walk the chain or grow the
+ * table.  We don't use ScmWeakHashTable, since it lacks the latter and
+ * we need to look up by raw content without making a string first.
+ */
+
+typedef struct intern_entry_rec {
+    struct intern_entry_rec *next;
+    u_long hashval;
+    ScmWeakBox *box;            /* to ScmString */
+} intern_entry;
+
+static struct {
+    intern_entry **buckets;
+    u_long numBuckets;          /* power of 2 */
+    u_long numEntries;
+    ScmInternalMutex mutex;
+} intern_table = { NULL, 0, 0, SCM_INTERNAL_MUTEX_INITIALIZER };
+
+#define INTERN_INITIAL_BUCKETS  256
+#define INTERN_MAX_CHAIN        2  /* grow if entries > buckets * this */
+
+static u_long intern_hash(const char *p, ScmSmallInt size)
+{
+    /* Same as STRING_HASH in hash.c */
+    u_long hv = 0;
+    while (size-- > 0) {
+        hv = (hv<<5) - hv + (unsigned char)*p++;
+    }
+    return hv;
+}
+
+static void intern_grow(void)
+{
+    u_long newsize = intern_table.numBuckets * 2;
+    intern_entry **newb = SCM_NEW_ARRAY(intern_entry*, newsize);
+    u_long live = 0;
+
+    for (u_long i=0; i<newsize; i++) newb[i] = NULL;
+    for (u_long i=0; i<intern_table.numBuckets; i++) {
+        intern_entry *e = intern_table.buckets[i], *next;
+        for (; e; e = next) {
+            next = e->next;
+            (void)Scm_WeakBoxRef(e->box);
+            if (Scm_WeakBoxEmptyP(e->box)) continue; /* drop dead entry */
+            u_long k = e->hashval & (newsize-1);
+            e->next = newb[k];
+            newb[k] = e;
+            live++;
+        }
+    }
+    intern_table.buckets = newb;
+    intern_table.numBuckets = newsize;
+    intern_table.numEntries = live;
+}
+
+/* Returns the interned string whose content is given by STR, SIZE, LEN
+   and the SCM_STRING_INCOMPLETE bit of FLAGS.  If there's none, a new
+   immutable string is created and registered.  It always gets its own
+   copy of the content, for the source may be a part of a larger buffer
+   (e.g. a substring) we don't want to retain. */
+static ScmObj intern_content(const char *str, ScmSmallInt size,
+                             ScmSmallInt len, int flags)
+{
+    int incomplete = (flags & SCM_STRING_INCOMPLETE);
+    u_long hv = intern_hash(str, size);
+    ScmObj r = SCM_FALSE;
+
+    SCM_INTERNAL_MUTEX_LOCK(intern_table.mutex);
+    if (intern_table.buckets == NULL) {
+        intern_table.numBuckets = INTERN_INITIAL_BUCKETS;
+        intern_table.buckets = SCM_NEW_ARRAY(intern_entry*,
+                                             INTERN_INITIAL_BUCKETS);
+        for (u_long i=0; i<INTERN_INITIAL_BUCKETS; i++) {
+            intern_table.buckets[i] = NULL;
+        }
+    }
+    intern_entry **loc = &intern_table.buckets[hv & (intern_table.numBuckets-1)];
+    while (*loc) {
+        intern_entry *e = *loc;
+        /* NB: Call Ref first and keep the result; see weak.c */
+        ScmString *s = (ScmString*)Scm_WeakBoxRef(e->box);
+        if (Scm_WeakBoxEmptyP(e->box)) {
+            *loc = e->next;     /* unlink dead entry */
+            intern_table.numEntries--;
+            continue;
+        }
+        if (e->hashval == hv) {
+            const ScmStringBody *b = SCM_STRING_BODY(s);
+            if (SCM_STRING_BODY_SIZE(b) == size
+                && !SCM_STRING_BODY_INCOMPLETE_P(b) == !incomplete
+                && memcmp(SCM_STRING_BODY_START(b), str, size) == 0) {
+                r = SCM_OBJ(s);
+                break;
+            }
+        }
+        loc = &e->next;
+    }
+    if (SCM_FALSEP(r)) {
+        r = Scm_MakeString(str, size, len,
+                           SCM_STRING_IMMUTABLE|SCM_STRING_COPYING|incomplete);
+        intern_entry *e = SCM_NEW(intern_entry);
+        e->hashval = hv;
+        e->box = Scm_MakeWeakBox(r);
+        e->next = intern_table.buckets[hv & (intern_table.numBuckets-1)];
+        intern_table.buckets[hv & (intern_table.numBuckets-1)] = e;
+        if (++intern_table.numEntries
+            > intern_table.numBuckets * INTERN_MAX_CHAIN) {
+            intern_grow();
+        }
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(intern_table.mutex);
+    return r;
+}
+
+/* Returns an immutable string of the same content as STR, which is
+   shared by all strings interned with the same content. */
+ScmObj Scm_StringIntern(ScmString *str)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    return intern_content(SCM_STRING_BODY_START(b),
+                          SCM_STRING_BODY_SIZE(b),
+                          SCM_STRING_BODY_LENGTH(b),
+                          SCM_STRING_BODY_FLAGS(b));
+}
+
+/* Same as Scm_StringIntern(Scm_MakeString(str, size, len, flags)),
+   but avoids allocating a string if it's already interned. */
+ScmObj Scm_MakeInternedString(const char *str, ScmSmallInt size,
+                              ScmSmallInt len, int flags)
+{
+    if (size < 0) {
+        count_size_and_length(str, &size, &len);
+    } else if (len < 0) {
+        len = count_length(str, size);
+    }
+    if (len < 0) flags |= SCM_STRING_INCOMPLETE;
+    return intern_content(str, size, len, flags);
+}
+
+void Scm__InitString(void)
+{
+    SCM_INTERNAL_MUTEX_INIT(intern_table.mutex);
+}
+
 /*----------------------------------------------------------------
  * Miscellaneous functions
  */
@@ -1251,6 +1406,83 @@ ScmObj Scm_StringToList(ScmString *str)
     return start;
 }
 
+/* Escapes characters special to HTML and XML, i.e. '&', '<', '>' and '"',
+   as character entities.  If STR contains none of them, a copy of STR
+   is returned, sharing the content.  These characters are ASCII and never appear in a multibyte
+   sequence of the supported encodings, so we scan bytes, a word at a time.
+ */
+#define MARKUP_ONES   (~(u_long)0/0xff)
+#define MARKUP_HIGHS  (MARKUP_ONES*0x80)
+#define MARKUP_HAS_BYTE(w, b) \
+    ((((w)^(MARKUP_ONES*(b))) - MARKUP_ONES) & ~((w)^(MARKUP_ONES*(b))) & MARKUP_HIGHS)
+
+static inline int markup_special_p(unsigned char c)
+{
+    return (c == '&' || c == '<' || c == '>' || c == '"');
+}
+
+/* Returns the pointer to the first special byte in [p, e), or e. */
+static const char *markup_scan(const char *p, const char *e)
+{
+    while (e - p >= (ptrdiff_t)sizeof(u_long)) {
+        u_long w;
+        memcpy(&w, p, sizeof(u_long));
+        if (MARKUP_HAS_BYTE(w, '&') || MARKUP_HAS_BYTE(w, '<')
+            || MARKUP_HAS_BYTE(w, '>') || MARKUP_HAS_BYTE(w, '"')) break;
+        p += sizeof(u_long);
+    }
+    for (; p < e; p++) {
+        if (markup_special_p((unsigned char)*p)) break;
+    }
+    return p;
+}
+
+ScmObj Scm_StringEscapeMarkup(ScmString *str)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    const char *s = SCM_STRING_BODY_START(b);
+    const char *e = s + SCM_STRING_BODY_SIZE(b);
+    const char *p = markup_scan(s, e);
+
+    if (p == e) return Scm_CopyString(str);
+
+    /* Count the extra bytes to allocate the result at once. */
+    ScmSmallInt extra = 0;
+    for (const char *q = p; q < e; q = markup_scan(q+1, e)) {
+        switch (*q) {
+        case '&': extra += 4; break; /* &amp; */
+        case '<':                    /* &lt; */
+        case '>': extra += 3; break; /* &gt; */
+        default:  extra += 5; break; /* &quot; */
+        }
+    }
+
+    ScmSmallInt size = SCM_STRING_BODY_SIZE(b) + extra;
+    char *buf = SCM_NEW_ATOMIC2(char *, size+1);
+    char *d = buf;
+    memcpy(d, s, p - s);
+    d += p - s;
+    while (p < e) {
+        switch (*p) {
+        case '&': memcpy(d, "&amp;", 5);  d += 5; break;
+        case '<': memcpy(d, "&lt;", 4);   d += 4; break;
+        case '>': memcpy(d, "&gt;", 4);   d += 4; break;
+        default:  memcpy(d, "&quot;", 6); d += 6; break;
+        }
+        const char *q = markup_scan(p+1, e);
+        memcpy(d, p+1, q - (p+1));
+        d += q - (p+1);
+        p = q;
+    }
+    *d = '\0';
+
+    if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
+        return Scm_MakeString(buf, size, size, SCM_STRING_INCOMPLETE);
+    } else {
+        return Scm_MakeString(buf, size, SCM_STRING_BODY_LENGTH(b) + extra, 0);
+    }
+}
+
 /* Convert cstring array to a list of Scheme strings.  Cstring array
    can be NULL terminated (in case size < 0) or its size is explicitly
    specified (size >= 0).  FLAGS is passed to Scm_MakeString. */
@@ -1646,6 +1878,17 @@ void Scm__DStringRealloc(ScmDString *dstr, int minincr)
     dstr->lastChunkSize = newsize;
 }
 
+/* Makes sure that at least SIZE more bytes can be added to DSTR
+   without allocating another chunk.  If the caller knows the approximate
+   size of the final content, calling this beforehand saves a bunch of
+   small chunks. */
+void Scm_DStringReserve(ScmDString *dstr, int size)
+{
+    if (size > 0 && dstr->current + size > dstr->end) {
+        Scm__DStringRealloc(dstr, size);
+    }
+}
+
 /* Retrieve accumulated string. */
 static const char *dstring_getz(ScmDString *dstr, int *psiz, int *plen, int noalloc)
 {
@@ -1717,6 +1960,41 @@ const char *Scm_DStringPeek(ScmDString *dstr, int *size, int *len)
     return dstring_getz(dstr, size, len, TRUE);
 }
 
+/* Returns the current content of DString as a list of immutable strings,
+   each of which shares the storage of the DString's chunk; that is, the
+   content isn't concatenated.  The initial chunk is embedded in DString
+   itself and may be reused, so only its content is copied.
+   A chunk boundary may split a multibyte character, in which case
+   the strings on both sides become incomplete. */
+ScmObj Scm_DStringGetChunks(ScmDString *dstr, int flags)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int isize;
+
+    flags |= SCM_STRING_IMMUTABLE;
+    (void)Scm_DStringSize(dstr); /* updates the byte count of the tail */
+    if (dstr->anchor == NULL) {
+        isize = (int)(dstr->current - dstr->init.data);
+        if (isize > 0) {
+            SCM_APPEND1(h, t, Scm_MakeString(dstr->init.data, isize,
+                                             dstr->length,
+                                             flags|SCM_STRING_COPYING));
+        }
+        return h;
+    }
+    isize = dstr->init.bytes;
+    if (isize > 0) {
+        SCM_APPEND1(h, t, Scm_MakeString(dstr->init.data, isize, -1,
+                                         flags|SCM_STRING_COPYING));
+    }
+    for (ScmDStringChain *chain = dstr->anchor; chain; chain = chain->next) {
+        if (chain->chunk->bytes == 0) continue;
+        SCM_APPEND1(h, t, Scm_MakeString(chain->chunk->data,
+                                         chain->chunk->bytes, -1, flags));
+    }
+    return h;
+}
+
 void Scm_DStringPutz(ScmDString *dstr, const char *str, int size)
 {
     if (size < 0) size = (int)strlen(str);
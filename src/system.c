@@ -2108,17 +2108,24 @@ static ScmObj select_int(ScmSysFdset *rfds, ScmSysFdset *wfds,
 {
     int numfds, maxfds = 0;
     struct timeval tm;
-    if (rfds) maxfds = rfds->maxfd;
-    if (wfds && wfds->maxfd > maxfds) maxfds = wfds->maxfd;
-    if (efds && efds->maxfd > maxfds) maxfds = efds->maxfd;
+    /* select() writes back to the fd_sets.  They're in heap objects,
+       which may be write-protected by incremental GC and the system call
+       would fail with EFAULT.  So we pass copies on the stack. */
+    fd_set r, w, e;
+    if (rfds) { maxfds = rfds->maxfd; r = rfds->fdset; }
+    if (wfds) { if (wfds->maxfd > maxfds) maxfds = wfds->maxfd; w = wfds->fdset; }
+    if (efds) { if (efds->maxfd > maxfds) maxfds = efds->maxfd; e = efds->fdset; }
 
     SCM_SYSCALL(numfds,
                 select(maxfds+1,
-                       (rfds? &rfds->fdset : NULL),
-                       (wfds? &wfds->fdset : NULL),
-                       (efds? &efds->fdset : NULL),
+                       (rfds? &r : NULL),
+                       (wfds? &w : NULL),
+                       (efds? &e : NULL),
                        select_timeval(timeout, &tm)));
     if (numfds < 0) Scm_SysError("select failed");
+    if (rfds) rfds->fdset = r;
+    if (wfds) wfds->fdset = w;
+    if (efds) efds->fdset = e;
     return Scm_Values4(Scm_MakeInteger(numfds),
                        (rfds? SCM_OBJ(rfds) : SCM_FALSE),
                        (wfds? SCM_OBJ(wfds) : SCM_FALSE),
@@ -36,6 +36,7 @@
 #include "gauche/class.h"
 #include "gauche/exception.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gauche/priv/allocP.h"
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/prof.h"
@@ -108,6 +109,13 @@ static ScmWord boundaryFrameMark = SCM_VM_INSN(SCM_VM_NOP);
 /* return true if cont is a boundary continuation frame */
 #define BOUNDARY_FRAME_P(cont) ((cont)->pc == &boundaryFrameMark)
 
+/* State of ScmCStack.  See "C stack rewinding" below. */
+enum {
+    CSTACK_ARMED = 0,           /* jbuf is valid */
+    CSTACK_LAZY,                /* jbuf is not set */
+    CSTACK_ARM_REQUESTED        /* jbuf is not set, but needs to be */
+};
+
 /* A stub VM code to make VM return immediately */
 static ScmWord return_code[] = { SCM_VM_INSN(SCM_VM_RET) };
 #define PC_TO_RETURN  return_code
@@ -260,6 +268,8 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
 
     v->exceptionHandler = DEFAULT_EXCEPTION_HANDLER;
     v->escapePoint = v->escapePointFloating = NULL;
+    v->escapePointPool = NULL;
+    v->escapePointPoolSize = 0;
     v->escapeReason = SCM_VM_ESCAPE_NONE;
     v->escapeData[0] = NULL;
     v->escapeData[1] = NULL;
@@ -872,6 +882,13 @@ static void run_loop()
 #endif
         }
       process_queue:
+        /* The innermost C frame wants to set its jbuf; see
+           user_eval_inner.  VM registers are kept in vm, so we
+           can return and be called again to resume. */
+        if (vm->cstack && vm->cstack->lazy == CSTACK_ARM_REQUESTED) {
+            vm->cstack->lazy = CSTACK_ARMED;
+            return;
+        }
         CHECK_STACK(CONT_FRAME_SIZE);
         PUSH_CONT(PC);
         process_queued_requests(vm);
@@ -935,7 +952,7 @@ static inline ScmEnvFrame *save_env(ScmVM *vm, ScmEnvFrame *env_begin)
             return head;
         }
 
-        ScmObj *d = SCM_NEW2(ScmObj*, ENV_SIZE(esize) * sizeof(ScmObj));
+        ScmObj *d = SCM_VM_NEW2(vm, ScmObj*, ENV_SIZE(esize) * sizeof(ScmObj));
         ScmObj *s = (ScmObj*)e - esize;
         for (long i=esize; i>0; i--) {
             SCM_FLONUM_ENSURE_MEM(*s);
@@ -972,7 +989,7 @@ static void save_cont(ScmVM *vm)
     /* First pass */
     do {
         int size = (CONT_FRAME_SIZE + c->size) * sizeof(ScmObj);
-        ScmObj *heap = SCM_NEW2(ScmObj*, size);
+        ScmObj *heap = SCM_VM_NEW2(vm, ScmObj*, size);
         ScmContFrame *csave = (ScmContFrame*)(heap + c->size);
 
         /* update env ptr if necessary */
@@ -1414,8 +1431,41 @@ void Scm_VMPushCC(ScmCContinuationProc *after,
  *
  *   At the implementation level, this boundary is kept in a
  *   structure ScmCStack.
+ *
+ *   Setting up the jbuf for every boundary is a considerable part of
+ *   the cost when C calls back Scheme in a tight loop, e.g. a sort
+ *   with a Scheme comparator.  The jbuf is only needed if a Scheme
+ *   continuation captured within this boundary, or an error handler
+ *   installed within it, is invoked from a deeper C frame.  Both
+ *   require an escape point whose cstack is this boundary.  So the
+ *   Scm_ApplyRec family enters the VM with a 'lazy' cstack, which has
+ *   no jbuf; when an escape point is created on it, the VM loop returns
+ *   to user_eval_inner at the next instruction boundary, and we set
+ *   the jbuf there before resuming.  Nothing can call back into C
+ *   between the two, so nobody can jump to the lazy cstack.
+ *   Other escapes just pass over lazy cstacks to the nearest one with
+ *   a jbuf (jump_cstack); a lazy boundary has nothing to clean up.
+ *
+ *   The outermost boundary is always armed, so there's always
+ *   somewhere to jump.
  */
 
+/* Called when an escape point is created on vm->cstack. */
+static inline void arm_cstack(ScmVM *vm)
+{
+    if (vm->cstack && vm->cstack->lazy == CSTACK_LAZY) {
+        vm->cstack->lazy = CSTACK_ARM_REQUESTED;
+        vm->attentionRequest = TRUE;
+    }
+}
+
+/* Jump to the innermost C stack that has a valid jbuf. */
+static void jump_cstack(ScmVM *vm)
+{
+    while (vm->cstack->lazy) vm->cstack = vm->cstack->prev;
+    siglongjmp(vm->cstack->jbuf, 1);
+}
+
 /* Border gate.  All the C->Scheme calls should go through here.
  *
  *   The current C stack information is saved in cstack.  The
@@ -1423,7 +1473,7 @@ void Scm_VMPushCC(ScmCContinuationProc *after,
  *   frame pointer) in cstack.cont.
  */
 
-static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
+static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec, int lazy)
 {
     ScmCStack cstack;
     ScmVM * volatile vm = theVM;
@@ -1450,12 +1500,20 @@ static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
 
     cstack.prev = vm->cstack;
     cstack.cont = vm->cont;
+    cstack.lazy = (lazy && vm->cstack)? CSTACK_LAZY : CSTACK_ARMED;
     vm->cstack = &cstack;
 
   restart:
     vm->escapeReason = SCM_VM_ESCAPE_NONE;
+    if (cstack.lazy) {
+        run_loop();
+        /* run_loop marks us armed when it returns to have jbuf set */
+        if (cstack.lazy == CSTACK_ARMED) goto restart;
+        goto done;
+    }
     if (sigsetjmp(cstack.jbuf, FALSE) == 0) {
         run_loop();             /* VM loop */
+      done:
         if (vm->cont == cstack.cont) {
             POP_CONT();
             PC = prev_pc;
@@ -1485,7 +1543,7 @@ static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
                 vm->cont = cstack.cont;
                 POP_CONT();
                 vm->cstack = vm->cstack->prev;
-                siglongjmp(vm->cstack->jbuf, 1);
+                jump_cstack(vm);
             }
         } else if (vm->escapeReason == SCM_VM_ESCAPE_ERROR) {
             ScmEscapePoint *ep = (ScmEscapePoint*)vm->escapeData[0];
@@ -1506,7 +1564,7 @@ static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
                 vm->cont = cstack.cont;
                 POP_CONT();
                 vm->cstack = vm->cstack->prev;
-                siglongjmp(vm->cstack->jbuf, 1);
+                jump_cstack(vm);
             }
         } else {
             Scm_Panic("invalid longjmp");
@@ -1529,7 +1587,7 @@ ScmObj Scm_EvalRec(ScmObj expr, ScmObj e)
     if (SCM_VM_COMPILER_FLAG_IS_SET(theVM, SCM_COMPILE_SHOWRESULT)) {
         Scm_CompiledCodeDump(SCM_COMPILED_CODE(v));
     }
-    return user_eval_inner(v, NULL);
+    return user_eval_inner(v, NULL, FALSE);
 }
 
 /* NB: The ApplyRec family can be called in an inner loop (e.g. the display
@@ -1547,7 +1605,7 @@ static ScmObj apply_rec(ScmVM *vm, ScmObj proc, int nargs)
     vm->val0 = proc;
     ScmObj program = vm->base?
             SCM_OBJ(vm->base) : SCM_OBJ(&internal_apply_compiled_code);
-    return user_eval_inner(program, code);
+    return user_eval_inner(program, code, TRUE);
 }
 
 ScmObj Scm_ApplyRec(ScmObj proc, ScmObj args)
@@ -1784,32 +1842,48 @@ static ScmCContinuationProc dynwind_before_cc;
 static ScmCContinuationProc dynwind_body_cc;
 static ScmCContinuationProc dynwind_after_cc;
 
-ScmObj Scm_VMDynamicWind(ScmObj before, ScmObj body, ScmObj after)
+/* If LINK is a pair, its car must be (BEFORE . AFTER), and it is
+   used as the entry of vm->handlers instead of allocating a new one.
+   Its cdr is overwritten. */
+static ScmObj dynamic_wind(ScmObj before, ScmObj body, ScmObj after,
+                           ScmObj link)
 {
-    void *data[3];
+    void *data[4];
 
     /* NB: we don't check types of arguments, since we allow object-apply
        hooks can be used for them. */
     data[0] = (void*)before;
     data[1] = (void*)body;
     data[2] = (void*)after;
+    data[3] = (void*)link;
 
-    Scm_VMPushCC(dynwind_before_cc, data, 3);
+    Scm_VMPushCC(dynwind_before_cc, data, 4);
     return Scm_VMApply0(before);
 }
 
+ScmObj Scm_VMDynamicWind(ScmObj before, ScmObj body, ScmObj after)
+{
+    return dynamic_wind(before, body, after, SCM_FALSE);
+}
+
 static ScmObj dynwind_before_cc(ScmObj result, void **data)
 {
     ScmObj before  = SCM_OBJ(data[0]);
     ScmObj body = SCM_OBJ(data[1]);
     ScmObj after = SCM_OBJ(data[2]);
+    ScmObj link = SCM_OBJ(data[3]);
     void *d[2];
     ScmVM *vm = theVM;
     ScmObj prev = vm->handlers;
 
     d[0] = (void*)after;
     d[1] = (void*)prev;
-    vm->handlers = Scm_Cons(Scm_Cons(before, after), prev);
+    if (SCM_PAIRP(link)) {
+        SCM_SET_CDR(link, prev);
+        vm->handlers = link;
+    } else {
+        vm->handlers = Scm_Cons(Scm_Cons(before, after), prev);
+    }
     Scm_VMPushCC(dynwind_body_cc, d, 2);
     return Scm_VMApply0(body);
 }
@@ -1968,6 +2042,9 @@ void Scm_VMDefaultExceptionHandler(ScmObj e)
         ScmObj result = SCM_FALSE, rvals[SCM_VM_MAX_VALUES];
         int numVals = 0;
 
+        /* We'll use ep after its dynamic handlers are rewound. */
+        ep->reusable = FALSE;
+
         /* To conform SRFI-34, the error handler (clauses in 'guard' form)
            should be executed with the same continuation and dynamic
            environment of the guard form itself.  That means the dynamic
@@ -2048,7 +2125,7 @@ void Scm_VMDefaultExceptionHandler(ScmObj e)
         vm->escapeReason = SCM_VM_ESCAPE_ERROR;
         vm->escapeData[0] = ep;
         vm->escapeData[1] = e;
-        siglongjmp(vm->cstack->jbuf, 1);
+        jump_cstack(vm);
     } else {
         exit(EX_SOFTWARE);
     }
@@ -2113,7 +2190,36 @@ ScmObj Scm_VMThrowException(ScmVM *vm, ScmObj exception)
 
 /*
  * with-error-handler
+ *
+ *   Parsers and such tend to wrap small pieces of work in guard, so
+ *   entering and leaving with-error-handler should be cheap when nothing
+ *   is raised.  An escape point is allocated together with its
+ *   install/discard procedures and the entry of vm->handlers (EHandler),
+ *   and recycled through vm->escapePointPool once with-error-handler
+ *   returns.  It is not recycled if anything else may still refer to it,
+ *   i.e. if it has handled an error (Scm_VMDefaultExceptionHandler), or
+ *   a continuation is captured while it is active (mark_escape_points).
  */
+
+typedef struct EHandlerRec {
+    ScmEscapePoint ep;          /* must be the first member */
+    ScmObj link;                /* ((install . discard) . prev-handlers) */
+} EHandler;
+
+#define EHANDLER_POOL_MAX  32
+
+/* Called when the escape points may be referenced from a captured
+   continuation. */
+static void mark_escape_points(ScmVM *vm)
+{
+    for (ScmEscapePoint *ep = vm->escapePoint; ep; ep = ep->prev) {
+        ep->reusable = FALSE;
+    }
+    for (ScmEscapePoint *ep = SCM_VM_FLOATING_EP(vm); ep; ep = ep->floating) {
+        ep->reusable = FALSE;
+    }
+}
+
 static ScmObj install_ehandler(ScmObj *args, int nargs, void *data)
 {
     ScmEscapePoint *ep = (ScmEscapePoint*)data;
@@ -2133,13 +2239,41 @@ static ScmObj discard_ehandler(ScmObj *args, int nargs, void *data)
     if (ep->errorReporting) {
         SCM_VM_RUNTIME_FLAG_SET(vm, SCM_ERROR_BEING_REPORTED);
     }
+    if (ep->reusable && vm->escapePointPoolSize < EHANDLER_POOL_MAX) {
+        ep->reusable = FALSE;
+        ep->floating = NULL;
+        ep->ehandler = ep->xhandler = SCM_FALSE;
+        ep->handlers = SCM_NIL;
+        ep->cont = NULL;
+        ep->cstack = NULL;
+        SCM_SET_CDR(((EHandler*)ep)->link, SCM_NIL);
+        ep->prev = vm->escapePointPool;
+        vm->escapePointPool = ep;
+        vm->escapePointPoolSize++;
+    }
     return SCM_UNDEFINED;
 }
 
+static EHandler *alloc_ehandler(ScmVM *vm)
+{
+    if (vm->escapePointPool) {
+        ScmEscapePoint *ep = vm->escapePointPool;
+        vm->escapePointPool = ep->prev;
+        vm->escapePointPoolSize--;
+        return (EHandler*)ep;
+    }
+    EHandler *eh = SCM_NEW(EHandler);
+    ScmObj before = Scm_MakeSubr(install_ehandler, eh, 0, 0, SCM_FALSE);
+    ScmObj after  = Scm_MakeSubr(discard_ehandler, eh, 0, 0, SCM_FALSE);
+    eh->link = Scm_Cons(Scm_Cons(before, after), SCM_NIL);
+    return eh;
+}
+
 static ScmObj with_error_handler(ScmVM *vm, ScmObj handler,
                                  ScmObj thunk, int rewindBefore)
 {
-    ScmEscapePoint *ep = SCM_NEW(ScmEscapePoint);
+    EHandler *eh = alloc_ehandler(vm);
+    ScmEscapePoint *ep = &eh->ep;
 
     /* NB: we can save pointer to the stack area (vm->cont) to ep->cont,
      * since such ep is always accessible via vm->escapePoint chain and
@@ -2151,18 +2285,19 @@ static ScmObj with_error_handler(ScmVM *vm, ScmObj handler,
     ep->ehandler = handler;
     ep->handlers = vm->handlers;
     ep->cstack = vm->cstack;
+    arm_cstack(vm);
     ep->xhandler = vm->exceptionHandler;
     ep->cont = vm->cont;
     ep->errorReporting =
         SCM_VM_RUNTIME_FLAG_IS_SET(vm, SCM_ERROR_BEING_REPORTED);
     ep->rewindBefore = rewindBefore;
+    ep->reusable = TRUE;
 
     vm->escapePoint = ep; /* This will be done in install_ehandler, but
                              make sure ep is visible from save_cont
                              to redirect ep->cont */
-    ScmObj before = Scm_MakeSubr(install_ehandler, ep, 0, 0, SCM_FALSE);
-    ScmObj after  = Scm_MakeSubr(discard_ehandler, ep, 0, 0, SCM_FALSE);
-    return Scm_VMDynamicWind(before, thunk, after);
+    return dynamic_wind(SCM_CAAR(eh->link), thunk, SCM_CDAR(eh->link),
+                        eh->link);
 }
 
 ScmObj Scm_VMWithErrorHandler(ScmObj handler, ScmObj thunk)
@@ -2322,7 +2457,7 @@ static ScmObj throw_continuation(ScmObj *argframe, int nargs, void *data)
             vm->escapeReason = SCM_VM_ESCAPE_CONT;
             vm->escapeData[0] = ep;
             vm->escapeData[1] = args;
-            siglongjmp(vm->cstack->jbuf, 1);
+            jump_cstack(vm);
         }
         /* If we're here, the continuation is 'ghost'---it was captured on
            a C stack that no longer exists, or that was in another thread.
@@ -2350,12 +2485,14 @@ ScmObj Scm_VMCallCC(ScmObj proc)
     ScmVM *vm = theVM;
 
     save_cont(vm);
+    mark_escape_points(vm);
     ScmEscapePoint *ep = SCM_NEW(ScmEscapePoint);
     ep->prev = NULL;
     ep->ehandler = SCM_FALSE;
     ep->cont = vm->cont;
     ep->handlers = vm->handlers;
     ep->cstack = vm->cstack;
+    arm_cstack(vm);
 
     ScmObj contproc = Scm_MakeSubr(throw_continuation, ep, 0, 1,
                                    SCM_MAKE_STR("continuation"));
@@ -2375,6 +2512,7 @@ ScmObj Scm_VMCallPC(ScmObj proc)
        we save everything to make things easier.  If we want to squeeze
        performance we'll optimize it later. */
     save_cont(vm);
+    mark_escape_points(vm);
 
     /* find the latest boundary frame */
     ScmContFrame *c, *cp;
@@ -2410,6 +2548,7 @@ long Scm_VMUnwindProtect(ScmVM *vm, ScmCStack *cstack)
 {
     cstack->prev = vm->cstack;
     cstack->cont = NULL;
+    cstack->lazy = CSTACK_ARMED;
     vm->cstack = cstack;
     return sigsetjmp(cstack->jbuf, FALSE);
 }
@@ -2418,7 +2557,7 @@ void Scm_VMNextHandler(ScmVM *vm)
 {
     if (vm->cstack->prev) {
         vm->cstack = vm->cstack->prev;
-        siglongjmp(vm->cstack->jbuf, 1);
+        jump_cstack(vm);
     } else {
         Scm_Exit(1);
     }
@@ -2797,8 +2936,9 @@ void Scm_VMDump(ScmVM *vm)
 
     Scm_Printf(out, "C stacks:\n");
     while (cstk) {
-        Scm_Printf(out, "  %p: prev=%p, cont=%p\n",
-                   cstk, cstk->prev, cstk->cont);
+        Scm_Printf(out, "  %p: prev=%p, cont=%p%s\n",
+                   cstk, cstk->prev, cstk->cont,
+                   cstk->lazy? " (lazy)" : "");
         cstk = cstk->prev;
     }
     Scm_Printf(out, "Escape points:\n");
@@ -2823,9 +2963,20 @@ struct GC_ms_entry *vm_stack_mark(GC_word *addr,
     struct GC_ms_entry *e = mark_sp;
     ScmObj *vmsb = ((ScmObj*)addr)+1;
     ScmVM *vm = (ScmVM*)*addr;
-    int limit = vm->sp - vm->stackBase + 5;
-    void *spb = (void *)vm->stackBase;
-    void *sbe = (void *)(vm->stackBase + SCM_VM_STACK_SIZE);
+
+    /* In incremental GC mode this can be called while the owner thread
+       is running, so we read the VM registers only once, and never trust
+       them to stay within the stack.  The slots the owner writes after
+       we scan are on dirty pages, and GC calls us again with the world
+       stopped to finish marking. */
+    if (vm == NULL) return e;   /* not initialized yet */
+    ScmObj *volatile *spp = &vm->sp;
+    ScmObj *sp = *spp;
+    int limit = sp - vmsb + 5;
+    if (limit < 0) limit = 0;
+    if (limit > SCM_VM_STACK_SIZE) limit = SCM_VM_STACK_SIZE;
+    void *spb = (void *)vmsb;
+    void *sbe = (void *)(vmsb + SCM_VM_STACK_SIZE);
     void *hb = GC_least_plausible_heap_addr;
     void *he = GC_greatest_plausible_heap_addr;
 
@@ -2851,7 +3002,7 @@ void Scm__InitVM(void)
     vm_stack_mark_proc = GC_new_proc(vm_stack_mark);
     vm_stack_kind = GC_new_kind(vm_stack_free_list,
                                 GC_MAKE_PROC(vm_stack_mark_proc, 0),
-                                0, 0);
+                                0, 1); /* cleared; see vm_stack_mark */
 #endif /*USE_CUSTOM_STACK_MARKER*/
 
     Scm_HashCoreInitSimple(&vm_table, SCM_HASH_EQ, 8, NULL);
@@ -528,11 +528,36 @@
 ;;  The stack already has NLOCALS values.  This instruction creates an
 ;;  env frame with them (just like LOCAL-ENV), then jump to <addr>.
 ;;  (# of arguments can be known by SP - ARGP).
+;;  When the jump is a self tail call of a loop, we reuse the loop's
+;;  env frame in place instead of building a new one.
 (define-insn LOCAL-ENV-JUMP 1 addr #f
   (let* ([nargs::int (cast int (- SP ARGP))]
          [env_depth::int (SCM_VM_INSN_ARG code)]
-         [to::ScmObj*] [tenv::ScmEnvFrame* ENV])
-    ;; We can discard env_depth environment frames.
+         [to::ScmObj*] [tenv::ScmEnvFrame* ENV] [fenv::ScmEnvFrame* NULL])
+    (while (> (post-- env_depth) 0)
+      (SCM_ASSERT tenv)
+      (set! fenv tenv)
+      (set! tenv (-> tenv up)))
+    ;; FENV is the outermost frame we discard.  If it is in stack, has
+    ;; the same size, and no cont frame is over it, nobody else can see
+    ;; it (closures and continuations move env frames to the heap before
+    ;; capturing them), so we just overwrite its slots.
+    (when (and (> nargs 0) (!= fenv NULL)
+               (== (-> fenv size) nargs)
+               (IN-STACK-P (cast ScmObj* fenv))
+               (not (and (IN-STACK-P (cast ScmObj* CONT))
+                         (> (cast ScmObj* CONT) (cast ScmObj* fenv)))))
+      (let* ([t::ScmObj* (ENV_FP fenv)] [a::ScmObj* ARGP])
+        (dotimes [c nargs]
+          (set! (* (post++ t)) (* (post++ a)))))
+      (set! (-> fenv info) SCM_FALSE)
+      (set! ENV fenv)
+      (set! ARGP (+ (cast ScmObj* fenv) ENV_HDR_SIZE))
+      (set! SP ARGP)
+      (FETCH-LOCATION PC)
+      CHECK-INTR
+      NEXT)
+    ;; Otherwise, we can discard env_depth environment frames.
     ;; There are several cases:
     ;;  - if the target env frame (TENV) is in stack:
     ;;   -- if the current cont frame is over TENV
@@ -542,9 +567,6 @@
     ;;   -- if the current cont frame is in stack
     ;;      => shift argframe on top of the current cont frame
     ;;   -- otherwise => shift argframe at the stack base
-    (while (> (post-- env_depth) 0)
-      (SCM_ASSERT tenv)
-      (set! tenv (-> tenv up)))
     (cond [(IN-STACK-P (cast ScmObj* tenv))
            (if (and (IN-STACK-P (cast ScmObj* CONT))
                     (> (cast ScmObj* CONT) (cast ScmObj* tenv)))
@@ -218,6 +218,73 @@ int Scm_WriteCircular(ScmObj obj, ScmObj port, int mode, int width)
     }
 }
 
+/*
+ * Scm_WriteTree - Write out a text tree (see text.tree module).
+ *
+ *  Walks TREE iteratively and displays the leaves.  Strings, symbols,
+ *  characters and numbers are put into the port directly.  Other leaves
+ *  are passed to LEAF_WRITER (usually write-tree generic function) with
+ *  the port, so that the user can customize how they're written.
+ *  The port is locked throughout the walk.
+ */
+static void write_tree_leaf(ScmObj obj, ScmPort *port, ScmObj leaf_writer)
+{
+    if (SCM_STRINGP(obj)) {
+        Scm_PutsUnsafe(SCM_STRING(obj), port);
+    } else if (SCM_SYMBOLP(obj)) {
+        Scm_PutsUnsafe(SCM_SYMBOL_NAME(obj), port);
+    } else if (SCM_CHARP(obj)) {
+        Scm_PutcUnsafe(SCM_CHAR_VALUE(obj), port);
+    } else if (SCM_INTP(obj)) {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%ld", SCM_INT_VALUE(obj));
+        Scm_PutzUnsafe(buf, n, port);
+    } else if (SCM_NUMBERP(obj)) {
+        Scm_PutsUnsafe(SCM_STRING(Scm_NumberToString(obj, 10, 0)), port);
+    } else {
+        Scm_ApplyRec2(leaf_writer, obj, SCM_OBJ(port));
+    }
+}
+
+#define WRITE_TREE_STACK_INIT 32
+
+static void write_tree_rec(ScmObj tree, ScmPort *port, ScmObj leaf_writer)
+{
+    ScmObj stack0[WRITE_TREE_STACK_INIT], *stack = stack0;
+    int sp = 0, size = WRITE_TREE_STACK_INIT;
+
+    for (;;) {
+        /* Descend into the car, saving the rest. */
+        while (SCM_PAIRP(tree)) {
+            if (!SCM_NULLP(SCM_CDR(tree))) {
+                if (sp == size) {
+                    ScmObj *newstack = SCM_NEW_ARRAY(ScmObj, size*2);
+                    memcpy(newstack, stack, sizeof(ScmObj)*size);
+                    stack = newstack;
+                    size *= 2;
+                }
+                stack[sp++] = SCM_CDR(tree);
+            }
+            tree = SCM_CAR(tree);
+        }
+        if (!SCM_NULLP(tree)) write_tree_leaf(tree, port, leaf_writer);
+        if (sp == 0) break;
+        tree = stack[--sp];
+    }
+}
+
+void Scm_WriteTree(ScmObj tree, ScmObj p, ScmObj leaf_writer)
+{
+    if (!SCM_OPORTP(p)) Scm_Error("output port required, but got %S", p);
+
+    ScmPort *port = SCM_PORT(p);
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    PORT_SAFE_CALL(port, write_tree_rec(tree, port, leaf_writer),
+                   /*no cleanup*/);
+    PORT_UNLOCK(port);
+}
+
 /*===================================================================
  * Internal writer
  */
@@ -442,7 +509,7 @@ static void write_rec(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 #define POP()                                   \
     do {                                        \
         stack = SCM_CDR(stack);                 \
-        if (ht) stack_depth--;                  \
+        if (!ht) stack_depth--;                 \
     } while (0)
 
 
@@ -581,6 +648,163 @@ static void write_rec(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 #undef POP
 }
 
+/* Optimistic cycle check
+   For the circular-only modes (write and display), most data given
+   to the writer doesn't have a cycle, yet the walk pass builds a hash
+   table of every aggregate in it before a single character is emitted.
+   So we first run a cheap check that doesn't allocate nor call out to
+   Scheme.  If it proves the structure is acyclic, we emit it directly
+   by write_rec without labels.
+
+   The check is a depth-first traversal with a small fixed-size stack
+   on the C stack.  A cycle is always closed by a back edge to an object
+   on the current path, so we only need to compare with the open frames.
+   The cdr direction of a list doesn't push frames; we walk it with
+   Brent's cycle detection, comparing each cell with open list frames.
+   When the structure is nested deeper than CYCLE_CHECK_DEPTH, or we see
+   an object whose printer may walk into its own components, we give up
+   and fall back to the two-pass algorithm.  So is the case when a cycle
+   is found.
+
+   The counters are just for diagnostics; they're updated without lock
+   and may not be accurate under contention. */
+
+#define CYCLE_CHECK_DEPTH 64
+
+enum {
+    CYCLE_CHECK_ACYCLIC,
+    CYCLE_CHECK_CYCLE,
+    CYCLE_CHECK_TOO_DEEP,
+    CYCLE_CHECK_OBJECT
+};
+
+static struct {
+    u_long optimistic;          /* written without walk pass */
+    u_long cycles;              /* fell back because a cycle is found */
+    u_long too_deep;            /* fell back because of nesting */
+    u_long objects;             /* fell back because of a general object */
+    u_long checked_nodes;       /* nodes visited by the check */
+    u_long walked;              /* written with the walk pass */
+} write_stats;
+
+/* Returns TRUE if we know OBJ's printer doesn't recurse. */
+static inline int cycle_check_leaf_p(ScmObj obj)
+{
+    return (!SCM_PTRP(obj)
+            || SCM_NUMBERP(obj)
+            || SCM_STRINGP(obj)
+            || SCM_SYMBOLP(obj)
+            || SCM_KEYWORDP(obj)
+            || SCM_CHAR_SET_P(obj)
+            || SCM_REGEXPP(obj)
+            || Scm_UVectorType(SCM_CLASS_OF(obj)) != SCM_UVECTOR_INVALID);
+}
+
+static int write_cycle_check(ScmObj obj)
+{
+    /* index >= 0: vector, index of the next element to visit.
+       index == -1: list, obj is the cell whose car is being visited.
+       index == -2: list, the dotted tail is being visited. */
+    struct { ScmObj obj; long index; } stack[CYCLE_CHECK_DEPTH];
+    int sp = 0, i;
+    u_long nodes = 0;
+    int result = CYCLE_CHECK_ACYCLIC;
+
+    for (;;) {
+        nodes++;
+        if (SCM_PAIRP(obj)) {
+            /* Walk the cdr chain first */
+            ScmObj p = obj, t = obj;
+            u_long power = 1, lam = 0;
+            for (;;) {
+                for (i=0; i<sp; i++) {
+                    if (stack[i].index < 0 && SCM_EQ(stack[i].obj, p)) {
+                        result = CYCLE_CHECK_CYCLE; goto done;
+                    }
+                }
+                p = SCM_CDR(p);
+                if (!SCM_PAIRP(p)) break;
+                if (SCM_EQ(p, t)) { result = CYCLE_CHECK_CYCLE; goto done; }
+                if (++lam == power) { t = p; power <<= 1; lam = 0; }
+            }
+            if (sp == CYCLE_CHECK_DEPTH) {
+                result = CYCLE_CHECK_TOO_DEEP; goto done;
+            }
+            stack[sp].obj = obj;
+            stack[sp].index = -1;
+            sp++;
+            obj = SCM_CAR(obj);
+            continue;
+        } else if (SCM_VECTORP(obj)) {
+            for (i=0; i<sp; i++) {
+                if (stack[i].index >= 0 && SCM_EQ(stack[i].obj, obj)) {
+                    result = CYCLE_CHECK_CYCLE; goto done;
+                }
+            }
+            if (SCM_VECTOR_SIZE(obj) > 0) {
+                if (sp == CYCLE_CHECK_DEPTH) {
+                    result = CYCLE_CHECK_TOO_DEEP; goto done;
+                }
+                stack[sp].obj = obj;
+                stack[sp].index = 1;
+                sp++;
+                obj = SCM_VECTOR_ELEMENT(obj, 0);
+                continue;
+            }
+        } else if (!cycle_check_leaf_p(obj)) {
+            result = CYCLE_CHECK_OBJECT; goto done;
+        }
+
+        /* We're done with obj.  Find the next one. */
+        for (;;) {
+            if (sp == 0) goto done;
+            if (stack[sp-1].index == -1) {
+                ScmObj next = SCM_CDR(stack[sp-1].obj);
+                if (SCM_PAIRP(next)) {
+                    stack[sp-1].obj = next;
+                    obj = SCM_CAR(next);
+                    break;
+                } else if (!SCM_NULLP(next)) {
+                    stack[sp-1].index = -2;
+                    obj = next;
+                    break;
+                }
+                sp--;
+            } else if (stack[sp-1].index == -2) {
+                sp--;
+            } else {
+                ScmObj v = stack[sp-1].obj;
+                long k = stack[sp-1].index;
+                if (k < SCM_VECTOR_SIZE(v)) {
+                    stack[sp-1].index = k+1;
+                    obj = SCM_VECTOR_ELEMENT(v, k);
+                    break;
+                }
+                sp--;
+            }
+        }
+    }
+  done:
+    write_stats.checked_nodes += nodes;
+    return result;
+}
+
+/* Returns a list of (:keyword value) lists, as gc-stat does. */
+ScmObj Scm__WriteStats(int resetp)
+{
+#define STAT(name, field) \
+    SCM_LIST2(SCM_MAKE_KEYWORD(name), Scm_MakeIntegerU(write_stats.field))
+    ScmObj r = Scm_Cons(STAT("optimistic", optimistic),
+                        SCM_LIST5(STAT("cycles", cycles),
+                                  STAT("too-deep", too_deep),
+                                  STAT("objects", objects),
+                                  STAT("checked-nodes", checked_nodes),
+                                  STAT("walked", walked)));
+#undef STAT
+    if (resetp) memset(&write_stats, 0, sizeof(write_stats));
+    return r;
+}
+
 /* Write/ss main driver
    This should never be called recursively.
    We modify port->flags and port->recursiveContext; they are cleaned up
@@ -589,6 +813,19 @@ static void write_ss(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 {
     SCM_ASSERT(SCM_FALSEP(port->recursiveContext));
 
+    if (SCM_WRITE_MODE(ctx) != SCM_WRITE_SHARED) {
+        switch (write_cycle_check(obj)) {
+        case CYCLE_CHECK_ACYCLIC:
+            write_stats.optimistic++;
+            write_rec(obj, port, ctx);
+            return;
+        case CYCLE_CHECK_CYCLE:    write_stats.cycles++; break;
+        case CYCLE_CHECK_TOO_DEEP: write_stats.too_deep++; break;
+        case CYCLE_CHECK_OBJECT:   write_stats.objects++; break;
+        }
+    }
+    write_stats.walked++;
+
     /* pass 1 */
     port->flags |= SCM_PORT_WALKING;
     if (SCM_WRITE_MODE(ctx)==SCM_WRITE_SHARED) port->flags |= SCM_PORT_WRITESS;
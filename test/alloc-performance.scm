@@ -0,0 +1,70 @@
+;;
+;; a short test program to measure how allocation-heavy code scales
+;; with the number of threads.  Each thread does the same work, so
+;; the elapsed time stays flat if allocation doesn't contend.
+;;
+;; To compare with another build (e.g. the tree before a change to the
+;; allocator), give its gosh:
+;;
+;;   gosh test/alloc-performance.scm /path/to/baseline/src/gosh
+;;
+;; The same workload is run by both, and the elapsed time of each is
+;; reported with the ratio.
+;;
+
+(use gauche.threads)
+(use gauche.time)
+(use gauche.process)
+(use util.match)
+
+(define *work* 200)
+(define *threads* '(1 2 4 8))
+
+;; pairs, flonums, and closures whose environments the VM moves
+;; to the heap
+(define (churn)
+  (dotimes [_ *work*]
+    (let* ([l (iota 1000)]
+           [f (map (^x (* x 1.5)) l)]
+           [g (map (^x (^[] x)) f)])
+      (fold (^[c s] (+ s (c))) 0.0 g))))
+
+;; Returns elapsed seconds.
+(define (run nthreads)
+  (let1 t (make <real-time-counter>)
+    (with-time-counter t
+      (for-each thread-join!
+                (map (^_ (thread-start! (make-thread churn)))
+                     (iota nthreads))))
+    (time-counter-value t)))
+
+(define (msec sec) (/ (round (* sec 1000)) 1000.0))
+
+(define (report results baseline)
+  (for-each
+   (^[n sec]
+     (format #t "~2d threads: ~as elapsed, ~a rounds/s" n (msec sec)
+             (round->exact (/ (* n *work*) sec)))
+     (when baseline
+       (let1 bsec (cdr (assv n baseline))
+         (format #t "  (baseline ~as, ~ax)" (msec bsec)
+                 (/ (round (* (/ bsec sec) 100)) 100.0))))
+     (newline))
+   *threads* results))
+
+(define (main args)
+  (match (cdr args)
+    [("--raw")                          ; used when run as the baseline
+     (write (map (^n (cons n (run n))) *threads*))
+     0]
+    [()
+     (report (map run *threads*) #f)
+     0]
+    [(baseline-gosh)
+     (let* ([baseline (read (open-input-string
+                             (process-output->string
+                              `(,baseline-gosh ,(car args) "--raw"))))]
+            [results (map run *threads*)])
+       (print "this tree vs. " baseline-gosh)
+       (report results baseline)
+       0)]))
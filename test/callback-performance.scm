@@ -0,0 +1,42 @@
+;;
+;; a short test program to measure the cost of calling Scheme procedures
+;; back from C, e.g. a sort with a Scheme comparator, or a hash table
+;; whose keys have user-defined object-hash and object-equal? methods.
+;;
+
+(use gauche.time)
+(use math.mt-random)
+
+(define *size* 100000)
+
+(define *numbers*
+  (let1 m (make <mersenne-twister> :seed 42)
+    (map (^_ (mt-random-integer m 1000000)) (iota *size*))))
+
+(define-class <key> ()
+  ((id :init-keyword :id)))
+
+(define-method object-hash ((k <key>)) (~ k'id))
+(define-method object-equal? ((a <key>) (b <key>)) (= (~ a'id) (~ b'id)))
+
+(define *keys* (map (^i (make <key> :id i)) *numbers*))
+
+(define (bench name thunk)
+  (print name)
+  (time (thunk)))
+
+(bench "sort with the default comparator"
+       (^[] (sort *numbers*)))
+
+(bench "sort with a Scheme comparator"
+       (^[] (sort *numbers* (^[a b] (< a b)))))
+
+(bench "equal?-hash table with object-hash keys"
+       (^[] (let1 h (make-hash-table 'equal?)
+              (dolist [k *keys*] (hash-table-put! h k #t))
+              (dolist [k *keys*] (hash-table-get h k #f)))))
+
+(bench "tree-map with a Scheme comparator"
+       (^[] (let1 t (make-tree-map = <)
+              (dolist [n *numbers*] (tree-map-put! t n #t))
+              (dolist [n *numbers*] (tree-map-get t n #f)))))
@@ -0,0 +1,34 @@
+;;
+;; a short test program to measure the effect of the prepared query cache
+;; and batched execution of dbi, using the in-memory driver.
+;;
+
+(use gauche.time)
+(use dbi)
+
+(define *rows* 100000)
+
+(define (bench name thunk)
+  (let1 conn (dbi-connect "dbi:memory")
+    (dbi-do conn "create table t (id integer, name varchar(32))")
+    (print name)
+    (time (thunk conn))))
+
+(bench "dbi-do without cache"
+       (^[conn] (parameterize ([dbi-query-cache-size 0])
+                  (dotimes [i *rows*]
+                    (dbi-do conn "insert into t values (?, ?)" '() i "x")))))
+
+(bench "dbi-do with cache"
+       (^[conn] (parameterize ([dbi-query-cache-size 32])
+                  (dotimes [i *rows*]
+                    (dbi-do conn "insert into t values (?, ?)" '() i "x")))))
+
+(bench "dbi-execute with explicit prepare"
+       (^[conn] (let1 q (dbi-prepare conn "insert into t values (?, ?)")
+                  (dotimes [i *rows*]
+                    (dbi-execute q i "x")))))
+
+(bench "dbi-execute-batch"
+       (^[conn] (dbi-execute-batch (dbi-prepare conn "insert into t values (?, ?)")
+                                   (map (cut list <> "x") (iota *rows*)))))
@@ -4,6 +4,7 @@
 
 (use gauche.test)
 (use gauche.sequence)
+(use util.relation)
 
 (test-start "dbi/dbd")
 (use dbi)
@@ -70,6 +71,129 @@
                       4))
   )
 
+(test-section "query cache")
+
+;; A connection that records calls of dbi-prepare and dbi-execute
+(define-class <counting-connection> ((with-module dbd.null <null-connection>))
+  ((prepared :init-value 0)
+   (executed :init-value '())))
+(define-method dbi-prepare ((c <counting-connection>) sql . opts)
+  (inc! (~ c'prepared))
+  (next-method))
+(define-method dbi-execute-using-connection ((c <counting-connection>) q p)
+  (rlet1 r (next-method)
+    (push! (~ c'executed) r)))
+(define *closed-queries* '())
+(define-method dbi-close ((q <dbi-query>))
+  (push! *closed-queries* q))
+
+(let1 conn (make <counting-connection>
+             :attr-string "" :attr-alist '() :options '())
+  (define (count-prepare thunk)
+    (set! (~ conn'prepared) 0)
+    (thunk)
+    (~ conn'prepared))
+  (test* "dbi-do doesn't cache by default" 3
+         (count-prepare
+          (^[] (dotimes [i 3]
+                 (dbi-do conn "insert into foo values (?)" '() i)))))
+  (parameterize ([dbi-query-cache-size 32])
+    (test* "dbi-do uses cache" 1
+           (count-prepare
+            (^[] (dotimes [i 3]
+                   (dbi-do conn "insert into foo values (?)" '() i)))))
+    (test* "dbi-do cached result" '("insert into foo values(5)")
+           (coerce-to <list> (dbi-do conn "insert into foo values (?)" '() 5)))
+    (test* "dbi-do no cache for pass-through" 2
+           (count-prepare
+            (^[] (dotimes [i 2]
+                   (dbi-do conn "select 1" '(:pass-through #t)))))))
+  (test* "dbi-do evicts LRU entry" 4
+         (count-prepare
+          (^[] (parameterize ([dbi-query-cache-size 2])
+                 (dbi-clear-query-cache! conn)
+                 (dbi-do conn "select 1")     ; miss
+                 (dbi-do conn "select 2")     ; miss
+                 (dbi-do conn "select 1")     ; hit
+                 (dbi-do conn "select 3")     ; miss, evicts "select 2"
+                 (dbi-do conn "select 1")     ; hit
+                 (dbi-do conn "select 2")))))  ; miss
+  (test* "dbi-do closes evicted queries" '(1 2)
+         (parameterize ([dbi-query-cache-size 1])
+           (dbi-clear-query-cache! conn)
+           (set! *closed-queries* '())
+           (dbi-do conn "select 1")
+           (dbi-do conn "select 2")     ; evicts "select 1"
+           (let1 n (length *closed-queries*)
+             (dbi-clear-query-cache! conn) ; closes "select 2"
+             (list n (length *closed-queries*)))))
+  (test* "dbi-do without cache" 2
+         (count-prepare
+          (^[] (parameterize ([dbi-query-cache-size 0])
+                 (dbi-do conn "select 1")
+                 (dbi-do conn "select 1")))))
+
+  (test* "dbi-execute-batch (default)"
+         '(("insert into foo values(1,'a')")
+           ("insert into foo values(2,'b')"))
+         (begin
+           (set! (~ conn'executed) '())
+           (dbi-execute-batch (dbi-prepare conn "insert into foo values (?, ?)")
+                              '((1 "a") (2 "b")))
+           (reverse (~ conn'executed))))
+  )
+
+(test-section "testing with dbd-memory")
+
+(let1 conn (dbi-connect "dbi:memory")
+  (define (rows r) (map (cut coerce-to <list> <>) (coerce-to <list> r)))
+  (test* "create table" 0
+         (dbi-do conn "create table emp (id integer, name varchar(20), dept char(4))"))
+  (test* "insert" 1
+         (dbi-do conn "insert into emp values (1, 'alice', 'dev')"))
+  (test* "insert multi-row" 2
+         (dbi-do conn "insert into emp (name, id) values ('bob', 2), (?, ?)"
+                 '() "carol" 3))
+  (test* "select *" '((1 "alice" "dev") (2 "bob" #f) (3 "carol" #f))
+         (rows (dbi-do conn "select * from emp")))
+  (test* "select columns" '(name id)
+         (relation-column-names (dbi-do conn "select name, id from emp")))
+  (test* "select where" '(("bob"))
+         (rows (dbi-do conn "select name from emp where id = ?" '() 2)))
+  (test* "dbi-execute-batch" 3
+         (dbi-execute-batch (dbi-prepare conn "insert into emp values (?, ?, 'ops')")
+                            '((4 "dave") (5 "eve") (6 "frank"))))
+  (test* "dbi-execute-batch result" '((4 "dave") (5 "eve") (6 "frank"))
+         (rows (dbi-do conn "select id, name from emp where dept = 'ops'")))
+  (test* "dbi-execute-batch (non-insert)" 2
+         (dbi-execute-batch (dbi-prepare conn "delete from emp where id = ?")
+                            '((4) (5))))
+  (test* "delete" 1
+         (dbi-do conn "delete from emp where dept = ? and id = ?" '() "ops" 6))
+  (test* "select after delete" '(1 2 3)
+         (map car (rows (dbi-do conn "select id from emp"))))
+  (test* "parameter error" (test-error <dbi-parameter-error>)
+         (dbi-execute-batch (dbi-prepare conn "insert into emp values (?, ?, ?)")
+                            '((7 "x"))))
+  (test* "no such table" (test-error <dbi-error>)
+         (dbi-do conn "select * from nosuch"))
+  (test* "unsupported sql" (test-error <dbi-unsupported-error>)
+         (dbi-do conn "update emp set id = 3"))
+  (test* "separate databases" (test-error <dbi-error>)
+         (dbi-do (dbi-connect "dbi:memory") "select * from emp"))
+  (test* "named databases" '((1))
+         (begin
+           (dbi-do (dbi-connect "dbi:memory:db=shared")
+                   "create table t (x integer)")
+           (dbi-do (dbi-connect "dbi:memory:db=shared")
+                   "insert into t values (1)")
+           (rows (dbi-do (dbi-connect "dbi:memory:db=shared")
+                         "select * from t"))))
+  (test* "closed connection" (test-error <dbi-error>)
+         (begin (dbi-close conn)
+                (dbi-do conn "select * from emp")))
+  )
+
 (test-section "testing conditions")
 
 (test* "<dbi-nonexistent-driver-error>" "nosuchdriver"
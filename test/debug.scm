@@ -6,6 +6,7 @@
 (use gauche.test)
 (use srfi-1)
 (use util.match)
+(use gauche.vm.profiler)
 
 (test-start "debug features")
 
@@ -33,4 +34,95 @@
                      [_ #f])
                    (call/cc (^x (ra x) #f))))
 
+;;------------------------------------------------------------------
+(test-section "heap inspection")
+
+(define-class <census-test> () ((x :init-keyword :x)))
+(define *census-objs*
+  (list-tabulate 100 (^i (make <census-test> :x i))))
+
+(test* "heap-census" #t
+       (match (assq <census-test> (heap-census))
+         [(_ count bytes) (and (>= count 100) (> bytes 0))]
+         [_ #f]))
+
+(test* "heap-census-get-result" #t
+       (match (assq '<census-test> (heap-census-get-result))
+         [(_ count bytes) (>= count 100)]
+         [_ #f]))
+
+(test* "heap-census-diff" '((foo 2 30) (bar -1 -10))
+       (heap-census-diff '((foo 1 10) (bar 1 10) (baz 3 30))
+                         '((foo 3 40) (baz 3 30))))
+
+(test* "heap-retention-path" #t
+       (match (heap-retention-path (car *census-objs*))
+         [(? pair? path)
+          (match (last path)
+            [#(obj _ _ #f) (eq? obj (car *census-objs*))]
+            [_ #f])]
+         [_ #f]))
+
+(test* "heap-retention-path (explicit roots)" #f
+       (heap-retention-path (car *census-objs*) (list (make-vector 3 0))))
+
+;;------------------------------------------------------------------
+(test-section "allocation profiler")
+
+;; The allocation profiler isn't available on the platforms without
+;; SIGPROF; we skip the tests there.
+(define *alloc-profiler-supported*
+  (guard (e [else #f]) (alloc-profiler-reset) #t))
+
+(define-class <alloc-test> () ((x :init-keyword :x)))
+
+;; These shouldn't be in let; see above.
+(define (alloc-test-list n)
+  (if (zero? n) '() (cons n (alloc-test-list (- n 1)))))
+(define (alloc-test-objs n)
+  (list-tabulate n (^i (make <alloc-test> :x i))))
+
+(define *alloc-test-data* #f)
+(define (alloc-test-samples)
+  (fold (^(e n) (+ (caddr e) n)) 0 (alloc-profiler-get-result)))
+
+(when *alloc-profiler-supported*
+  (test* "alloc-profiler-raw-result (inactive)" #f
+         ((with-module gauche.internal alloc-profiler-raw-result)))
+
+  (test* "alloc-profiler-start/stop" #t
+         (begin
+           (alloc-profiler-start 256)
+           (set! *alloc-test-data*
+                 (list (alloc-test-list 2000) (alloc-test-objs 2000)))
+           (> (alloc-profiler-stop) 0)))
+
+  (test* "alloc-profiler-raw-result" #t
+         (match ((with-module gauche.internal alloc-profiler-raw-result))
+           [(((? list?) _ (? integer?) (? integer?) (? integer?)) ..1) #t]
+           [_ #f]))
+
+  (test* "alloc-profiler-get-result (class)" #t
+         (let1 r (alloc-profiler-get-result)
+           (and (any (^e (eq? (cadr e) '<pair>)) r)
+                (any (^e (eq? (cadr e) '<alloc-test>)) r))))
+
+  (test* "alloc-profiler-get-result (site)" #t
+         (any (^e (match e
+                    [(('alloc-test-list . _) '<pair> cnt est bytes)
+                     (and (> cnt 0) (> est 0) (> bytes 0))]
+                    [_ #f]))
+              (alloc-profiler-get-result)))
+
+  (test* "alloc-profiler-stop doesn't take samples" #t
+         (let1 n (alloc-test-samples)
+           (alloc-test-list 2000)
+           (= n (alloc-test-samples))))
+
+  (test* "alloc-profiler-reset" #f
+         (begin
+           (alloc-profiler-reset)
+           (alloc-profiler-get-result)))
+  )
+
 (test-end)
@@ -0,0 +1,334 @@
+;;
+;; A benchmark suite to compare dictionary implementations: hash tables,
+;; tree maps, sparse tables and vectors, tries, persistent maps and dbm.
+;;
+;; Run it by 'make bench-dict' at the top of the build tree, or as
+;;
+;;   src/gosh -ftest test/dict-performance.scm [options]
+;;
+;; Options:
+;;   --sizes N,...     table sizes (default: 1000,10000,100000,1000000)
+;;   --max-size N      all powers of 10 from 1000 up to N, e.g. 100000000
+;;                     (beware, 10^8 entries need tens of gigabytes)
+;;   --impls NAME,...  run only the named implementations
+;;   --keys TYPE,...   key types; fixnum, symbol, short-string, long-string
+;;   --min-ops N       repeat small runs until N operations are done
+;;                     (default: 1000000)
+;;   -o, --output FILE also write the results to FILE, one per line
+;;
+;; For each implementation, key type and size, it measures insertion,
+;; lookup, deletion and iteration in nanoseconds per entry, and the heap
+;; retained by the table in bytes per entry.  Each line of the output
+;; file is an S-expression like this:
+;;
+;;   (dict-bench :impl hash-table :keys fixnum :size 1000
+;;               :op lookup :value 35.2 :unit ns/op)
+;;
+;; so that results of different builds can be compared by a script.
+;;
+;; NB: Weak hash tables aren't covered, since they don't have a Scheme
+;; level constructor.
+;;
+
+(use gauche.parseopt)
+(use file.util)
+(use gauche.record)
+(use gauche.sequence)
+(use srfi-1)
+(use srfi-13)
+(use math.mt-random)
+(use util.sparse)
+(use util.trie)
+(use data.persistent)
+(use dbm)
+
+;;;
+;;; Implementations
+;;;
+
+;; Each implementation is a set of procedures.  PUT and DELETE return
+;; the table, so that functional ones can be run in the same way.
+;; MAKE takes a key type and returns a new table, or #f if the key type
+;; isn't supported.  CLEANUP is called with a table when we're done.
+(define-record-type impl #t #t
+  name make put get delete fold
+  max-size                              ;#f for no limit
+  in-memory?                            ;#f if memory can't be measured
+  cleanup)                              ;#f if not needed
+
+(define (key-hash-type keys)
+  (case keys
+    [(fixnum) 'eqv?]
+    [(symbol) 'eq?]
+    [else 'string=?]))
+
+(define (symbol-less? a b) (string<? (symbol->string a) (symbol->string b)))
+
+(define *tmpdir*
+  (build-path (temporary-directory) #"dictbench-~(sys-getpid)"))
+
+(define (dbm-impl type)
+  (and-let* ([class (dbm-type->class type)])
+    (define path (build-path *tmpdir* (x->string type)))
+    (make-impl (string->symbol #"dbm.~type")
+               (^[keys] (and (memq keys '(short-string long-string))
+                             (begin (make-directory* *tmpdir*)
+                                    (dbm-open class :path path
+                                              :rw-mode :create))))
+               (^[d k v] (dbm-put! d k v) d)
+               (^[d k] (dbm-get d k #f))
+               (^[d k] (dbm-delete! d k) d)
+               dbm-fold
+               10000 #f
+               (^[d] (dbm-close d) (dbm-db-remove class path)))))
+
+(define *impls*
+  (cond-list
+   [#t (make-impl 'hash-table
+                  (^[keys] (make-hash-table (key-hash-type keys)))
+                  (^[d k v] (hash-table-put! d k v) d)
+                  (^[d k] (hash-table-get d k #f))
+                  (^[d k] (hash-table-delete! d k) d)
+                  hash-table-fold
+                  #f #t #f)]
+   [#t (make-impl 'tree-map
+                  (^[keys] (if (eq? keys 'symbol)
+                             (make-tree-map eq? symbol-less?)
+                             (make-tree-map)))
+                  (^[d k v] (tree-map-put! d k v) d)
+                  (^[d k] (tree-map-get d k #f))
+                  (^[d k] (tree-map-delete! d k) d)
+                  tree-map-fold
+                  #f #t #f)]
+   [#t (make-impl 'sparse-table
+                  (^[keys] (make-sparse-table (key-hash-type keys)))
+                  (^[d k v] (sparse-table-set! d k v) d)
+                  (^[d k] (sparse-table-ref d k #f))
+                  (^[d k] (sparse-table-delete! d k) d)
+                  sparse-table-fold
+                  #f #t #f)]
+   [#t (make-impl 'sparse-vector
+                  (^[keys] (and (eq? keys 'fixnum) (make-sparse-vector)))
+                  (^[d k v] (sparse-vector-set! d k v) d)
+                  (^[d k] (sparse-vector-ref d k #f))
+                  (^[d k] (sparse-vector-delete! d k) d)
+                  sparse-vector-fold
+                  #f #t #f)]
+   [#t (make-impl 'trie
+                  (^[keys] (and (memq keys '(short-string long-string))
+                                (make-trie)))
+                  (^[d k v] (trie-put! d k v) d)
+                  (^[d k] (trie-get d k #f))
+                  (^[d k] (trie-delete! d k) d)
+                  trie-fold
+                  #f #t #f)]
+   ;; giving a table procedure disables the native storage of strings
+   [#t (make-impl 'trie/generic
+                  (^[keys] (and (memq keys '(short-string long-string))
+                                (make-trie (cut make-hash-table 'eqv?))))
+                  (^[d k v] (trie-put! d k v) d)
+                  (^[d k] (trie-get d k #f))
+                  (^[d k] (trie-delete! d k) d)
+                  trie-fold
+                  #f #t #f)]
+   [#t (make-impl 'persistent-map
+                  (^[keys] (make-persistent-map (key-hash-type keys)))
+                  persistent-map-put
+                  (^[d k] (persistent-map-ref d k #f))
+                  persistent-map-delete
+                  persistent-map-fold
+                  #f #t #f)]
+   [#t (make-impl 'transient-map
+                  (^[keys] (persistent-map-transient
+                            (make-persistent-map (key-hash-type keys))))
+                  (^[d k v] (transient-map-put! d k v) d)
+                  (^[d k] (transient-map-ref d k #f))
+                  (^[d k] (transient-map-delete! d k) d)
+                  persistent-map-fold   ;works on transients too
+                  #f #t #f)]
+   [(dbm-impl 'gdbm) => identity]
+   [(dbm-impl 'ndbm) => identity]
+   [(dbm-impl 'odbm) => identity]
+   [(dbm-impl 'fsdbm) => identity]))
+
+;;;
+;;; Keys
+;;;
+
+(define *key-types* '(fixnum symbol short-string long-string))
+
+;; Returns a vector of N distinct keys of the given type.
+(define (make-keys type n)
+  (let1 m (make <mersenne-twister> :seed 42)
+    (define (rand-fixnum i)
+      ;; distinct, scattered values
+      (+ (* i 1024) (mt-random-integer m 1024)))
+    (vector-tabulate
+     n
+     (case type
+       [(fixnum) rand-fixnum]
+       [(symbol) (^i (string->symbol (number->string (rand-fixnum i) 36)))]
+       [(short-string) (^i (number->string (rand-fixnum i) 36))]
+       ;; like paths or URLs, with a long common prefix
+       [(long-string)
+        (^i (string-append "/usr/local/share/gauche/site/lib/data/"
+                           (number->string (rand-fixnum i) 36)
+                           "/index.html"))]))))
+
+;; Returns a shuffled copy of V.
+(define (shuffle v)
+  (let ([m (make <mersenne-twister> :seed 7)]
+        [v (vector-copy v)])
+    (do ([i (- (vector-length v) 1) (- i 1)])
+        [(<= i 0) v]
+      (let* ([j (mt-random-integer m (+ i 1))]
+             [t (vector-ref v i)])
+        (vector-set! v i (vector-ref v j))
+        (vector-set! v j t)))))
+
+;;;
+;;; Measurement
+;;;
+
+(define (now-nsec)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (+ (* sec 1000000000) nsec)))
+
+(define (live-bytes)
+  (define (ref key) (cadr (assq key (gc-stat))))
+  (gc) (gc)
+  (- (ref :total-heap-size) (ref :free-bytes)))
+
+(define *min-ops* 1000000)
+
+;; Runs THUNK repeatedly until MIN-OPS operations are done, N operations
+;; each, and returns nanoseconds per operation.
+(define (measure n thunk)
+  (let1 rounds (max 1 (ceiling->exact (/ *min-ops* n)))
+    (let1 t0 (now-nsec)
+      (dotimes [_ rounds] (thunk))
+      (/. (- (now-nsec) t0) (* rounds n)))))
+
+(define (fill impl keys-type keys)
+  (let ([put (impl-put impl)] [n (vector-length keys)])
+    (let loop ([i 0] [d ((impl-make impl) keys-type)])
+      (if (= i n)
+        d
+        (let1 k (vector-ref keys i) (loop (+ i 1) (put d k k)))))))
+
+(define (delete-all impl d keys)
+  (let ([del (impl-delete impl)] [n (vector-length keys)])
+    (let loop ([i 0] [d d])
+      (if (= i n) d (loop (+ i 1) (del d (vector-ref keys i)))))))
+
+;; Returns an alist of op and value.
+(define (run-one impl keys-type keys shuffled)
+  (let* ([n (vector-length keys)]
+         [get (impl-get impl)]
+         [cleanup (or (impl-cleanup impl) (^_ #f))]
+         [insert (measure n (^[] (cleanup (fill impl keys-type keys))))]
+         [b0 (and (impl-in-memory? impl) (live-bytes))]
+         [d (fill impl keys-type keys)]
+         [mem (and b0 (/. (- (live-bytes) b0) n))]
+         [lookup (measure n (^[] (vector-for-each (^k (get d k)) shuffled)))]
+         [iterate (measure n (^[] ((impl-fold impl) d (^[k v s] s) #f)))])
+    (cleanup d)
+    (let1 delete
+        (measure n (^[] (let1 d (fill impl keys-type keys)
+                          (cleanup (delete-all impl d shuffled)))))
+      (cond-list
+       [#t `(insert . ,insert)]
+       [#t `(lookup . ,lookup)]
+       [#t `(delete . ,delete)]
+       [#t `(iterate . ,iterate)]
+       [mem `(memory . ,mem)]))))
+
+;; NB: DELETE includes the time to fill the table, so we subtract
+;; INSERT from it when reporting.
+(define (report-values results)
+  (map (^p (if (eq? (car p) 'delete)
+             (cons 'delete (max 0 (- (cdr p) (assq-ref results 'insert))))
+             p))
+       results))
+
+;;;
+;;; Output
+;;;
+
+(define *ops* '(insert lookup delete iterate memory))
+
+(define (print-header keys-type size)
+  (format #t "\n~a keys, ~d entries\n" keys-type size)
+  (format #t "  ~16a~10@a~10@a~10@a~10@a~14@a\n"
+          "" "insert" "lookup" "delete" "iterate" "bytes/entry")
+  (format #t "  ~16a~10@a~10@a~10@a~10@a~14@a\n"
+          "" "(ns/op)" "(ns/op)" "(ns/op)" "(ns/op)" ""))
+
+(define (round1 v) (/ (round (* v 10)) 10.0))
+(define (format-value v) (if v (number->string (round1 v)) "-"))
+
+(define (print-row impl results)
+  (format #t "  ~16a~10@a~10@a~10@a~10@a~14@a\n" (impl-name impl)
+          (format-value (assq-ref results 'insert))
+          (format-value (assq-ref results 'lookup))
+          (format-value (assq-ref results 'delete))
+          (format-value (assq-ref results 'iterate))
+          (format-value (assq-ref results 'memory)))
+  (flush))
+
+(define (write-records port impl keys-type size results)
+  (when port
+    (dolist [op *ops*]
+      (and-let* ([v (assq-ref results op)])
+        (write `(dict-bench :impl ,(impl-name impl) :keys ,keys-type
+                            :size ,size :op ,op
+                            :value ,(round1 v)
+                            :unit ,(if (eq? op 'memory) 'bytes/entry 'ns/op))
+               port)
+        (newline port)))
+    (flush port)))
+
+;;;
+;;; Main
+;;;
+
+(define (split-list str conv)
+  (map conv (string-split str #\,)))
+
+(define (main args)
+  (let-args (cdr args)
+      ([sizes "sizes=s" #f]
+       [max-size "max-size=i" #f]
+       [impls "impls=s" #f]
+       [keys "keys=s" #f]
+       [min-ops "min-ops=i" #f]
+       [output "o|output=s" #f])
+    (let ([sizes (cond [sizes (split-list sizes string->number)]
+                       [max-size (unfold (cut > <> max-size) identity
+                                         (cut * <> 10) 1000)]
+                       [else '(1000 10000 100000 1000000)])]
+          [impls (if impls
+                   (let1 names (split-list impls string->symbol)
+                     (filter (^i (memq (impl-name i) names)) *impls*))
+                   *impls*)]
+          [key-types (if keys (split-list keys string->symbol) *key-types*)]
+          [port (and output (open-output-file output))])
+      (when min-ops (set! *min-ops* min-ops))
+      (dolist [keys-type key-types]
+        (dolist [size sizes]
+          (let* ([keys (make-keys keys-type size)]
+                 [shuffled (shuffle keys)])
+            (print-header keys-type size)
+            (dolist [impl impls]
+              (when (and (or (not (impl-max-size impl))
+                             (<= size (impl-max-size impl)))
+                         (and-let* ([d ((impl-make impl) keys-type)])
+                           (cond [(impl-cleanup impl) => (cut <> d)])
+                           #t))
+                (let1 results (report-values
+                               (run-one impl keys-type keys shuffled))
+                  (print-row impl results)
+                  (write-records port impl keys-type size results)))))))
+      (when port (close-output-port port))
+      (when (file-exists? *tmpdir*) (remove-directory* *tmpdir*))
+      0)))
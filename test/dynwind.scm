@@ -341,6 +341,31 @@
 (test "stack overflow (apply)" (/ (* 3000 3001) 2)
       (^[] (sum-rec-apply 3000)))
 
+;;-----------------------------------------------------------------------
+;; Escapes across callbacks from C (sort calls the comparator from C)
+
+(test "escape from a callback" 'escaped
+      (^[] (call/cc (^k (sort '(3 1 2) (^[a b] (k 'escaped)))))))
+
+(test "error handler in a callback, error from a nested callback" '(1 2 3)
+      (^[] (sort '(3 1 2)
+                 (^[a b] (guard (e [#t (< a b)])
+                           (sort '(2 1) (^[x y] (error "boo")))
+                           #f)))))
+
+(test "continuation in a callback, invoked from a nested callback" '(1 2 3)
+      (^[] (sort '(3 1 2)
+                 (^[a b] (call/cc
+                          (^k (sort '(2 1) (^[x y] (k (< a b))))))))))
+
+(test "reentering a continuation within a callback" '(1 2 3)
+      (^[] (sort '(3 1 2)
+                 (^[a b] (let ([n 0] [k #f])
+                           (call/cc (^c (set! k c)))
+                           (inc! n)
+                           (when (< n 3) (k #f))
+                           (< a b))))))
+
 ;;-----------------------------------------------------------------------
 ;; See if port stuff is cleaned up properly
 
@@ -243,6 +243,27 @@
          (let1 x (guard (e (else aaa)) (foo))
            (list x aaa))))
 
+;; escape points of guard are recycled; make sure they aren't when
+;; they can still be used.
+(test* "guard (repeated)" '(0 err 2 err 4)
+       (map (^i (guard (e [else 'err]) (if (odd? i) (raise i) i))) (iota 5)))
+
+(test* "guard (sequence in guard)" 'outer
+       (guard (e [(eq? e 'x) 'outer])
+         (guard (e [(eq? e 'y) 'inner]) 1)
+         (guard (e [(eq? e 'y) 'inner]) (raise 'y))
+         (raise 'x)))
+
+(test* "guard (reentering the body)" '(caught 2 1)
+       (let ([k #f] [n 0] [r '()])
+         (push! r (guard (e [else 'caught])
+                    (call/cc (^c (set! k c)))
+                    (inc! n)
+                    (if (= n 3) (raise 'boom) n)))
+         (dotimes [i 10] (guard (e [else #f]) i))
+         (when (< n 3) (k #f))
+         r))
+
 
 ;;--------------------------------------------------------------------
 (test-section "unwind-protect")
@@ -0,0 +1,69 @@
+;;
+;; a short test program to compare GC pause times of the default
+;; stop-the-world mode and the incremental mode (GAUCHE_GC_INCREMENTAL).
+;;
+;; Run it as 'gosh gc-performance.scm'.  It runs itself in a subprocess
+;; for each mode, since the mode is fixed when the runtime is initialized.
+;; With an argument 'run', it runs the benchmark in the current mode.
+;;
+
+(use gauche.process)
+(use gauche.sequence)
+
+(define *live-cells* 4000000)           ; retained during the run
+(define *steps* 20000)
+(define *self* (current-load-path))
+
+;; Keep a large live heap, so that a full mark takes long.
+(define (make-live-heap)
+  (let1 v (make-vector 1000)
+    (dotimes [i 1000]
+      (vector-set! v i (make-list (quotient *live-cells* 1000) i)))
+    v))
+
+(define (now-usec)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (+ (* sec 1000000) (quotient nsec 1000))))
+
+;; Each step does the same amount of work; its latency mostly varies
+;; by the GC work done in it.
+(define (step live i)
+  (let1 junk (make-list 2000 i)
+    ;; mutate the old generation a bit, as a server updates its state
+    (vector-set! live (modulo i 1000) (cons (length junk)
+                                            (vector-ref live (modulo i 1000))))))
+
+(define (run)
+  (let* ([live (make-live-heap)]
+         [lat (make-vector *steps* 0)]
+         [gc0 (cadr (assq :gc-count (gc-stat)))])
+    (dotimes [i *steps*]
+      (let1 t0 (now-usec)
+        (step live i)
+        (vector-set! lat i (- (now-usec) t0))))
+    (let ([sorted (sort lat)]
+          [gcs (- (cadr (assq :gc-count (gc-stat))) gc0)])
+      (define (pct p) (vector-ref sorted (floor->exact (* p (- *steps* 1)))))
+      (format #t "  incremental: ~a, collections: ~d, heap: ~dMB\n"
+              (cadr (assq :incremental (gc-stat))) gcs
+              (quotient (cadr (assq :total-heap-size (gc-stat))) 1048576))
+      (format #t "  step latency (usec): median ~d, p99 ~d, p99.9 ~d, max ~d\n"
+              (pct 0.5) (pct 0.99) (pct 0.999) (pct 1))
+      (format #t "  total: ~dms\n" (quotient (fold + 0 lat) 1000)))))
+
+(define (spawn title env)
+  (print title)
+  (if env
+    (sys-setenv "GAUCHE_GC_INCREMENTAL" env #t)
+    (sys-unsetenv "GAUCHE_GC_INCREMENTAL"))
+  (let1 gosh (string-append (sys-dirname *self*) "/../src/gosh")
+    (run-process `(,gosh "-ftest" ,*self* "run") :wait #t)))
+
+(define (main args)
+  (cond
+   [(member "run" (cdr args)) (run)]
+   [else
+    (spawn "stop-the-world" #f)
+    (spawn "incremental (default pause target)" "")
+    (spawn "incremental (10ms pause target)" "10")])
+  0)
@@ -0,0 +1,38 @@
+;;
+;; a short test program to measure the cost of entering and leaving
+;; guard and with-error-handler, and of raising and catching a condition.
+;;
+
+(use gauche.time)
+
+(define *count* 1000000)
+
+(define (total-bytes) (cadr (assq :total-bytes (gc-stat))))
+
+(define (bench name thunk)
+  (print name)
+  (let1 b0 (total-bytes)
+    (time (thunk))
+    (format #t "  ~d bytes allocated per iteration\n"
+            (quotient (- (total-bytes) b0) *count*))))
+
+(bench "guard, no raise"
+       (^[] (dotimes [i *count*]
+              (guard (e [else #f]) i))))
+
+(bench "guard, no raise, body refers to a local variable"
+       (^[] (let loop ([i 0] [s 0])
+              (when (< i *count*)
+                (loop (+ i 1) (guard (e [else s]) (+ s 1)))))))
+
+(bench "with-error-handler, no raise"
+       (^[] (dotimes [i *count*]
+              (with-error-handler (^e #f) (^[] i)))))
+
+(bench "guard, raise and catch"
+       (^[] (dotimes [i *count*]
+              (guard (e [else e]) (raise i)))))
+
+(bench "guard, error and catch"
+       (^[] (dotimes [i *count*]
+              (guard (e [(<error> e) #f]) (error "oops" i)))))
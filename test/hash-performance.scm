@@ -0,0 +1,58 @@
+;;
+;; a short test program to compare the native bulk operations on hash
+;; tables with the equivalent ones written with the iterator-based
+;; procedures, on a million-entry table.
+;;
+
+(use gauche.time)
+
+(define *size* 1000000)
+
+(define *keys*   (vector-tabulate *size* (^i (* i 7))))
+(define *values* (vector-tabulate *size* (^i i)))
+
+(define (make-table)
+  (rlet1 h (make-hash-table 'eqv?)
+    (hash-table-put-all! h *keys* *values*)))
+
+(define *table* (make-table))
+
+(define (bench title alist)
+  (print title)
+  (time-these/report '(cpu 3) alist))
+
+(bench "bulk insert from vectors"
+       `((put-all!    . ,(^[] (make-table)))
+         (put!        . ,(^[] (let1 h (make-hash-table 'eqv?)
+                                (dotimes [i *size*]
+                                  (hash-table-put! h (vector-ref *keys* i)
+                                                   (vector-ref *values* i))))))))
+
+(bench "update all values"
+       `((update-all!   . ,(^[] (hash-table-update-all! *table* (^[k v] v))))
+         (for-each+put! . ,(^[] (hash-table-for-each
+                                 *table*
+                                 (^[k v] (hash-table-put! *table* k v)))))))
+
+(bench "filter (copy, then drop half of entries)"
+       `((filter!         . ,(^[] (hash-table-filter! (hash-table-copy *table*)
+                                                      (^[k v] (even? v)))))
+         (fold+delete!    . ,(^[] (let1 h (hash-table-copy *table*)
+                                    (dolist [k (hash-table-fold
+                                                h (^[k v s] (if (even? v)
+                                                              s
+                                                              (cons k s)))
+                                                '())]
+                                      (hash-table-delete! h k)))))))
+
+(bench "merge two tables"
+       `((merge!          . ,(^[] (hash-table-merge! (make-hash-table 'eqv?)
+                                                     *table*)))
+         (for-each+put!   . ,(^[] (let1 h (make-hash-table 'eqv?)
+                                    (hash-table-for-each
+                                     *table*
+                                     (^[k v] (hash-table-put! h k v))))))))
+
+(bench "convert to a sequence of pairs"
+       `((->vector        . ,(^[] (hash-table->vector *table*)))
+         (->alist         . ,(^[] (hash-table->alist *table*)))))
@@ -325,6 +325,59 @@
          (list (assoc "a" a)
                (assoc "b" a))))
 
+;;------------------------------------------------------------------
+(test-section "bulk operations")
+
+(define (sorted-alist h) (sort (hash-table->alist h) < car))
+
+(test* "hash-table-update-all!" '((1 . 10) (2 . 40) (3 . 90))
+       (rlet1 h (hash-table 'eqv? '(1 . 10) '(2 . 20) '(3 . 30))
+         (hash-table-update-all! h (^[k v] (* k v))))
+       (^[a b] (equal? a (sorted-alist b))))
+
+(test* "hash-table-filter!" '(2 ((2 . b) (4 . d)))
+       (let* ([h (hash-table 'eqv? '(1 . a) '(2 . b) '(3 . c) '(4 . d))]
+              [n (hash-table-filter! h (^[k v] (even? k)))])
+         (list n (sorted-alist h))))
+
+(test* "hash-table-filter! (large)" '(5000 #t)
+       (let1 h (make-hash-table 'eqv?)
+         (dotimes [i 10000] (hash-table-put! h i i))
+         (hash-table-filter! h (^[k v] (odd? k)))
+         (list (hash-table-num-entries h)
+               (every (^[k] (and (odd? k) (= k (hash-table-get h k))))
+                      (hash-table-keys h)))))
+
+(test* "hash-table-put-all!" '(1000 0 998 "x")
+       (let1 h (hash-table 'equal? '("x" . "x"))
+         (hash-table-put-all! h
+                              (vector-tabulate 999 (^i i))
+                              (vector-tabulate 999 (^i i)))
+         (list (hash-table-num-entries h)
+               (hash-table-get h 0) (hash-table-get h 998)
+               (hash-table-get h "x"))))
+
+(test* "hash-table-put-all! (length mismatch)" (test-error)
+       (hash-table-put-all! (make-hash-table) '#(a b) '#(1)))
+
+(test* "hash-table-merge!" '((1 . a) (2 . y) (3 . z))
+       (let ([h1 (hash-table 'eqv? '(1 . a) '(2 . b))]
+             [h2 (hash-table 'eqv? '(2 . y) '(3 . z))])
+         (sorted-alist (hash-table-merge! h1 h2))))
+
+(test* "hash-table-merge! (proc)" '((1 . 1) (2 . 22) (3 . 30))
+       (let ([h1 (hash-table 'eqv? '(1 . 1) '(2 . 2))]
+             [h2 (hash-table 'eqv? '(2 . 20) '(3 . 30))])
+         (hash-table-merge! h1 h2 (^[k a b] (+ a b)))
+         (sorted-alist h1)))
+
+(test* "hash-table->vector" '((a . 3) (b . 4) (c . 8) (d . 10))
+       (vector->list (hash-table->vector h-it))
+       (^[a b] (lset= equal? a b)))
+
+(test* "hash-table->vector (empty)" '#()
+       (hash-table->vector (make-hash-table)))
+
 (test-module 'gauche.hashutil) ; autoloaded module
 
 (test-end)
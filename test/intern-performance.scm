@@ -0,0 +1,84 @@
+;;
+;; a short test program to measure the effect of string interning on
+;; realistic data: CSV rows with categorical columns, and JSON records
+;; with repeating keys.  Reports the time to read the data, and the
+;; heap retained by the result.
+;;
+
+(use gauche.time)
+(use math.mt-random)
+(use text.csv)
+(use rfc.json)
+
+(define *nrows* 100000)
+
+(define (gc-stat-ref key) (cadr (assq key (gc-stat))))
+
+;; Live bytes in the heap, after a full collection.
+(define (live-bytes)
+  (gc) (gc)
+  (- (gc-stat-ref :total-heap-size) (gc-stat-ref :free-bytes)))
+
+(define *cities* '#("Tokyo" "Osaka" "Nagoya" "Sapporo" "Fukuoka" "Kobe"))
+(define *products* (list->vector (map (^i #"product-~i") (iota 200))))
+
+(define *csv-text*
+  (let1 m (make <mersenne-twister> :seed 42)
+    (with-output-to-string
+      (^[] (dotimes [i *nrows*]
+             (format #t "~d,~a,~a,~d\n" i
+                     (vector-ref *cities* (mt-random-integer m 6))
+                     (vector-ref *products* (mt-random-integer m 200))
+                     (mt-random-integer m 1000)))))))
+
+(define *json-text*
+  (let1 m (make <mersenne-twister> :seed 42)
+    (with-output-to-string
+      (^[] (display "[")
+           (dotimes [i (quotient *nrows* 10)]
+             (unless (zero? i) (display ","))
+             (format #t "{\"id\":~d,\"city\":~s,\"product\":~s,\"status\":~s}"
+                     i
+                     (vector-ref *cities* (mt-random-integer m 6))
+                     (vector-ref *products* (mt-random-integer m 200))
+                     (if (zero? (mt-random-integer m 2)) "active" "inactive")))
+           (display "]")))))
+
+(define (bench name thunk)
+  (print name)
+  (let* ([b0 (live-bytes)]
+         [r (time (thunk))]
+         [b1 (live-bytes)])
+    (format #t "  ~d bytes retained\n" (- b1 b0))
+    (set! r #f)))
+
+(define (read-csv intern)
+  (call-with-input-string *csv-text*
+    (^p (let1 reader (make-csv-reader #\, #\" intern)
+          (let loop ([rows '()])
+            (let1 r (reader p)
+              (if (eof-object? r) rows (loop (cons r rows)))))))))
+
+(define *lines-text*
+  (let1 m (make <mersenne-twister> :seed 42)
+    (with-output-to-string
+      (^[] (dotimes [i *nrows*]
+             (print (vector-ref *products* (mt-random-integer m 200))))))))
+
+(define (read-lines intern)
+  (call-with-input-string *lines-text*
+    (^p (let loop ([lines '()])
+          (let1 l (read-line p #f intern)
+            (if (eof-object? l) lines (loop (cons l lines))))))))
+
+(define (read-json intern)
+  (parameterize ([json-intern-strings intern])
+    (parse-json-string *json-text*)))
+
+(bench "csv, not interned"        (^[] (read-csv #f)))
+(bench "csv, interned"            (^[] (read-csv #t)))
+(bench "csv, interned up to 16"   (^[] (read-csv 16)))
+(bench "json, not interned"       (^[] (read-json #f)))
+(bench "json, interned"           (^[] (read-json #t)))
+(bench "read-line, not interned"  (^[] (read-lines #f)))
+(bench "read-line, interned"      (^[] (read-lines #t)))
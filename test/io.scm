@@ -103,6 +103,15 @@
              :if-exists #f)
            (call-with-input-file "tmp2.o" read)))
 
+(test* "write-output-string-chunks to file port" 30003
+       (let1 src (open-output-string)
+         (dotimes [i 10000] (display "abc" src))
+         (call-with-output-file "tmp2.o"
+           (^p (display "<" p)
+               (write-output-string-chunks src p)
+               (display ">" p)))
+         (string-length (call-with-input-file "tmp2.o" port->string))))
+
 ;;-------------------------------------------------------------------
 (test-section "port-attributes")
 
@@ -290,6 +299,32 @@
                (and (eof-object? s3)
                     (list (string-size s1) (string-size s2)))))))
 
+(with-output-to-file "tmp1.o" (cut display "abc\nabcdef\nabc\nabcdef\n"))
+(test* "read-line (intern)" '(#t #t #t)
+       (call-with-input-file "tmp1.o"
+         (^p (let* ([l1 (read-line p #f #t)]
+                    [l2 (read-line p #f #t)]
+                    [l3 (read-line p #f #t)]
+                    [l4 (read-line p #f #t)])
+               (list (eq? l1 l3) (eq? l2 l4) (string-immutable? l1))))))
+(test* "read-line (intern with limit)" '(#t #f)
+       (call-with-input-file "tmp1.o"
+         (^p (let* ([l1 (read-line p #f 3)]
+                    [l2 (read-line p #f 3)]
+                    [l3 (read-line p #f 3)]
+                    [l4 (read-line p #f 3)])
+               (list (eq? l1 l3) (eq? l2 l4))))))
+(test* "read-line (intern, shared with string-intern)" '(#t #t)
+       (call-with-input-file "tmp1.o"
+         (^p (let* ([l1 (read-line p #f #t)]
+                    [l2 (read-line p #f 10)])
+               (list (eq? l1 (string-intern (string-copy "abc")))
+                     (eq? l2 (string-intern (string-copy "abcdef"))))))))
+(test* "read-line (intern, bad argument)" (test-error)
+       (call-with-input-file "tmp1.o" (cut read-line <> #f 'yes)))
+(test* "read-line (intern, bad argument)" (test-error)
+       (call-with-input-file "tmp1.o" (cut read-line <> #f 1.5)))
+
 (with-output-to-file "tmp1.o"
   (cut display "a b c \"d e\" f g\n(0 1 2\n3 4 5)\n"))
 
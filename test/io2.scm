@@ -225,6 +225,78 @@
          (set-cdr! a a)
          (format/ss "The answer is ~s ~s" a a)))
 
+;;---------------------------------------------------------------
+(test-section "write (circular only)")
+
+;; write first checks the structure for cycles without the walk pass,
+;; and falls back to the walk pass if it can't prove there's none.
+(define %write-stats (with-module gauche.internal %write-stats))
+
+(define (write-stat key) (cadr (assq key (%write-stats))))
+
+(test* "acyclic" "((a b) (a b) #(c d) #(c d))"
+       (let ([x '(a b)] [y (vector 'c 'd)])
+         (write-to-string (list x x y y))))
+(test* "acyclic, dotted" "(a b . #(c (d . e) \"f\"))"
+       (write-to-string '(a b . #(c (d . e) "f"))))
+(test* "acyclic, shared tail" "((a b c) (x b c) . #(b c))"
+       (let1 x '(b c)
+         (write-to-string `((a ,@x) (x ,@x) . ,(list->vector x)))))
+(test* "acyclic stream without walk" '(#t #f)
+       (let ([o (write-stat :optimistic)]
+             [w (write-stat :walked)])
+         (write-to-string '(a #(b (c)) "d" 1.0))
+         (list (> (write-stat :optimistic) o)
+               (> (write-stat :walked) w))))
+
+(test* "cycle" "#0=(a . #0#)"
+       (let1 x (list 'a)
+         (set-cdr! x x)
+         (write-to-string x)))
+(test* "cycle" "(x y #0=(a b . #0#))"
+       (let1 x (list 'a 'b)
+         (set-cdr! (cdr x) x)
+         (write-to-string (list 'x 'y x))))
+(test* "cycle, shared but not circular" "#0=(a (b #0#) (c) (c))"
+       (let* ([c '(c)]
+              [x (list 'a (list 'b #f) c c)])
+         (set-car! (cdadr x) x)
+         (write-to-string x)))
+(test* "cycle through dotted tail" "#0=(a . #(#0#))"
+       (let* ([v (vector #f)]
+              [x (cons 'a v)])
+         (vector-set! v 0 x)
+         (write-to-string x)))
+(test* "cycle through vector" "#(a #0=#(b #0#))"
+       (let1 v (vector 'b #f)
+         (vector-set! v 1 v)
+         (write-to-string (vector 'a v))))
+(test* "cycle falls back to walk" #t
+       (let ([c (write-stat :cycles)]
+             [x (list 'a)])
+         (set-car! x x)
+         (write-to-string x)
+         (> (write-stat :cycles) c)))
+
+(test* "deeply nested, acyclic"
+       (list (string-append (make-string 100 #\() "a" (make-string 100 #\)))
+             #t)
+       (let1 d (write-stat :too-deep)
+         (list (write-to-string (fold (^[_ x] (list x)) 'a (iota 100)))
+               (> (write-stat :too-deep) d))))
+(test* "deeply nested, cyclic"
+       (string-append "#0=" (make-string 100 #\() "#0#"
+                      (make-string 100 #\)))
+       (let* ([x (list #f)]
+              [y (fold (^[_ x] (list x)) x (iota 99))])
+         (set-car! x y)
+         (write-to-string y)))
+
+(test* "display" "#0=(a b . #0#)"
+       (let1 x (list "a" 'b)
+         (set-cdr! (cdr x) x)
+         (write-to-string x display)))
+
 ;;---------------------------------------------------------------
 (test-section "read/ss basic")
 
@@ -0,0 +1,61 @@
+;;
+;; a short test program to measure the cost of loops compiled into
+;; local jumps (named let, do, and internal self-recursive procedures).
+;;
+
+(use gauche.time)
+
+(define *count* 10000000)
+
+(define *vec* (make-vector 1000 1))
+(define *str* (make-string 1000 #\a))
+
+(define (bench name thunk)
+  (print name)
+  (time (thunk)))
+
+(bench "named let, one induction variable"
+       (^[] (let loop ([i 0])
+              (when (< i *count*) (loop (+ i 1))))))
+
+(bench "named let, induction variable and accumulator"
+       (^[] (let loop ([i 0] [s 0])
+              (if (< i *count*) (loop (+ i 1) (+ s i)) s))))
+
+(bench "named let, loop-invariant argument"
+       (^[] (let loop ([i 0] [n *count*] [s 0])
+              (if (< i n) (loop (+ i 1) n (+ s 1)) s))))
+
+(bench "do loop"
+       (^[] (do ([i 0 (+ i 1)] [s 0 (+ s i)])
+                [(= i *count*) s])))
+
+(bench "loop with a let in the body"
+       (^[] (let loop ([i 0] [s 0])
+              (let ([j (+ i 1)] [t (+ s 1)])
+                (if (< j *count*) (loop j t) t)))))
+
+(bench "nested loops over a vector"
+       (^[] (let outer ([k 0] [s 0])
+              (if (< k (quotient *count* 1000))
+                (outer (+ k 1)
+                       (let inner ([i 0] [s s])
+                         (if (< i 1000)
+                           (inner (+ i 1) (+ s (vector-ref *vec* i)))
+                           s)))
+                s))))
+
+(bench "internal define loop over a string"
+       (^[] (define (count-a i n)
+              (cond [(= i 1000) n]
+                    [(eqv? (string-ref *str* i) #\a) (count-a (+ i 1) (+ n 1))]
+                    [else (count-a (+ i 1) n)]))
+            (dotimes [k (quotient *count* 1000)] (count-a 0 0))))
+
+(bench "loop with flonum accumulator"
+       (^[] (let loop ([i 0] [x 0.0])
+              (if (< i *count*) (loop (+ i 1) (+ x 0.5)) x))))
+
+(bench "loop whose frame is captured every iteration"
+       (^[] (let loop ([i 0] [p #f])
+              (when (< i (quotient *count* 10)) (loop (+ i 1) (^[] i))))))
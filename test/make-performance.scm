@@ -0,0 +1,39 @@
+;;
+;; a short test program to measure the cost of instantiating classes
+;; with make, with and without user-defined initialize methods.
+;;
+
+(use gauche.time)
+
+(define *count* 1000000)
+
+(define-class <point> ()
+  ((x :init-keyword :x :init-value 0)
+   (y :init-keyword :y :init-value 0)))
+
+(define-class <point3> (<point>)
+  ((z :init-keyword :z :init-value 0)
+   (tag :init-form (list 'point))))
+
+(define-class <initialized-point> (<point>)
+  ((norm)))
+
+(define-method initialize ((p <initialized-point>) initargs)
+  (next-method)
+  (slot-set! p 'norm (+ (abs (~ p'x)) (abs (~ p'y)))))
+
+(define (bench name thunk)
+  (print name)
+  (time (thunk)))
+
+(bench "make, no initargs"
+       (^[] (dotimes [i *count*] (make <point>))))
+
+(bench "make, with initargs"
+       (^[] (dotimes [i *count*] (make <point> :x i :y 1))))
+
+(bench "make, subclass with init-form"
+       (^[] (dotimes [i *count*] (make <point3> :y i :z 2))))
+
+(bench "make, with initialize method"
+       (^[] (dotimes [i *count*] (make <initialized-point> :x i :y 1))))
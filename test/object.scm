@@ -133,6 +133,43 @@
 (test* "make <r> :a" '(9 5) (slot-values r2))
 (test* "make <r> :a :b" '(20 100) (slot-values r3))
 
+(define-class <r2> (<r>)
+  ((c :init-keyword :c :init-thunk (let1 n 0 (^[] (inc! n) n)))
+   (d :init-keyword :a)
+   (e)))
+
+(define-method slot-values ((obj <r2>))
+  (map (^s (and (slot-bound? obj s) (slot-ref obj s))) '(a b c d e)))
+
+(test* "make <r2>" '(4 5 1 #f #f) (slot-values (make <r2>)))
+(test* "make <r2> :c" '(4 5 0 #f #f) (slot-values (make <r2> :c 0)))
+(test* "make <r2> (thunk)" '(4 5 2 #f #f) (slot-values (make <r2>)))
+(test* "make <r2> (shared keyword)" '(7 5 3 7 #f)
+       (slot-values (make <r2> :a 7)))
+(test* "make <r2> (duplicate keyword)" '(7 5 4 7 #f)
+       (slot-values (make <r2> :a 7 :a 8)))
+(test* "make <r2> (unknown keyword)" '(4 5 5 #f #f)
+       (slot-values (make <r2> :z 7)))
+(test* "make <r2> (incomplete key list)" (test-error)
+       (make <r2> :a))
+(test* "make <r2> (instance is fresh)" #f
+       (let ([x (make <r2> :b 1)] [y (make <r2> :b 2)])
+         (slot-set! x 'e 'x)
+         (slot-bound? y 'e)))
+(test* "make <r2> (#<undef> as absent)" '(4 5 8 #f #f)
+       (slot-values (make <r2> :a (undefined))))
+(test* "make <r2> (#<undef> as absent, thunk)" '(4 5 9 #f #f)
+       (slot-values (make <r2> :c (undefined))))
+(test* "make <r2> (#<undef> as absent, duplicate keyword)" '(4 5 10 #f #f)
+       (slot-values (make <r2> :a (undefined) :a 8)))
+
+(define-method initialize ((obj <r2>) initargs)
+  (next-method)
+  (slot-set! obj 'e 'init))
+
+(test* "make <r2> (initialize method added later)" '(4 5 11 #f init)
+       (slot-values (make <r2>)))
+
 ;;----------------------------------------------------------------
 (test-section "slot allocations")
 
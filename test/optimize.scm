@@ -64,6 +64,54 @@
 (test* "constant closure identity" #t
        (eq? (make-constant-closure) (make-constant-closure)))
 
+(test-section "inlining map and for-each")
+
+;; map and for-each with literal lambda are expanded into a local loop,
+;; so the lambda closing over the outer variable shouldn't make a closure.
+(test* "for-each with closing lambda" '()
+       (filter-insn (^(xs y) (for-each (^k (print (+ k y))) xs)) 'CLOSURE))
+(test* "map with closing lambda" '()
+       (filter-insn (^(xs ys z) (map (^[k l] (+ k l z)) xs ys)) 'CLOSURE))
+
+(test* "inlined map" '(11 22 33)
+       (let1 z 10 (map (^k (+ k z)) '(1 2 3))))
+(test* "inlined map (n-ary)" '((1 a) (2 b))
+       (let1 z list (map (^[k l] (z k l)) '(1 2 3) '(a b))))
+(test* "inlined for-each" '(3 2 1)
+       (let1 r '() (for-each (^k (push! r k)) '(1 2 3)) r))
+(test* "inlined for-each (n-ary)" '((2 . b) (1 . a))
+       (let1 r '() (for-each (^[k l] (push! r (cons k l))) '(1 2) '(a b c)) r))
+(test* "inlined map (improper list)" (test-error)
+       (let1 z 1 (map (^k (+ k z)) '(1 2 . 3))))
+(test* "inlined for-each (improper list)" (test-error)
+       (for-each (^[k l] k) '(1 2) '(a . b)))
+
+(test-section "auto-inlining")
+
+(define-module auto-inline-test
+  (declare (auto-inline))
+  (export ai-add1 ai-big)
+  (define (ai-add1 x) (+ x 1))
+  (define (ai-big x)
+    (list (list x x) (list x x) (list x x) (list x x) (list x x))))
+
+(import auto-inline-test)
+
+;; Small procedures from auto-inline module are inlined with a guard.
+(define (call-ai-add1 x) (ai-add1 x))
+(test* "auto-inlined call (guard)" 1
+       (length (filter-insn call-ai-add1 'BNEQC)))
+(test* "auto-inlined call" 4 (call-ai-add1 3))
+(test* "auto-inlined call (argument count mismatch)" (test-error)
+       (ai-add1 1 2))
+(test* "too big to auto-inline" 0
+       (length (filter-insn (^x (ai-big x)) 'BNEQC)))
+
+;; Redefinition is honored by the guard.
+(with-module auto-inline-test
+  (set! ai-add1 (^x (- x 1))))
+(test* "auto-inlined call (redefined)" 2 (call-ai-add1 3))
+
 (test-section "transformation")
 
 ;; pass2 intermediate lref elimination
@@ -138,5 +186,51 @@
            (test (bar)))
          (foo)))
 
+;;----------------------------------------------------------------
+(test-section "loops")
+
+;; A self tail call of a loop reuses the loop's env frame in place,
+;; unless the frame has been captured.
+
+(test* "loop with env frame reuse" '(4950 100)
+       (let loop ([i 0] [s 0])
+         (if (< i 100)
+           (loop (+ i 1) (+ s i))
+           (list s i))))
+
+(test* "loop from an inner frame" 4950
+       (let loop ([i 0] [s 0])
+         (let ([j (+ i 1)] [t (+ s i)])
+           (if (< j 100)
+             (loop j t)
+             t))))
+
+(test* "loop capturing the loop variable" '(0 1 2 3 4)
+       (let loop ([i 0] [r '()])
+         (if (< i 5)
+           (loop (+ i 1) (cons (^[] i) r))
+           (map (^p (p)) (reverse r)))))
+
+(test* "loop with mutated loop variable" '(0 2 4 6 8)
+       (let loop ([i 0] [r '()])
+         (if (< i 5)
+           (let1 p (^[] i)
+             (set! i (* i 2))
+             (loop (+ (quotient i 2) 1) (cons p r)))
+           (map (^p (p)) (reverse r)))))
+
+(test* "loop with non-tail self call" 120
+       (let loop ([n 5])
+         (if (= n 0) 1 (* n (loop (- n 1))))))
+
+(test* "loop re-entered by a continuation" '(3 2 1 0)
+       (let ([k #f] [r '()])
+         (let loop ([i 0])
+           (when (< i 3)
+             (when (= i 1) (call/cc (^c (set! k c))))
+             (loop (+ i 1))))
+         (set! r (cons (length r) r))
+         (if (< (length r) 4) (k #f) r)))
+
 (test-end)
 
@@ -0,0 +1,74 @@
+;;;
+;;; Compare row-based relations and the columnar relation of util.relation.
+;;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use util.relation)
+(use math.mt-random)
+
+(define *nrows* 100000)
+
+(define-class <sale> ()
+  ((region :init-keyword :region)
+   (item   :init-keyword :item)
+   (qty    :init-keyword :qty)
+   (price  :init-keyword :price)))
+
+(define *rows*
+  (let ([m (make <mersenne-twister> :seed 42)]
+        [regions '#(east west north south)]
+        [items   (list->vector (map (^i (string->symbol #"item~i")) (iota 50)))])
+    (map (^_ (vector (vector-ref regions (mt-random-integer m 4))
+                     (vector-ref items (mt-random-integer m 50))
+                     (mt-random-integer m 100)
+                     (* 1.0 (mt-random-integer m 1000))))
+         (iota *nrows*))))
+
+(define *columns* '(region item qty price))
+
+(define simple (make <simple-relation> :columns *columns* :rows *rows*))
+
+(define objects
+  (make <object-set-relation>
+    :class <sale>
+    :rows (map (^[row] (make <sale>
+                         :region (vector-ref row 0) :item (vector-ref row 1)
+                         :qty (vector-ref row 2) :price (vector-ref row 3)))
+               *rows*)))
+
+(define columnar
+  (make <columnar-relation> :columns *columns*
+        :types (list #f #f <s32vector> <f64vector>)
+        :rows *rows*))
+
+(define indexed
+  (rlet1 r (relation->columnar-relation columnar
+                                        (list #f #f <s32vector> <f64vector>))
+    (relation-add-index! r 'item 'hash)
+    (relation-add-index! r 'qty 'sorted)))
+
+(define (bench title thunk-maker)
+  (print title)
+  (time-these/report
+   '(cpu 3)
+   `((simple       . ,(thunk-maker simple))
+     (object-set   . ,(thunk-maker objects))
+     (columnar     . ,(thunk-maker columnar))
+     (with-index   . ,(thunk-maker indexed)))))
+
+(bench "filter (qty < 10 and price >= 500)"
+       (^r (^[] (size-of (relation-rows
+                          (relation-filter r (^[q p] (and (< q 10) (>= p 500)))
+                                           'qty 'price))))))
+
+(bench "lookup (item = item7)"
+       (^r (^[] (relation-lookup r 'item 'item7))))
+
+(bench "range (40 <= qty < 42)"
+       (^r (^[] (relation-range r 'qty 40 42))))
+
+(bench "group-by region, sum and mean"
+       (^r (^[] (relation-group-by r '(region)
+                                   '((n count) (total sum qty)
+                                     (avg mean price))))))
@@ -686,6 +686,39 @@ Content-Length: 4349
               #f)))))
                      
 (dotimes (n 8) (mime-roundtrip-tester n))
+;; Bodies larger than the internal buffer of mime-port, with things
+;; that look like a boundary near the block borders.
+(let* ([boundary "xyzzy"]
+       [filler (^[n] (make-string n #\a))]
+       [bodies (list (string-append (filler 65530) "\r\n--xyzz" (filler 100))
+                     (string-append (filler 65535) "\n--xyzzyx" (filler 70000))
+                     ""
+                     "\r\n--xyzzy-\r")]
+       [msg (string-append
+             "prologue\r\n"
+             (string-join (map (^[body]
+                                 #"--~|boundary|\r\n\r\n~|body|\r\n")
+                               bodies)
+                          "")
+             #"--~|boundary|--\r\nepilogue\r\n")]
+       [headers `(("content-type" ,#"multipart/mixed; boundary=~boundary"))])
+  (test* "mime-parse-message (large bodies)" bodies
+         (map (cut ref <> 'content)
+              (ref (call-with-input-string msg
+                     (cut mime-parse-message <> headers
+                          (cut mime-body->string <> <>)))
+                   'content)))
+  (test* "mime-body-for-each" (map string-length bodies)
+         (map (cut ref <> 'content)
+              (ref (call-with-input-string msg
+                     (cut mime-parse-message <> headers
+                          (^[part inp]
+                            (rlet1 n 0
+                              (mime-body-for-each part inp
+                                                  (^v (inc! n (size-of v)))
+                                                  :chunk-size 1000)))))
+                   'content)))
+  )
     
 ;;--------------------------------------------------------------------
 (test-section "rfc.uri")
@@ -319,6 +319,25 @@
 (test* "string-split (bad limit)" (test-error)
        (string-split "--aa--bbb---c-c-" #/-+/ 'a))
 
+;;-------------------------------------------------------------------
+(test-section "string-intern")
+
+(let ([a (string-intern (string #\a #\b #\c))]
+      [b (string-intern (string-copy "xabcx" 1 4))])
+  (test* "string-intern" "abc" a)
+  (test* "string-intern (shared)" #t (eq? a b))
+  (test* "string-intern (immutable)" #t (string-immutable? a))
+  (test* "string-intern (distinct)" #f (eq? a (string-intern "abd")))
+  (test* "string-intern (empty)" #t
+         (eq? (string-intern (string)) (string-intern (string-copy ""))))
+  (test* "string-intern (incomplete)" '(#t #f)
+         (let ([x (string-intern (string-complete->incomplete "abc"))]
+               [y (string-intern (string-complete->incomplete "abc"))])
+           (list (eq? x y) (eq? x a))))
+  (test* "string-intern (limit)" #t (eq? a (string-intern (string-copy "abc") 3)))
+  (let1 s (string-copy "abcd")
+    (test* "string-intern (over limit)" #t (eq? s (string-intern s 3)))))
+
 ;;-------------------------------------------------------------------
 (test-section "incomplete strings")
 
@@ -615,6 +634,46 @@
                    (* *dstr-init-size* (+ *dstr-incr-factor* 1))
                    )
 
+(let ()
+  (define (chunk-tester size-hint . args)
+    (let1 out (open-output-string :size-hint size-hint)
+      (for-each (^s (display s out)) args)
+      out))
+  (define str10000 (make-string 10000 #\z))
+
+  (test* "get-output-string-chunks (empty)" '()
+         (get-output-string-chunks (chunk-tester 0)))
+  (test* "get-output-string-chunks (small)" '("abc")
+         (get-output-string-chunks (chunk-tester 0 "a" "b" "c")))
+  (test* "get-output-string-chunks (large)" (list #t str10000)
+         (let1 chunks (get-output-string-chunks (chunk-tester 0 str10000))
+           (list (every string-immutable? chunks)
+                 (apply string-append chunks))))
+  (test* "get-output-string-chunks (size hint)" (list str10000)
+         (get-output-string-chunks (chunk-tester 10000 str10000)))
+  (test* "get-output-string-chunks (keep writing)" '("abc" "abcdef")
+         (let* ([out (chunk-tester 100 "abc")]
+                [c0 (get-output-string-chunks out)])
+           (display "def" out)
+           (list (apply string-append c0)
+                 (apply string-append (get-output-string-chunks out)))))
+  (test* "get-output-u8vector" '(3 #t)
+         (let1 v (get-output-u8vector (chunk-tester 0 "abc"))
+           (list (uvector-length v) (uvector-immutable? v))))
+  (test* "get-output-u8vector (size hint)" '(10000 #t)
+         (let1 v (get-output-u8vector (chunk-tester 20000 str10000))
+           (list (uvector-length v) (uvector-immutable? v))))
+  (test* "get-output-u8vector (large)" 10001
+         (uvector-length (get-output-u8vector (chunk-tester 0 "a" str10000))))
+  (test* "write-output-string-chunks" (string-append "<" str10000 ">")
+         (let ([in (chunk-tester 0 str10000)]
+               [out (open-output-string)])
+           (display "<" out)
+           (write-output-string-chunks in out)
+           (display ">" out)
+           (get-output-string out)))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "string interpolation")
 
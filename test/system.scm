@@ -634,6 +634,70 @@
       ))
   (cmd-rmrf "test.out")
 
+  ;; Under the incremental GC, the pages of the heap that contain pointers
+  ;; are write-protected between collections, and a system call that
+  ;; writes into such a page fails with EFAULT.  We run a child with
+  ;; GAUCHE_GC_INCREMENTAL, and call the procedures whose system calls
+  ;; write back into heap objects, interleaved with allocation and
+  ;; collection so that the results land on protected pages.
+  (when (file-exists? "./gosh")
+    (cmd-rmrf "test.out")
+    (with-output-to-file "test.out"
+      (lambda ()
+        (for-each
+         write
+         '((use gauche.termios)
+           (use gauche.fcntl)
+           (define keep '())
+           (define (churn i)
+             (dotimes [j 200] (push! keep (list i j)))
+             (when (zero? (modulo i 20)) (set! keep '()) (gc)))
+           (define pty
+             (and (global-variable-bound? 'gauche.termios 'sys-openpty)
+                  (receive (master slave) (sys-openpty) slave)))
+           (define (check i)
+             (let1 p (open-input-file "test.out")
+               (and (eq? (sys-stat->file-type (sys-stat ".")) 'directory)
+                    (= (sys-stat->size (sys-fstat p))
+                       (sys-stat->size (sys-stat "test.out")))
+                    (receive (in out) (sys-pipe)
+                      (write-byte 1 out) (flush out)
+                      (let1 rfds (make <sys-fdset>)
+                        (sys-fdset-set! rfds in #t)
+                        (receive (n r w e) (sys-select rfds #f #f 0)
+                          (close-port in) (close-port out)
+                          (and (eqv? n 1) (sys-fdset-ref r in)))))
+                    (let1 old (sys-sigmask SIG_BLOCK (sys-sigset SIGUSR1))
+                      (and (is-a? (sys-sigmask SIG_SETMASK old) <sys-sigset>)
+                           (is-a? old <sys-sigset>)))
+                    (or (not pty)
+                        (is-a? (sys-tcgetattr pty) <sys-termios>))
+                    (let1 fl (make <sys-flock>)
+                      (slot-set! fl 'type F_RDLCK)
+                      (sys-fcntl p F_GETLK fl)
+                      (eqv? (slot-ref fl 'type) F_UNLCK))
+                    (begin (close-port p) #t))))
+           (write
+            (list (cadr (assq :incremental (gc-stat)))
+                  (guard (e [else (condition-message e)])
+                    (let loop ([i 0] [ok 0])
+                      (if (= i 300)
+                        ok
+                        (begin (churn i)
+                               (loop (+ i 1) (if (check i) (+ ok 1) ok))))))))
+           ))))
+    (test* "system calls under incremental GC" '(#t 300)
+           (receive (in out) (sys-pipe)
+             (sys-setenv "GAUCHE_GC_INCREMENTAL" "" #t)
+             (let1 pid (unwind-protect
+                           (sys-fork-and-exec "./gosh"
+                                              `("./gosh" "-ftest" "./test.out")
+                                              :iomap `((1 . ,out)))
+                         (sys-unsetenv "GAUCHE_GC_INCREMENTAL"))
+               (close-port out)
+               (begin0 (read in) (sys-waitpid pid)))))
+    (cmd-rmrf "test.out"))
+
   ;; Testing GC in forked process---we don't explicitly spawn a thread here,
   ;; but some architecture (OSX 10.7.3, at least) seems to create a thread
   ;; implicitly.  In the child process all threads are gone except one,
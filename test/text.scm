@@ -45,6 +45,15 @@
        (eof-object?
         (call-with-input-string "" (make-csv-reader #\,))))
 
+(test* "csv-reader (intern)" '(("a" "xyz" "b") #t #f)
+       (call-with-input-string "a,xyz,b\na,xyz,\"b\"\n"
+         (^p (let* ([r (make-csv-reader #\, #\" 2)]
+                    [x (r p)]
+                    [y (r p)])
+               (list x
+                     (and (eq? (car x) (car y)) (eq? (caddr x) (caddr y)))
+                     (eq? (cadr x) (cadr y)))))))
+
 (test* "csv-writer"
        "abc,def,123,\"what's up?\",\"he said, \"\"nothing new.\"\"\"\n"
        (call-with-output-string
@@ -116,6 +125,26 @@ fuga
        "&lt;class&gt;"
        (html-escape-string '<class>))
 
+(let1 s (string-append (make-string 20 #\a) (string #\x3042) "<&>\""
+                       (make-string 13 #\b) "&")
+  (test* "html-escape-string (long)"
+         (string-append (make-string 20 #\a) (string #\x3042)
+                        "&lt;&amp;&gt;&quot;" (make-string 13 #\b) "&amp;")
+         (html-escape-string s))
+  (test* "html-escape" (html-escape-string s)
+         (with-string-io s html-escape)))
+
+(test* "html-escape-string (nothing to escape)"
+       (string-append (make-string 30 #\z) (string #\x3042))
+       (html-escape-string (string-append (make-string 30 #\z)
+                                          (string #\x3042))))
+
+(test* "html-escape-string (nothing to escape, fresh string)" '(#f "zzz")
+       (let* ([s (string-copy "zzz")]
+              [r (html-escape-string s)])
+         (string-set! s 0 #\a)
+         (list (eq? r s) r)))
+
 (test* "html-doctype"
        '("<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01//EN\""
          "\"http://www.w3.org/TR/html4/strict.dtd\">" "")
@@ -414,5 +443,14 @@ fuga
 (test* "tree->string" "ab" (tree->string '(a b)))
 (test* "tree->string" "Ab" (tree->string '(|A| . :b)))
 (test* "tree->string" "ab" (tree->string '((((() ())) . a) ((((b)))))))
+(test* "tree->string" "a1x2.5" (tree->string '(a (1 #\x) . 2.5)))
+(test* "tree->string (deep)" (make-string 100 #\a)
+       (tree->string (fold (^[_ t] (list t "a")) '() (iota 100))))
+
+(define-class <tree-test-node> () ((name :init-keyword :name)))
+(define-method write-tree ((node <tree-test-node>) out)
+  (write-tree `("<" ,(~ node'name) ">") out))
+(test* "write-tree (custom leaf)" "a<b>#t"
+       (tree->string `(a (,(make <tree-test-node> :name 'b)) #t)))
 
 (test-end)
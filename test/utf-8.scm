@@ -306,6 +306,14 @@
        (let1 s (open-input-string "なむ\n")
          (peek-byte s) (read-line s)))
 
+;; chunk boundaries may split multibyte chars
+(test* "get-output-string-chunks" (make-list 2 (make-string 1000 #\あ))
+       (let1 out (open-output-string)
+         (write-string (make-string 1000 #\あ) out)
+         (let1 chunks (get-output-string-chunks out)
+           (list (string-incomplete->complete (apply string-append chunks))
+                 (get-output-string out)))))
+
 ;;-------------------------------------------------------------------
 (test-section "buffered ports")
 
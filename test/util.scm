@@ -743,6 +743,126 @@
   (test* "simple-relation (relation-fold)" 1644
          (relation-fold r + 0 'a 'c))
   )
+
+;; relational operators; the generic version and the columnar version
+;; should agree.
+(define (relation->lists r)
+  (let1 coerce (relation-coercer r)
+    (map (^[row] (coerce-to <list> (coerce row))) r)))
+
+(define *sales-columns* '(region item qty price))
+(define *sales-rows*
+  '(#(east apple 3 100) #(west apple 1 100) #(east pear 2 150)
+    #(north apple 5 90) #(west pear 4 150) #(east apple 7 80)))
+
+(let ([s (make <simple-relation>
+           :columns *sales-columns* :rows *sales-rows*)]
+      [c (make <columnar-relation>
+           :columns *sales-columns* :rows *sales-rows*)])
+  (define (both name expected op)
+    (test* #"~name (simple)" expected (relation->lists (op s)))
+    (test* #"~name (columnar)" expected (relation->lists (op c))))
+
+  (test* "columnar-relation (size-of)" 6 (size-of c))
+  (test* "columnar-relation (relation-ref)" '(east west east north west east)
+         (map (cut relation-ref c <> 'region) c))
+  (test* "columnar-relation (relation-fold)" 22
+         (relation-fold c + 0 'qty))
+  (test* "columnar-relation-column" #(100 100 150 90 150 80)
+         (columnar-relation-column c 'price))
+
+  (both "relation-filter" '((east apple 3 100) (east apple 7 80))
+        (cut relation-filter <> (^[r i] (and (eq? r 'east) (eq? i 'apple)))
+             'region 'item))
+  (both "relation-project" '((apple 3) (apple 1) (pear 2) (apple 5) (pear 4) (apple 7))
+        (cut relation-project <> '(item qty)))
+  (both "relation-lookup" '((west apple 1 100) (west pear 4 150))
+        (cut relation-lookup <> 'region 'west))
+  (both "relation-range" '((east apple 3 100) (east pear 2 150) (west pear 4 150))
+        (cut relation-range <> 'qty 2 5))
+  (both "relation-range (open)" '((north apple 5 90) (east apple 7 80))
+        (cut relation-range <> 'qty 5 #f))
+  (both "relation-group-by"
+        '((east 3 12 80 150 4) (west 2 5 100 150 5/2) (north 1 5 90 90 5))
+        (cut relation-group-by <> '(region)
+             '((n count) (total sum qty) (lo min price) (hi max price)
+               (avg mean qty))))
+  (both "relation-group-by (multiple keys)"
+        '((east apple (3 7)) (west apple (1)) (east pear (2))
+          (north apple (5)) (west pear (4)))
+        (cut relation-group-by <> '(region item) `((qtys ,identity qty))))
+  (both "relation-group-by (no keys)" '((6 22))
+        (cut relation-group-by <> '() '((n count) (total sum qty))))
+
+  (test* "relation-add-index!" '(#f #t #t)
+         (list (relation-add-index! s 'region)
+               (relation-add-index! c 'region)
+               (relation-add-index! c 'qty 'sorted)))
+  (both "relation-lookup (hash index)" '((north apple 5 90))
+        (cut relation-lookup <> 'region 'north))
+  (both "relation-range (sorted index)"
+        '((east apple 3 100) (north apple 5 90) (west pear 4 150))
+        (cut relation-range <> 'qty 3 6))
+
+  ;; indexes should follow the updates
+  (test* "columnar-relation (insert with index)" '((north apple 5 90) (north pear 6 120))
+         (begin
+           (relation-insert! c '#(north pear 6 120))
+           (relation->lists (relation-lookup c 'region 'north))))
+  (test* "columnar-relation (set with index)"
+         '((east apple 3 100) (north apple 5 90) (west pear 4 150) (north pear 6 120))
+         (begin
+           (relation-set! c 5 'qty 70)
+           (relation->lists (relation-range c 'qty 3 7))))
+  (test* "columnar-relation (delete with index)" '((north pear 6 120))
+         (begin
+           (relation-delete! c 3)
+           (relation->lists (relation-lookup c 'region 'north))))
+  (test* "columnar-relation (delete)" '(east west east west east north)
+         (map (cut relation-ref c <> 'region) c))
+  )
+
+(test* "relation->columnar-relation" '((east apple 3 100))
+       (relation->lists
+        (relation-lookup (relation->columnar-relation
+                          (make <simple-relation>
+                            :columns *sales-columns* :rows *sales-rows*))
+                         'qty 3)))
+
+(use gauche.uvector)
+(let1 c (make <columnar-relation>
+          :columns *sales-columns* :rows *sales-rows*
+          :types `(#f #f ,<s32vector> ,<f64vector>))
+  (test* "columnar-relation (typed, columnar-relation-column)"
+         '#f64(100.0 100.0 150.0 90.0 150.0 80.0)
+         (columnar-relation-column c 'price))
+  (test* "columnar-relation (typed, relation-lookup)"
+         '((east apple 3 100.0))
+         (relation->lists (relation-lookup c 'qty 3)))
+  (test* "columnar-relation (typed, relation-lookup, key normalization)"
+         '((east pear 2 150.0) (west pear 4 150.0))
+         (relation->lists (relation-lookup c 'price 150)))
+  (test* "columnar-relation (typed, relation-lookup, inexact key)"
+         '((east apple 3 100.0))
+         (relation->lists (relation-lookup c 'qty 3.0)))
+  (test* "columnar-relation (typed, relation-lookup, non-number)" '()
+         (relation->lists (relation-lookup c 'qty 'three)))
+  (test* "columnar-relation (typed, relation-lookup, non-real)" '()
+         (relation->lists (relation-lookup c 'price 1+2i)))
+  (test* "columnar-relation (typed, relation-lookup, infinity)" '()
+         (relation->lists (relation-lookup c 'qty +inf.0)))
+  (test* "columnar-relation (typed, hash index)"
+         '(() ((north apple 5 90.0)))
+         (begin
+           (relation-add-index! c 'qty)
+           (list (relation->lists (relation-lookup c 'qty "5"))
+                 (relation->lists (relation-lookup c 'qty 5)))))
+  )
+
+(test* "columnar-relation (growth)" (iota 1000)
+       (let1 c (make <columnar-relation> :columns '(x))
+         (dotimes [i 1000] (relation-insert! c (list i)))
+         (map (cut relation-ref c <> 'x) c)))
 ;;-----------------------------------------------
 (test-section "util.stream")
 (use util.stream)
@@ -1084,6 +1204,52 @@
            (let1 h (coerce-to <hash-table> t6)
              (every (cut hash-table-get h <>) strs)))
     )
+
+  ;; ordering and prefix match
+  (let1 t7 (make-trie)
+    (for-each (^s (trie-put! t7 s (string-length s))) strs)
+    (for-each (^v (trie-put! t7 v 'u8)) uvecs)
+    (for-each (^l (trie-put! t7 l 'list)) '((#\k #\u) (#\k #\u #\a)))
+    (test* "trie: keys in order" (sort strs)
+           (filter string? (trie-keys t7)))
+    (test* "trie: iterator in order" (sort strs)
+           (filter string? (map car (coerce-to <list> t7))))
+    (test* "trie: exists? (prefix)" '(#t #f #f)
+           (list (trie-exists? t7 "kane") (trie-exists? t7 "kan")
+                 (trie-exists? t7 '(#\k))))
+    (test* "trie: common-prefix with a list"
+           '("ku" "kua" "kua`aina" "kua`ana" (#\k #\u) (#\k #\u #\a))
+           (trie-common-prefix-keys t7 '(#\k #\u))
+           (cut lset= equal? <> <>))
+    (test* "trie: common-prefix with a u8vector"
+           (map string->u8vector '("lili`u" "liliko`i" "lilinoe"))
+           (trie-common-prefix-keys t7 (string->u8vector "lili"))
+           (cut lset= equal? <> <>))
+    (test* "trie: common-prefix of integers" 4
+           (length (trie-common-prefix t7 (map char->integer '(#\l #\i)))))
+    (test* "trie: longest-match" '(("kua" . 3) ("kane make" . 9) ("" . 0))
+           (map (cut trie-longest-match t7 <>)
+                '("kua`a" "kane maker" "humuhumu")))
+    (test* "trie: longest-match (u8vector)" (cons '#u8(107 117) 'u8)
+           (trie-longest-match t7 (string->u8vector "kuz")))
+    (test* "trie: longest-match (list)" '((#\k #\u #\a) . list)
+           (trie-longest-match t7 '(#\k #\u #\a #\` #\a)))
+    (test* "trie: longest-match (none)" #f
+           (trie-longest-match t7 '(#\l)))
+    (test* "trie: num-entries" (+ (* 2 (length strs)) 2)
+           (trie-num-entries t7))
+    )
+  (let1 t8 (make-trie list
+                      (cut assoc-ref <> <> #f char-ci=?)
+                      (^[t k v] (if v
+                                  (assoc-set! t k v char-ci=?)
+                                  (alist-delete! k t char-ci=?)))
+                      (^[t f s] (fold f s t)))
+    (for-each (^s (trie-put! t8 s (string-length s))) strs)
+    (test* "trie(custom): longest-match" '("KANE" . 4)
+           (let1 p (trie-longest-match t8 "KANEOHE")
+             (cons (string-upcase (car p)) (cdr p))))
+    )
   )
 
 (test-end)